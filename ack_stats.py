@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""
+Agrégation des accusés d'exécution (<device>/ack) de l'ESP32 IO Controller
+Distribution du retard (lateness) et de la gigue par appareil, pour le suivi SLA.
+Optionnellement, envoie lui-même des commandes programmées portant un "id".
+"""
+
+import argparse
+import csv
+import json
+import statistics
+import sys
+import threading
+import time
+import uuid
+
+import paho.mqtt.client as mqtt
+
+# ========== CONFIGURATION ==========
+MQTT_BROKER = "localhost"
+MQTT_PORT = 1883
+PERCENTILES = [50, 90, 99, 99.9]
+HISTOGRAM_BOUNDS_US = [100, 250, 500, 1000, 2500, 5000, 10000, 50000]
+
+
+class DeviceStats:
+    def __init__(self):
+        self.lateness_us = []
+        self.results = {}
+        self.pending = {}  # id -> heure d'envoi (commandes émises par ce script)
+
+    def add(self, receipt):
+        result = receipt.get("result", "executed")
+        self.results[result] = self.results.get(result, 0) + 1
+        if result == "executed":
+            self.lateness_us.append(receipt.get("lateness_us", 0))
+
+
+devices = {}
+lock = threading.Lock()
+csv_writer = None
+
+
+def percentile(values, p):
+    """Percentile par interpolation linéaire (valeurs triées)"""
+    if not values:
+        return 0
+    k = (len(values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(values) - 1)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def histogram(values):
+    counts = [0] * (len(HISTOGRAM_BOUNDS_US) + 1)
+    for v in values:
+        bucket = 0
+        while bucket < len(HISTOGRAM_BOUNDS_US) and abs(v) >= HISTOGRAM_BOUNDS_US[bucket]:
+            bucket += 1
+        counts[bucket] += 1
+    return counts
+
+
+def print_report():
+    with lock:
+        snapshot = {name: (sorted(s.lateness_us), dict(s.results), len(s.pending)) for name, s in devices.items()}
+    if not snapshot:
+        print("Aucun accusé reçu.")
+        return
+    print()
+    print("=" * 78)
+    print(f"{'Appareil':<16}{'N':>7}{'moy µs':>10}{'gigue µs':>10}" + "".join(f"{'p' + str(p):>9}" for p in PERCENTILES) + f"{'max':>9}")
+    print("-" * 78)
+    for name, (values, results, pending) in sorted(snapshot.items()):
+        if values:
+            mean = statistics.fmean(values)
+            jitter = statistics.pstdev(values) if len(values) > 1 else 0.0
+            line = f"{name:<16}{len(values):>7}{mean:>10.0f}{jitter:>10.0f}"
+            line += "".join(f"{percentile(values, p):>9.0f}" for p in PERCENTILES)
+            line += f"{values[-1]:>9}"
+        else:
+            line = f"{name:<16}{0:>7}"
+        print(line)
+        others = {k: v for k, v in results.items() if k != "executed"}
+        if others or pending:
+            print(f"{'':<16}non exécutées: {others}  sans accusé: {pending}")
+        if values:
+            labels = [f"<{b}" for b in HISTOGRAM_BOUNDS_US] + [f">={HISTOGRAM_BOUNDS_US[-1]}"]
+            counts = histogram(values)
+            print(f"{'':<16}" + "  ".join(f"{l}:{c}" for l, c in zip(labels, counts) if c))
+    print("=" * 78)
+
+
+def on_connect(client, userdata, flags, reason_code, properties):
+    if reason_code != 0:
+        print(f"❌ Connexion au broker refusée ({reason_code})")
+        return
+    client.subscribe(f"{userdata['device']}/ack", qos=1)
+    print(f"✓ Abonné à {userdata['device']}/ack")
+
+
+def on_message(client, userdata, msg):
+    device = msg.topic.rsplit("/", 1)[0]
+    try:
+        receipt = json.loads(msg.payload)
+    except ValueError:
+        return
+    with lock:
+        stats = devices.setdefault(device, DeviceStats())
+        stats.add(receipt)
+        stats.pending.pop(receipt.get("id"), None)
+    if csv_writer:
+        csv_writer.writerow([device, receipt.get("id"), receipt.get("pin"), receipt.get("state"),
+                             receipt.get("result"), receipt.get("received_us"), receipt.get("scheduled_us"),
+                             receipt.get("executed_us"), receipt.get("lateness_us"), receipt.get("time_quality")])
+    if userdata["verbose"]:
+        print(f"[{device}] {receipt.get('id')} {receipt.get('result')} lateness={receipt.get('lateness_us')} µs")
+
+
+def drive(client, args):
+    """Commandes programmées alternées (0/1) sur --pin de chaque appareil, toutes les --interval s"""
+    targets = args.drive.split(",")
+    state = 1
+    while True:
+        exec_time = time.time() + args.delay
+        exec_at = int(exec_time)
+        exec_at_us = int((exec_time - exec_at) * 1000000)
+        for device in targets:
+            command_id = uuid.uuid4().hex[:12]
+            with lock:
+                devices.setdefault(device, DeviceStats()).pending[command_id] = time.time()
+            payload = json.dumps({"state": state, "exec_at": exec_at, "exec_at_us": exec_at_us, "id": command_id})
+            client.publish(f"{device}/control/{args.pin}/set", payload, qos=1)
+        state ^= 1
+        time.sleep(args.interval)
+
+
+def main():
+    global csv_writer
+    parser = argparse.ArgumentParser(description="Distribution du retard d'exécution à partir de <device>/ack")
+    parser.add_argument("--broker", default=MQTT_BROKER)
+    parser.add_argument("--port", type=int, default=MQTT_PORT)
+    parser.add_argument("--device", default="+", help="Appareil écouté (défaut: tous)")
+    parser.add_argument("--duration", type=float, default=0, help="Arrêt après N secondes (0 = Ctrl+C)")
+    parser.add_argument("--report", type=float, default=30, help="Rapport toutes les N secondes")
+    parser.add_argument("--csv", help="Enregistre chaque accusé dans ce fichier CSV")
+    parser.add_argument("--drive", help="Envoie des commandes programmées à ces appareils (liste séparée par des virgules)")
+    parser.add_argument("--pin", default="RelaisK1", help="Broche commandée avec --drive")
+    parser.add_argument("--delay", type=float, default=1.0, help="exec_at = maintenant + N secondes (--drive)")
+    parser.add_argument("--interval", type=float, default=2.0, help="Période des commandes (--drive)")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    csv_file = None
+    if args.csv:
+        csv_file = open(args.csv, "w", newline="")
+        csv_writer = csv.writer(csv_file)
+        csv_writer.writerow(["device", "id", "pin", "state", "result", "received_us", "scheduled_us",
+                             "executed_us", "lateness_us", "time_quality"])
+
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id=f"ack-stats-{uuid.uuid4().hex[:6]}",
+                         userdata={"device": args.device, "verbose": args.verbose})
+    client.on_connect = on_connect
+    client.on_message = on_message
+    try:
+        client.connect(args.broker, args.port, 60)
+    except OSError as e:
+        print(f"❌ Broker injoignable: {e}")
+        sys.exit(1)
+    client.loop_start()
+
+    if args.drive:
+        threading.Thread(target=drive, args=(client, args), daemon=True).start()
+
+    started = time.time()
+    next_report = started + args.report
+    try:
+        while not args.duration or time.time() - started < args.duration:
+            time.sleep(0.5)
+            if time.time() >= next_report:
+                print_report()
+                next_report += args.report
+    except KeyboardInterrupt:
+        pass
+    finally:
+        client.loop_stop()
+        client.disconnect()
+        print_report()
+        if csv_file:
+            csv_file.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""
+Banc du serveur Modbus TCP de l'ESP32 IO Controller (modbus_tcp.h)
+
+Plusieurs maîtres (--clients, une connexion chacun) envoient des requêtes en
+boucle pendant --duration secondes, avec --pipeline requêtes en vol par
+connexion. Chaque réponse est contrôlée (transaction, fonction, longueur,
+exception) ; le banc donne le débit en transactions/s et la latence côté
+client (p50/p90/p99/max), puis le temps de service mesuré par l'appareil.
+
+  python3 modbus_tcp_bench.py 192.168.1.50 --coil 16 --input 4
+  python3 modbus_tcp_bench.py 192.168.1.50 --mix read --clients 4 --pipeline 4
+  python3 modbus_tcp_bench.py 192.168.1.50 --coil 16 --mix write   (bascule la sortie)
+
+Adresses : numéro de broche (FC 1 coils = sorties, FC 2 entrées TOR = entrées).
+"""
+
+import argparse
+import json
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+import urllib.request
+
+FC_READ_COILS = 1
+FC_READ_DISCRETE_INPUTS = 2
+FC_WRITE_SINGLE_COIL = 5
+FC_WRITE_MULTIPLE_COILS = 15
+
+EXCEPTIONS = {1: "fonction", 2: "adresse", 3: "valeur", 4: "défaillance", 6: "occupé"}
+
+
+def percentile(values, p):
+    """Percentile par interpolation linéaire (valeurs triées)"""
+    if not values:
+        return 0
+    k = (len(values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(values) - 1)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def build_request(args, rng, state):
+    """PDU suivant selon --mix ; state garde l'état écrit de la sortie"""
+    kind = args.mix
+    if kind == "mixed":
+        kind = "write" if rng.random() < args.write_ratio else "read"
+    if kind == "write":
+        state[0] ^= 1
+        if args.multiple:
+            return struct.pack(">BHHBB", FC_WRITE_MULTIPLE_COILS, args.coil, 1, 1, state[0])
+        return struct.pack(">BHH", FC_WRITE_SINGLE_COIL, args.coil, 0xFF00 if state[0] else 0)
+    if args.input is not None and rng.random() < 0.5:
+        return struct.pack(">BHH", FC_READ_DISCRETE_INPUTS, args.input, args.count)
+    return struct.pack(">BHH", FC_READ_COILS, args.coil, args.count)
+
+
+def check_response(request, pdu):
+    """None si la réponse correspond à la requête, sinon la raison"""
+    function = request[0]
+    if not pdu:
+        return "réponse vide"
+    if pdu[0] == function | 0x80:
+        code = pdu[1] if len(pdu) > 1 else 0
+        return f"exception {code} ({EXCEPTIONS.get(code, '?')})"
+    if pdu[0] != function:
+        return f"fonction {pdu[0]} au lieu de {function}"
+    if function in (FC_READ_COILS, FC_READ_DISCRETE_INPUTS):
+        count = struct.unpack(">H", request[3:5])[0]
+        if len(pdu) != 2 + (count + 7) // 8 or pdu[1] != (count + 7) // 8:
+            return "longueur de lecture"
+    elif pdu != request[:5]:
+        return "écho d'écriture différent"
+    return None
+
+
+class Master(threading.Thread):
+    """Un maître : une connexion, jusqu'à --pipeline requêtes en vol"""
+
+    def __init__(self, index, args, stop):
+        super().__init__(daemon=True)
+        self.args = args
+        self.stop = stop
+        self.rng = random.Random(args.seed + index)
+        self.state = [0]
+        self.latencies = []
+        self.errors = {}
+        self.transactions = 0
+        self.failure = None
+
+    def error(self, reason):
+        self.errors[reason] = self.errors.get(reason, 0) + 1
+
+    def run(self):
+        try:
+            sock = socket.create_connection((self.args.host, self.args.port), timeout=self.args.timeout)
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        except OSError as e:
+            self.failure = f"connexion : {e}"
+            return
+        in_flight = {}   # transaction -> (envoi en s, requête)
+        buffer = b""
+        transaction = 0
+        try:
+            while True:
+                while not self.stop.is_set() and len(in_flight) < self.args.pipeline:
+                    transaction = (transaction + 1) & 0xFFFF
+                    pdu = build_request(self.args, self.rng, self.state)
+                    frame = struct.pack(">HHHB", transaction, 0, len(pdu) + 1, self.args.unit) + pdu
+                    in_flight[transaction] = (time.perf_counter(), pdu)
+                    sock.sendall(frame)
+                if not in_flight:
+                    break
+                data = sock.recv(4096)
+                if not data:
+                    self.failure = "connexion fermée par l'appareil"
+                    break
+                buffer += data
+                while len(buffer) >= 7:
+                    tid, protocol, length, _unit = struct.unpack(">HHHB", buffer[:7])
+                    if len(buffer) < 6 + length:
+                        break
+                    pdu = buffer[7:6 + length]
+                    buffer = buffer[6 + length:]
+                    sent = in_flight.pop(tid, None)
+                    if sent is None or protocol != 0:
+                        self.error("transaction inconnue")
+                        continue
+                    self.latencies.append((time.perf_counter() - sent[0]) * 1e6)
+                    self.transactions += 1
+                    reason = check_response(sent[1], pdu)
+                    if reason:
+                        self.error(reason)
+        except socket.timeout:
+            self.failure = f"pas de réponse en {self.args.timeout} s ({len(in_flight)} requête(s) en vol)"
+        except OSError as e:
+            self.failure = f"socket : {e}"
+        finally:
+            sock.close()
+
+
+def fetch_stats(host):
+    try:
+        with urllib.request.urlopen(f"http://{host}/api/modbus/tcp", timeout=3) as response:
+            return json.loads(response.read())
+    except Exception:
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Débit et latence du serveur Modbus TCP")
+    parser.add_argument("host", help="adresse IP de l'appareil")
+    parser.add_argument("--port", type=int, default=502)
+    parser.add_argument("--unit", type=int, default=1, help="identifiant d'unité (renvoyé tel quel)")
+    parser.add_argument("--clients", type=int, default=2, help="maîtres simultanés (4 au plus côté appareil)")
+    parser.add_argument("--pipeline", type=int, default=1, help="requêtes en vol par connexion")
+    parser.add_argument("--duration", type=float, default=10.0)
+    parser.add_argument("--mix", choices=("read", "write", "mixed"), default="read")
+    parser.add_argument("--write-ratio", type=float, default=0.2, help="part d'écritures en --mix mixed")
+    parser.add_argument("--coil", type=int, default=16, help="première broche lue en FC 1, sortie écrite")
+    parser.add_argument("--input", type=int, help="première broche lue en FC 2 (sinon FC 1 seulement)")
+    parser.add_argument("--count", type=int, default=8, help="bits par lecture")
+    parser.add_argument("--multiple", action="store_true", help="écritures en FC 15 au lieu de FC 5")
+    parser.add_argument("--timeout", type=float, default=2.0)
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    stop = threading.Event()
+    masters = [Master(i, args, stop) for i in range(args.clients)]
+    start = time.perf_counter()
+    for master in masters:
+        master.start()
+    time.sleep(args.duration)
+    stop.set()
+    for master in masters:
+        master.join(args.timeout + 1)
+    elapsed = time.perf_counter() - start
+
+    latencies = sorted(l for m in masters for l in m.latencies)
+    transactions = sum(m.transactions for m in masters)
+    errors = {}
+    for master in masters:
+        for reason, count in master.errors.items():
+            errors[reason] = errors.get(reason, 0) + count
+
+    print(f"📊 {transactions} transactions en {elapsed:.2f} s : {transactions / elapsed:.0f} tr/s "
+          f"({args.clients} maître(s), pipeline {args.pipeline}, {args.mix})")
+    for i, master in enumerate(masters):
+        line = f"   maître {i} : {master.transactions} tr"
+        if master.failure:
+            line += f"  ❌ {master.failure}"
+        print(line)
+    if latencies:
+        print(f"   latence µs : p50 {percentile(latencies, 50):.0f}  p90 {percentile(latencies, 90):.0f}  "
+              f"p99 {percentile(latencies, 99):.0f}  max {latencies[-1]:.0f}")
+    for reason, count in sorted(errors.items()):
+        print(f"❌ {count} réponse(s) : {reason}")
+
+    stats = fetch_stats(args.host)
+    if stats:
+        service = stats.get("serviceUs", {})
+        print(f"   appareil : service min/moy/max {service.get('min')}/{service.get('avg')}/{service.get('max')} µs, "
+              f"{stats.get('exceptions')} exception(s), {stats.get('busy')} file pleine, "
+              f"{stats.get('rejected')} connexion(s) refusée(s)")
+    failed = errors or any(m.failure for m in masters) or transactions == 0
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
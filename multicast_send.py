@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""
+Envoi de commandes synchronisées via le canal UDP multicast (sans broker)
+Construit et signe les trames MulticastFrame décrites dans src/multicast.h
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import socket
+import struct
+import sys
+import time
+
+# ========== CONFIGURATION ==========
+MULTICAST_GROUP = "239.10.0.1"
+MULTICAST_PORT = 5007
+MULTICAST_TTL = 1  # Reste sur le LAN
+
+MAGIC = 0x434D4F49  # "IOMC"
+VERSION = 1
+MAC_LEN = 16
+
+# magic, version, state, reserved, senderId, seq, sent_at, exec_at, exec_at_us, group, pin
+HEADER_FORMAT = "<IBBHIIIII16s32s"
+
+
+def build_frame(key, sender_id, seq, pin, state, exec_at=0, exec_at_us=0, group=""):
+    """Construit une trame signée (HMAC-SHA256 tronqué à 128 bits)"""
+    header = struct.pack(
+        HEADER_FORMAT,
+        MAGIC, VERSION, 1 if state else 0, 0,
+        sender_id, seq, int(time.time()),
+        exec_at, exec_at_us,
+        group.encode()[:15], pin.encode()[:31],
+    )
+    mac = hmac.new(key.encode(), header, hashlib.sha256).digest()[:MAC_LEN]
+    return header + mac
+
+
+def open_socket():
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, MULTICAST_TTL)
+    return sock
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Commande UDP multicast signée pour ESP32 IO Controller")
+    parser.add_argument("pin", help="Nom de la broche (ex: RelaisK1)")
+    parser.add_argument("state", type=int, choices=[0, 1], help="État désiré")
+    parser.add_argument("--key", default=os.environ.get("ESP32_MULTICAST_KEY"), help="Clé partagée (ou ESP32_MULTICAST_KEY)")
+    parser.add_argument("--group", default="", help="Groupe ciblé (vide = tous les appareils)")
+    parser.add_argument("--delay", type=float, default=0.0, help="Exécution programmée dans N secondes (0 = immédiat)")
+    parser.add_argument("--repeat", type=int, default=2, help="Nombre d'envois de la même trame (les doublons sont ignorés)")
+    parser.add_argument("--address", default=MULTICAST_GROUP)
+    parser.add_argument("--port", type=int, default=MULTICAST_PORT)
+    args = parser.parse_args()
+
+    if not args.key:
+        print("❌ Clé partagée requise (--key ou ESP32_MULTICAST_KEY)")
+        sys.exit(1)
+
+    exec_at, exec_at_us = 0, 0
+    if args.delay > 0:
+        exec_time = time.time() + args.delay
+        exec_at = int(exec_time)
+        exec_at_us = int((exec_time - exec_at) * 1000000)
+
+    sender_id = struct.unpack("<I", os.urandom(4))[0]
+    # Séquence dérivée de l'horloge : croissante d'une exécution du script à l'autre
+    seq = int(time.time() * 1000) & 0xFFFFFFFF
+    frame = build_frame(args.key, sender_id, seq, args.pin, args.state, exec_at, exec_at_us, args.group)
+
+    sock = open_socket()
+    # La même trame peut être répétée pour tolérer une perte UDP : l'ESP32 ignore les doublons
+    for _ in range(max(1, args.repeat)):
+        sock.sendto(frame, (args.address, args.port))
+    sock.close()
+
+    target = f"groupe '{args.group}'" if args.group else "tous les appareils"
+    when = f"à {exec_at}.{exec_at_us:06d}" if exec_at else "immédiatement"
+    print(f"✓ {args.pin} -> {args.state} envoyé à {target} {when} ({len(frame)} octets, seq {seq})")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+"""
+Mises à jour compressées et différentielles de l'ESP32 IO Controller (/api/ota)
+
+  make   ancien.bin nouveau.bin   patch IODP (gzip) du firmware en service vers le nouveau
+  gzip   nouveau.bin              image complète compressée
+  apply  ancien.bin patch         applique un patch sur le PC (vérification)
+  upload <ip> fichier             envoie une image, une image gzip ou un patch
+
+Le format IODP est décrit dans src/ota_update.h. Le patch ne s'applique qu'au
+firmware dont il a été calculé (SHA-256 vérifié par l'appareil avant d'écrire).
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import struct
+import sys
+import urllib.error
+import urllib.request
+import uuid
+
+IODP_MAGIC = b"IODP"
+IODP_VERSION = 1
+IODP_END, IODP_COPY, IODP_INSERT = 0, 1, 2
+HEADER = struct.Struct("<4sII32sI32s")   # 80 octets
+
+BLOCK = 32        # Correspondance minimale reprise du firmware en service (une COPY coûte 9 octets)
+ALIGN = 4         # Les blocs de l'ancien firmware sont indexés tous les 4 octets
+ESP_IMAGE_MAGIC = 0xE9
+
+
+def read_file(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def write_file(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def make_ops(old, new):
+    """Liste de ("copy", offset, longueur) et ("insert", octets) qui reconstruit `new`"""
+    index = {}
+    for i in range(0, len(old) - BLOCK + 1, ALIGN):
+        index.setdefault(old[i:i + BLOCK], i)
+
+    ops = []
+    literal = bytearray()
+    j = 0
+    while j < len(new):
+        k = index.get(new[j:j + BLOCK]) if j + BLOCK <= len(new) else None
+        if k is None:
+            literal.append(new[j])
+            j += 1
+            continue
+        # Extension vers l'avant, par blocs de 64 octets puis octet par octet
+        n = BLOCK
+        while j + n + 64 <= len(new) and k + n + 64 <= len(old) and old[k + n:k + n + 64] == new[j + n:j + n + 64]:
+            n += 64
+        while j + n < len(new) and k + n < len(old) and old[k + n] == new[j + n]:
+            n += 1
+        # Extension vers l'arrière sur les littéraux en attente
+        while literal and k > 0 and old[k - 1] == literal[-1]:
+            literal.pop()
+            j -= 1
+            k -= 1
+            n += 1
+        if literal:
+            ops.append(("insert", bytes(literal)))
+            literal = bytearray()
+        ops.append(("copy", k, n))
+        j += n
+    if literal:
+        ops.append(("insert", bytes(literal)))
+    return ops
+
+
+def encode_patch(old, new, ops):
+    out = bytearray(HEADER.pack(IODP_MAGIC, IODP_VERSION, len(old), hashlib.sha256(old).digest(),
+                                len(new), hashlib.sha256(new).digest()))
+    for op in ops:
+        if op[0] == "copy":
+            out += struct.pack("<BII", IODP_COPY, op[1], op[2])
+        else:
+            out += struct.pack("<BI", IODP_INSERT, len(op[1])) + op[1]
+    out.append(IODP_END)
+    return bytes(out)
+
+
+def apply_patch(old, patch):
+    """Même contrôle que l'appareil : empreinte source, opérations, empreinte cible"""
+    if patch[:2] == b"\x1f\x8b":
+        patch = gzip.decompress(patch)
+    magic, version, source_size, source_sha, target_size, target_sha = HEADER.unpack_from(patch)
+    if magic != IODP_MAGIC or version != IODP_VERSION:
+        raise ValueError("en-tête IODP invalide")
+    if hashlib.sha256(old[:source_size]).digest() != source_sha:
+        raise ValueError("le patch a été calculé pour un autre firmware")
+    out = bytearray()
+    pos = HEADER.size
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == IODP_END:
+            break
+        if op == IODP_COPY:
+            offset, length = struct.unpack_from("<II", patch, pos)
+            pos += 8
+            if offset + length > source_size:
+                raise ValueError("COPY hors du firmware source")
+            out += old[offset:offset + length]
+        elif op == IODP_INSERT:
+            (length,) = struct.unpack_from("<I", patch, pos)
+            pos += 4
+            out += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError(f"opération inconnue {op}")
+    if pos != len(patch):
+        raise ValueError("données après la fin du patch")
+    if len(out) != target_size or hashlib.sha256(out).digest() != target_sha:
+        raise ValueError("image reconstruite incorrecte")
+    return bytes(out)
+
+
+def cmd_make(args):
+    old = read_file(args.old)
+    new = read_file(args.new)
+    ops = make_ops(old, new)
+    patch = encode_patch(old, new, ops)
+    if not args.no_gzip:
+        patch = gzip.compress(patch, compresslevel=9, mtime=0)
+    apply_patch(old, patch)   # Auto-vérification avant de livrer le patch
+
+    output = args.output or args.new + (".iodp" if args.no_gzip else ".iodp.gz")
+    write_file(output, patch)
+    copied = sum(op[2] for op in ops if op[0] == "copy")
+    full_gzip = len(gzip.compress(new, compresslevel=9, mtime=0))
+    print(f"✓ {output}: {len(patch)} octets")
+    print(f"  image {len(new)} octets, gzip seul {full_gzip} octets, patch {100.0 * len(patch) / len(new):.1f} %")
+    print(f"  {copied} octets repris du firmware en service ({100.0 * copied / max(1, len(new)):.1f} %), "
+          f"{sum(1 for op in ops if op[0] == 'copy')} COPY, {sum(1 for op in ops if op[0] == 'insert')} INSERT")
+    print(f"  sha256 cible {hashlib.sha256(new).hexdigest()}")
+
+
+def cmd_gzip(args):
+    data = read_file(args.image)
+    output = args.output or args.image + ".gz"
+    write_file(output, gzip.compress(data, compresslevel=9, mtime=0))
+    print(f"✓ {output}: {len(data)} -> {len(read_file(output))} octets")
+    print(f"  sha256 {hashlib.sha256(data).hexdigest()}")
+
+
+def cmd_apply(args):
+    image = apply_patch(read_file(args.old), read_file(args.patch))
+    if args.output:
+        write_file(args.output, image)
+    print(f"✓ patch valide : {len(image)} octets, sha256 {hashlib.sha256(image).hexdigest()}")
+
+
+def expected_sha256(data):
+    """Empreinte de l'image finale pour ?sha256= (un patch porte la sienne)"""
+    if data[:2] == b"\x1f\x8b":
+        data = gzip.decompress(data)
+    if data[:4] == IODP_MAGIC:
+        return None
+    if not data or data[0] != ESP_IMAGE_MAGIC:
+        raise ValueError("ni image ESP32, ni gzip, ni patch IODP")
+    return hashlib.sha256(data).hexdigest()
+
+
+def cmd_upload(args):
+    data = read_file(args.file)
+    sha = args.sha256 or expected_sha256(data)
+    url = f"http://{args.host}/api/ota" + (f"?sha256={sha}" if sha else "")
+    boundary = uuid.uuid4().hex
+    body = (f"--{boundary}\r\nContent-Disposition: form-data; name=\"firmware\"; filename=\"firmware.bin\"\r\n"
+            f"Content-Type: application/octet-stream\r\n\r\n").encode() + data + f"\r\n--{boundary}--\r\n".encode()
+    request = urllib.request.Request(url, data=body, method="POST",
+                                     headers={"Content-Type": f"multipart/form-data; boundary={boundary}"})
+    print(f"📤 {args.file} ({len(data)} octets) -> {url}")
+    try:
+        with urllib.request.urlopen(request, timeout=args.timeout) as response:
+            print(json.dumps(json.loads(response.read()), indent=2, ensure_ascii=False))
+    except urllib.error.HTTPError as e:
+        print(f"❌ HTTP {e.code}: {e.read().decode(errors='replace')}")
+        sys.exit(1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Mises à jour compressées et différentielles (/api/ota)")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("make", help="patch IODP de ancien.bin vers nouveau.bin")
+    p.add_argument("old", help="firmware en service (.pio/build/.../firmware.bin de la version installée)")
+    p.add_argument("new", help="nouveau firmware")
+    p.add_argument("-o", "--output")
+    p.add_argument("--no-gzip", action="store_true", help="patch non compressé")
+    p.set_defaults(func=cmd_make)
+
+    p = sub.add_parser("gzip", help="image complète compressée")
+    p.add_argument("image")
+    p.add_argument("-o", "--output")
+    p.set_defaults(func=cmd_gzip)
+
+    p = sub.add_parser("apply", help="applique un patch sur le PC")
+    p.add_argument("old")
+    p.add_argument("patch")
+    p.add_argument("-o", "--output")
+    p.set_defaults(func=cmd_apply)
+
+    p = sub.add_parser("upload", help="envoie un fichier à /api/ota")
+    p.add_argument("host", help="adresse IP de l'appareil")
+    p.add_argument("file", help="image, image gzip ou patch")
+    p.add_argument("--sha256", help="empreinte attendue de l'image finale (calculée si absente)")
+    p.add_argument("--timeout", type=float, default=300)
+    p.set_defaults(func=cmd_upload)
+
+    args = parser.parse_args()
+    try:
+        args.func(args)
+    except ValueError as e:
+        print(f"❌ {e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -62,6 +62,50 @@ def control_relay(relay_num, action):
         print(f"❌ Error: {e}")
         return False
 
+def control_batch(assignments, delay=None):
+    """
+    Set several outputs in one request (/api/io/batch)
+
+    Args:
+        assignments (list): "Name=state" strings, e.g. ["RelaisK1=1", "RelaisK2=0"]
+        delay (float): optional delay in seconds; all outputs switch together at now + delay
+
+    Returns:
+        bool: True if every operation was accepted, False otherwise
+    """
+    ops = []
+    for item in assignments:
+        name, sep, state = item.partition("=")
+        if not sep or state not in ("0", "1"):
+            print(f"Error: expected Name=0 or Name=1, got '{item}'")
+            return False
+        ops.append({"name": name, "state": int(state)})
+
+    body = {"ops": ops}
+    if delay is not None:
+        # exec_at is absolute: the device clock must be synchronized (NTP or MQTT)
+        exec_at = time.time() + delay
+        body["exec_at"] = int(exec_at)
+        body["exec_at_us"] = int((exec_at % 1) * 1e6)
+
+    url = f"{BASE_URL}/api/io/batch"
+    try:
+        print(f"Sending {len(ops)} operation(s) to: {url}")
+        response = requests.post(url, json=body, timeout=5)
+        result = response.json()
+        for op in result.get("results", []):
+            mark = "✅" if op["result"] in ("queued", "scheduled") else "❌"
+            print(f"  {mark} {op.get('name', op.get('pin'))}: {op['result']}")
+        return response.status_code == 200
+
+    except requests.exceptions.ConnectionError:
+        print(f"❌ Error: Cannot connect to ESP32 at {ESP32_IP}")
+        return False
+
+    except Exception as e:
+        print(f"❌ Error: {e}")
+        return False
+
 def get_relay_status():
     """
     Get current status of all relays
@@ -97,6 +141,7 @@ def print_usage():
     print("Usage:")
     print("  python relay_control.py <relay_num> <action>")
     print("  python relay_control.py status")
+    print("  python relay_control.py batch <Name=0|1>... [--at <seconds>]")
     print("")
     print("Arguments:")
     print("  relay_num: 1, 2, 3, or 4")
@@ -106,6 +151,7 @@ def print_usage():
     print("  python relay_control.py 1 start    # Turn ON relay 1")
     print("  python relay_control.py 2 stop     # Turn OFF relay 2")
     print("  python relay_control.py status     # Show all relay states")
+    print("  python relay_control.py batch RelaisK1=1 RelaisK2=0 --at 2   # Both switch together in 2 s")
     print("")
     print(f"ESP32 IP: {ESP32_IP}")
     print("")
@@ -121,6 +167,24 @@ def main():
         get_relay_status()
         return
     
+    # Several outputs in one request
+    if sys.argv[1].lower() == 'batch':
+        args = sys.argv[2:]
+        delay = None
+        if '--at' in args:
+            i = args.index('--at')
+            try:
+                delay = float(args[i + 1])
+            except (IndexError, ValueError):
+                print("❌ Error: --at expects a delay in seconds")
+                sys.exit(1)
+            del args[i:i + 2]
+        if not args or not control_batch(args, delay):
+            print("💥 Batch failed!")
+            sys.exit(1)
+        print("✨ Batch completed successfully!")
+        return
+
     # Check for relay control command
     if len(sys.argv) != 3:
         print("❌ Error: Wrong number of arguments")
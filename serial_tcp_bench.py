@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+Débit du serveur TCP du pont série de l'ESP32 IO Controller (serial_server.h)
+
+TX et RX de Serial2 reliés par un cavalier : chaque octet envoyé sur le socket
+revient par l'UART. Le script émet un flux pseudo-aléatoire pendant --duration
+secondes, vérifie qu'il revient intact et dans l'ordre, et compare le débit au
+maximum de la ligne (baud / 10 en 8N1).
+
+  python3 serial_tcp_bench.py 192.168.1.50 --baud 921600
+  python3 serial_tcp_bench.py 192.168.1.50 --raw        (serveur en mode brut)
+"""
+
+import argparse
+import json
+import random
+import select
+import socket
+import sys
+import time
+import urllib.request
+
+IAC, SB, SE, WILL, WONT, DO, DONT = 255, 250, 240, 251, 252, 253, 254
+COM_PORT_OPTION = 44
+SET_BAUDRATE = 1
+
+
+class Telnet:
+    """Juste assez de RFC 2217 pour régler le baud et séparer données et commandes"""
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.state = "data"
+        self.sb = bytearray()
+        self.replies = []
+
+    def send_subnegotiation(self, command, value):
+        escaped = value.replace(bytes([IAC]), bytes([IAC, IAC]))
+        self.sock.sendall(bytes([IAC, SB, COM_PORT_OPTION, command]) + escaped + bytes([IAC, SE]))
+
+    def feed(self, data):
+        """Octets reçus -> données (IAC IAC = 0xFF), réponses COM-PORT-OPTION dans replies"""
+        out = bytearray()
+        for c in data:
+            if self.state == "data":
+                if c == IAC:
+                    self.state = "iac"
+                else:
+                    out.append(c)
+            elif self.state == "iac":
+                if c == IAC:
+                    out.append(c)
+                    self.state = "data"
+                elif c in (WILL, WONT, DO, DONT):
+                    self.state = "option"
+                elif c == SB:
+                    self.sb = bytearray()
+                    self.state = "sb"
+                else:
+                    self.state = "data"
+            elif self.state == "option":
+                self.state = "data"   # Le serveur a déjà proposé ce qu'il accepte
+            elif self.state == "sb":
+                if c == IAC:
+                    self.state = "sb_iac"
+                else:
+                    self.sb.append(c)
+            elif self.state == "sb_iac":
+                if c == IAC:
+                    self.sb.append(c)
+                    self.state = "sb"
+                else:
+                    if c == SE and len(self.sb) >= 2 and self.sb[0] == COM_PORT_OPTION:
+                        self.replies.append((self.sb[1], bytes(self.sb[2:])))
+                    self.state = "data"
+        return bytes(out)
+
+
+def set_baud(sock, telnet, baud, timeout=2.0):
+    telnet.send_subnegotiation(SET_BAUDRATE, baud.to_bytes(4, "big"))
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        ready, _, _ = select.select([sock], [], [], 0.1)
+        if ready:
+            telnet.feed(sock.recv(4096))
+        for command, value in telnet.replies:
+            if command == SET_BAUDRATE + 100:
+                return int.from_bytes(value, "big")
+    raise RuntimeError("pas de réponse SET-BAUDRATE (serveur en mode brut ?)")
+
+
+def fetch_stats(host):
+    try:
+        with urllib.request.urlopen(f"http://{host}/api/serial/server", timeout=3) as response:
+            return json.loads(response.read())
+    except Exception:
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Débit du serveur TCP du pont série (boucle TX-RX)")
+    parser.add_argument("host", help="adresse IP de l'appareil")
+    parser.add_argument("--port", type=int, default=2217)
+    parser.add_argument("--raw", action="store_true", help="serveur en mode brut (pas de RFC 2217)")
+    parser.add_argument("--baud", type=int, default=921600, help="baud demandé en RFC 2217 ; en brut, celui configuré")
+    parser.add_argument("--duration", type=float, default=10.0)
+    parser.add_argument("--window", type=int, default=4096, help="octets envoyés et pas encore revenus, au plus")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    sock = socket.create_connection((args.host, args.port), timeout=5)
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    telnet = None if args.raw else Telnet(sock)
+    baud = args.baud
+    if telnet:
+        baud = set_baud(sock, telnet, args.baud)
+        print(f"🔧 Ligne réglée à {baud} bauds (demandé : {args.baud})")
+    line_rate = baud / 10.0
+
+    rng = random.Random(args.seed)
+    stream = bytes(rng.getrandbits(8) for _ in range(1 << 16))   # Motif rejoué en boucle
+    sent = received = errors = 0
+    first_error = None
+    sock.setblocking(False)
+    start = time.time()
+    end = start + args.duration
+    while True:
+        now = time.time()
+        if now >= end and received >= sent:
+            break
+        if now >= end + 2.0:
+            break   # Octets perdus : on n'attend pas indéfiniment
+        want_write = now < end and sent - received < args.window
+        ready_r, ready_w, _ = select.select([sock], [sock] if want_write else [], [], 0.05)
+        if ready_w:
+            offset = sent % len(stream)
+            chunk = stream[offset:offset + min(1024, args.window - (sent - received))]
+            payload = chunk.replace(bytes([IAC]), bytes([IAC, IAC])) if telnet else chunk
+            try:
+                n = sock.send(payload)
+            except BlockingIOError:
+                n = 0
+            if n == len(payload):
+                sent += len(chunk)
+            elif n > 0:
+                # Envoi partiel : le reste part en bloquant (ne pas couper un IAC doublé)
+                sock.setblocking(True)
+                sock.sendall(payload[n:])
+                sock.setblocking(False)
+                sent += len(chunk)
+        if ready_r:
+            data = sock.recv(65536)
+            if not data:
+                print("❌ Connexion fermée par l'appareil")
+                break
+            if telnet:
+                data = telnet.feed(data)
+            for i, c in enumerate(data):
+                if c != stream[(received + i) % len(stream)]:
+                    errors += 1
+                    if first_error is None:
+                        first_error = received + i
+            received += len(data)
+    elapsed = time.time() - start
+    sock.close()
+
+    rate = received / elapsed if elapsed > 0 else 0
+    print(f"📊 {sent} octets envoyés, {received} reçus en {elapsed:.2f} s")
+    print(f"   débit {rate:.0f} o/s, {100.0 * rate / line_rate:.1f} % de la ligne ({line_rate:.0f} o/s à {baud} bauds)")
+    if errors:
+        print(f"❌ {errors} octet(s) différent(s), premier à l'octet {first_error}")
+    if received < sent:
+        print(f"❌ {sent - received} octet(s) perdu(s)")
+    stats = fetch_stats(args.host)
+    if stats:
+        print(f"   appareil : tampon RX du pilote au plus {stats.get('uartRxHighWater')} / {stats.get('uartRxBuffer')} octets, "
+              f"pic UART->TCP {stats.get('uartToTcp', {}).get('peakBytesPerSec')} o/s")
+    sys.exit(1 if errors or received < sent else 0)
+
+
+if __name__ == "__main__":
+    main()
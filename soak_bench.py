@@ -0,0 +1,771 @@
+#!/usr/bin/env python3
+"""
+Banc d'endurance et de débit de l'ESP32 IO Controller, sur un seul PC Linux
+
+Un broker MQTT minimal tourne dans le script (ou mosquitto lancé localement,
+ou un broker existant) ; l'appareil y est connecté (mqttServer = IP de ce PC)
+et piloté par ses topics habituels :
+
+  commands   rafale de commandes immédiates avec "id" : débit, latence p50/p99/p999
+  scheduled  commandes exec_at : retard d'exécution (lateness_us de <device>/ack)
+  edges      rafale de fronts sur une entrée câblée à une sortie (--edge-out/--edge-in)
+  serial     flot <device>/serial/send, compté sur <device>/serial/receive (TX relié à RX)
+  churn      le broker coupe la connexion de l'appareil périodiquement : temps de
+             reconnexion, commandes perdues (broker intégré seulement)
+
+Avec --ip, le tas libre minimal est relevé sur /api/metrics pendant le banc.
+--emulate remplace la carte par un appareil simulé (mêmes topics) : valide le banc
+et mesure son propre surcoût, sans matériel.
+
+Les résultats sont comparés à une référence (--baseline) : code de sortie 1 si une
+mesure régresse au-delà de la tolérance. --save-baseline enregistre la référence.
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import shutil
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+import urllib.request
+import uuid
+
+import paho.mqtt.client as mqtt
+
+# ========== CONFIGURATION ==========
+MQTT_PORT = 1883
+DEVICE_NAME = "lilygo"
+BASELINE_FILE = "bench_baseline.json"
+SCENARIOS = ["commands", "scheduled", "edges", "serial", "churn"]
+
+# Mesures comparées à la référence : sens favorable et marge absolue tolérée en
+# plus de --tolerance (évite les fausses régressions sur de petites valeurs)
+METRICS = {
+    "commands.rate_per_s":      ("higher", 0),
+    "commands.latency_p50_ms":  ("lower", 1),
+    "commands.latency_p99_ms":  ("lower", 2),
+    "commands.latency_p999_ms": ("lower", 5),
+    "commands.device_p99_us":   ("lower", 200),
+    "commands.lost":            ("lower", 0),
+    "scheduled.lateness_p50_us":  ("lower", 100),
+    "scheduled.lateness_p99_us":  ("lower", 200),
+    "scheduled.lateness_p999_us": ("lower", 500),
+    "scheduled.lost":           ("lower", 0),
+    "edges.rate_per_s":         ("higher", 0),
+    "edges.latency_p99_ms":     ("lower", 2),
+    "edges.missed":             ("lower", 0),
+    "serial.rate_per_s":        ("higher", 0),
+    "serial.lost":              ("lower", 0),
+    "churn.reconnect_p50_ms":   ("lower", 100),
+    "churn.reconnect_max_ms":   ("lower", 250),
+    "churn.failed_reconnects":  ("lower", 0),
+    "churn.lost":               ("lower", 0),
+    "heap.min_free":            ("higher", 1024),
+}
+
+
+def now_us():
+    return time.time_ns() // 1000
+
+
+def percentile(values, p):
+    """Percentile par interpolation linéaire (valeurs triées)"""
+    if not values:
+        return 0
+    k = (len(values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(values) - 1)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def get_local_ip():
+    try:
+        s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        s.connect(("8.8.8.8", 80))
+        ip = s.getsockname()[0]
+        s.close()
+        return ip
+    except OSError:
+        return "127.0.0.1"
+
+
+def topic_matches(topic_filter, topic):
+    f = topic_filter.split("/")
+    t = topic.split("/")
+    for i, part in enumerate(f):
+        if part == "#":
+            return True
+        if i >= len(t) or (part != "+" and part != t[i]):
+            return False
+    return len(f) == len(t)
+
+
+# ========== BROKER MINIMAL (MQTT 3.1.1) ==========
+# Ce qu'utilisent l'appareil et les scripts : QoS 0/1 (2 accepté en entrée),
+# messages retenus, jokers, LWT. Pas de session persistante (session present = 0 :
+# l'appareil se réabonne à chaque connexion).
+
+def encode_packet(header, body):
+    length = len(body)
+    out = bytearray([header])
+    while True:
+        byte = length % 128
+        length //= 128
+        out.append(byte | (0x80 if length else 0))
+        if not length:
+            break
+    return bytes(out) + body
+
+
+def encode_string(data):
+    return struct.pack("!H", len(data)) + data
+
+
+class Session:
+    def __init__(self, client_id, writer):
+        self.client_id = client_id
+        self.writer = writer
+        self.subscriptions = {}   # filtre -> QoS
+        self.will = None          # (topic, payload, qos, retain)
+        self.next_pid = 1
+
+    def send_publish(self, topic, payload, qos, retain=False):
+        var = encode_string(topic.encode())
+        if qos:
+            var += struct.pack("!H", self.next_pid)
+            self.next_pid = self.next_pid % 65535 + 1
+        self.writer.write(encode_packet(0x30 | (qos << 1) | (1 if retain else 0), var + payload))
+
+
+class MiniBroker:
+    def __init__(self, port):
+        self.port = port
+        self.sessions = {}
+        self.retained = {}
+        self.received = 0
+        self.delivered = 0
+        self.loop = None
+
+    def start(self):
+        ready = threading.Event()
+        failure = []
+
+        def run():
+            self.loop = asyncio.new_event_loop()
+            asyncio.set_event_loop(self.loop)
+            try:
+                self.loop.run_until_complete(asyncio.start_server(self.handle, "0.0.0.0", self.port))
+            except OSError as e:
+                failure.append(e)
+                ready.set()
+                return
+            ready.set()
+            self.loop.run_forever()
+
+        threading.Thread(target=run, daemon=True).start()
+        ready.wait(5)
+        if failure:
+            raise failure[0]
+
+    def kick(self, client_id):
+        """Coupe brutalement la connexion d'un client (son LWT est publié)"""
+        def abort():
+            session = self.sessions.get(client_id)
+            if session:
+                session.writer.transport.abort()
+        self.loop.call_soon_threadsafe(abort)
+
+    def route(self, topic, payload, qos, retain):
+        self.received += 1
+        if retain:
+            if payload:
+                self.retained[topic] = (payload, qos)
+            else:
+                self.retained.pop(topic, None)
+        for session in list(self.sessions.values()):
+            granted = [q for f, q in session.subscriptions.items() if topic_matches(f, topic)]
+            if granted:
+                session.send_publish(topic, payload, min(qos, max(granted)))
+                self.delivered += 1
+
+    async def handle(self, reader, writer):
+        session = None
+        clean_exit = False
+        try:
+            while True:
+                header = (await reader.readexactly(1))[0]
+                length, multiplier = 0, 1
+                while True:
+                    byte = (await reader.readexactly(1))[0]
+                    length += (byte & 0x7F) * multiplier
+                    multiplier *= 128
+                    if not byte & 0x80:
+                        break
+                body = await reader.readexactly(length) if length else b""
+                kind = header >> 4
+
+                if kind == 1:      # CONNECT
+                    session = self.on_connect(body, writer)
+                    writer.write(bytes([0x20, 2, 0, 0]))
+                elif session is None:
+                    break
+                elif kind == 3:    # PUBLISH
+                    qos = (header >> 1) & 3
+                    (topic_len,) = struct.unpack_from("!H", body)
+                    topic = body[2:2 + topic_len].decode(errors="replace")
+                    pos = 2 + topic_len
+                    if qos:
+                        pid = body[pos:pos + 2]
+                        pos += 2
+                        writer.write(bytes([0x40 if qos == 1 else 0x50, 2]) + pid)
+                    self.route(topic, body[pos:], min(qos, 1), bool(header & 1))
+                elif kind == 6:    # PUBREL (QoS 2 entrant)
+                    writer.write(bytes([0x70, 2]) + body[:2])
+                elif kind == 8:    # SUBSCRIBE
+                    pid, pos, granted = body[:2], 2, bytearray()
+                    while pos < len(body):
+                        (flen,) = struct.unpack_from("!H", body, pos)
+                        topic_filter = body[pos + 2:pos + 2 + flen].decode(errors="replace")
+                        qos = min(body[pos + 2 + flen], 1)
+                        pos += 3 + flen
+                        session.subscriptions[topic_filter] = qos
+                        granted.append(qos)
+                    writer.write(encode_packet(0x90, pid + bytes(granted)))
+                    for topic, (payload, qos) in list(self.retained.items()):
+                        if any(topic_matches(f, topic) for f in session.subscriptions):
+                            session.send_publish(topic, payload, qos, retain=True)
+                elif kind == 10:   # UNSUBSCRIBE
+                    pos = 2
+                    while pos < len(body):
+                        (flen,) = struct.unpack_from("!H", body, pos)
+                        session.subscriptions.pop(body[pos + 2:pos + 2 + flen].decode(errors="replace"), None)
+                        pos += 2 + flen
+                    writer.write(bytes([0xB0, 2]) + body[:2])
+                elif kind == 12:   # PINGREQ
+                    writer.write(bytes([0xD0, 0]))
+                elif kind == 14:   # DISCONNECT
+                    clean_exit = True
+                    break
+                # PUBACK/PUBREC/PUBCOMP des clients : rien à faire sans session persistante
+        except (asyncio.IncompleteReadError, ConnectionError, struct.error, IndexError):
+            pass
+        finally:
+            if session and self.sessions.get(session.client_id) is session:
+                del self.sessions[session.client_id]
+                if session.will and not clean_exit:
+                    self.route(*session.will)
+            writer.close()
+
+    def on_connect(self, body, writer):
+        (name_len,) = struct.unpack_from("!H", body)
+        pos = 2 + name_len + 1           # Nom du protocole, niveau
+        flags = body[pos]
+        pos += 3                          # Drapeaux, keepalive
+
+        def field():
+            nonlocal pos
+            (n,) = struct.unpack_from("!H", body, pos)
+            value = body[pos + 2:pos + 2 + n]
+            pos += 2 + n
+            return value
+
+        client_id = field().decode(errors="replace") or f"anon-{uuid.uuid4().hex[:8]}"
+        session = Session(client_id, writer)
+        if flags & 0x04:
+            will_topic = field().decode(errors="replace")
+            session.will = (will_topic, field(), (flags >> 3) & 3, bool(flags & 0x20))
+        # Identifiants éventuels ignorés
+        old = self.sessions.get(client_id)
+        if old:
+            old.writer.transport.abort()
+        self.sessions[client_id] = session
+        return session
+
+
+# ========== APPAREIL SIMULÉ (--emulate) ==========
+
+class EmulatedDevice:
+    """Mêmes topics que le firmware : accusés, programmation exec_at, états, pont série"""
+
+    def __init__(self, args):
+        self.name = args.device
+        self.edge_out = args.edge_out
+        self.edge_in = args.edge_in
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id=f"{self.name}-emulated")
+        self.client.will_set(f"{self.name}/availability", "offline", qos=1, retain=True)
+        self.client.on_connect = self.on_connect
+        self.client.on_message = self.on_message
+        self.client.reconnect_delay_set(min_delay=1, max_delay=2)
+        self.client.connect(args.broker_host, args.broker_port, 30)
+        self.client.loop_start()
+
+    @property
+    def client_id(self):
+        return f"{self.name}-emulated"
+
+    def on_connect(self, client, userdata, flags, reason_code, properties):
+        client.subscribe([(f"{self.name}/control/+/set", 1), (f"{self.name}/serial/send", 1)])
+        client.publish(f"{self.name}/availability", "online", qos=1, retain=True)
+
+    def execute(self, pin, state, command_id, received_us, scheduled_us):
+        executed_us = now_us()
+        if pin == self.edge_out and self.edge_in:
+            self.client.publish(f"{self.name}/status/{self.edge_in}", str(state))
+        if command_id:
+            reference = scheduled_us or received_us
+            self.client.publish(f"{self.name}/ack", json.dumps({
+                "id": command_id, "pin": pin, "state": state, "result": "executed",
+                "received_us": received_us, "scheduled_us": scheduled_us, "executed_us": executed_us,
+                "lateness_us": executed_us - reference, "time_quality": "good"}), qos=1)
+
+    def on_message(self, client, userdata, msg):
+        received_us = now_us()
+        if msg.topic.endswith("/serial/send"):
+            client.publish(f"{self.name}/serial/receive", msg.payload)
+            return
+        pin = msg.topic.split("/")[-2]
+        command = json.loads(msg.payload)
+        state = int(command.get("state", 0))
+        scheduled_us = command.get("exec_at", 0) * 1000000 + command.get("exec_at_us", 0)
+        if scheduled_us:
+            delay = max(0.0, (scheduled_us - now_us()) / 1e6)
+            threading.Timer(delay, self.execute, (pin, state, command.get("id"), received_us, scheduled_us)).start()
+        else:
+            self.execute(pin, state, command.get("id"), received_us, 0)
+
+    def stop(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+# ========== BANC ==========
+
+class Bench:
+    def __init__(self, args):
+        self.args = args
+        self.device = args.device
+        self.lock = threading.Lock()
+        self.pending = {}         # id -> heure d'envoi (s)
+        self.acks = []            # (rtt_ms, device_us, lateness_us, result)
+        self.edge_sent = []       # heures d'envoi des fronts
+        self.edge_seen = []       # heures de réception sur status/<edge-in>
+        self.serial_received = 0
+        self.online_at = []
+        self.heap_min = None
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id=f"soak-bench-{uuid.uuid4().hex[:6]}")
+        self.client.on_connect = self.on_connect
+        self.client.on_message = self.on_message
+        self.client.max_inflight_messages_set(1000)
+        self.client.max_queued_messages_set(0)
+        self.client.connect(args.broker_host, args.broker_port, 30)
+        self.client.loop_start()
+
+    def on_connect(self, client, userdata, flags, reason_code, properties):
+        subscriptions = [(f"{self.device}/ack", 1), (f"{self.device}/availability", 1),
+                         (f"{self.device}/serial/receive", 1)]
+        if self.args.edge_in:
+            subscriptions.append((f"{self.device}/status/{self.args.edge_in}", 0))
+        client.subscribe(subscriptions)
+
+    def on_message(self, client, userdata, msg):
+        arrived = time.time()
+        topic = msg.topic
+        with self.lock:
+            if topic.endswith("/ack"):
+                try:
+                    receipt = json.loads(msg.payload)
+                except ValueError:
+                    return
+                sent = self.pending.pop(receipt.get("id"), None)
+                if sent is None:
+                    return
+                device_us = receipt.get("executed_us", 0) - receipt.get("received_us", 0)
+                self.acks.append(((arrived - sent) * 1000.0, device_us, receipt.get("lateness_us", 0),
+                                  receipt.get("result")))
+            elif topic.endswith("/availability"):
+                if msg.payload == b"online":
+                    self.online_at.append(arrived)
+            elif topic.endswith("/serial/receive"):
+                self.serial_received += 1
+            else:
+                self.edge_seen.append(arrived)
+
+    def wait_online(self, timeout):
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            with self.lock:
+                if self.online_at:
+                    return True
+            time.sleep(0.2)
+        return False
+
+    def paced(self, rate, duration):
+        """Itérateur cadencé : rend la main rate fois par seconde pendant duration s"""
+        period = 1.0 / rate
+        start = time.time()
+        next_at = start
+        n = 0
+        while time.time() - start < duration:
+            delay = next_at - time.time()
+            if delay > 0:
+                time.sleep(delay)
+            yield n
+            n += 1
+            next_at += period
+
+    def send_command(self, pin, state, exec_at=None):
+        command_id = uuid.uuid4().hex[:12]
+        payload = {"state": state, "id": command_id}
+        if exec_at is not None:
+            payload["exec_at"] = int(exec_at)
+            payload["exec_at_us"] = int((exec_at % 1) * 1000000)
+        with self.lock:
+            self.pending[command_id] = time.time()
+        self.client.publish(f"{self.device}/control/{pin}/set", json.dumps(payload), qos=1)
+
+    def reset(self):
+        with self.lock:
+            self.pending.clear()
+            self.acks = []
+            self.edge_sent = []
+            self.edge_seen = []
+            self.serial_received = 0
+
+    def drain(self):
+        deadline = time.time() + self.args.drain
+        while time.time() < deadline:
+            with self.lock:
+                if not self.pending:
+                    break
+            time.sleep(0.05)
+        with self.lock:
+            lost = len(self.pending)
+            self.pending.clear()
+            return list(self.acks), lost
+
+    # ----- Scénarios -----
+
+    def run_commands(self):
+        self.reset()
+        start = time.time()
+        for n in self.paced(self.args.rate, self.args.duration):
+            self.send_command(self.args.pin, n & 1)
+        acks, lost = self.drain()
+        elapsed = time.time() - start
+        rtt = sorted(a[0] for a in acks)
+        device = sorted(a[1] for a in acks if a[1] > 0)
+        return {
+            "commands.sent": len(acks) + lost,
+            "commands.rate_per_s": len(acks) / elapsed,
+            "commands.latency_p50_ms": percentile(rtt, 50),
+            "commands.latency_p99_ms": percentile(rtt, 99),
+            "commands.latency_p999_ms": percentile(rtt, 99.9),
+            "commands.device_p99_us": percentile(device, 99),
+            "commands.lost": lost,
+        }
+
+    def run_scheduled(self):
+        self.reset()
+        for n in self.paced(self.args.scheduled_rate, self.args.duration):
+            self.send_command(self.args.pin, n & 1, exec_at=time.time() + self.args.delay)
+        time.sleep(self.args.delay)
+        acks, lost = self.drain()
+        lateness = sorted(a[2] for a in acks if a[3] == "executed")
+        refused = sum(1 for a in acks if a[3] != "executed")
+        return {
+            "scheduled.sent": len(acks) + lost,
+            "scheduled.lateness_p50_us": percentile(lateness, 50),
+            "scheduled.lateness_p99_us": percentile(lateness, 99),
+            "scheduled.lateness_p999_us": percentile(lateness, 99.9),
+            "scheduled.lateness_max_us": lateness[-1] if lateness else 0,
+            "scheduled.lost": lost + refused,
+        }
+
+    def run_edges(self):
+        if not (self.args.edge_out and self.args.edge_in):
+            print("  ⏭️  edges ignoré : --edge-out et --edge-in requis (sortie câblée à l'entrée)")
+            return {}
+        self.reset()
+        start = time.time()
+        for n in self.paced(self.args.edge_rate, self.args.duration):
+            with self.lock:
+                self.edge_sent.append(time.time())
+            self.client.publish(f"{self.device}/control/{self.args.edge_out}/set",
+                                json.dumps({"state": n & 1}), qos=1)
+        time.sleep(self.args.drain)
+        with self.lock:
+            sent, seen = list(self.edge_sent), list(self.edge_seen)
+        # Fronts appariés dans l'ordre : un front manqué décale, on borne par la latence
+        latencies = sorted((b - a) * 1000.0 for a, b in zip(sent, seen) if b >= a)
+        return {
+            "edges.rate_per_s": len(seen) / (time.time() - start - self.args.drain),
+            "edges.latency_p50_ms": percentile(latencies, 50),
+            "edges.latency_p99_ms": percentile(latencies, 99),
+            "edges.missed": max(0, len(sent) - len(seen)),
+        }
+
+    def run_serial(self):
+        self.reset()
+        message = "X" * self.args.serial_size
+        start = time.time()
+        sent = 0
+        for _ in self.paced(self.args.serial_rate, self.args.duration):
+            self.client.publish(f"{self.device}/serial/send", message, qos=1)
+            sent += 1
+        elapsed = time.time() - start
+        time.sleep(self.args.drain)
+        with self.lock:
+            received = self.serial_received
+        if received == 0:
+            print("  ⚠️  serial : rien reçu sur serial/receive (TX relié à RX ?), débit d'envoi seul")
+            return {"serial.sent_per_s": sent / elapsed}
+        return {
+            "serial.sent_per_s": sent / elapsed,
+            "serial.rate_per_s": received / elapsed,
+            "serial.lost": max(0, sent - received),
+        }
+
+    def run_churn(self, broker, device_client_id):
+        if broker is None:
+            print("  ⏭️  churn ignoré : nécessite le broker intégré")
+            return {}
+        if device_client_id is None:
+            print("  ⏭️  churn ignoré : client MQTT de l'appareil introuvable (--device-client-id)")
+            return {}
+        self.reset()
+        reconnects = []
+        stop = threading.Event()
+
+        def storm():
+            for n in self.paced(self.args.churn_rate, self.args.duration):
+                if stop.is_set():
+                    break
+                self.send_command(self.args.pin, n & 1)
+
+        thread = threading.Thread(target=storm, daemon=True)
+        thread.start()
+        start = time.time()
+        kicks = 0
+        while time.time() - start < self.args.duration:
+            with self.lock:
+                self.online_at = []
+            kicked = time.time()
+            kicks += 1
+            broker.kick(device_client_id)
+            while time.time() - kicked < self.args.churn_period:
+                with self.lock:
+                    online = [t for t in self.online_at if t > kicked]
+                if online:
+                    reconnects.append((online[0] - kicked) * 1000.0)
+                    break
+                time.sleep(0.02)
+            time.sleep(max(0.0, self.args.churn_period - (time.time() - kicked)))
+        stop.set()
+        thread.join()
+        acks, lost = self.drain()
+        reconnects.sort()
+        results = {"churn.kicks": kicks}
+        if reconnects:
+            results["churn.reconnect_p50_ms"] = percentile(reconnects, 50)
+            results["churn.reconnect_max_ms"] = reconnects[-1]
+        results["churn.failed_reconnects"] = kicks - len(reconnects)
+        # Commandes émises pendant les coupures : perdues (pas de session persistante)
+        results["churn.lost"] = lost
+        return results
+
+    # ----- Tas -----
+
+    def poll_heap(self, stop):
+        url = f"http://{self.args.ip}/api/metrics"
+        while not stop.is_set():
+            try:
+                with urllib.request.urlopen(url, timeout=2) as response:
+                    metrics = json.loads(response.read())
+                value = metrics.get("memory", {}).get("minFreeHeap", metrics.get("minFreeHeap"))
+                if value is not None:
+                    self.heap_min = value if self.heap_min is None else min(self.heap_min, value)
+            except (OSError, ValueError):
+                pass
+            stop.wait(1.0)
+
+    def stop(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+# ========== RÉFÉRENCE ==========
+
+def compare(results, baseline, tolerance):
+    """Liste des (mesure, référence, actuel, régression ?) comparables"""
+    rows = []
+    for name, (direction, slack) in METRICS.items():
+        if name not in results or name not in baseline:
+            continue
+        ref, cur = baseline[name], results[name]
+        if direction == "lower":
+            regressed = cur > ref * (1 + tolerance) + slack
+        else:
+            regressed = cur < ref * (1 - tolerance) - slack
+        rows.append((name, ref, cur, regressed))
+    return rows
+
+
+def print_results(results, rows):
+    compared = {r[0]: r for r in rows}
+    print()
+    print("=" * 78)
+    print(f"{'Mesure':<32}{'actuel':>14}{'référence':>14}{'écart':>10}")
+    print("-" * 78)
+    for name, value in results.items():
+        line = f"{name:<32}{value:>14.2f}"
+        if name in compared:
+            _, ref, cur, regressed = compared[name]
+            delta = f"{100.0 * (cur - ref) / ref:+.0f} %" if ref else "-"
+            line += f"{ref:>14.2f}{delta:>10}" + ("  ❌ régression" if regressed else "")
+        print(line)
+    print("=" * 78)
+
+
+def spawn_mosquitto(port):
+    binary = shutil.which("mosquitto")
+    if not binary:
+        print("❌ mosquitto introuvable dans le PATH")
+        sys.exit(1)
+    process = subprocess.Popen([binary, "-p", str(port)], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    time.sleep(0.5)
+    if process.poll() is not None:
+        print(f"❌ mosquitto n'a pas démarré (port {port} occupé ?)")
+        sys.exit(1)
+    return process
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Banc d'endurance et de débit (broker local, appareil réel ou simulé)")
+    parser.add_argument("--device", default=DEVICE_NAME, help="Nom de l'appareil (deviceName)")
+    parser.add_argument("--device-client-id", help="Client MQTT de l'appareil pour churn (défaut : détecté)")
+    parser.add_argument("--ip", help="Adresse de l'appareil : tas minimal relevé sur /api/metrics")
+    parser.add_argument("--port", type=int, default=MQTT_PORT, help="Port du broker intégré ou lancé")
+    parser.add_argument("--broker", help="Broker existant host[:port] au lieu du broker intégré")
+    parser.add_argument("--mosquitto", action="store_true", help="Lance mosquitto localement au lieu du broker intégré")
+    parser.add_argument("--emulate", action="store_true", help="Appareil simulé (validation du banc sans carte)")
+    parser.add_argument("--scenarios", default=",".join(SCENARIOS), help="Liste séparée par des virgules")
+    parser.add_argument("--duration", type=float, default=20, help="Durée de chaque scénario (s)")
+    parser.add_argument("--pin", default="RelaisK1", help="Sortie commandée")
+    parser.add_argument("--rate", type=float, default=200, help="Commandes immédiates par seconde")
+    parser.add_argument("--scheduled-rate", type=float, default=50, help="Commandes programmées par seconde")
+    parser.add_argument("--delay", type=float, default=0.5, help="exec_at = maintenant + N s")
+    parser.add_argument("--edge-out", help="Sortie câblée à --edge-in")
+    parser.add_argument("--edge-in", help="Entrée reliée à --edge-out")
+    parser.add_argument("--edge-rate", type=float, default=100, help="Fronts par seconde")
+    parser.add_argument("--serial-rate", type=float, default=100, help="Messages série par seconde")
+    parser.add_argument("--serial-size", type=int, default=64, help="Taille d'un message série")
+    parser.add_argument("--churn-period", type=float, default=5, help="Coupure de l'appareil toutes les N s")
+    parser.add_argument("--churn-rate", type=float, default=20, help="Commandes par seconde pendant churn")
+    parser.add_argument("--drain", type=float, default=3, help="Attente des derniers accusés (s)")
+    parser.add_argument("--wait", type=float, default=60, help="Attente de la connexion de l'appareil (s)")
+    parser.add_argument("--baseline", default=BASELINE_FILE, help="Référence JSON")
+    parser.add_argument("--save-baseline", action="store_true", help="Enregistre les résultats comme référence")
+    parser.add_argument("--tolerance", type=float, default=0.2, help="Régression tolérée (0.2 = 20 %%)")
+    parser.add_argument("--json", help="Écrit les résultats dans ce fichier")
+    args = parser.parse_args()
+
+    scenarios = [s.strip() for s in args.scenarios.split(",") if s.strip()]
+    unknown = [s for s in scenarios if s not in SCENARIOS]
+    if unknown:
+        parser.error(f"scénario inconnu : {', '.join(unknown)}")
+
+    broker = None
+    mosquitto = None
+    if args.broker:
+        host, _, port = args.broker.partition(":")
+        args.broker_host, args.broker_port = host, int(port or MQTT_PORT)
+    else:
+        args.broker_host, args.broker_port = "127.0.0.1", args.port
+        if args.mosquitto:
+            mosquitto = spawn_mosquitto(args.port)
+        else:
+            broker = MiniBroker(args.port)
+            try:
+                broker.start()
+            except OSError as e:
+                print(f"❌ Broker intégré : port {args.port} indisponible ({e})")
+                sys.exit(1)
+        print(f"📡 Broker local sur {get_local_ip()}:{args.port} (mqttServer de l'appareil)")
+
+    emulated = EmulatedDevice(args) if args.emulate else None
+    bench = Bench(args)
+    print(f"⏳ Attente de {args.device}/availability = online ...")
+    if not bench.wait_online(args.wait):
+        print("❌ Appareil non connecté au broker")
+        sys.exit(1)
+
+    device_client_id = args.device_client_id
+    if device_client_id is None and emulated:
+        device_client_id = emulated.client_id
+    if device_client_id is None and broker:
+        # Client qui s'est abonné aux commandes de l'appareil
+        for client_id, session in broker.sessions.items():
+            if any(f.startswith(f"{args.device}/control") for f in session.subscriptions):
+                device_client_id = client_id
+
+    stop_polling = threading.Event()
+    if args.ip:
+        threading.Thread(target=bench.poll_heap, args=(stop_polling,), daemon=True).start()
+
+    results = {}
+    for scenario in scenarios:
+        print(f"▶️  {scenario} ({args.duration:.0f} s)")
+        if scenario == "churn":
+            results.update(bench.run_churn(broker, device_client_id))
+        else:
+            results.update(getattr(bench, f"run_{scenario}")())
+        if not bench.wait_online(args.wait):
+            print("❌ Appareil perdu")
+            break
+    stop_polling.set()
+    if bench.heap_min is not None:
+        results["heap.min_free"] = bench.heap_min
+    if broker:
+        results["broker.received"] = broker.received
+        results["broker.delivered"] = broker.delivered
+
+    bench.stop()
+    if emulated:
+        emulated.stop()
+    if mosquitto:
+        mosquitto.terminate()
+
+    baseline = {}
+    if os.path.exists(args.baseline) and not args.save_baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f).get("results", {})
+    rows = compare(results, baseline, args.tolerance)
+    print_results(results, rows)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2)
+    if args.save_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump({"date": time.strftime("%Y-%m-%d %H:%M:%S"), "device": args.device,
+                       "emulated": args.emulate, "options": {k: v for k, v in vars(args).items()
+                                                              if k not in ("baseline", "save_baseline", "json")},
+                       "results": results}, f, indent=2)
+        print(f"💾 Référence enregistrée dans {args.baseline}")
+        return
+
+    regressions = [r[0] for r in rows if r[3]]
+    if regressions:
+        print(f"❌ {len(regressions)} régression(s) : {', '.join(regressions)}")
+        sys.exit(1)
+    if rows:
+        print(f"✅ Aucune régression ({len(rows)} mesures comparées à {args.baseline})")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,213 @@
+#include "access_log.h"
+#include "time_sync.h"
+#include <time.h>
+
+extern AccessLog accessLogs[];
+
+struct RouteStats {
+  const char* path;                        // Chaîne littérale de setupWebServer()
+  uint8_t method;
+  uint32_t requests;
+  uint32_t errors;                         // Statut >= 400
+  uint64_t bytes;
+  uint64_t totalUs;
+  uint32_t maxUs;
+  uint32_t histogram[ACCESS_HISTOGRAM_BUCKETS];
+  uint32_t windowCount;
+  float perSec;                            // Sur la dernière fenêtre complète
+};
+
+struct ClientStats {
+  uint32_t ip;                             // 0 = libre
+  uint32_t requests;
+  uint32_t errors;
+  uint32_t windowCount;
+  float perSec;
+  uint32_t lastMs;
+};
+
+// Route 0 : requêtes hors table (404, routes au-delà de ACCESS_MAX_ROUTES)
+static RouteStats routes[ACCESS_MAX_ROUTES] = { { "other", HTTP_ANY } };
+static int routeCount = 1;
+static ClientStats clients[ACCESS_CLIENT_SLOTS];
+static int logHead = 0;                    // Prochaine entrée écrite
+static int logCount = 0;
+static uint32_t totalRequests = 0;
+static uint32_t windowStartMs = 0;
+
+// Seau k >= 1 : [2^(k-1), 2^k) µs, seau 0 : moins d'1 µs, dernier seau : au-delà
+static inline int bucketOf(uint32_t us) {
+  if (us == 0) return 0;
+  int k = 32 - __builtin_clz(us);
+  return k < ACCESS_HISTOGRAM_BUCKETS ? k : ACCESS_HISTOGRAM_BUCKETS - 1;
+}
+
+static void rollWindow(uint32_t nowMs) {
+  uint32_t elapsed = nowMs - windowStartMs;
+  if (elapsed < ACCESS_RATE_WINDOW_MS) return;
+  for (int i = 0; i < routeCount; i++) {
+    routes[i].perSec = routes[i].windowCount * 1000.0f / elapsed;
+    routes[i].windowCount = 0;
+  }
+  for (int i = 0; i < ACCESS_CLIENT_SLOTS; i++) {
+    clients[i].perSec = clients[i].windowCount * 1000.0f / elapsed;
+    clients[i].windowCount = 0;
+  }
+  windowStartMs = nowMs;
+}
+
+static ClientStats& clientSlot(uint32_t ip, uint32_t nowMs) {
+  int oldest = 0;
+  for (int i = 0; i < ACCESS_CLIENT_SLOTS; i++) {
+    if (clients[i].ip == ip) return clients[i];
+    if (clients[i].ip == 0) {
+      oldest = i;
+      break;
+    }
+    if (nowMs - clients[i].lastMs > nowMs - clients[oldest].lastMs) oldest = i;
+  }
+  ClientStats& client = clients[oldest];
+  memset(&client, 0, sizeof(client));
+  client.ip = ip;
+  return client;
+}
+
+int accessRegisterRoute(WebRequestMethodComposite method, const char* path) {
+  if (routeCount >= ACCESS_MAX_ROUTES) return 0;
+  routes[routeCount].path = path;
+  routes[routeCount].method = method;
+  return routeCount++;
+}
+
+void accessRecord(int route, uint32_t ip, uint16_t status, uint32_t bytes, uint32_t durationUs) {
+  uint32_t nowMs = millis();
+  rollWindow(nowMs);
+  bool error = status >= 400;
+
+  RouteStats& r = routes[route < routeCount ? route : 0];
+  r.requests++;
+  r.errors += error;
+  r.bytes += bytes;
+  r.totalUs += durationUs;
+  if (durationUs > r.maxUs) r.maxUs = durationUs;
+  r.histogram[bucketOf(durationUs)]++;
+  r.windowCount++;
+
+  if (ip != 0) {   // 0 : client inconnu (ElegantOTA), 0 marque aussi un emplacement libre
+    ClientStats& client = clientSlot(ip, nowMs);
+    client.requests++;
+    client.errors += error;
+    client.windowCount++;
+    client.lastMs = nowMs;
+  }
+
+  AccessLog& entry = accessLogs[logHead];
+  entry.atMs = nowMs;
+  entry.ip = ip;
+  entry.bytes = bytes;
+  entry.durationUs = durationUs;
+  entry.status = status;
+  entry.route = route < routeCount ? route : 0;
+  logHead = (logHead + 1) % ACCESS_LOG_ENTRIES;
+  if (logCount < ACCESS_LOG_ENTRIES) logCount++;
+  totalRequests++;
+}
+
+// ===== LECTURE (mise en texte) =====
+
+static const char* formatIp(char* buffer, size_t size, uint32_t ip) {
+  // Ordre réseau : premier octet dans l'octet de poids faible (comme IPAddress)
+  snprintf(buffer, size, "%u.%u.%u.%u", ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, ip >> 24);
+  return buffer;
+}
+
+static const char* methodName(uint8_t method) {
+  switch (method) {
+    case HTTP_GET: return "GET";
+    case HTTP_POST: return "POST";
+    case HTTP_PUT: return "PUT";
+    case HTTP_DELETE: return "DELETE";
+    default: return "ANY";
+  }
+}
+
+static const char* formatRoute(char* buffer, size_t size, int route) {
+  if (route == 0) return routes[0].path;
+  snprintf(buffer, size, "%s %s", methodName(routes[route].method), routes[route].path);
+  return buffer;
+}
+
+// Borne haute du seau qui contient le percentile p (durée maximale pour le dernier)
+static uint32_t percentileUs(const RouteStats& r, float p) {
+  uint32_t target = (uint32_t)(r.requests * p + 0.5f);
+  if (target == 0) target = 1;
+  uint32_t seen = 0;
+  for (int k = 0; k < ACCESS_HISTOGRAM_BUCKETS - 1; k++) {
+    seen += r.histogram[k];
+    if (seen >= target) return min((uint32_t)1 << k, r.maxUs);
+  }
+  return r.maxUs;
+}
+
+void accessStatsToJson(JsonObject out) {
+  uint32_t nowMs = millis();
+  rollWindow(nowMs);
+  out["requests"] = totalRequests;
+  out["windowMs"] = ACCESS_RATE_WINDOW_MS;
+
+  char name[64];
+  JsonArray routeList = out["routes"].to<JsonArray>();
+  for (int i = 0; i < routeCount; i++) {
+    const RouteStats& r = routes[i];
+    if (r.requests == 0) continue;   // Routes jamais appelées : document plus petit
+    JsonObject entry = routeList.add<JsonObject>();
+    entry["route"] = formatRoute(name, sizeof(name), i);
+    entry["requests"] = r.requests;
+    entry["errors"] = r.errors;
+    entry["bytes"] = r.bytes;
+    entry["perSec"] = r.perSec;
+    entry["avgUs"] = (uint32_t)(r.totalUs / r.requests);
+    entry["p50Us"] = percentileUs(r, 0.50f);
+    entry["p99Us"] = percentileUs(r, 0.99f);
+    entry["maxUs"] = r.maxUs;
+    // Seaux jusqu'au dernier non vide : [0,1), [1,2), [2,4)... µs
+    int last = ACCESS_HISTOGRAM_BUCKETS - 1;
+    while (last > 0 && r.histogram[last] == 0) last--;
+    JsonArray histogram = entry["histogram"].to<JsonArray>();
+    for (int k = 0; k <= last; k++) histogram.add(r.histogram[k]);
+  }
+
+  char ip[16];
+  JsonArray clientList = out["clients"].to<JsonArray>();
+  for (int i = 0; i < ACCESS_CLIENT_SLOTS; i++) {
+    const ClientStats& c = clients[i];
+    if (c.ip == 0) continue;
+    JsonObject entry = clientList.add<JsonObject>();
+    entry["ip"] = formatIp(ip, sizeof(ip), c.ip);
+    entry["requests"] = c.requests;
+    entry["errors"] = c.errors;
+    entry["perSec"] = c.perSec;
+    entry["lastSeenSec"] = (nowMs - c.lastMs) / 1000;
+  }
+}
+
+void accessLogToJson(JsonArray out, int limit) {
+  uint32_t nowMs = millis();
+  time_t now = time(nullptr);
+  bool clock = timeQuality() != TIME_QUALITY_NONE;
+  char ip[16];
+  char name[64];
+  int count = min(limit, logCount);
+  for (int n = 0; n < count; n++) {
+    const AccessLog& e = accessLogs[(logHead - 1 - n + ACCESS_LOG_ENTRIES) % ACCESS_LOG_ENTRIES];
+    JsonObject entry = out.add<JsonObject>();
+    uint32_t ageMs = nowMs - e.atMs;
+    if (clock) entry["timestamp"] = (uint32_t)(now - ageMs / 1000);
+    entry["ageMs"] = ageMs;
+    if (e.ip) entry["ip"] = formatIp(ip, sizeof(ip), e.ip);
+    entry["route"] = formatRoute(name, sizeof(name), e.route);
+    entry["status"] = e.status;
+    entry["bytes"] = e.bytes;
+    entry["us"] = e.durationUs;
+  }
+}
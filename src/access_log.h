@@ -0,0 +1,25 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+
+// ===== JOURNAL D'ACCÈS HTTP =====
+// Chaque requête traitée par une route de setupWebServer() laisse une entrée dans
+// l'anneau accessLogs[] (client, route, statut, octets, durée du gestionnaire) et
+// alimente les compteurs de sa route (histogramme de durée, requêtes/s, erreurs) et
+// de son client. L'enregistrement ne fait que ranger des entiers : adresse IP, noms
+// de route et horodatage ne sont mis en texte qu'à la lecture (/api/access).
+//
+// Tout se passe dans la tâche AsyncTCP (routes, callbacks ElegantOTA et lecture),
+// sans verrou.
+
+int accessRegisterRoute(WebRequestMethodComposite method, const char* path);   // Au démarrage
+void accessRecord(int route, uint32_t ip, uint16_t status, uint32_t bytes, uint32_t durationUs);   // ip 0 : inconnue
+
+void accessStatsToJson(JsonObject out);                   // GET /api/access
+void accessLogToJson(JsonArray out, int limit);           // GET /api/access/log, plus récente en premier
+
+#endif // ACCESS_LOG_H
@@ -0,0 +1,201 @@
+#include "alloc_audit.h"
+#include "json_arena.h"
+#include "log_task.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifdef ALLOC_AUDIT
+
+struct TaskAllocStats {
+  TaskHandle_t handle;
+  uint32_t allocations;      // Hors portées AllocAuditExempt
+  uint32_t bytes;
+  uint32_t exempt;
+  uint32_t iterations;
+  uint32_t iterationStart;   // `allocations` au début du tour en cours
+  uint32_t maxPerIteration;  // Depuis l'armement
+  uint32_t violations;
+  uint8_t exemptDepth;
+};
+
+struct AllocViolation {
+  TaskHandle_t task;
+  uint32_t size;
+  uint32_t caller;
+};
+
+// Les compteurs d'une tâche ne sont écrits que par elle-même
+static TaskAllocStats tasks[ALLOC_AUDIT_MAX_TASKS];
+static volatile int taskCount = 0;
+static volatile bool armed = false;
+static uint32_t otherAllocations = 0;     // Tâches non enregistrées (lwIP, AsyncTCP, esp-mqtt...)
+static AllocViolation violationLog[ALLOC_AUDIT_LOG_ENTRIES];
+static uint32_t violationCount = 0;
+static uint32_t violationsReported = 0;
+static portMUX_TYPE registerMux = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskAllocStats* currentTask() {
+  if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) return NULL;
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  int count = taskCount;
+  for (int i = 0; i < count; i++) {
+    if (tasks[i].handle == self) return &tasks[i];
+  }
+  return NULL;
+}
+
+// Appelée depuis malloc : ni log, ni allocation, ni verrou bloquant
+static void recordAllocation(size_t size, void* returnAddress) {
+  if (xPortInIsrContext()) return;
+  TaskAllocStats* task = currentTask();
+  if (task == NULL) {
+    __atomic_fetch_add(&otherAllocations, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  if (task->exemptDepth > 0) {
+    task->exempt++;
+    return;
+  }
+  task->allocations++;
+  task->bytes += size;
+  if (!armed) return;
+
+  task->violations++;
+  uint32_t slot = __atomic_fetch_add(&violationCount, 1, __ATOMIC_RELAXED);
+  if (slot < ALLOC_AUDIT_LOG_ENTRIES) {
+    // Xtensa (fenêtres de registres) : les 2 bits de poids fort portent la taille de fenêtre
+    violationLog[slot].task = task->handle;
+    violationLog[slot].size = size;
+    violationLog[slot].caller = ((uint32_t)(uintptr_t)returnAddress & 0x3FFFFFFF) | 0x40000000;
+  }
+#ifdef ALLOC_AUDIT_STRICT
+  abort();   // Backtrace du panic : le chemin fautif
+#endif
+}
+
+extern "C" {
+struct _reent;
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real__malloc_r(struct _reent* r, size_t size);
+void* __real__calloc_r(struct _reent* r, size_t count, size_t size);
+void* __real__realloc_r(struct _reent* r, void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  recordAllocation(size, __builtin_return_address(0));
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  recordAllocation(count * size, __builtin_return_address(0));
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  recordAllocation(size, __builtin_return_address(0));
+  return __real_realloc(ptr, size);
+}
+
+// newlib (printf, strdup...) passe par les variantes réentrantes
+void* __wrap__malloc_r(struct _reent* r, size_t size) {
+  recordAllocation(size, __builtin_return_address(0));
+  return __real__malloc_r(r, size);
+}
+
+void* __wrap__calloc_r(struct _reent* r, size_t count, size_t size) {
+  recordAllocation(count * size, __builtin_return_address(0));
+  return __real__calloc_r(r, count, size);
+}
+
+void* __wrap__realloc_r(struct _reent* r, void* ptr, size_t size) {
+  recordAllocation(size, __builtin_return_address(0));
+  return __real__realloc_r(r, ptr, size);
+}
+}
+
+void allocAuditRegisterTask() {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL(&registerMux);
+  if (taskCount < ALLOC_AUDIT_MAX_TASKS) {
+    TaskAllocStats& task = tasks[taskCount];
+    memset(&task, 0, sizeof(task));
+    task.handle = self;
+    taskCount = taskCount + 1;
+  }
+  portEXIT_CRITICAL(&registerMux);
+  // newlib alloue les tampons de conversion des flottants de la tâche au premier
+  // printf("%f") : une fois pour toutes, pas une allocation de régime établi
+  char warmup[16];
+  snprintf(warmup, sizeof(warmup), "%.3f", 1.5);
+}
+
+void allocAuditIteration() {
+  TaskAllocStats* task = currentTask();
+  if (task == NULL) return;
+  uint32_t count = task->allocations - task->iterationStart;
+  if (armed && count > task->maxPerIteration) task->maxPerIteration = count;
+  task->iterationStart = task->allocations;
+  task->iterations++;
+}
+
+void allocAuditLoop() {
+  if (!armed && millis() > ALLOC_AUDIT_GRACE_MS) {
+    armed = true;
+    logPrintf("🔒 Allocation audit armed: %d task(s) must no longer allocate\n", taskCount);
+  }
+  uint32_t count = violationCount;
+  while (violationsReported < count && violationsReported < ALLOC_AUDIT_LOG_ENTRIES) {
+    const AllocViolation& v = violationLog[violationsReported++];
+    logPrintf("❌ ALLOC AUDIT: %s allocated %u bytes (caller 0x%08x)\n",
+              pcTaskGetName(v.task), (unsigned)v.size, (unsigned)v.caller);
+  }
+}
+
+AllocAuditExempt::AllocAuditExempt() {
+  TaskAllocStats* task = currentTask();
+  if (task) task->exemptDepth++;
+}
+
+AllocAuditExempt::~AllocAuditExempt() {
+  TaskAllocStats* task = currentTask();
+  if (task) task->exemptDepth--;
+}
+
+#endif // ALLOC_AUDIT
+
+void memoryStatsToJson(JsonObject out) {
+  out["freeHeap"] = ESP.getFreeHeap();
+  out["minFreeHeap"] = ESP.getMinFreeHeap();
+  out["largestBlock"] = ESP.getMaxAllocHeap();   // Écart avec freeHeap = fragmentation
+  jsonArenaStatsToJson(out["arenas"].to<JsonArray>());
+
+#ifdef ALLOC_AUDIT
+  JsonObject audit = out["audit"].to<JsonObject>();
+  audit["armed"] = armed;
+  audit["violations"] = violationCount;
+  audit["otherTasks"] = otherAllocations;
+  JsonArray list = audit["tasks"].to<JsonArray>();
+  for (int i = 0; i < taskCount; i++) {
+    const TaskAllocStats& task = tasks[i];
+    JsonObject entry = list.add<JsonObject>();
+    entry["name"] = pcTaskGetName(task.handle);
+    entry["iterations"] = task.iterations;
+    entry["allocations"] = task.allocations;
+    entry["bytes"] = task.bytes;
+    entry["exempt"] = task.exempt;
+    entry["maxPerIteration"] = task.maxPerIteration;
+    entry["violations"] = task.violations;
+  }
+  JsonArray log = audit["log"].to<JsonArray>();
+  uint32_t logged = violationCount < ALLOC_AUDIT_LOG_ENTRIES ? violationCount : ALLOC_AUDIT_LOG_ENTRIES;
+  for (uint32_t i = 0; i < logged; i++) {
+    JsonObject entry = log.add<JsonObject>();
+    entry["task"] = pcTaskGetName(violationLog[i].task);
+    entry["size"] = violationLog[i].size;
+    char caller[12];
+    snprintf(caller, sizeof(caller), "0x%08x", (unsigned)violationLog[i].caller);
+    entry["caller"] = caller;
+  }
+#endif
+}
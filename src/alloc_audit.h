@@ -0,0 +1,43 @@
+#ifndef ALLOC_AUDIT_H
+#define ALLOC_AUDIT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== AUDIT DES ALLOCATIONS =====
+// En régime établi, les tâches de l'application n'allouent plus rien (tampons fixes,
+// arènes JSON). Le build ALLOC_AUDIT (env wt32-eth01-alloc-audit : malloc, calloc,
+// realloc et leurs variantes _r enveloppés à l'édition de liens) le vérifie : chaque
+// allocation est comptée pour la tâche appelante, par itération de sa boucle. Passé
+// ALLOC_AUDIT_GRACE_MS après le boot, une allocation dans une tâche enregistrée est
+// une violation (tâche, taille, appelant pour addr2line) ; avec ALLOC_AUDIT_STRICT
+// la carte s'arrête sur la première. Hors audit, ces fonctions sont vides.
+
+#ifdef ALLOC_AUDIT
+void allocAuditRegisterTask();   // Au démarrage de la tâche appelante
+void allocAuditIteration();      // À chaque tour de sa boucle
+void allocAuditLoop();           // Tâche réseau : armement, violations dans le log
+
+// Portée où une bibliothèque alloue pour nous (outbox esp-mqtt) : comptée à part
+class AllocAuditExempt {
+public:
+  AllocAuditExempt();
+  ~AllocAuditExempt();
+};
+#else
+inline void allocAuditRegisterTask() {}
+inline void allocAuditIteration() {}
+inline void allocAuditLoop() {}
+
+class AllocAuditExempt {
+public:
+  AllocAuditExempt() {}
+};
+#endif
+
+// Tas (libre, minimum, plus grand bloc : fragmentation), arènes JSON et, en build
+// d'audit, compteurs par tâche (GET /api/metrics, champ "memory")
+void memoryStatsToJson(JsonObject out);
+
+#endif // ALLOC_AUDIT_H
@@ -0,0 +1,189 @@
+#include "analog.h"
+#include "analog_filter.h"
+#include "mqtt.h"
+#include "io_table.h"
+#include "alloc_audit.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+struct AnalogChannel {
+  char name[32];             // Copies : la table d'I/O peut être remplacée par /api/ios
+  AnalogConfig cfg;
+  MovingAverage average;
+  IirFilter iir;
+  float millivolts;          // Après suréchantillonnage et filtre
+  float value;               // Après calibration
+  float lastPublished;
+  unsigned long lastPublishAt;
+  bool valid;
+};
+
+static AnalogChannel channels[ANALOG_MAX_CHANNELS];
+static int channelCount = 0;
+// La tâche d'échantillonnage et analogRebuild() (web/boot) se partagent channels[]
+static SemaphoreHandle_t channelMutex = NULL;
+static TaskHandle_t analogTaskHandle = NULL;
+
+bool analogPinValid(int pin) {
+  return pin >= 32 && pin <= 39;
+}
+
+void analogConfigDefaults(AnalogConfig& c, uint8_t pin) {
+  memset(&c, 0, sizeof(c));
+  c.pin = pin;
+  c.oversampling = 16;
+  c.filter = ANALOG_FILTER_IIR;
+  c.window = 8;
+  c.alpha = 0.2f;
+  // Par défaut : tension à la broche en mV
+  c.inLo = 0.0f;
+  c.inHi = 1000.0f;
+  c.outLo = 0.0f;
+  c.outHi = 1000.0f;
+  c.deadband = 10.0f;
+  c.minIntervalMs = 100;
+  c.periodMs = 60000;
+  strlcpy(c.unit, "mV", sizeof(c.unit));
+}
+
+static void publishChannel(AnalogChannel& ch, unsigned long now) {
+  ch.lastPublished = ch.value;
+  ch.lastPublishAt = now;
+  if (!mqttEnabled || !mqttConnected()) return;
+
+  char topic[128];
+  snprintf(topic, sizeof(topic), "%s/analog/%s", config.deviceName, ch.name);
+  char payload[128];
+  snprintf(payload, sizeof(payload), "{\"value\":%.3f,\"mv\":%.1f,\"unit\":\"%s\",\"timestamp\":%ld}",
+           ch.value, ch.millivolts, ch.cfg.unit, (long)time(nullptr));
+  publishMQTT(topic, payload, true);
+}
+
+static void sampleChannel(AnalogChannel& ch, unsigned long now) {
+  uint16_t readings[ANALOG_MAX_OVERSAMPLING];
+  uint8_t count = ch.cfg.oversampling;
+  for (uint8_t i = 0; i < count; i++) {
+    // Tension calibrée (courbe eFuse de l'ADC), pas la valeur brute 12 bits
+    readings[i] = analogReadMilliVolts(ch.cfg.pin);
+  }
+  float mv = oversampleAverage(readings, count);
+
+  switch (ch.cfg.filter) {
+    case ANALOG_FILTER_MOVING_AVERAGE: mv = movingAverageUpdate(ch.average, mv); break;
+    case ANALOG_FILTER_IIR:            mv = iirUpdate(ch.iir, mv); break;
+    default: break;
+  }
+  ch.millivolts = mv;
+  ch.value = calibrate({ch.cfg.inLo, ch.cfg.inHi, ch.cfg.outLo, ch.cfg.outHi}, mv);
+  ch.valid = true;
+
+  unsigned long sincePublish = now - ch.lastPublishAt;
+  if (sincePublish < ch.cfg.minIntervalMs) return;
+  bool periodic = ch.cfg.periodMs > 0 && sincePublish >= ch.cfg.periodMs;
+  if (periodic || deadbandExceeded(ch.value, ch.lastPublished, ch.cfg.deadband)) {
+    publishChannel(ch, now);
+  }
+}
+
+static void analogTask(void* pvParameters) {
+  Serial.println("✅ Analog sampling task started.");
+  TickType_t lastWake = xTaskGetTickCount();
+  allocAuditRegisterTask();
+  for (;;) {
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(ANALOG_SAMPLE_PERIOD_MS));
+    unsigned long now = millis();
+    xSemaphoreTake(channelMutex, portMAX_DELAY);
+    for (int i = 0; i < channelCount; i++) sampleChannel(channels[i], now);
+    xSemaphoreGive(channelMutex);
+    allocAuditIteration();
+  }
+}
+
+void analogRebuild() {
+  if (!channelMutex) channelMutex = xSemaphoreCreateMutex();
+  xSemaphoreTake(channelMutex, portMAX_DELAY);
+  channelCount = 0;
+  IoSnapshot table;
+  for (int i = 0; i < table->count && channelCount < ANALOG_MAX_CHANNELS; i++) {
+    const IOPin& io = table->pins[i];
+    if (io.mode != 3 || !analogPinValid(io.pin)) continue;
+    AnalogChannel& ch = channels[channelCount++];
+    memset(&ch, 0, sizeof(ch));
+    strlcpy(ch.name, io.name, sizeof(ch.name));
+    const AnalogConfig* cfg = ioAnalogConfig(*table, io.pin);
+    if (cfg) ch.cfg = *cfg;
+    else analogConfigDefaults(ch.cfg, io.pin);
+    ch.cfg.oversampling = constrain(ch.cfg.oversampling, 1, ANALOG_MAX_OVERSAMPLING);
+    // Configuration enregistrée avant la validation de /api/ios : calibration par défaut
+    if (!calibrationValid({ch.cfg.inLo, ch.cfg.inHi, ch.cfg.outLo, ch.cfg.outHi})) {
+      Serial.printf("⚠️ Analog channel %s: invalid calibration (inHi = inLo), using defaults\n", ch.name);
+      AnalogConfig defaults;
+      analogConfigDefaults(defaults, io.pin);
+      ch.cfg.inLo = defaults.inLo;
+      ch.cfg.inHi = defaults.inHi;
+      ch.cfg.outLo = defaults.outLo;
+      ch.cfg.outHi = defaults.outHi;
+    }
+    movingAverageInit(ch.average, ch.cfg.window);
+    iirInit(ch.iir, ch.cfg.alpha);
+    ch.lastPublished = NAN;
+    analogSetPinAttenuation(ch.cfg.pin, ADC_11db);   // Pleine échelle ~3.1 V
+  }
+  xSemaphoreGive(channelMutex);
+  Serial.printf("%d analog channel(s) configured.\n", channelCount);
+}
+
+void setupAnalog() {
+  if (analogTaskHandle) return;
+  if (!channelMutex) channelMutex = xSemaphoreCreateMutex();
+  // Core de service : le core 1 est réservé à la tâche temps réel
+  xTaskCreatePinnedToCore(analogTask, "AnalogTask", ANALOG_TASK_STACK_SIZE, NULL, ANALOG_TASK_PRIORITY,
+                          &analogTaskHandle, SERVICE_TASK_CORE);
+}
+
+bool analogValue(int pin, float* value, float* millivolts) {
+  if (!channelMutex) return false;
+  bool found = false;
+  xSemaphoreTake(channelMutex, portMAX_DELAY);
+  for (int i = 0; i < channelCount; i++) {
+    if (channels[i].cfg.pin == pin && channels[i].valid) {
+      *value = channels[i].value;
+      if (millivolts) *millivolts = channels[i].millivolts;
+      found = true;
+      break;
+    }
+  }
+  xSemaphoreGive(channelMutex);
+  return found;
+}
+
+void analogConfigToJson(const AnalogConfig& c, JsonObject out) {
+  out["oversampling"] = c.oversampling;
+  out["filter"] = c.filter;
+  out["window"] = c.window;
+  out["alpha"] = c.alpha;
+  out["inLo"] = c.inLo;
+  out["inHi"] = c.inHi;
+  out["outLo"] = c.outLo;
+  out["outHi"] = c.outHi;
+  out["deadband"] = c.deadband;
+  out["minIntervalMs"] = c.minIntervalMs;
+  out["periodMs"] = c.periodMs;
+  out["unit"] = c.unit;
+}
+
+bool analogConfigFromJson(AnalogConfig& c, JsonObjectConst in) {
+  if (in["oversampling"].is<int>()) c.oversampling = constrain((int)in["oversampling"], 1, ANALOG_MAX_OVERSAMPLING);
+  if (in["filter"].is<int>()) c.filter = constrain((int)in["filter"], 0, 2);
+  if (in["window"].is<int>()) c.window = constrain((int)in["window"], 1, ANALOG_MAX_WINDOW);
+  if (in["alpha"].is<float>()) c.alpha = constrain((float)in["alpha"], 0.001f, 1.0f);
+  if (in["inLo"].is<float>()) c.inLo = in["inLo"];
+  if (in["inHi"].is<float>()) c.inHi = in["inHi"];
+  if (in["outLo"].is<float>()) c.outLo = in["outLo"];
+  if (in["outHi"].is<float>()) c.outHi = in["outHi"];
+  if (in["deadband"].is<float>()) c.deadband = in["deadband"];
+  if (in["minIntervalMs"].is<uint32_t>()) c.minIntervalMs = in["minIntervalMs"];
+  if (in["periodMs"].is<uint32_t>()) c.periodMs = in["periodMs"];
+  if (in["unit"].is<const char*>()) strlcpy(c.unit, in["unit"], sizeof(c.unit));
+  return calibrationValid({c.inLo, c.inHi, c.outLo, c.outHi});
+}
@@ -0,0 +1,27 @@
+#ifndef ANALOG_H
+#define ANALOG_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== ENTRÉES ANALOGIQUES =====
+// Une tâche échantillonne chaque canal ANALOG à ANALOG_SAMPLE_PERIOD_MS
+// (suréchantillonnage, filtre, calibration : voir analog_filter.h) et publie
+// <device>/analog/<name> sur bande morte et/ou périodiquement, jamais à chaque
+// échantillon.
+
+// Copie de travail (chargement, /api/ios) : les lecteurs passent par la table d'I/O
+extern AnalogConfig analogConfigs[];
+extern int analogConfigCount;
+
+void setupAnalog();                          // Démarre la tâche d'échantillonnage
+void analogRebuild();                        // Canaux = IOPin en mode 3 (après applyIOPinModes)
+bool analogPinValid(int pin);                // ADC1 : GPIO 32..39
+void analogConfigDefaults(AnalogConfig& c, uint8_t pin);
+bool analogValue(int pin, float* value, float* millivolts);
+
+void analogConfigToJson(const AnalogConfig& c, JsonObject out);
+bool analogConfigFromJson(AnalogConfig& c, JsonObjectConst in);   // false : calibration invalide
+
+#endif // ANALOG_H
@@ -0,0 +1,109 @@
+#ifndef ANALOG_FILTER_H
+#define ANALOG_FILTER_H
+
+#include <stdint.h>
+#include <math.h>
+
+// ===== NOYAUX DE FILTRAGE ANALOGIQUE =====
+// Sans dépendance Arduino : compilables et vérifiables sur PC.
+// Chaîne par canal : suréchantillonnage -> filtre -> calibration -> bande morte.
+
+#define ANALOG_MAX_WINDOW 32   // Moyenne glissante : nombre max d'échantillons
+
+enum AnalogFilterType : uint8_t {
+  ANALOG_FILTER_NONE = 0,
+  ANALOG_FILTER_MOVING_AVERAGE,
+  ANALOG_FILTER_IIR              // Passe-bas du 1er ordre : y += alpha * (x - y)
+};
+
+struct MovingAverage {
+  float samples[ANALOG_MAX_WINDOW];
+  float sum;
+  uint8_t window;
+  uint8_t index;
+  uint8_t count;
+};
+
+inline void movingAverageInit(MovingAverage& f, uint8_t window) {
+  if (window < 1) window = 1;
+  if (window > ANALOG_MAX_WINDOW) window = ANALOG_MAX_WINDOW;
+  f.window = window;
+  f.index = 0;
+  f.count = 0;
+  f.sum = 0.0f;
+}
+
+inline float movingAverageUpdate(MovingAverage& f, float x) {
+  if (f.count == f.window) f.sum -= f.samples[f.index];
+  else f.count++;
+  f.samples[f.index] = x;
+  f.sum += x;
+  f.index++;
+  if (f.index == f.window) {
+    // Re-somme exacte à chaque tour : pas d'accumulation d'erreurs d'arrondi
+    f.index = 0;
+    float exact = 0.0f;
+    for (uint8_t i = 0; i < f.count; i++) exact += f.samples[i];
+    f.sum = exact;
+  }
+  return f.sum / f.count;
+}
+
+struct IirFilter {
+  float alpha;     // 0 < alpha <= 1 (1 = pas de filtrage)
+  float y;
+  bool primed;
+};
+
+inline void iirInit(IirFilter& f, float alpha) {
+  f.alpha = alpha <= 0.0f || alpha > 1.0f ? 1.0f : alpha;
+  f.y = 0.0f;
+  f.primed = false;
+}
+
+inline float iirUpdate(IirFilter& f, float x) {
+  // Le premier échantillon initialise la sortie (pas de rampe depuis 0)
+  if (!f.primed) {
+    f.y = x;
+    f.primed = true;
+  } else {
+    f.y += f.alpha * (x - f.y);
+  }
+  return f.y;
+}
+
+// Moyenne de `count` lectures brutes (réduit le bruit de quantification de l'ADC)
+inline float oversampleAverage(const uint16_t* readings, uint8_t count) {
+  if (count == 0) return 0.0f;
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < count; i++) sum += readings[i];
+  return (float)sum / count;
+}
+
+// Calibration deux points : inLo..inHi (mV à la broche) -> outLo..outHi (unité physique)
+// Ex. 4-20 mA sur shunt 150 Ω : 600..3000 mV -> 4..20 ; 0-10 V via pont 1/4 : 0..2500 mV -> 0..10
+struct LinearCalibration {
+  float inLo;
+  float inHi;
+  float outLo;
+  float outHi;
+};
+
+// inHi == inLo : pente infinie, refusée au chargement de la configuration
+inline bool calibrationValid(const LinearCalibration& c) {
+  return isfinite(c.inLo) && isfinite(c.inHi) && isfinite(c.outLo) && isfinite(c.outHi) && c.inHi != c.inLo;
+}
+
+inline float calibrate(const LinearCalibration& c, float x) {
+  float span = c.inHi - c.inLo;
+  if (span == 0.0f) return x;
+  return c.outLo + (x - c.inLo) * (c.outHi - c.outLo) / span;
+}
+
+// Publication : variation supérieure à la bande morte depuis la dernière valeur publiée
+inline bool deadbandExceeded(float value, float lastPublished, float deadband) {
+  if (isnan(lastPublished)) return true;
+  return fabsf(value - lastPublished) >= deadband;
+}
+
+#endif // ANALOG_FILTER_H
@@ -0,0 +1,401 @@
+#include "capture.h"
+#include "io_table.h"
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include <freertos/FreeRTOS.h>
+#include <esp_spi_flash.h>
+
+extern Config config;
+
+#define CAPTURE_MAGIC 0x50434F49   // "IOCP" en little-endian
+
+// En-tête de l'export binaire (little-endian), suivi de `count` événements de 9 octets
+struct __attribute__((packed)) CaptureHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t eventSize;
+  uint32_t count;
+  int32_t triggerIndex;      // Index du premier événement post-déclenchement, -1 si aucun
+  uint32_t baseTimeUs;       // Instant des niveaux de référence
+  uint32_t triggerTimeUs;
+  uint64_t pins;
+  uint64_t baseLevels;       // Niveaux avant le premier événement conservé
+};
+
+struct __attribute__((packed)) PackedEvent {
+  uint32_t timeUs;
+  uint32_t levelsLo;
+  uint8_t levelsHi;
+};
+
+static CaptureEvent* events = NULL;
+static uint32_t capacity = 0;
+static volatile CaptureState state = CAPTURE_IDLE;
+static CaptureSettings settings;
+static uint64_t attachedPins = 0;
+static bool bufferInPsram = false;
+static uint32_t missed = 0;           // Fronts perdus (PSRAM inaccessible pendant une écriture flash)
+static bool downloading = false;      // Un export en cours (curseur VCD unique, tampon figé)
+
+// Écrits par l'ISR (sous captureMux)
+static uint32_t written = 0;          // Événements écrits depuis l'armement
+static uint32_t postEvents = 0;       // Événements à écrire après le déclenchement
+static uint32_t triggerSeq = 0;
+static uint32_t triggerTimeUs = 0;
+static uint64_t lastLevels = 0;
+static uint64_t baseLevels = 0;
+static uint32_t baseTimeUs = 0;
+static unsigned long triggerMillis = 0;
+static portMUX_TYPE captureMux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint64_t IRAM_ATTR readLevels() {
+  return (uint64_t)REG_READ(GPIO_IN_REG) | ((uint64_t)(REG_READ(GPIO_IN1_REG) & 0xFF) << 32);
+}
+
+static inline uint64_t eventLevels(const CaptureEvent& e) {
+  return (uint64_t)e.levelsLo | ((uint64_t)e.levelsHi << 32);
+}
+
+static inline void IRAM_ATTR markTriggered(uint32_t now) {
+  state = CAPTURE_TRIGGERED;
+  triggerSeq = written;
+  triggerTimeUs = now;
+}
+
+static void IRAM_ATTR onCaptureEdge() {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  uint64_t levels = readLevels();
+
+  // Le cache (et donc la PSRAM) est coupé pendant les écritures flash (NVS, OTA)
+  if (bufferInPsram && !spi_flash_cache_enabled()) {
+    missed++;
+    return;
+  }
+
+  portENTER_CRITICAL_ISR(&captureMux);
+  CaptureState current = state;
+  uint64_t changed = (levels ^ lastLevels) & settings.pins;
+  // Plusieurs broches peuvent lever la même transition : un seul événement
+  if ((current == CAPTURE_ARMED || current == CAPTURE_TRIGGERED) && changed) {
+    if (current == CAPTURE_ARMED && settings.triggerPin >= 0 && ((changed >> settings.triggerPin) & 1)) {
+      bool high = (levels >> settings.triggerPin) & 1;
+      if (settings.edge == CAPTURE_EDGE_ANY ||
+          (settings.edge == CAPTURE_EDGE_RISING && high) ||
+          (settings.edge == CAPTURE_EDGE_FALLING && !high)) {
+        markTriggered(now);
+      }
+    }
+
+    CaptureEvent& slot = events[written % capacity];
+    if (written >= capacity) {
+      // L'événement écrasé devient la référence de l'historique conservé
+      baseLevels = eventLevels(slot);
+      baseTimeUs = slot.timeUs;
+    }
+    slot.timeUs = now;
+    slot.levelsLo = (uint32_t)levels;
+    slot.levelsHi = (uint8_t)(levels >> 32);
+    written++;
+    lastLevels = levels;
+
+    if (state == CAPTURE_TRIGGERED && written - triggerSeq >= postEvents) {
+      state = CAPTURE_DONE;
+    }
+  }
+  portEXIT_CRITICAL_ISR(&captureMux);
+}
+
+static uint32_t oldestSeq() {
+  return written > capacity ? written - capacity : 0;
+}
+
+static uint32_t retainedCount() {
+  return written - oldestSeq();
+}
+
+static void detachAll() {
+  for (int g = 0; g < IO_NATIVE_PIN_COUNT; g++) {
+    if ((attachedPins >> g) & 1) detachInterrupt(digitalPinToInterrupt(g));
+  }
+  attachedPins = 0;
+}
+
+void setupCapture() {
+  if (events) return;
+  // Tampon alloué une fois : aucune allocation pendant la capture
+  if (psramFound()) {
+    capacity = CAPTURE_PSRAM_EVENTS;
+    events = (CaptureEvent*)ps_malloc(sizeof(CaptureEvent) * capacity);
+    bufferInPsram = events != NULL;
+  }
+  if (!events) {
+    capacity = CAPTURE_RAM_EVENTS;
+    events = (CaptureEvent*)malloc(sizeof(CaptureEvent) * capacity);
+  }
+  if (!events) {
+    capacity = 0;
+    Serial.println("❌ Capture: buffer allocation failed");
+    return;
+  }
+  Serial.printf("✅ Capture buffer: %u events (%s)\n", capacity, bufferInPsram ? "PSRAM" : "RAM");
+}
+
+bool captureArm(const CaptureSettings& requested, const char** error) {
+  if (!events) { *error = "Tampon de capture indisponible"; return false; }
+  uint64_t pins = requested.pins & ((1ULL << IO_NATIVE_PIN_COUNT) - 1);
+  if (requested.triggerPin >= IO_NATIVE_PIN_COUNT) { *error = "Broche de déclenchement invalide"; return false; }
+  if (requested.triggerPin >= 0) pins |= 1ULL << requested.triggerPin;
+  if (!pins) { *error = "Aucun GPIO à surveiller"; return false; }
+  if (downloading) { *error = "Téléchargement de capture en cours"; return false; }
+
+  captureStop();
+
+  portENTER_CRITICAL(&captureMux);
+  settings = requested;
+  settings.pins = pins;
+  settings.preTriggerPercent = constrain(settings.preTriggerPercent, 0, 99);
+  if (settings.durationMs == 0 || settings.durationMs > CAPTURE_MAX_DURATION_MS) settings.durationMs = CAPTURE_MAX_DURATION_MS;
+  written = 0;
+  missed = 0;
+  postEvents = capacity - (uint32_t)((uint64_t)capacity * settings.preTriggerPercent / 100);
+  lastLevels = readLevels();
+  baseLevels = lastLevels;
+  baseTimeUs = (uint32_t)esp_timer_get_time();
+  triggerSeq = 0;
+  triggerTimeUs = 0;
+  state = CAPTURE_ARMED;
+  portEXIT_CRITICAL(&captureMux);
+
+  for (int g = 0; g < IO_NATIVE_PIN_COUNT; g++) {
+    if (!((pins >> g) & 1)) continue;
+    attachInterrupt(digitalPinToInterrupt(g), onCaptureEdge, CHANGE);
+    attachedPins |= 1ULL << g;
+  }
+  Serial.printf("🎯 Capture armed: %d GPIO, trigger %d\n", __builtin_popcountll(pins), settings.triggerPin);
+  return true;
+}
+
+void captureTrigger() {
+  portENTER_CRITICAL(&captureMux);
+  if (state == CAPTURE_ARMED) markTriggered((uint32_t)esp_timer_get_time());
+  portEXIT_CRITICAL(&captureMux);
+}
+
+void captureStop() {
+  detachAll();
+  portENTER_CRITICAL(&captureMux);
+  if (state == CAPTURE_ARMED || state == CAPTURE_TRIGGERED) {
+    state = written > 0 ? CAPTURE_DONE : CAPTURE_IDLE;
+  }
+  portEXIT_CRITICAL(&captureMux);
+}
+
+void captureLoop() {
+  CaptureState current = state;
+  if (current == CAPTURE_TRIGGERED) {
+    if (triggerMillis == 0) triggerMillis = millis();
+    if (millis() - triggerMillis < settings.durationMs) return;
+    captureStop();   // Durée écoulée avant que le tampon soit plein
+  } else {
+    triggerMillis = 0;
+    if (current != CAPTURE_DONE || !attachedPins) return;
+    detachAll();     // Tampon plein (fin décidée par l'ISR)
+  }
+  Serial.printf("📼 Capture complete: %u events\n", retainedCount());
+}
+
+CaptureState captureState() {
+  return state;
+}
+
+const char* captureStateName(CaptureState s) {
+  switch (s) {
+    case CAPTURE_IDLE:      return "idle";
+    case CAPTURE_ARMED:     return "armed";
+    case CAPTURE_TRIGGERED: return "triggered";
+    case CAPTURE_DONE:      return "done";
+  }
+  return "unknown";
+}
+
+void captureStatusToJson(JsonObject out) {
+  out["state"] = captureStateName(state);
+  out["capacity"] = capacity;
+  out["events"] = retainedCount();
+  out["written"] = written;
+  out["missed"] = missed;
+  out["pins"] = settings.pins;
+  out["triggerPin"] = settings.triggerPin;
+  out["preTriggerPercent"] = settings.preTriggerPercent;
+  out["durationMs"] = settings.durationMs;
+  if (state == CAPTURE_TRIGGERED || state == CAPTURE_DONE) {
+    out["triggerIndex"] = triggerSeq >= oldestSeq() ? (int32_t)(triggerSeq - oldestSeq()) : -1;
+  }
+}
+
+// ----- Téléchargement -----
+
+bool captureBeginDownload() {
+  if (downloading || state != CAPTURE_DONE) return false;
+  downloading = true;
+  return true;
+}
+
+void captureEndDownload() {
+  downloading = false;
+}
+
+bool captureDownloading() {
+  return downloading;
+}
+
+// ----- Export binaire -----
+
+size_t captureBinarySize() {
+  return sizeof(CaptureHeader) + (size_t)retainedCount() * sizeof(PackedEvent);
+}
+
+size_t captureFillBinary(uint8_t* buffer, size_t maxLen, size_t index) {
+  size_t total = captureBinarySize();
+  size_t out = 0;
+  while (out < maxLen && index < total) {
+    if (index < sizeof(CaptureHeader)) {
+      CaptureHeader h;
+      h.magic = CAPTURE_MAGIC;
+      h.version = 1;
+      h.eventSize = sizeof(PackedEvent);
+      h.count = retainedCount();
+      h.triggerIndex = (state == CAPTURE_DONE && triggerSeq >= oldestSeq() && triggerSeq < written)
+                           ? (int32_t)(triggerSeq - oldestSeq()) : -1;
+      h.baseTimeUs = baseTimeUs;
+      h.triggerTimeUs = triggerTimeUs;
+      h.pins = settings.pins;
+      h.baseLevels = baseLevels;
+      size_t n = min(maxLen - out, sizeof(CaptureHeader) - index);
+      memcpy(buffer + out, (const uint8_t*)&h + index, n);
+      out += n;
+      index += n;
+      continue;
+    }
+    size_t offset = index - sizeof(CaptureHeader);
+    uint32_t k = offset / sizeof(PackedEvent);
+    const CaptureEvent& e = events[(oldestSeq() + k) % capacity];
+    PackedEvent p = { e.timeUs, e.levelsLo, e.levelsHi };
+    size_t within = offset % sizeof(PackedEvent);
+    size_t n = min(maxLen - out, sizeof(PackedEvent) - within);
+    memcpy(buffer + out, (const uint8_t*)&p + within, n);
+    out += n;
+    index += n;
+  }
+  return out;
+}
+
+// ----- Export VCD (Value Change Dump, lisible par GTKWave/PulseView) -----
+
+// Le VCD est produit ligne par ligne dans `line`, puis recopié par morceaux dans
+// les tampons de la réponse HTTP (taille imposée par AsyncTCP).
+static struct {
+  char line[512];
+  size_t len;
+  size_t pos;
+  int phase;           // 0 = en-tête, 1 = variables, 2 = valeurs initiales, 3 = événements, 4 = fin
+  int pinCursor;
+  uint32_t eventCursor;
+  uint64_t levels;
+} vcd;
+
+static char vcdIdentifier(int gpio) {
+  return (char)('!' + gpio);   // 40 identifiants imprimables distincts
+}
+
+static void vcdPinName(int gpio, char* out, size_t size) {
+  IoSnapshot table;
+  int index = ioIndexByPin(*table, gpio);
+  if (index < 0) {
+    snprintf(out, size, "gpio%d", gpio);
+    return;
+  }
+  // Référence VCD : pas d'espace
+  strlcpy(out, table->pins[index].name, size);
+  for (char* c = out; *c; c++) if (*c == ' ') *c = '_';
+}
+
+// Produit la prochaine ligne (ou groupe de lignes) ; false quand le VCD est terminé
+static bool vcdNextLine() {
+  vcd.len = 0;
+  vcd.pos = 0;
+  char* l = vcd.line;
+  size_t size = sizeof(vcd.line);
+
+  switch (vcd.phase) {
+    case 0: {
+      long trigger = (long)(triggerTimeUs - baseTimeUs);
+      vcd.len = snprintf(l, size,
+                         "$version %s capture $end\n$timescale 1us $end\n"
+                         "$comment trigger pin %d at #%ld $end\n$scope module %s $end\n",
+                         config.deviceName, settings.triggerPin,
+                         (state == CAPTURE_DONE && triggerTimeUs) ? trigger : -1L, config.deviceName);
+      vcd.phase = 1;
+      vcd.pinCursor = 0;
+      return true;
+    }
+    case 1:
+      while (vcd.pinCursor < IO_NATIVE_PIN_COUNT && !((settings.pins >> vcd.pinCursor) & 1)) vcd.pinCursor++;
+      if (vcd.pinCursor < IO_NATIVE_PIN_COUNT) {
+        char name[40];
+        vcdPinName(vcd.pinCursor, name, sizeof(name));
+        vcd.len = snprintf(l, size, "$var wire 1 %c %s $end\n", vcdIdentifier(vcd.pinCursor), name);
+        vcd.pinCursor++;
+        return true;
+      }
+      vcd.len = snprintf(l, size, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+      vcd.phase = 2;
+      return true;
+    case 2: {
+      vcd.levels = baseLevels;
+      for (int g = 0; g < IO_NATIVE_PIN_COUNT; g++) {
+        if (!((settings.pins >> g) & 1)) continue;
+        vcd.len += snprintf(l + vcd.len, size - vcd.len, "%d%c\n", (int)((vcd.levels >> g) & 1), vcdIdentifier(g));
+      }
+      vcd.len += snprintf(l + vcd.len, size - vcd.len, "$end\n");
+      vcd.phase = 3;
+      vcd.eventCursor = 0;
+      return true;
+    }
+    case 3: {
+      if (vcd.eventCursor >= retainedCount()) {
+        vcd.phase = 4;
+        return false;
+      }
+      const CaptureEvent& e = events[(oldestSeq() + vcd.eventCursor) % capacity];
+      vcd.eventCursor++;
+      uint64_t levels = eventLevels(e);
+      uint64_t changed = (levels ^ vcd.levels) & settings.pins;
+      vcd.levels = levels;
+      vcd.len = snprintf(l, size, "#%lu\n", (unsigned long)(e.timeUs - baseTimeUs));
+      while (changed) {
+        int g = __builtin_ctzll(changed);
+        changed &= changed - 1;
+        vcd.len += snprintf(l + vcd.len, size - vcd.len, "%d%c\n", (int)((levels >> g) & 1), vcdIdentifier(g));
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+size_t captureFillVcd(uint8_t* buffer, size_t maxLen, size_t index) {
+  if (index == 0) {
+    memset(&vcd, 0, sizeof(vcd));
+  }
+  size_t out = 0;
+  while (out < maxLen) {
+    if (vcd.pos >= vcd.len && !vcdNextLine()) break;
+    size_t n = min(maxLen - out, vcd.len - vcd.pos);
+    memcpy(buffer + out, vcd.line + vcd.pos, n);
+    out += n;
+    vcd.pos += n;
+  }
+  return out;
+}
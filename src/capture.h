@@ -0,0 +1,64 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== CAPTURE D'ENTRÉES (mise en service) =====
+// Enregistre chaque front des GPIO surveillés avec un horodatage µs (interruption
+// sur changement + lecture des registres GPIO_IN) dans un tampon circulaire alloué
+// une fois au démarrage (PSRAM si présente). Armée, la capture conserve l'historique
+// pré-déclenchement ; après le déclenchement elle remplit le reste du tampon puis
+// s'arrête. Le résultat est téléchargeable en VCD ou en binaire compact.
+
+enum CaptureState : uint8_t {
+  CAPTURE_IDLE = 0,
+  CAPTURE_ARMED,       // Enregistrement circulaire, attente du déclenchement
+  CAPTURE_TRIGGERED,   // Enregistrement post-déclenchement
+  CAPTURE_DONE
+};
+
+enum CaptureEdge : uint8_t {
+  CAPTURE_EDGE_ANY = 0,
+  CAPTURE_EDGE_RISING,
+  CAPTURE_EDGE_FALLING
+};
+
+// Un front : niveaux de tous les GPIO (0..39) au moment de l'interruption
+struct CaptureEvent {
+  uint32_t timeUs;      // esp_timer, 32 bits bas
+  uint32_t levelsLo;    // GPIO 0..31
+  uint8_t levelsHi;     // GPIO 32..39
+};
+
+struct CaptureSettings {
+  uint64_t pins;             // Masque des GPIO surveillés
+  int triggerPin;            // -1 = déclenchement manuel (/api/capture/trigger)
+  CaptureEdge edge;
+  uint8_t preTriggerPercent; // Part du tampon réservée à l'historique
+  uint32_t durationMs;       // Durée max après déclenchement
+};
+
+void setupCapture();                              // Alloue le tampon (une seule fois)
+void captureLoop();                               // Fin de capture sur durée écoulée
+bool captureArm(const CaptureSettings& settings, const char** error);
+void captureTrigger();
+void captureStop();
+CaptureState captureState();
+const char* captureStateName(CaptureState state);
+void captureStatusToJson(JsonObject out);
+
+// Un seul téléchargement à la fois (tâche AsyncTCP) : l'export VCD garde son curseur
+// dans un état global et l'armement réécrirait le tampon en cours de lecture.
+// captureArm() est refusé entre captureBeginDownload() et captureEndDownload().
+bool captureBeginDownload();                      // false : déjà en cours ou pas de capture terminée
+void captureEndDownload();                        // À la déconnexion du client (fin ou abandon)
+bool captureDownloading();
+
+// Export (état DONE) : remplissent `buffer` à partir de l'octet `index`, 0 = fin
+size_t captureBinarySize();
+size_t captureFillBinary(uint8_t* buffer, size_t maxLen, size_t index);
+size_t captureFillVcd(uint8_t* buffer, size_t maxLen, size_t index);
+
+#endif // CAPTURE_H
@@ -0,0 +1,77 @@
+#include "clock_model.h"
+#include <math.h>
+#include <string.h>
+
+void clockModelReset(ClockModel& model) {
+  memset((void*)&model, 0, sizeof(model));
+}
+
+uint64_t clockModelPredict(const ClockModel& model, int64_t localUs) {
+  int64_t elapsed = localUs - model.localRefUs;
+  return model.masterRefUs + elapsed + (int64_t)(elapsed * (double)model.driftPpm / 1e6);
+}
+
+uint32_t clockModelUncertainty(const ClockModel& model, const ClockModelParams& params, int64_t localUs) {
+  if (!model.valid) return UINT32_MAX;
+  double elapsed = (double)(localUs - model.localRefUs);
+  double ppm = model.driftKnown ? params.driftResidualPpm : params.driftUnknownPpm;
+  double u = model.baseUncertaintyUs + elapsed * ppm / 1e6;
+  return u > UINT32_MAX ? UINT32_MAX : (uint32_t)u;
+}
+
+bool clockModelSample(ClockModel& model, const ClockModelParams& params, TimeSource source,
+                      int64_t localUs, uint64_t sampleUs, uint32_t uncertaintyUs) {
+  ClockSourceState& st = model.sources[source];
+  float measuredDrift = 0;
+  bool driftUpdated = false;
+
+  int64_t offset = model.valid ? (int64_t)(sampleUs - clockModelPredict(model, localUs)) : 0;
+  st.lastOffsetUs = offset > INT32_MAX ? INT32_MAX : offset < INT32_MIN ? INT32_MIN : (int32_t)offset;
+  st.samples++;
+  st.lastLocalUs = localUs;
+
+  // Aberrant : ni la dérive ni la référence ne sont touchées
+  uint64_t magnitude = (uint64_t)(offset < 0 ? -offset : offset);
+  if (model.valid) {
+    uint64_t bound = (uint64_t)clockModelUncertainty(model, params, localUs) + uncertaintyUs + params.outlierMarginUs;
+    if (magnitude <= bound) {
+      st.consecutiveOutliers = 0;
+    } else if (++st.consecutiveOutliers < params.outlierMaxConsecutive) {
+      st.outliers++;
+      return false;
+    } else {
+      st.consecutiveOutliers = 0;
+      st.driftRefLocalUs = 0;   // Saut : la mesure de dérive repart de cet échantillon
+    }
+  }
+
+  // Dérive : comparaison sur une longue base de temps pour que le bruit
+  // de l'échantillon (quelques ms) reste négligeable
+  if (st.driftRefLocalUs == 0) {
+    st.driftRefLocalUs = localUs;
+    st.driftRefMasterUs = sampleUs;
+  } else if (localUs - st.driftRefLocalUs >= (int64_t)params.driftMinIntervalS * 1000000LL) {
+    double localDelta = (double)(localUs - st.driftRefLocalUs);
+    double masterDelta = (double)(int64_t)(sampleUs - st.driftRefMasterUs);
+    measuredDrift = (float)((masterDelta - localDelta) / localDelta * 1e6);
+    st.driftRefLocalUs = localUs;
+    st.driftRefMasterUs = sampleUs;
+    driftUpdated = fabsf(measuredDrift) < params.driftMaxPpm;
+  }
+
+  if (model.valid && model.source != source && uncertaintyUs > clockModelUncertainty(model, params, localUs)) {
+    return false;
+  }
+  if (driftUpdated && (model.source == source || !model.driftKnown)) {
+    model.driftPpm = model.driftKnown ? model.driftPpm + params.driftEmaAlpha * (measuredDrift - model.driftPpm)
+                                      : measuredDrift;
+    model.driftKnown = true;
+  }
+  model.source = source;
+  model.localRefUs = localUs;
+  model.masterRefUs = sampleUs;
+  model.baseUncertaintyUs = magnitude > uncertaintyUs ? (magnitude > UINT32_MAX ? UINT32_MAX : (uint32_t)magnitude)
+                                                      : uncertaintyUs;
+  model.valid = true;
+  return true;
+}
@@ -0,0 +1,65 @@
+#ifndef CLOCK_MODEL_H
+#define CLOCK_MODEL_H
+
+#include <stdint.h>
+
+// ===== MODÈLE D'HORLOGE DISCIPLINÉ =====
+// temps = masterRefUs + écoulé * (1 + driftPpm / 1e6), l'écoulé étant lu sur
+// l'horloge locale monotone (esp_timer). Sans dépendance matérielle ni verrou :
+// time_sync.cpp le protège et lui fournit l'heure locale, le simulateur PC
+// (tools/sync_sim.cpp) en instancie un par appareil simulé.
+
+enum TimeSource : uint8_t {
+  TIME_SOURCE_NONE = 0,
+  TIME_SOURCE_SNTP,
+  TIME_SOURCE_MQTT
+};
+#define TIME_SOURCE_COUNT 3
+
+struct ClockModelParams {
+  float driftUnknownPpm;       // Hypothèse tant que la dérive n'est pas mesurée
+  float driftResidualPpm;      // Erreur résiduelle après correction de dérive
+  float driftMaxPpm;           // Mesure de dérive au-delà : rejetée (saut d'horloge)
+  uint32_t driftMinIntervalS;  // Base de temps minimale d'une mesure de dérive
+  float driftEmaAlpha;
+  uint32_t outlierMarginUs;    // Écart toléré au-delà des incertitudes du modèle et de l'échantillon
+  uint8_t outlierMaxConsecutive;   // Aberrants d'affilée d'une source : saut réel, adopté
+};
+
+// Dernier état de chaque source
+struct ClockSourceState {
+  uint32_t samples;
+  int64_t lastLocalUs;
+  int32_t lastOffsetUs;        // Écart échantillon - modèle au moment de la réception
+  int64_t driftRefLocalUs;     // Point de départ de la mesure de dérive en cours
+  uint64_t driftRefMasterUs;
+  uint32_t outliers;           // Échantillons écartés (message retardé)
+  uint8_t consecutiveOutliers;
+};
+
+struct ClockModel {
+  volatile bool valid;
+  TimeSource source;
+  int64_t localRefUs;
+  uint64_t masterRefUs;
+  uint32_t baseUncertaintyUs;
+  float driftPpm;              // > 0 : l'oscillateur local retarde
+  bool driftKnown;
+  ClockSourceState sources[TIME_SOURCE_COUNT];
+};
+
+void clockModelReset(ClockModel& model);
+uint64_t clockModelPredict(const ClockModel& model, int64_t localUs);
+uint32_t clockModelUncertainty(const ClockModel& model, const ClockModelParams& params, int64_t localUs);
+
+// Intègre un échantillon reçu à localUs ; la source est adoptée (true) si elle est
+// déjà active ou si son incertitude est meilleure que celle du modèle en holdover.
+// Un échantillon qui s'écarte de la prédiction de plus que les deux incertitudes
+// (plus outlierMarginUs) est écarté : un message retardé ne fait pas sauter l'horloge.
+// Après outlierMaxConsecutive écarts d'affilée, l'horloge maître a vraiment changé :
+// l'échantillon est adopté. Un échantillon adopté porte au moins l'écart observé en
+// incertitude, pour que l'incertitude annoncée reste à la mesure de l'erreur.
+bool clockModelSample(ClockModel& model, const ClockModelParams& params, TimeSource source,
+                      int64_t localUs, uint64_t sampleUs, uint32_t uncertaintyUs);
+
+#endif // CLOCK_MODEL_H
@@ -3,40 +3,211 @@
 
 #include <Arduino.h>
 
-#define MAX_IOS 20
+#define MAX_IOS 128   // GPIO natifs + broches d'extension (I2C)
+
+// ===== TABLE D'I/O =====
+// Broches 0..39 : GPIO de l'ESP32. Broches IO_EXPANDER_PIN_BASE et + : broches
+// virtuelles d'extension, IO_EXPANDER_CHANNELS par expander (ordre de config.expanders).
+#define IO_NATIVE_PIN_COUNT   40
+#define IO_EXPANDER_PIN_BASE  64
+#define IO_EXPANDER_CHANNELS  16
+#define MAX_EXPANDERS         8        // 64 + 8*16 = 192 < 255 (IOPin.pin est un uint8_t)
+#define IO_NAME_HASH_SIZE     256      // Puissance de 2, >= 2 * MAX_IOS
+#define IO_EXPANDER_POLL_MS   5        // Scrutation des ports d'extension sans ligne INT
+#define IO_EXPANDER_RESYNC_MS 100      // Avec INT : relecture de sécurité (front manqué)
+#define I2C_DEFAULT_SDA       14
+#define I2C_DEFAULT_SCL       15
+#define I2C_FREQUENCY         400000
+
+// ===== TÂCHES =====
+// Core 1 (APP_CPU) est réservé au temps réel : commandes, commandes programmées,
+// balayage des entrées. Tout le reste tourne sur le core 0 avec la pile réseau
+// (lwIP/Ethernet/WiFi prio 18-23, esp-mqtt MQTT_TASK_PRIORITY, AsyncTCP prio 3).
+#define RT_TASK_CORE             1
+#define RT_TASK_PRIORITY         20     // Au-dessus de tout ce qui tourne sur le core 1
+#define RT_TASK_STACK_SIZE       4096
+#define NET_TASK_PRIORITY        3      // Machine d'état MQTT, files de publication, SNTP, OTA
+#define NET_TASK_STACK_SIZE      6144
+#define SERIAL_TASK_PRIORITY     2      // Pont série
+#define SERIAL_TASK_STACK_SIZE   4096
+#define SERIAL_SERVER_TASK_PRIORITY 4   // Serveur TCP du pont série : au-dessus de NetTask et AsyncTCP
+#define SERIAL_SERVER_STACK_SIZE 4096
+#define MODBUS_TASK_PRIORITY     2      // Maître Modbus RTU (bloqué sur l'UART entre deux trames)
+#define MODBUS_TASK_STACK_SIZE   4096
+#define MODBUS_TCP_TASK_PRIORITY 3      // Serveur Modbus TCP : comme NetTask et AsyncTCP
+#define MODBUS_TCP_STACK_SIZE    4096
+#define LOG_TASK_PRIORITY        1      // Écriture des logs sur l'UART (tâche la moins prioritaire)
+#define LOG_TASK_STACK_SIZE      3072
+#define SERVICE_TASK_CORE        0
+#define IO_COMMAND_QUEUE_LENGTH  32     // Commandes MQTT/web/multicast -> tâche temps réel
+#define IO_BATCH_MAX_OPS         IO_COMMAND_QUEUE_LENGTH  // /api/io/batch : un lot tient dans la file
+#define SERIAL_TX_QUEUE_BYTES    2048   // Messages à émettre sur le pont série
+#define LOG_QUEUE_BYTES          4096   // Lignes de log en attente d'écriture
+#define LOG_LINE_LENGTH          192
+#define TASK_METRICS_MAX         32     // Tâches suivies par /api/metrics
+#define TASK_METRICS_PERIOD_MS   1000   // Fenêtre de calcul des % CPU
+
+// ===== MÉMOIRE =====
+// Régime établi sans allocation : documents JSON dans des arènes fixes (json_arena.h),
+// chaînes dans des tampons de taille fixe. Vérifié par le build ALLOC_AUDIT (alloc_audit.h).
+#define JSON_ARENA_MQTT_BYTES    6144   // Tâche MQTT : commandes, esp32/time/sync, ping
+#define JSON_ARENA_NET_BYTES     6144   // Tâche réseau : métriques MQTT, qualité du temps
+#define JSON_ARENA_WEB_BYTES     16384  // Tâche AsyncTCP : routes /api
+#define WEB_RESPONSE_BYTES       8192   // Réponses /api sérialisées ici (au-delà : String, rare)
+#define WEB_BODY_BYTES           16384  // Corps de requête /api reçu en plusieurs morceaux (au-delà : 413)
+#define WEB_BODY_TIMEOUT_MS      5000   // Tampon repris si le client s'arrête au milieu du corps
+#define ACCESS_LOG_ENTRIES       100    // Anneau des dernières requêtes HTTP (/api/access/log)
+#define ACCESS_MAX_ROUTES        48     // Routes suivies (latence, débit) ; au-delà, comptées dans "other"
+#define ACCESS_CLIENT_SLOTS      16     // Clients suivis, le moins récent est remplacé
+#define ACCESS_HISTOGRAM_BUCKETS 16     // Durées en puissances de 2 de µs : [0,1), [1,2), [2,4)... [16384, ∞)
+#define ACCESS_RATE_WINDOW_MS    10000  // Fenêtre du calcul des requêtes/s
+#define SERIAL_LINE_LENGTH       256    // Ligne reçue sur le pont série
+#define SERIAL_LOG_ENTRIES       50     // Historique /api/serial/logs
+#define SERIAL_LOG_MESSAGE_LENGTH 160   // Messages plus longs tronqués dans l'historique
+#define SERIAL_RPC_QUEUE_LENGTH  8      // Requêtes <device>/serial/rpc reçues, pas encore prises par la tâche série
+#define SERIAL_RPC_MAX_PENDING   8      // Requêtes en cours (émises ou en attente d'émission)
+#define SERIAL_RPC_MESSAGE_LENGTH 192
+#define SERIAL_RPC_MATCH_LENGTH  32
+#define SERIAL_RPC_DEFAULT_TIMEOUT_MS 1000
+#define SERIAL_RPC_MAX_TIMEOUT_MS 60000
+#define SERIAL_SERVER_UART_RX_BYTES 8192  // Pilote UART avec le serveur TCP : ~90 ms de réception à 921600 bauds
+#define SERIAL_SERVER_UART_TX_BYTES 4096
+#define SERIAL_SERVER_CHUNK      1024   // Octets lus par passe, dans chaque sens
+#define SERIAL_SERVER_DEFAULT_PORT 2217
+#define ALLOC_AUDIT_GRACE_MS     30000  // Initialisations paresseuses tolérées après le boot
+#define ALLOC_AUDIT_MAX_TASKS    10
+#define ALLOC_AUDIT_LOG_ENTRIES  16     // Violations détaillées (les suivantes sont comptées)
 
 
 // ===== CONFIGURATION PINS =====
 #define RELAY_K1        16
 #define RELAY_K2       17
+#define SERIAL_BRIDGE_UART UART_NUM_2   // Serial2 : pont série, serveur TCP, Modbus
 
 // ===== STRUCTURES =====
 // Structure for a single configurable I/O pin
+// Enregistrement "froid" (persisté tel quel en NVS) : les champs chauds sont
+// recopiés dans la table SoA de io_table.h, qui fait foi pour l'état courant.
 struct IOPin {
   uint8_t pin;
   char name[32];
-  uint8_t mode; // 0 = DISABLED, 1 = INPUT, 2 = OUTPUT
+  uint8_t mode; // 0 = DISABLED, 1 = INPUT, 2 = OUTPUT, 3 = ANALOG
   uint8_t inputType; // For inputs: 0 = INPUT, 1 = INPUT_PULLUP, 2 = INPUT_PULLDOWN
   bool state;   // Current state (for outputs) or last read state (for inputs)
   bool defaultState; // Default state at boot for outputs
 };
 
 
+// Paramètres d'une entrée analogique (IOPin.mode == 3), persistés à part
+// pour ne pas changer le format des enregistrements IOPin existants.
+struct AnalogConfig {
+  uint8_t pin;
+  uint8_t oversampling;   // Lectures ADC moyennées par échantillon (1..ANALOG_MAX_OVERSAMPLING)
+  uint8_t filter;         // AnalogFilterType : 0 = aucun, 1 = moyenne glissante, 2 = IIR
+  uint8_t window;         // Moyenne glissante (1..ANALOG_MAX_WINDOW)
+  float alpha;            // IIR (0..1]
+  float inLo, inHi;       // Calibration deux points : mV à la broche...
+  float outLo, outHi;     // ... -> unité physique
+  float deadband;         // Variation minimale (unité physique) pour publier
+  uint32_t minIntervalMs; // Intervalle minimal entre deux publications
+  uint32_t periodMs;      // Publication périodique (0 = seulement sur variation)
+  char unit[8];
+};
+
+// Requête HTTP journalisée (access_log.h) : champs bruts, mis en texte à la lecture
 struct AccessLog {
-  char timestamp[25];
-  char ip[16];
-  char resource[50];
+  uint32_t atMs;           // millis() à la fin du traitement
+  uint32_t ip;             // IPv4 du client, ordre réseau
+  uint32_t bytes;          // Taille du corps de réponse (0 si inconnue : fichier, flux)
+  uint32_t durationUs;     // Durée du gestionnaire de la route
+  uint16_t status;
+  uint8_t route;           // Index dans la table des routes
+  uint8_t reserved;
 };
 
+// ===== MODBUS RTU =====
+#define MODBUS_MAX_REGISTERS     64     // Entrées de la table de registres (modbus_rtu.h)
+#define MODBUS_MAX_GROUPS        32     // Lectures distinctes après fusion des registres voisins
+#define MODBUS_MERGE_GAP         4      // Registres inutilisés lus en plus pour fusionner deux entrées
+#define MODBUS_DEFAULT_TIMEOUT_MS 200
+#define MODBUS_OFFLINE_AFTER     3      // Échecs consécutifs avant de marquer les valeurs invalides
+#define MODBUS_MIN_INTERVAL_MS   10
+#define MODBUS_TCP_DEFAULT_PORT  502
+#define MODBUS_TCP_MAX_CLIENTS   4      // Maîtres connectés simultanément (les suivants sont refusés)
+#define MODBUS_TCP_IDLE_TIMEOUT_MS 60000 // Connexion sans requête fermée (place libérée)
+
+// ===== ANALOG =====
+#define ANALOG_MAX_CHANNELS      8      // ADC1 uniquement (GPIO 32..39), l'ADC2 est pris par le WiFi
+#define ANALOG_SAMPLE_PERIOD_MS  10     // Cadence de la tâche d'échantillonnage (100 Hz)
+#define ANALOG_MAX_OVERSAMPLING  64
+#define ANALOG_TASK_STACK_SIZE   4096
+#define ANALOG_TASK_PRIORITY     1      // Core SERVICE_TASK_CORE, dort entre deux périodes
+
+// ===== CAPTURE =====
+#define CAPTURE_RAM_EVENTS       2048   // 24 Ko sans PSRAM
+#define CAPTURE_PSRAM_EVENTS     65536
+#define CAPTURE_MAX_DURATION_MS  10000  // Durée max après déclenchement
+
+// ===== OTA =====
+// Écritures flash de la mise à jour placées entre les échéances (ota_guard.h)
+#define OTA_FLASH_GUARD_US       50000  // Pas d'écriture si une commande programmée tombe dans cette fenêtre
+#define OTA_DEADLINE_HORIZON_US  1000000 // Échéances publiées par la tâche temps réel au-delà de la garde
+#define OTA_GATE_MAX_WAIT_MS     500    // Attente max d'une fenêtre (chien de garde AsyncTCP)
+#define OTA_SECTOR_PAUSE_MS      5      // Laissés à la tâche temps réel après chaque secteur écrit
+#define OTA_LATE_THRESHOLD_US    2000   // Commande programmée comptée en retard pendant une OTA
+// Mise à jour compressée / différentielle (ota_update.h)
+#define OTA_COPY_CHUNK           1024   // Lecture du firmware en cours (patch, empreinte source)
+#define OTA_REBOOT_DELAY_MS      1000   // Après la réponse HTTP
+#define OTA_HEALTH_STABLE_MS     10000  // Nouveau firmware : critères de santé tenus sans interruption...
+#define OTA_HEALTH_TIMEOUT_MS    180000 // ... avant ce délai, sinon retour à l'ancien firmware
+
+// ===== MQTT =====
+#define MQTT_DEFAULT_BUFFER_SIZE 1024   // Taille par défaut du tampon de paquets (octets)
+#define MQTT_TASK_PRIORITY       5      // Priorité de la tâche esp-mqtt
+#define MQTT_TASK_STACK_SIZE     6144
+#define MQTT_NETWORK_TIMEOUT_MS  10000  // Timeout TCP/CONNACK (dans la tâche MQTT, non bloquant pour loop())
+#define MQTT_BACKOFF_MIN_MS      1000   // Premier délai de reconnexion (doublé à chaque échec)
+#define MQTT_BACKOFF_MAX_MS      60000  // Plafond du backoff exponentiel
+#define MQTT_STABLE_CONNECTION_MS 30000 // Connexion considérée stable -> backoff remis à zéro
+#define MQTT_INSTABILITY_DECAY_MIN 10.0f // Constante de décroissance du score de santé (minutes)
+#define MQTT_STATS_INTERVAL_MS   60000  // Publication périodique de <device>/metrics/mqtt
+#define MQTT_DOWNTIME_BUCKETS    6      // Classes de l'histogramme des durées de coupure
+#define MAX_GROUPS               4      // Groupes de diffusion (group/<g>/control/...)
+
+// Ordonnanceur de publication : une file par classe de priorité (taille en octets),
+// débit limité par seau à jetons (messages/s, rafale)
+#define MQTT_QUEUE_REALTIME_BYTES 2048   // pong, acquittements de commandes
+#define MQTT_QUEUE_STATE_BYTES    8192   // changements d'état, instantanés, disponibilité, analogique
+#define MQTT_QUEUE_BULK_BYTES     4096   // pont série, métriques
+#define MQTT_RATE_REALTIME        50
+#define MQTT_BURST_REALTIME       10
+#define MQTT_RATE_STATE           100
+#define MQTT_BURST_STATE          32
+#define MQTT_RATE_BULK            20
+#define MQTT_BURST_BULK           5
+#define MQTT_OUTBOX_HIGH_WATER    2048   // Octets dans l'outbox esp-mqtt au-delà desquels on n'y ajoute plus rien
+#define MQTT_REPUBLISH_BATCH      8      // États republiés en file à la fois après (re)connexion
+
+// Instantané d'état (<device>/state) et deltas versionnés (<device>/state/delta)
+#define STATE_SNAPSHOT_INTERVAL_MS     60000  // Republication périodique
+#define STATE_SNAPSHOT_MIN_INTERVAL_MS 1000   // Demandes regroupées (plusieurs consommateurs)
+#define STATE_SNAPSHOT_BYTES           5120   // 128 I/O aux noms de 31 caractères
+
+#include "time_sync_config.h"   // Section TIME SYNC, partagée avec tools/sync_sim.cpp
+
 // Maximum number of scheduled commands
 #define MAX_SCHEDULED_COMMANDS 10
 
+#define COMMAND_ID_LENGTH 33   // Identifiant de corrélation ("id" du message de contrôle), 32 car. max
+
 struct ScheduledCommand {
   bool active;
   int pin;
   int state;
   uint32_t exec_at_sec;  // Unix timestamp en secondes
   uint32_t exec_at_us;   // Microsecondes (0-999999)
+  uint64_t received_us;  // Réception de la commande (horloge corrigée)
+  char id[COMMAND_ID_LENGTH];  // Vide = pas d'accusé sur <device>/ack
 };
 
 
@@ -59,6 +230,28 @@ struct Config {
   char mqttUser[32];
   char mqttPassword[32];
   char mqttTopic[32];
+  int mqttBufferSize;    // Tampon de paquets MQTT (entrée et sortie)
+  char groups[64];       // Groupes de diffusion séparés par des virgules ("ligne1,zoneA")
+
+  // Multicast UDP Settings (commandes directes sans broker)
+  bool useMulticast;
+  char multicastGroup[16]; // Adresse du groupe, ex: "239.10.0.1"
+  int multicastPort;
+  char multicastKey[33];   // Clé partagée HMAC-SHA256
+
+  // Modbus TCP Settings (ioPins en coils et entrées TOR, modbus_tcp.h)
+  bool useModbusTcp;
+  int modbusTcpPort;
+
+  // I/O Expander Settings
+  int i2cSdaPin;
+  int i2cSclPin;
+  char expanders[96];      // "mcp23017:0x20,pcf8574:0x38,mcp23s17:0" (slot = ordre dans la liste)
+  int expanderIntPin;      // Ligne INT commune (drain ouvert), -1 = scrutation
+  int spiSckPin;           // Bus SPI des MCP23S17 (-1 = non utilisé)
+  int spiMisoPin;
+  int spiMosiPin;
+  int spiCsPin;            // CS partagé, les MCP23S17 sont distingués par A2..A0
 
   // NTP Settings
   char ntpServer[64];
@@ -70,6 +263,13 @@ struct Config {
   int serialRxPin;
   int serialTxPin;
   long serialBaudRate;
+  bool useSerialServer;    // Serveur TCP brut (serial_server.h), nécessite le pont série
+  int serialServerPort;
+  bool serialServerRfc2217; // Telnet + RFC 2217 (baud, parité... par le client), sinon octets bruts
+  bool useModbus;          // Maître Modbus RTU sur Serial2 (exclusif : pont série et serveur TCP suspendus)
+  int modbusDePin;         // Direction RS-485 (RTS de l'UART), -1 = transceiver automatique
+  int modbusParity;        // 0 = aucune, 1 = impaire, 2 = paire
+  int modbusTimeoutMs;
 
   bool initialized;
 };
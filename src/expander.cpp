@@ -0,0 +1,276 @@
+#include "expander.h"
+#include <Wire.h>
+#include <SPI.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+extern Config config;
+
+#define MCP23S17_SPI_CLOCK 10000000   // 10 MHz max (datasheet)
+
+// ----- Bus I2C (Wire) -----
+class I2cExpanderBus : public ExpanderBus {
+public:
+  bool writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, size_t length) override {
+    _transactions++;
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    Wire.write(data, length);
+    return Wire.endTransmission() == 0;
+  }
+  bool readRegisters(uint8_t address, uint8_t reg, uint8_t* data, size_t length) override {
+    // Écriture du registre + lecture en START répété : une seule transaction
+    _transactions++;
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0) return false;
+    if (Wire.requestFrom(address, (uint8_t)length) != length) return false;
+    for (size_t i = 0; i < length; i++) data[i] = Wire.read();
+    return true;
+  }
+  bool writeRaw(uint8_t address, const uint8_t* data, size_t length) override {
+    _transactions++;
+    Wire.beginTransmission(address);
+    Wire.write(data, length);
+    return Wire.endTransmission() == 0;
+  }
+  bool readRaw(uint8_t address, uint8_t* data, size_t length) override {
+    _transactions++;
+    if (Wire.requestFrom(address, (uint8_t)length) != length) return false;
+    for (size_t i = 0; i < length; i++) data[i] = Wire.read();
+    return true;
+  }
+  bool probe(uint8_t address) override {
+    _transactions++;
+    Wire.beginTransmission(address);
+    return Wire.endTransmission() == 0;
+  }
+};
+
+// ----- Bus SPI (MCP23S17, une ligne CS partagée, adressage matériel) -----
+class SpiExpanderBus : public ExpanderBus {
+public:
+  void begin() {
+    _spi = new SPIClass(HSPI);
+    _spi->begin(config.spiSckPin, config.spiMisoPin, config.spiMosiPin, -1);
+    pinMode(config.spiCsPin, OUTPUT);
+    digitalWrite(config.spiCsPin, HIGH);
+  }
+  bool writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, size_t length) override {
+    transfer(0x40 | (address << 1), reg, (uint8_t*)data, length, false);
+    return true;
+  }
+  bool readRegisters(uint8_t address, uint8_t reg, uint8_t* data, size_t length) override {
+    transfer(0x41 | (address << 1), reg, data, length, true);
+    return true;
+  }
+  bool writeRaw(uint8_t, const uint8_t*, size_t) override { return false; }
+  bool readRaw(uint8_t, uint8_t*, size_t) override { return false; }
+  bool probe(uint8_t) override { return false; }   // Pas d'ACK en SPI (voir expanderDeviceInit)
+
+private:
+  SPIClass* _spi = nullptr;
+
+  void transfer(uint8_t opcode, uint8_t reg, uint8_t* data, size_t length, bool read) {
+    _transactions++;
+    _spi->beginTransaction(SPISettings(MCP23S17_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+    digitalWrite(config.spiCsPin, LOW);
+    _spi->transfer(opcode);
+    _spi->transfer(reg);
+    for (size_t i = 0; i < length; i++) {
+      uint8_t value = _spi->transfer(read ? 0 : data[i]);
+      if (read) data[i] = value;
+    }
+    digitalWrite(config.spiCsPin, HIGH);
+    _spi->endTransaction();
+  }
+};
+
+static I2cExpanderBus i2cBus;
+static SpiExpanderBus spiBus;
+static ExpanderDevice devices[MAX_EXPANDERS];
+static int expanderSlots = 0;
+static bool useInterrupt = false;
+static volatile bool interruptPending = false;
+static uint32_t interruptCount = 0;
+// Les bus sont partagés entre la tâche I/O (lectures, flush) et les commandes
+static SemaphoreHandle_t busMutex = NULL;
+// Protège les copies olat/iodir, modifiées depuis plusieurs tâches
+static portMUX_TYPE shadowMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void IRAM_ATTR onExpanderInterrupt() {
+  interruptPending = true;
+}
+
+// "mcp23017:0x20,pcf8574:0x38,mcp23s17:0" -> devices[]
+static void parseExpanders() {
+  expanderSlots = 0;
+  const char* p = config.expanders;
+  while (*p && expanderSlots < MAX_EXPANDERS) {
+    while (*p == ',' || *p == ' ') p++;
+    const char* start = p;
+    while (*p && *p != ',') p++;
+    size_t len = p - start;
+    if (len == 0) continue;
+
+    char entry[32];
+    if (len >= sizeof(entry)) len = sizeof(entry) - 1;
+    memcpy(entry, start, len);
+    entry[len] = '\0';
+
+    char* sep = strchr(entry, ':');
+    if (!sep) {
+      Serial.printf("⚠️ Expander '%s' ignoré (format type:adresse)\n", entry);
+      continue;
+    }
+    *sep = '\0';
+    ExpanderType type = expanderTypeFromName(entry);
+    if (type == EXPANDER_NONE) {
+      Serial.printf("⚠️ Type d'expander inconnu: %s\n", entry);
+      continue;
+    }
+    ExpanderBus* bus = type == EXPANDER_MCP23S17 ? (ExpanderBus*)&spiBus : (ExpanderBus*)&i2cBus;
+    expanderDeviceReset(devices[expanderSlots], type, (uint8_t)strtol(sep + 1, NULL, 0), bus);
+    expanderSlots++;
+  }
+}
+
+void setupExpanders() {
+  parseExpanders();
+  if (expanderSlots == 0) return;
+
+  if (!busMutex) busMutex = xSemaphoreCreateMutex();
+
+  bool needI2c = false, needSpi = false;
+  for (int i = 0; i < expanderSlots; i++) {
+    if (devices[i].type == EXPANDER_MCP23S17) needSpi = true; else needI2c = true;
+  }
+  if (needI2c) Wire.begin(config.i2cSdaPin, config.i2cSclPin, I2C_FREQUENCY);
+  if (needSpi) {
+    if (config.spiSckPin < 0 || config.spiMosiPin < 0 || config.spiMisoPin < 0 || config.spiCsPin < 0) {
+      Serial.println("❌ MCP23S17 configuré mais broches SPI non définies");
+    } else {
+      spiBus.begin();
+    }
+  }
+
+  // Ligne INT commune (drain ouvert) : front descendant = au moins un port a changé
+  useInterrupt = config.expanderIntPin >= 0;
+  if (useInterrupt) {
+    pinMode(config.expanderIntPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(config.expanderIntPin), onExpanderInterrupt, FALLING);
+  }
+
+  for (int i = 0; i < expanderSlots; i++) {
+    ExpanderDevice& d = devices[i];
+    if (d.type == EXPANDER_MCP23S17 && config.spiCsPin < 0) continue;
+    expanderDeviceInit(d, useInterrupt);
+    Serial.printf("%s Expander %d: %s @0x%02X -> broches %d..%d\n",
+                  d.present ? "✅" : "❌", i, expanderTypeName(d.type), d.address,
+                  IO_EXPANDER_PIN_BASE + i * IO_EXPANDER_CHANNELS,
+                  IO_EXPANDER_PIN_BASE + i * IO_EXPANDER_CHANNELS + expanderChannels(d.type) - 1);
+  }
+  Serial.printf("Expanders: %s\n", useInterrupt ? "lecture sur interruption" : "lecture par scrutation");
+}
+
+int expanderCount() {
+  return expanderSlots;
+}
+
+bool expanderIsVirtualPin(int pin) {
+  return pin >= IO_EXPANDER_PIN_BASE;
+}
+
+// Découpe une broche virtuelle en (slot, canal) ; false si hors d'un expander configuré
+static bool locate(int pin, int* slot, int* channel) {
+  if (!expanderIsVirtualPin(pin)) return false;
+  int s = (pin - IO_EXPANDER_PIN_BASE) / IO_EXPANDER_CHANNELS;
+  int c = (pin - IO_EXPANDER_PIN_BASE) % IO_EXPANDER_CHANNELS;
+  if (s >= expanderSlots || c >= expanderChannels(devices[s].type)) return false;
+  *slot = s;
+  *channel = c;
+  return true;
+}
+
+bool expanderPinValid(int pin) {
+  int slot, channel;
+  return locate(pin, &slot, &channel);
+}
+
+void expanderPinMode(int pin, uint8_t mode, uint8_t inputType) {
+  int slot, channel;
+  if (!locate(pin, &slot, &channel)) return;
+  ExpanderDevice& d = devices[slot];
+  uint16_t bit = 1u << channel;
+  portENTER_CRITICAL(&shadowMux);
+  if (mode == 2) {
+    d.iodir &= ~bit;
+  } else {
+    d.iodir |= bit;
+    // Le MCP23x17 n'a que des pull-up ; le PCF8574 est toujours tiré à 1
+    if (inputType == 1) d.pullup |= bit; else d.pullup &= ~bit;
+  }
+  portEXIT_CRITICAL(&shadowMux);
+  if (!d.present || !busMutex) return;
+  xSemaphoreTake(busMutex, portMAX_DELAY);
+  expanderDeviceConfigure(d, useInterrupt);
+  xSemaphoreGive(busMutex);
+}
+
+void expanderWrite(int pin, bool state) {
+  int slot, channel;
+  if (!locate(pin, &slot, &channel)) return;
+  portENTER_CRITICAL(&shadowMux);
+  expanderDeviceStage(devices[slot], channel, state);
+  portEXIT_CRITICAL(&shadowMux);
+}
+
+void expanderFlush() {
+  if (!busMutex) return;
+  for (int s = 0; s < expanderSlots; s++) {
+    ExpanderDevice& d = devices[s];
+    if (!d.present || !expanderDeviceDirty(d)) continue;
+    xSemaphoreTake(busMutex, portMAX_DELAY);
+    expanderDeviceFlush(d);
+    xSemaphoreGive(busMutex);
+  }
+}
+
+bool expanderReadPort(int slot, uint16_t* value) {
+  if (slot < 0 || slot >= expanderSlots || !busMutex) return false;
+  xSemaphoreTake(busMutex, portMAX_DELAY);
+  bool ok = expanderDeviceReadPort(devices[slot], value);
+  xSemaphoreGive(busMutex);
+  return ok;
+}
+
+bool expanderUsesInterrupt() {
+  return useInterrupt;
+}
+
+bool expanderTakeInterrupt() {
+  if (!interruptPending) return false;
+  interruptPending = false;
+  interruptCount++;
+  return true;
+}
+
+void expanderStatsToJson(JsonObject out) {
+  out["mode"] = useInterrupt ? "interrupt" : "poll";
+  out["interrupts"] = interruptCount;
+  out["i2cTransactions"] = i2cBus.transactions();
+  out["spiTransactions"] = spiBus.transactions();
+  JsonArray list = out["devices"].to<JsonArray>();
+  for (int i = 0; i < expanderSlots; i++) {
+    const ExpanderDevice& d = devices[i];
+    JsonObject o = list.add<JsonObject>();
+    o["type"] = expanderTypeName(d.type);
+    o["address"] = d.address;
+    o["present"] = d.present;
+    o["firstPin"] = IO_EXPANDER_PIN_BASE + i * IO_EXPANDER_CHANNELS;
+    o["channels"] = expanderChannels(d.type);
+    o["reads"] = d.reads;
+    o["writes"] = d.writes;
+    o["errors"] = d.errors;
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef EXPANDER_H
+#define EXPANDER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+#include "expander_driver.h"
+
+// ===== EXTENSIONS D'I/O =====
+// MCP23017 / PCF8574 (I2C) et MCP23S17 (SPI). Chaque expander occupe un slot de
+// IO_EXPANDER_CHANNELS broches virtuelles à partir de IO_EXPANDER_PIN_BASE.
+// - Lecture : un port complet par transaction, déclenchée par la ligne INT
+//   (config.expanderIntPin) plutôt que par scrutation.
+// - Écriture : expanderWrite() ne fait que préparer le port ; expanderFlush()
+//   envoie une transaction par expander modifié (une fois par cycle).
+
+void setupExpanders();                       // Analyse config.expanders, initialise les bus
+int expanderCount();
+bool expanderIsVirtualPin(int pin);
+bool expanderPinValid(int pin);              // Broche virtuelle d'un expander présent
+void expanderPinMode(int pin, uint8_t mode, uint8_t inputType);
+void expanderWrite(int pin, bool state);     // Préparé, envoyé au prochain expanderFlush()
+void expanderFlush();
+bool expanderReadPort(int slot, uint16_t* value);
+
+bool expanderUsesInterrupt();
+bool expanderTakeInterrupt();                // true si INT est tombée depuis le dernier appel
+
+void expanderStatsToJson(JsonObject out);
+
+#endif // EXPANDER_H
@@ -0,0 +1,34 @@
+#ifndef EXPANDER_BUS_H
+#define EXPANDER_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ===== BUS DES EXTENSIONS D'I/O =====
+// Interface minimale commune à l'I2C (MCP23017, PCF8574) et au SPI (MCP23S17).
+// Chaque appel correspond à UNE transaction sur le bus (START..STOP ou CS bas..haut) :
+// le compteur permet de mesurer le coût réel d'une stratégie d'accès. Sans
+// dépendance Arduino, pour pouvoir brancher un bus simulé sur PC (tools/expander_bench.cpp).
+
+class ExpanderBus {
+public:
+  virtual ~ExpanderBus() {}
+
+  // Registres consécutifs à partir de `reg` (auto-incrément de l'expander)
+  virtual bool writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, size_t length) = 0;
+  virtual bool readRegisters(uint8_t address, uint8_t reg, uint8_t* data, size_t length) = 0;
+
+  // Accès sans registre (PCF8574). Non supporté par le bus SPI.
+  virtual bool writeRaw(uint8_t address, const uint8_t* data, size_t length) = 0;
+  virtual bool readRaw(uint8_t address, uint8_t* data, size_t length) = 0;
+
+  // Présence d'un périphérique (transaction vide en I2C)
+  virtual bool probe(uint8_t address) = 0;
+
+  uint32_t transactions() const { return _transactions; }
+
+protected:
+  uint32_t _transactions = 0;
+};
+
+#endif // EXPANDER_BUS_H
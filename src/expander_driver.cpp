@@ -0,0 +1,128 @@
+#include "expander_driver.h"
+#include <string.h>
+#include <strings.h>
+
+// Registres MCP23x17 (IOCON.BANK = 0 : registres A/B entrelacés, auto-incrément)
+#define MCP_IODIRA   0x00
+#define MCP_GPINTENA 0x04
+#define MCP_IOCON    0x0A
+#define MCP_GPPUA    0x0C
+#define MCP_GPIOA    0x12
+#define MCP_OLATA    0x14
+
+#define MCP_IOCON_MIRROR 0x40   // INTA = INTB = OU des deux ports
+#define MCP_IOCON_HAEN   0x08   // Adresse matérielle (MCP23S17)
+#define MCP_IOCON_ODR    0x04   // INT en drain ouvert (ligne partagée)
+
+static bool isMcp(const ExpanderDevice& d) {
+  return d.type == EXPANDER_MCP23017 || d.type == EXPANDER_MCP23S17;
+}
+
+uint8_t expanderChannels(ExpanderType type) {
+  return type == EXPANDER_PCF8574 ? 8 : 16;
+}
+
+const char* expanderTypeName(ExpanderType type) {
+  switch (type) {
+    case EXPANDER_MCP23017: return "mcp23017";
+    case EXPANDER_MCP23S17: return "mcp23s17";
+    case EXPANDER_PCF8574:  return "pcf8574";
+    default:                return "none";
+  }
+}
+
+ExpanderType expanderTypeFromName(const char* name) {
+  if (strcasecmp(name, "mcp23017") == 0) return EXPANDER_MCP23017;
+  if (strcasecmp(name, "mcp23s17") == 0) return EXPANDER_MCP23S17;
+  if (strcasecmp(name, "pcf8574") == 0) return EXPANDER_PCF8574;
+  return EXPANDER_NONE;
+}
+
+void expanderDeviceReset(ExpanderDevice& d, ExpanderType type, uint8_t address, ExpanderBus* bus) {
+  memset(&d, 0, sizeof(d));
+  d.type = type;
+  d.address = address;
+  d.bus = bus;
+  d.iodir = 0xFFFF;
+}
+
+static bool count(ExpanderDevice& d, bool ok, uint32_t& counter) {
+  if (ok) counter++; else d.errors++;
+  return ok;
+}
+
+bool expanderDeviceConfigure(ExpanderDevice& d, bool interrupts) {
+  if (!isMcp(d)) {
+    // PCF8574 : une entrée est une sortie maintenue à 1 (pull-up faible interne)
+    uint8_t port = (uint8_t)((d.olat | d.iodir) & 0xFF);
+    bool ok = d.bus->writeRaw(d.address, &port, 1);
+    if (ok) d.written = d.olat;
+    return count(d, ok, d.writes);
+  }
+
+  // Sorties d'abord : une broche qui passe en sortie démarre au bon niveau
+  uint8_t olat[2] = { (uint8_t)(d.olat & 0xFF), (uint8_t)(d.olat >> 8) };
+  if (!count(d, d.bus->writeRegisters(d.address, MCP_OLATA, olat, 2), d.writes)) return false;
+  d.written = d.olat;
+
+  // IODIR..GPPU (0x00..0x0D) en une seule écriture séquentielle
+  uint16_t gpinten = interrupts ? d.iodir : 0;
+  uint8_t iocon = MCP_IOCON_MIRROR | MCP_IOCON_ODR | (d.type == EXPANDER_MCP23S17 ? MCP_IOCON_HAEN : 0);
+  uint8_t block[MCP_GPPUA + 2] = {0};
+  block[MCP_IODIRA] = d.iodir & 0xFF;
+  block[MCP_IODIRA + 1] = d.iodir >> 8;
+  block[MCP_GPINTENA] = gpinten & 0xFF;       // INTCON = 0 : interruption sur tout changement
+  block[MCP_GPINTENA + 1] = gpinten >> 8;
+  block[MCP_IOCON] = iocon;
+  block[MCP_IOCON + 1] = iocon;
+  block[MCP_GPPUA] = d.pullup & 0xFF;
+  block[MCP_GPPUA + 1] = d.pullup >> 8;
+  return count(d, d.bus->writeRegisters(d.address, MCP_IODIRA, block, sizeof(block)), d.writes);
+}
+
+bool expanderDeviceInit(ExpanderDevice& d, bool interrupts) {
+  if (d.type == EXPANDER_MCP23S17) {
+    // Pas d'acquittement en SPI : HAEN doit être activé avant de pouvoir adresser
+    // le composant (adresse 0 tant que HAEN = 0), la présence est vérifiée en relisant IOCON.
+    uint8_t iocon = MCP_IOCON_MIRROR | MCP_IOCON_ODR | MCP_IOCON_HAEN;
+    d.bus->writeRegisters(0, MCP_IOCON, &iocon, 1);
+    uint8_t readBack = 0;
+    d.present = d.bus->readRegisters(d.address, MCP_IOCON, &readBack, 1) && readBack == iocon;
+  } else {
+    d.present = d.bus->probe(d.address);
+  }
+  if (!d.present) return false;
+  d.present = expanderDeviceConfigure(d, interrupts);
+  return d.present;
+}
+
+bool expanderDeviceFlush(ExpanderDevice& d) {
+  if (!d.present || !expanderDeviceDirty(d)) return true;
+  uint16_t value = d.olat;
+  bool ok;
+  if (isMcp(d)) {
+    uint8_t olat[2] = { (uint8_t)(value & 0xFF), (uint8_t)(value >> 8) };
+    ok = d.bus->writeRegisters(d.address, MCP_OLATA, olat, 2);
+  } else {
+    uint8_t port = (uint8_t)((value | d.iodir) & 0xFF);
+    ok = d.bus->writeRaw(d.address, &port, 1);
+  }
+  if (ok) d.written = value;
+  return count(d, ok, d.writes);
+}
+
+bool expanderDeviceReadPort(ExpanderDevice& d, uint16_t* value) {
+  if (!d.present) return false;
+  bool ok;
+  if (isMcp(d)) {
+    // GPIOA + GPIOB en une seule lecture séquentielle
+    uint8_t port[2];
+    ok = d.bus->readRegisters(d.address, MCP_GPIOA, port, 2);
+    if (ok) *value = port[0] | ((uint16_t)port[1] << 8);
+  } else {
+    uint8_t port;
+    ok = d.bus->readRaw(d.address, &port, 1);
+    if (ok) *value = port;
+  }
+  return count(d, ok, d.reads);
+}
@@ -0,0 +1,64 @@
+#ifndef EXPANDER_DRIVER_H
+#define EXPANDER_DRIVER_H
+
+#include <stdint.h>
+#include "expander_bus.h"
+
+// ===== PILOTES D'EXTENSIONS D'I/O =====
+// Un port complet (16 canaux MCP23x17, 8 canaux PCF8574) est lu ou écrit en une
+// seule transaction. Les écritures sont d'abord appliquées à une copie locale
+// (olat) puis envoyées par expanderDeviceFlush() : plusieurs sorties modifiées
+// dans le même cycle ne coûtent qu'une transaction. Pas de verrou ici : c'est
+// à l'appelant (expander.cpp) de sérialiser les accès.
+
+enum ExpanderType : uint8_t {
+  EXPANDER_NONE = 0,
+  EXPANDER_MCP23017,   // I2C, 16 canaux
+  EXPANDER_MCP23S17,   // SPI, 16 canaux, adresse matérielle 0..7 (HAEN)
+  EXPANDER_PCF8574     // I2C, 8 canaux quasi-bidirectionnels
+};
+
+struct ExpanderDevice {
+  ExpanderType type;
+  uint8_t address;     // Adresse I2C, ou adresse matérielle A2..A0 pour le MCP23S17
+  ExpanderBus* bus;
+  bool present;
+  uint16_t iodir;      // 1 = entrée (valeur de reset du MCP23x17)
+  uint16_t pullup;
+  uint16_t olat;       // Sorties voulues
+  uint16_t written;    // Sorties effectivement écrites sur le bus
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t errors;
+};
+
+uint8_t expanderChannels(ExpanderType type);
+const char* expanderTypeName(ExpanderType type);
+ExpanderType expanderTypeFromName(const char* name);
+
+void expanderDeviceReset(ExpanderDevice& d, ExpanderType type, uint8_t address, ExpanderBus* bus);
+
+// Sonde le composant et écrit sa configuration complète. Avec `interrupts`, les
+// MCP23x17 signalent tout changement d'entrée sur INTA/INTB (mirroir, drain ouvert :
+// plusieurs expanders peuvent partager une seule ligne). Le PCF8574 le fait toujours.
+bool expanderDeviceInit(ExpanderDevice& d, bool interrupts);
+
+// Réécrit direction/pull-up/interruptions après un changement de mode
+bool expanderDeviceConfigure(ExpanderDevice& d, bool interrupts);
+
+inline void expanderDeviceStage(ExpanderDevice& d, uint8_t channel, bool state) {
+  uint16_t bit = 1u << channel;
+  if (state) d.olat |= bit; else d.olat &= ~bit;
+}
+
+inline bool expanderDeviceDirty(const ExpanderDevice& d) {
+  return d.olat != d.written;
+}
+
+// Envoie les sorties en attente (0 ou 1 transaction)
+bool expanderDeviceFlush(ExpanderDevice& d);
+
+// Lit le port complet (1 transaction ; acquitte l'interruption du composant)
+bool expanderDeviceReadPort(ExpanderDevice& d, uint16_t* value);
+
+#endif // EXPANDER_DRIVER_H
@@ -0,0 +1,32 @@
+#ifndef IO_COMMAND_H
+#define IO_COMMAND_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== FILE DE COMMANDES =====
+// MQTT, serveur web et multicast ne touchent plus aux sorties : ils déposent la
+// commande dans une file lue par la tâche temps réel (core RT_TASK_CORE), seule
+// propriétaire des sorties et de scheduledCommands[]. La tâche est réveillée
+// par l'arrivée d'une commande, sans attendre son prochain tick.
+
+struct IoCommand {
+  int pin;
+  int state;
+  uint32_t exec_at_sec;   // 0 = exécution immédiate
+  uint32_t exec_at_us;
+  uint64_t received_us;
+  uint8_t batch_follow;   // Commandes du même lot encore à venir (/api/io/batch)
+  char id[COMMAND_ID_LENGTH];
+};
+
+// false si la file est pleine (commande perdue, comptée)
+bool submitIoCommand(int pin, int state, uint32_t exec_at_sec = 0, uint32_t exec_at_us = 0,
+                     const char* id = NULL, uint64_t receivedUs = 0);
+// Lot : nombre de commandes déposées, 0 si la file n'a pas la place pour tout le lot.
+// La tâche temps réel applique le lot dans un même tour (expanders en une transaction).
+int submitIoBatch(IoCommand* commands, int count);
+void ioCommandStatsToJson(JsonObject out);
+
+#endif // IO_COMMAND_H
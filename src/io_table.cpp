@@ -0,0 +1,283 @@
+#include "io_table.h"
+#include "expander.h"
+#include "log_task.h"
+#include <freertos/semphr.h>
+#include <soc/gpio_reg.h>
+
+static IoTable tables[2];
+static IoTable* activeTable = &tables[0];
+static IoTable* volatile pendingTable = NULL;
+// Lecteurs en cours sur chaque table : l'écrivain attend qu'il n'y en ait plus
+static uint32_t readerCount[2] = {0, 0};
+static SemaphoreHandle_t writerMutex = NULL;
+static SemaphoreHandle_t swapDone = NULL;
+static TaskHandle_t realtimeTask = NULL;
+// +1 à chaque changement d'état (écrit par la tâche temps réel après le bit d'état)
+static uint32_t stateVersion = 0;
+
+// Niveaux au dernier balayage : privés à la tâche temps réel
+static uint64_t nativeLevels = 0;
+static uint16_t expanderLevels[MAX_EXPANDERS];
+static unsigned long lastExpanderPoll = 0;
+
+static inline int tableSlot(const IoTable* table) {
+  return table == &tables[0] ? 0 : 1;
+}
+
+// FNV-1a 32 bits sur exactement `length` octets (le nom n'est pas forcément terminé)
+static uint32_t hashName(const char* name, size_t length) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    h ^= (uint8_t)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static inline void setStateBit(IoTable& t, int index, bool state) {
+  // Lecteurs concurrents (web, MQTT) : mots modifiés de façon atomique
+  uint32_t bit = 1u << (index & 31);
+  if (state) __atomic_fetch_or(&t.state[index >> 5], bit, __ATOMIC_RELAXED);
+  else __atomic_fetch_and(&t.state[index >> 5], ~bit, __ATOMIC_RELAXED);
+}
+
+static inline void bumpStateVersion() {
+  __atomic_store_n(&stateVersion, stateVersion + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t ioStateVersion() {
+  return __atomic_load_n(&stateVersion, __ATOMIC_ACQUIRE);
+}
+
+// Écriture directe des registres W1TS/W1TC : un accès, sans passer par digitalWrite
+static inline void writeNativePin(int pin, bool state) {
+  if (pin < 32) REG_WRITE(state ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, 1u << pin);
+  else REG_WRITE(state ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG, 1u << (pin - 32));
+}
+
+static inline uint64_t readNativeLevels() {
+  // GPIO 0..31 puis 32..39 : deux lectures de registre pour toutes les broches
+  return (uint64_t)REG_READ(GPIO_IN_REG) | ((uint64_t)(REG_READ(GPIO_IN1_REG) & 0xFF) << 32);
+}
+
+const IoTable* ioTableAcquire() {
+  for (;;) {
+    IoTable* table = __atomic_load_n(&activeTable, __ATOMIC_ACQUIRE);
+    int slot = tableSlot(table);
+    __atomic_fetch_add(&readerCount[slot], 1, __ATOMIC_ACQ_REL);
+    // Bascule entre le chargement et l'inscription : l'écrivain a pu ne pas nous voir
+    if (__atomic_load_n(&activeTable, __ATOMIC_ACQUIRE) == table) return table;
+    __atomic_fetch_sub(&readerCount[slot], 1, __ATOMIC_RELEASE);
+  }
+}
+
+void ioTableRelease(const IoTable* table) {
+  __atomic_fetch_sub(&readerCount[tableSlot(table)], 1, __ATOMIC_RELEASE);
+}
+
+const IoTable& ioTableActive() {
+  return *activeTable;
+}
+
+void ioTableSetRealtimeTask(TaskHandle_t task) {
+  realtimeTask = task;
+}
+
+// Remplit les tableaux chauds de `t` à partir de ses enregistrements
+static void buildLookups(IoTable& t) {
+  t.nativeInputs = 0;
+  memset(t.state, 0, sizeof(t.state));
+  memset(t.expanderInputs, 0, sizeof(t.expanderInputs));
+  memset(t.pinIndex, IO_INDEX_NONE, sizeof(t.pinIndex));
+  memset(t.nameSlots, IO_INDEX_NONE, sizeof(t.nameSlots));
+
+  for (int i = 0; i < t.count; i++) {
+    const IOPin& io = t.pins[i];
+    t.pin[i] = io.pin;
+    t.mode[i] = io.mode;
+
+    // Première occurrence prioritaire, comme l'ancien parcours linéaire
+    if (t.pinIndex[io.pin] == IO_INDEX_NONE) t.pinIndex[io.pin] = i;
+
+    size_t len = strnlen(io.name, sizeof(io.name));
+    uint32_t slot = hashName(io.name, len) & (IO_NAME_HASH_SIZE - 1);
+    bool duplicate = false;
+    while (t.nameSlots[slot] != IO_INDEX_NONE) {
+      if (strncmp(t.pins[t.nameSlots[slot]].name, io.name, sizeof(io.name)) == 0) {
+        duplicate = true;
+        break;
+      }
+      slot = (slot + 1) & (IO_NAME_HASH_SIZE - 1);
+    }
+    if (!duplicate) t.nameSlots[slot] = i;
+
+    if (io.mode == 1) {
+      if (expanderPinValid(io.pin)) {
+        int offset = io.pin - IO_EXPANDER_PIN_BASE;
+        t.expanderInputs[offset / IO_EXPANDER_CHANNELS] |= 1u << (offset % IO_EXPANDER_CHANNELS);
+      } else if (io.pin < IO_NATIVE_PIN_COUNT) {
+        t.nativeInputs |= 1ULL << io.pin;
+      }
+    } else if (io.mode == 2) {
+      setStateBit(t, i, io.defaultState);
+    }
+  }
+}
+
+// Niveaux de référence de la nouvelle table (pas de fausse transition au premier
+// balayage), puis bascule. Appelé par la tâche temps réel, ou au boot.
+static void activate(IoTable* t) {
+  nativeLevels = readNativeLevels();
+  for (int s = 0; s < expanderCount(); s++) {
+    if (t->expanderInputs[s] && expanderReadPort(s, &expanderLevels[s])) continue;
+    expanderLevels[s] = 0;
+  }
+  for (int i = 0; i < t->count; i++) {
+    if (t->mode[i] != 1) continue;
+    int pin = t->pin[i];
+    if (expanderPinValid(pin)) {
+      int offset = pin - IO_EXPANDER_PIN_BASE;
+      setStateBit(*t, i, (expanderLevels[offset / IO_EXPANDER_CHANNELS] >> (offset % IO_EXPANDER_CHANNELS)) & 1);
+    } else if (pin < IO_NATIVE_PIN_COUNT) {
+      setStateBit(*t, i, (nativeLevels >> pin) & 1);
+    }
+  }
+  __atomic_store_n(&activeTable, t, __ATOMIC_RELEASE);
+  bumpStateVersion();   // Nouvelle table : tous les états sont réinitialisés
+}
+
+void ioTableApplyPending() {
+  IoTable* t = pendingTable;
+  if (t == NULL) return;
+  pendingTable = NULL;
+  activate(t);
+  xSemaphoreGive(swapDone);
+}
+
+void ioTablePublish(const IOPin* pins, int count, const AnalogConfig* analog, int analogCount) {
+  if (writerMutex == NULL) {
+    writerMutex = xSemaphoreCreateMutex();
+    swapDone = xSemaphoreCreateBinary();
+  }
+  xSemaphoreTake(writerMutex, portMAX_DELAY);
+
+  IoTable* next = activeTable == &tables[0] ? &tables[1] : &tables[0];
+  // Les lecteurs de l'avant-dernière configuration terminent leur instantané
+  unsigned long waitStart = millis();
+  while (__atomic_load_n(&readerCount[tableSlot(next)], __ATOMIC_ACQUIRE) != 0) {
+    if (millis() - waitStart > 1000) {
+      logPrintf("⚠️ I/O table: still waiting for %u reader(s)\n", readerCount[tableSlot(next)]);
+      waitStart = millis();
+    }
+    vTaskDelay(1);
+  }
+
+  next->generation = activeTable->generation + 1;
+  next->count = count < MAX_IOS ? count : MAX_IOS;
+  memcpy(next->pins, pins, sizeof(IOPin) * next->count);
+  next->analogCount = analogCount < ANALOG_MAX_CHANNELS ? analogCount : ANALOG_MAX_CHANNELS;
+  memcpy(next->analog, analog, sizeof(AnalogConfig) * next->analogCount);
+  buildLookups(*next);
+
+  if (realtimeTask == NULL) {
+    activate(next);   // Boot : la tâche temps réel ne tourne pas encore
+  } else {
+    // Bascule entre deux ticks : un balayage n'est jamais à cheval sur deux tables
+    pendingTable = next;
+    if (xSemaphoreTake(swapDone, pdMS_TO_TICKS(1000)) != pdTRUE) {
+      logPrintf("⚠️ I/O table: real-time task did not switch tables\n");
+    }
+  }
+  xSemaphoreGive(writerMutex);
+}
+
+int ioIndexByPin(const IoTable& t, int pin) {
+  if (pin < 0 || pin > 255) return -1;
+  uint8_t index = t.pinIndex[pin];
+  return index == IO_INDEX_NONE ? -1 : index;
+}
+
+int ioIndexByName(const IoTable& t, const char* name, size_t length) {
+  if (length == 0 || length >= sizeof(t.pins[0].name)) return -1;
+  uint32_t slot = hashName(name, length) & (IO_NAME_HASH_SIZE - 1);
+  uint8_t index;
+  while ((index = t.nameSlots[slot]) != IO_INDEX_NONE) {
+    const char* candidate = t.pins[index].name;
+    if (strncmp(candidate, name, length) == 0 && candidate[length] == '\0') return index;
+    slot = (slot + 1) & (IO_NAME_HASH_SIZE - 1);
+  }
+  return -1;
+}
+
+const AnalogConfig* ioAnalogConfig(const IoTable& t, int pin) {
+  for (int i = 0; i < t.analogCount; i++) {
+    if (t.analog[i].pin == pin) return &t.analog[i];
+  }
+  return NULL;
+}
+
+bool ioPinValid(int pin) {
+  if (pin >= 0 && pin < IO_NATIVE_PIN_COUNT) return true;
+  return expanderPinValid(pin);
+}
+
+bool ioWrite(int index, bool state) {
+  IoTable& t = *activeTable;
+  int pin = t.pin[index];
+  if (expanderIsVirtualPin(pin)) expanderWrite(pin, state);
+  else writeNativePin(pin, state);
+  if (ioState(t, index) == state) return false;
+  setStateBit(t, index, state);
+  bumpStateVersion();
+  return true;
+}
+
+int ioScanInputs(IoChangeHandler onChange) {
+  IoTable& t = *activeTable;
+  int changes = 0;
+
+  uint64_t levels = readNativeLevels();
+  uint64_t changed = (levels ^ nativeLevels) & t.nativeInputs;
+  nativeLevels = levels;
+  while (changed) {
+    int gpio = __builtin_ctzll(changed);
+    changed &= changed - 1;
+    int index = t.pinIndex[gpio];
+    bool state = (levels >> gpio) & 1;
+    setStateBit(t, index, state);
+    bumpStateVersion();
+    onChange(index, state);
+    changes++;
+  }
+
+  // Expanders : lus quand la ligne INT est tombée (plus une relecture de sécurité),
+  // ou par scrutation si aucune ligne INT n'est câblée
+  unsigned long now = millis();
+  bool readExpanders;
+  if (expanderUsesInterrupt()) {
+    readExpanders = expanderTakeInterrupt() || now - lastExpanderPoll >= IO_EXPANDER_RESYNC_MS;
+  } else {
+    readExpanders = now - lastExpanderPoll >= IO_EXPANDER_POLL_MS;
+  }
+  if (expanderCount() > 0 && readExpanders) {
+    lastExpanderPoll = now;
+    for (int s = 0; s < expanderCount(); s++) {
+      if (!t.expanderInputs[s]) continue;
+      uint16_t port;
+      if (!expanderReadPort(s, &port)) continue;
+      uint16_t diff = (port ^ expanderLevels[s]) & t.expanderInputs[s];
+      expanderLevels[s] = port;
+      while (diff) {
+        int channel = __builtin_ctz(diff);
+        diff &= diff - 1;
+        int index = t.pinIndex[IO_EXPANDER_PIN_BASE + s * IO_EXPANDER_CHANNELS + channel];
+        bool state = (port >> channel) & 1;
+        setStateBit(t, index, state);
+        bumpStateVersion();
+        onChange(index, state);
+        changes++;
+      }
+    }
+  }
+  return changes;
+}
@@ -0,0 +1,87 @@
+#ifndef IO_TABLE_H
+#define IO_TABLE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+
+// ===== TABLE D'I/O (structure de tableaux) =====
+// Les champs consultés à chaque tick/commande sont rangés en tableaux parallèles,
+// indexés comme les enregistrements `pins` : les recherches par broche ou par nom
+// sont en O(1) et le balayage des entrées ne parcourt que les bits qui ont changé.
+//
+// Publication : deux tables (double tampon). La configuration courante n'est
+// jamais modifiée en place ; ioTablePublish() remplit la table inactive puis la
+// tâche temps réel bascule le pointeur actif entre deux ticks. Les lecteurs des
+// autres tâches prennent un instantané (IoSnapshot) sans verrou : la table qu'ils
+// lisent n'est réécrite qu'une fois le dernier d'entre eux parti.
+
+#define IO_INDEX_NONE 0xFF
+#define IO_WORDS ((MAX_IOS + 31) / 32)
+
+struct IoTable {
+  uint32_t generation;                     // Incrémenté à chaque publication
+  int count;
+  IOPin pins[MAX_IOS];                     // Enregistrements (nom, mode, valeurs par défaut)
+  AnalogConfig analog[ANALOG_MAX_CHANNELS];
+  int analogCount;
+  uint8_t pin[MAX_IOS];
+  uint8_t mode[MAX_IOS];                   // 0 = DISABLED, 1 = INPUT, 2 = OUTPUT, 3 = ANALOG
+  uint32_t state[IO_WORDS];                // Bit i = état courant de l'I/O i (seul champ mutable)
+  uint64_t nativeInputs;                   // Bit g = GPIO g configuré en entrée
+  uint16_t expanderInputs[MAX_EXPANDERS];  // Canaux en entrée, par expander
+  uint8_t pinIndex[256];                   // Broche -> index (IO_INDEX_NONE si absente)
+  uint8_t nameSlots[IO_NAME_HASH_SIZE];    // Hachage du nom -> index (adressage ouvert)
+};
+
+// Lecteurs (web, MQTT, multicast, analogique...) : jamais bloquant
+const IoTable* ioTableAcquire();
+void ioTableRelease(const IoTable* table);
+
+class IoSnapshot {
+public:
+  IoSnapshot() : _table(ioTableAcquire()) {}
+  ~IoSnapshot() { ioTableRelease(_table); }
+  const IoTable& operator*() const { return *_table; }
+  const IoTable* operator->() const { return _table; }
+private:
+  IoSnapshot(const IoSnapshot&);
+  IoSnapshot& operator=(const IoSnapshot&);
+  const IoTable* _table;
+};
+
+// Tâche temps réel : c'est elle qui bascule la table active, elle la lit sans instantané
+const IoTable& ioTableActive();
+void ioTableSetRealtimeTask(TaskHandle_t task);
+void ioTableApplyPending();                // Début de tick de la tâche temps réel
+
+// Écrivains (boot, /api/ios) : copie la configuration dans la table inactive et la
+// rend active de façon atomique. Les écrivains sont sérialisés entre eux.
+void ioTablePublish(const IOPin* pins, int count, const AnalogConfig* analog, int analogCount);
+
+int ioIndexByPin(const IoTable& table, int pin);
+int ioIndexByName(const IoTable& table, const char* name, size_t length);
+const AnalogConfig* ioAnalogConfig(const IoTable& table, int pin);
+bool ioPinValid(int pin);                  // GPIO natif ou broche d'un expander présent
+
+inline bool ioState(const IoTable& table, int index) {
+  return (__atomic_load_n(&table.state[index >> 5], __ATOMIC_RELAXED) >> (index & 31)) & 1;
+}
+
+// Version de l'état : +1 à chaque changement d'état d'une I/O et à chaque bascule de
+// table. Incrémentée après le bit : des états lus après la version contiennent au
+// moins tous les changements jusqu'à elle.
+uint32_t ioStateVersion();
+
+// Tâche temps réel : écrit la sortie (GPIO ou expander) et met à jour l'état de l'I/O.
+// true si l'état a changé (nouvelle version).
+bool ioWrite(int index, bool state);
+
+// Tâche temps réel : lit les GPIO en un accès registre (et les expanders toutes les
+// IO_EXPANDER_POLL_MS), puis appelle onChange pour chaque entrée modifiée (la
+// version est déjà incrémentée).
+typedef void (*IoChangeHandler)(int index, bool state);
+int ioScanInputs(IoChangeHandler onChange);
+
+#endif // IO_TABLE_H
@@ -0,0 +1,86 @@
+#include "json_arena.h"
+
+// Chaque bloc est précédé de sa taille (en-tête de 8 octets : alignement des double)
+static const size_t HEADER_SIZE = 8;
+static const size_t NO_BLOCK = (size_t)-1;
+
+static JsonArenaBase* arenaList = NULL;
+
+JsonArena<JSON_ARENA_MQTT_BYTES> mqttTaskArena("mqtt_task");
+JsonArena<JSON_ARENA_NET_BYTES> netTaskArena("NetTask");
+JsonArena<JSON_ARENA_WEB_BYTES> webArena("async_tcp");
+
+static inline size_t blockSize(size_t size) {
+  return HEADER_SIZE + ((size + 7) & ~(size_t)7);
+}
+
+JsonArenaBase::JsonArenaBase(const char* name, uint8_t* buffer, size_t capacity)
+    : _name(name), _buffer(buffer), _capacity(capacity), _used(0), _last(NO_BLOCK),
+      _highWater(0), _live(0), _failures(0), _next(arenaList) {
+  arenaList = this;
+}
+
+void* JsonArenaBase::allocate(size_t size) {
+  size_t need = blockSize(size);
+  if (_used + need > _capacity) {
+    _failures++;
+    return NULL;
+  }
+  uint8_t* block = _buffer + _used;
+  *(uint32_t*)block = size;
+  _last = _used;
+  _used += need;
+  if (_used > _highWater) _highWater = _used;
+  _live++;
+  return block + HEADER_SIZE;
+}
+
+void JsonArenaBase::deallocate(void* ptr) {
+  if (ptr == NULL) return;
+  size_t offset = (uint8_t*)ptr - HEADER_SIZE - _buffer;
+  if (--_live == 0) {
+    // Plus aucun document vivant : l'arène est de nouveau entière
+    _used = 0;
+    _last = NO_BLOCK;
+  } else if (offset == _last) {
+    _used = _last;
+    _last = NO_BLOCK;
+  }
+}
+
+void* JsonArenaBase::reallocate(void* ptr, size_t size) {
+  if (ptr == NULL) return allocate(size);
+  uint8_t* block = (uint8_t*)ptr - HEADER_SIZE;
+  size_t offset = block - _buffer;
+  size_t oldSize = *(uint32_t*)block;
+
+  // Dernier bloc (chaîne en cours de construction, pool réduit à la fin
+  // d'une désérialisation) : agrandi ou réduit sur place
+  if (offset == _last) {
+    if (offset + blockSize(size) > _capacity) {
+      _failures++;
+      return NULL;
+    }
+    *(uint32_t*)block = size;
+    _used = offset + blockSize(size);
+    if (_used > _highWater) _highWater = _used;
+    return ptr;
+  }
+  if (size <= oldSize) return ptr;
+
+  void* moved = allocate(size);
+  if (moved == NULL) return NULL;
+  memcpy(moved, ptr, oldSize);
+  deallocate(ptr);
+  return moved;
+}
+
+void jsonArenaStatsToJson(JsonArray out) {
+  for (const JsonArenaBase* arena = arenaList; arena != NULL; arena = arena->_next) {
+    JsonObject entry = out.add<JsonObject>();
+    entry["name"] = arena->_name;
+    entry["capacity"] = arena->_capacity;
+    entry["highWater"] = arena->_highWater;
+    entry["failures"] = arena->_failures;
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== ARÈNES JSON =====
+// Allocateur ArduinoJson sur un tampon fixe : un document construit avec
+// `JsonDocument doc(&arena)` ne touche jamais au tas. Allocation par pointeur
+// croissant ; l'arène redevient vide dès que le dernier bloc est rendu (fin de
+// portée des documents). Une arène appartient à UNE tâche : pas de verrou.
+// Plein : l'allocation échoue, le document le signale (overflowed(), NoMemory).
+
+class JsonArenaBase : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override;
+  void deallocate(void* ptr) override;
+  void* reallocate(void* ptr, size_t size) override;
+
+  const char* name() const { return _name; }
+  size_t capacity() const { return _capacity; }
+  size_t highWater() const { return _highWater; }
+  uint32_t failures() const { return _failures; }
+
+protected:
+  JsonArenaBase(const char* name, uint8_t* buffer, size_t capacity);
+
+private:
+  const char* _name;
+  uint8_t* _buffer;
+  size_t _capacity;
+  size_t _used;
+  size_t _last;          // Position du dernier bloc (agrandi sur place par reallocate)
+  size_t _highWater;
+  uint32_t _live;        // Blocs non rendus
+  uint32_t _failures;
+  JsonArenaBase* _next;  // Liste des arènes pour /api/metrics
+  friend void jsonArenaStatsToJson(JsonArray out);
+};
+
+template <size_t N>
+class JsonArena : public JsonArenaBase {
+public:
+  explicit JsonArena(const char* name) : JsonArenaBase(name, _storage, N) {}
+private:
+  alignas(8) uint8_t _storage[N];
+};
+
+// Une arène par tâche qui produit ou lit du JSON en régime établi
+extern JsonArena<JSON_ARENA_MQTT_BYTES> mqttTaskArena;   // Messages reçus (mqtt_callback)
+extern JsonArena<JSON_ARENA_NET_BYTES> netTaskArena;     // Publications périodiques de la tâche réseau
+extern JsonArena<JSON_ARENA_WEB_BYTES> webArena;         // Routes /api (tâche AsyncTCP)
+
+void jsonArenaStatsToJson(JsonArray out);
+
+#endif // JSON_ARENA_H
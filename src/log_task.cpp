@@ -0,0 +1,57 @@
+#include "log_task.h"
+#include "alloc_audit.h"
+#include <stdarg.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
+
+static RingbufHandle_t logRing = NULL;
+static TaskHandle_t logTaskHandle = NULL;
+static volatile uint32_t linesQueued = 0;
+static volatile uint32_t linesDropped = 0;
+
+static void logTask(void* pvParameters) {
+  allocAuditRegisterTask();
+  for (;;) {
+    size_t length = 0;
+    char* line = (char*)xRingbufferReceive(logRing, &length, portMAX_DELAY);
+    if (line == NULL) continue;
+    Serial.write((const uint8_t*)line, length);
+    vRingbufferReturnItem(logRing, line);
+    allocAuditIteration();
+  }
+}
+
+void setupLogTask() {
+  if (logTaskHandle) return;
+  logRing = xRingbufferCreate(LOG_QUEUE_BYTES, RINGBUF_TYPE_NOSPLIT);
+  if (logRing == NULL) {
+    Serial.println("✗ Log queue allocation failed (logs stay synchronous)");
+    return;
+  }
+  xTaskCreatePinnedToCore(logTask, "LogTask", LOG_TASK_STACK_SIZE, NULL, LOG_TASK_PRIORITY,
+                          &logTaskHandle, SERVICE_TASK_CORE);
+}
+
+void logPrintf(const char* format, ...) {
+  char line[LOG_LINE_LENGTH];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (length < 0) return;
+  if (length >= (int)sizeof(line)) length = sizeof(line) - 1;   // Ligne tronquée
+
+  if (logRing == NULL) {
+    Serial.write((const uint8_t*)line, length);
+    return;
+  }
+  // Jamais bloquant : si l'UART ne suit pas, la ligne est perdue (et comptée)
+  if (xRingbufferSend(logRing, line, length, 0) == pdTRUE) linesQueued++;
+  else linesDropped++;
+}
+
+void logStatsToJson(JsonObject out) {
+  out["queued"] = linesQueued;
+  out["dropped"] = linesDropped;
+  out["freeBytes"] = logRing ? xRingbufferGetCurFreeSize(logRing) : 0;
+}
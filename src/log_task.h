@@ -0,0 +1,18 @@
+#ifndef LOG_TASK_H
+#define LOG_TASK_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== LOGS ASYNCHRONES =====
+// logPrintf() formate la ligne et la dépose dans une file ; la tâche de log
+// (priorité la plus basse, core SERVICE_TASK_CORE) l'écrit sur l'UART. Un
+// appelant temps réel n'attend donc jamais la liaison série à 115200 bauds.
+// Avant setupLogTask() (boot), la ligne est écrite directement.
+
+void setupLogTask();
+void logPrintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void logStatsToJson(JsonObject out);
+
+#endif // LOG_TASK_H
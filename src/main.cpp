@@ -4,32 +4,47 @@
 #include <ETH.h>
 #include <ESPAsyncWebServer.h>
 #include <ElegantOTA.h>
-#include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include <Preferences.h>
-#include <WiFiUdp.h>
 #include <SPIFFS.h>
 #include <time.h>
 
 #include "config.h"
 #include "mqtt.h"
 #include "serial_manager.h"
+#include "multicast.h"
+#include "serial_server.h"
+#include "modbus_master.h"
+#include "modbus_tcp.h"
+#include "time_sync.h"
+#include "io_table.h"
+#include "expander.h"
+#include "analog.h"
+#include "capture.h"
+#include "io_command.h"
+#include "log_task.h"
+#include "task_metrics.h"
+#include "alloc_audit.h"
+#include "state_sync.h"
+#include "ota_guard.h"
+#include "ota_update.h"
+#include <freertos/queue.h>
 
 // ===== GLOBAL OBJECTS =====
 AsyncWebServer server(80);
-// WiFiClient and mqttClient are now defined in src/mqtt.cpp
+// The MQTT client is owned by src/mqtt.cpp (runs in its own esp-mqtt task)
 Preferences preferences;
 WiFiManager wifiManager;
 
 Config config;
 IOPin ioPins[MAX_IOS];
-AccessLog accessLogs[100];   // Max 100 logs
+AnalogConfig analogConfigs[ANALOG_MAX_CHANNELS];
+int analogConfigCount = 0;
+AccessLog accessLogs[ACCESS_LOG_ENTRIES];   // Anneau écrit par access_log.cpp
 int ioPinCount = 0;
 
 ScheduledCommand scheduledCommands[MAX_SCHEDULED_COMMANDS];
 
-unsigned long lastMqttReconnect = 0;
-
 // Ethernet globals
 bool ethConnected = false;
 void WiFiEvent(WiFiEvent_t event);
@@ -40,11 +55,13 @@ void WiFiEvent(WiFiEvent_t event);
 
 // ===== PROTOTYPES =====
 void loadConfig();
-void saveConfig();
+void saveConfig(const Config& c);
 void loadIOs();
 void saveIOs();
 void applyIOPinModes();
-void handleIOs(void *pvParameters); // Modified for FreeRTOS
+void handleIOs(void *pvParameters); // Tâche temps réel (core RT_TASK_CORE)
+void networkTask(void *pvParameters);
+void serialTask(void *pvParameters);
 void setupWebServer();
 void blinkStatusLED(int times, int delayMs);
 void processScheduledCommands();
@@ -53,6 +70,13 @@ bool initEthernet();
 
 // ===== FreeRTOS Task Handles =====
 TaskHandle_t ioTaskHandle = NULL;
+TaskHandle_t networkTaskHandle = NULL;
+TaskHandle_t serialTaskHandle = NULL;
+
+// Commandes vers la tâche temps réel (voir io_command.h)
+static QueueHandle_t commandQueue = NULL;
+static volatile uint32_t commandsSubmitted = 0;
+static volatile uint32_t commandsDropped = 0;
 
 // ===== FONCTION RESET WiFi =====
 // Fonction pour détecter 3 appuis sur le bouton BOOT
@@ -208,6 +232,8 @@ bool initEthernet() {
 void setup() {
   Serial.begin(115200);
   delay(1000);
+  // Logs des tâches de service et temps réel : écrits par une tâche dédiée
+  setupLogTask();
 
   // Initialize scheduled commands queue
   for (int i = 0; i < MAX_SCHEDULED_COMMANDS; i++) {
@@ -247,13 +273,15 @@ void setup() {
   }
   if (!config.initialized) {
     config.initialized = true;
-    saveConfig();
+    saveConfig(config);
     Serial.println("First boot detected - Configuration initialized");
   }
   
   loadIOs();
   Serial.println("Configuration and I/O settings loaded.");
   blinkStatusLED(2, 100);
+  // I/O expanders (avant les modes : les broches virtuelles en dépendent)
+  setupExpanders();
   // Apply I/O pin configurations
   applyIOPinModes();
   Serial.println("I/O pin configurations applied.");
@@ -387,26 +415,57 @@ void setup() {
   }
   Serial.println("SPIFFS mounted successfully.");
 
+  // Source de temps SNTP (le réseau est disponible à ce stade)
+  setupTimeSync();
+
   // Setup Web Server (configure toutes les routes)
   setupWebServer();
+  setupOtaUpdate();
 
   // Setup MQTT
   setupMQTT();
+  setupStateSync();
   if (strlen(config.mqttServer) > 0) {
     Serial.println("MQTT configuration found, enabling MQTT.");
     mqttEnabled = true;
     blinkStatusLED(2, 100);  // Signal MQTT activé
   }
 
-  // === DÉMARRAGE TÂCHE I/O ===
+  // Canal de commande UDP multicast (optionnel, indépendant du broker)
+  setupMulticast();
+
+  // Serveur TCP du pont série (optionnel) : Serial2 en octets bruts ou RFC 2217
+  setupSerialServer();
+
+  // Maître Modbus RTU (optionnel) : Serial2 lui est alors réservée
+  setupModbus();
+
+  // Serveur Modbus TCP (optionnel) : ioPins en coils et entrées TOR
+  setupModbusTcp();
+
+  // === DÉMARRAGE TÂCHE TEMPS RÉEL (seule sur le core 1, voir config.h) ===
+  commandQueue = xQueueCreate(IO_COMMAND_QUEUE_LENGTH, sizeof(IoCommand));
   xTaskCreatePinnedToCore(
       handleIOs,        
       "IOTask",         
-      4096,             
+      RT_TASK_STACK_SIZE,
       NULL,             
-      1,                
+      RT_TASK_PRIORITY,
       &ioTaskHandle,    
-      0);               
+      RT_TASK_CORE);
+
+  // === DÉMARRAGE TÂCHE ANALOGIQUE (canaux en mode ANALOG) ===
+  setupAnalog();
+
+  // Tampon de capture des entrées (alloué une fois, utilisé via /api/capture)
+  setupCapture();
+
+  // Tâches de service (core 0) : réseau/MQTT et pont série. Le serveur web tourne
+  // dans la tâche AsyncTCP (CONFIG_ASYNC_TCP_RUNNING_CORE, platformio.ini).
+  xTaskCreatePinnedToCore(networkTask, "NetTask", NET_TASK_STACK_SIZE, NULL, NET_TASK_PRIORITY,
+                          &networkTaskHandle, SERVICE_TASK_CORE);
+  xTaskCreatePinnedToCore(serialTask, "SerialTask", SERIAL_TASK_STACK_SIZE, NULL, SERIAL_TASK_PRIORITY,
+                          &serialTaskHandle, SERVICE_TASK_CORE);
 
   // Démarrage du serveur web (UNE SEULE FOIS, après avoir configuré toutes les routes)
   server.begin();
@@ -424,44 +483,53 @@ void setup() {
 
 // ===== LOOP =====
 void loop() {
-  // The main loop is now responsible for high-frequency tasks only.
-  // I/O handling is moved to a separate FreeRTOS task.
-
-  processScheduledCommands();
-  serialManager.loop();
+  // Tout le travail est réparti dans des tâches dédiées (voir setup() et config.h) :
+  // la tâche Arduino partagerait le core 1 avec la tâche temps réel.
+  vTaskDelete(NULL);
+}
 
-  // Check network connection (WiFi or Ethernet)
-  bool networkOk = config.useEthernet ? ethConnected : (WiFi.status() == WL_CONNECTED);
-  
-  if (networkOk) {
-    if (mqttEnabled) {
-      if (!mqttClient.connected()) {
-        long now = millis();
-        // Attempt to reconnect every 5 seconds if disconnected.
-        if (now - lastMqttReconnect > 5000) {
-          lastMqttReconnect = now;
-          reconnectMQTT();
-        }
-      }
-      // This should be called as often as possible.
-      mqttClient.loop();
-    }
+// Réseau et MQTT : machine d'état, files de publication, SNTP, capture, OTA
+void networkTask(void *pvParameters) {
+  Serial.println("✅ Network task started.");
+  allocAuditRegisterTask();
+  for (;;) {
+    // Check network connection (WiFi or Ethernet)
+    bool networkOk = config.useEthernet ? ethConnected : (WiFi.status() == WL_CONNECTED);
+
+    // Non bloquant : la connexion elle-même se fait dans la tâche MQTT
+    mqttLoop(networkOk);
+    stateSyncLoop();
+    timeSyncLoop();
+    captureLoop();
+    taskMetricsLoop();
+    // Redémarrage après /api/ota, validation ou retour arrière du nouveau firmware
+    otaUpdateLoop(networkOk);
+
+    allocAuditLoop();
+
+    // ElegantOTA loop for web updates.
+    ElegantOTA.loop();
+    allocAuditIteration();
+    vTaskDelay(pdMS_TO_TICKS(1));
   }
+}
 
-  // ElegantOTA loop for web updates.
-  ElegantOTA.loop();
-
-  // A small delay can be added here if needed to prevent watchdog timeouts,
-  // but it should be as small as possible (e.g., 1ms) or removed entirely
-  // if other tasks yield frequently enough.
-  delay(1);
+void serialTask(void *pvParameters) {
+  allocAuditRegisterTask();
+  for (;;) {
+    serialManager.loop();
+    allocAuditIteration();
+    // Requête RPC en cours : réponse lue au tick suivant (temps d'aller-retour mesuré)
+    vTaskDelay(serialManager.rpcBusy() ? 1 : pdMS_TO_TICKS(2));
+  }
 }
 
+// Code en flash comme le reste de la tâche : une écriture flash d'OTA la suspend, d'où
+// les écritures placées hors des OTA_FLASH_GUARD_US qui précèdent une échéance (ota_guard.h)
 void processScheduledCommands() {
-  // Obtenir le temps actuel avec précision microseconde
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  uint64_t currentTimeUs = (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+  // Obtenir le temps actuel avec précision microseconde (modèle corrigé de la dérive)
+  uint64_t currentTimeUs = getCurrentTimeMicros();
+  int64_t nextDeadlineUs = INT64_MAX;   // Commande en attente la plus proche
   
   for (int i = 0; i < MAX_SCHEDULED_COMMANDS; i++) {
     if (scheduledCommands[i].active) {
@@ -475,17 +543,26 @@ void processScheduledCommands() {
         int64_t delay_us = (int64_t)currentTimeUs - (int64_t)execTimeUs;
         
         // Exécuter la commande
-        executeCommand(scheduledCommands[i].pin, scheduledCommands[i].state);
+        uint64_t executedUs = executeCommand(scheduledCommands[i].pin, scheduledCommands[i].state);
         
         // Désactiver cette commande
         scheduledCommands[i].active = false;
         
         // Afficher le délai en millisecondes avec 3 décimales
         double delay_ms = delay_us / 1000.0;
-        Serial.printf("⏰ Scheduled command executed (delay: %.3f ms)\n", delay_ms);
+        logPrintf("⏰ Scheduled command executed (delay: %.3f ms)\n", delay_ms);
+        publishCommandAck(scheduledCommands[i].id, scheduledCommands[i].pin, scheduledCommands[i].state,
+                          "executed", scheduledCommands[i].received_us, execTimeUs, executedUs);
+        otaGuardScheduledExecuted(delay_us);
+      } else if ((int64_t)(execTimeUs - currentTimeUs) < nextDeadlineUs) {
+        nextDeadlineUs = (int64_t)(execTimeUs - currentTimeUs);
       }
     }
   }
+  // Les écritures flash d'une OTA attendent que cette échéance soit passée
+  otaGuardSetNextDeadline(nextDeadlineUs);
+  // Commandes échues simultanément sur un même expander : une seule transaction
+  expanderFlush();
 }
 
 // ===== CONFIGURATION FUNCTIONS =====
@@ -513,8 +590,32 @@ void loadConfig() {
   if (strlen(config.mqttTopic) == 0) {
     snprintf(config.mqttTopic, sizeof(config.mqttTopic), "%s/io", config.deviceName);
   }
-
-  // NTP settings are now for display and offset, not for server connection
+  config.mqttBufferSize = preferences.getInt("mqttBuf", MQTT_DEFAULT_BUFFER_SIZE);
+  preferences.getString("groups", config.groups, sizeof(config.groups));
+
+  config.useMulticast = preferences.getBool("mcast", false);
+  preferences.getString("mcGroup", config.multicastGroup, sizeof(config.multicastGroup));
+  if (strlen(config.multicastGroup) == 0) strcpy(config.multicastGroup, "239.10.0.1");
+  config.multicastPort = preferences.getInt("mcPort", 5007);
+  preferences.getString("mcKey", config.multicastKey, sizeof(config.multicastKey));
+  config.useModbusTcp = preferences.getBool("mbTcp", false);
+  config.modbusTcpPort = preferences.getInt("mbTcpPort", MODBUS_TCP_DEFAULT_PORT);
+
+  config.i2cSdaPin = preferences.getInt("i2cSda", I2C_DEFAULT_SDA);
+  config.i2cSclPin = preferences.getInt("i2cScl", I2C_DEFAULT_SCL);
+  preferences.getString("expanders", config.expanders, sizeof(config.expanders));
+  config.expanderIntPin = preferences.getInt("expInt", -1);
+  config.spiSckPin = preferences.getInt("spiSck", -1);
+  config.spiMisoPin = preferences.getInt("spiMiso", -1);
+  config.spiMosiPin = preferences.getInt("spiMosi", -1);
+  config.spiCsPin = preferences.getInt("spiCs", -1);
+
+  // NTP : source de temps secondaire (vide = désactivé), classée face à esp32/time/sync
+  if (!preferences.isKey("ntpSrv")) {
+    strcpy(config.ntpServer, "pool.ntp.org");
+  } else {
+    preferences.getString("ntpSrv", config.ntpServer, sizeof(config.ntpServer));
+  }
   config.gmtOffset_sec = preferences.getLong("gmtOffset", 3600);
   config.daylightOffset_sec = preferences.getInt("daylightOff", 3600);
 
@@ -522,34 +623,65 @@ void loadConfig() {
   config.serialRxPin = preferences.getInt("serRx", 4);
   config.serialTxPin = preferences.getInt("serTx", 5);
   config.serialBaudRate = preferences.getLong("serBaud", 9600);
+  config.useSerialServer = preferences.getBool("serSrv", false);
+  config.serialServerPort = preferences.getInt("serSrvPort", SERIAL_SERVER_DEFAULT_PORT);
+  config.serialServerRfc2217 = preferences.getBool("serSrvRfc", true);
+  config.useModbus = preferences.getBool("mbUse", false);
+  config.modbusDePin = preferences.getInt("mbDe", -1);
+  config.modbusParity = preferences.getInt("mbPar", 2);   // 8E1 : parité paire par défaut du protocole
+  config.modbusTimeoutMs = preferences.getInt("mbTo", MODBUS_DEFAULT_TIMEOUT_MS);
 
   config.initialized = preferences.getBool("init", false);
   Serial.println("Configuration loaded.");
 }
 
-void saveConfig() {
-  preferences.putString("deviceName", config.deviceName);
-  preferences.putBool("useEthernet", config.useEthernet);
-  preferences.putString("ethType", config.ethernetType);
-  preferences.putBool("useStaticIP", config.useStaticIP);
-  preferences.putString("staticIP", config.staticIP);
-  preferences.putString("staticGW", config.staticGateway);
-  preferences.putString("staticSN", config.staticSubnet);
+void saveConfig(const Config& c) {
+  preferences.putString("deviceName", c.deviceName);
+  preferences.putBool("useEthernet", c.useEthernet);
+  preferences.putString("ethType", c.ethernetType);
+  preferences.putBool("useStaticIP", c.useStaticIP);
+  preferences.putString("staticIP", c.staticIP);
+  preferences.putString("staticGW", c.staticGateway);
+  preferences.putString("staticSN", c.staticSubnet);
   
-  preferences.putString("adminPw", config.adminPassword);
-  preferences.putString("mqttSrv", config.mqttServer);
-  preferences.putInt("mqttPort", config.mqttPort);
-  preferences.putString("mqttUser", config.mqttUser);
-  preferences.putString("mqttPass", config.mqttPassword);
-  preferences.putString("mqttTop", config.mqttTopic);
-  //preferences.putString("ntpSrv", config.ntpServer); // No longer needed
-  preferences.putLong("gmtOffset", config.gmtOffset_sec);
-  preferences.putInt("daylightOff", config.daylightOffset_sec);
+  preferences.putString("adminPw", c.adminPassword);
+  preferences.putString("mqttSrv", c.mqttServer);
+  preferences.putInt("mqttPort", c.mqttPort);
+  preferences.putString("mqttUser", c.mqttUser);
+  preferences.putString("mqttPass", c.mqttPassword);
+  preferences.putString("mqttTop", c.mqttTopic);
+  preferences.putInt("mqttBuf", c.mqttBufferSize);
+  preferences.putString("groups", c.groups);
+  preferences.putBool("mcast", c.useMulticast);
+  preferences.putString("mcGroup", c.multicastGroup);
+  preferences.putInt("mcPort", c.multicastPort);
+  preferences.putString("mcKey", c.multicastKey);
+  preferences.putBool("mbTcp", c.useModbusTcp);
+  preferences.putInt("mbTcpPort", c.modbusTcpPort);
+  preferences.putInt("i2cSda", c.i2cSdaPin);
+  preferences.putInt("i2cScl", c.i2cSclPin);
+  preferences.putString("expanders", c.expanders);
+  preferences.putInt("expInt", c.expanderIntPin);
+  preferences.putInt("spiSck", c.spiSckPin);
+  preferences.putInt("spiMiso", c.spiMisoPin);
+  preferences.putInt("spiMosi", c.spiMosiPin);
+  preferences.putInt("spiCs", c.spiCsPin);
+
+  preferences.putString("ntpSrv", c.ntpServer);
+  preferences.putLong("gmtOffset", c.gmtOffset_sec);
+  preferences.putInt("daylightOff", c.daylightOffset_sec);
   
-  preferences.putBool("useSerial", config.useSerialBridge);
-  preferences.putInt("serRx", config.serialRxPin);
-  preferences.putInt("serTx", config.serialTxPin);
-  preferences.putLong("serBaud", config.serialBaudRate);
+  preferences.putBool("useSerial", c.useSerialBridge);
+  preferences.putInt("serRx", c.serialRxPin);
+  preferences.putInt("serTx", c.serialTxPin);
+  preferences.putLong("serBaud", c.serialBaudRate);
+  preferences.putBool("serSrv", c.useSerialServer);
+  preferences.putInt("serSrvPort", c.serialServerPort);
+  preferences.putBool("serSrvRfc", c.serialServerRfc2217);
+  preferences.putBool("mbUse", c.useModbus);
+  preferences.putInt("mbDe", c.modbusDePin);
+  preferences.putInt("mbPar", c.modbusParity);
+  preferences.putInt("mbTo", c.modbusTimeoutMs);
 
   preferences.putBool("init", true);
   Serial.println("Configuration saved.");
@@ -559,8 +691,19 @@ void loadIOs() {
   ioPinCount = preferences.getInt("ioCount", 0);
   if (ioPinCount > MAX_IOS) ioPinCount = 0;
   for (int i = 0; i < ioPinCount; i++) {
-    String key = "io" + String(i);
-    preferences.getBytes(key.c_str(), &ioPins[i], sizeof(IOPin));
+    char key[8];
+    snprintf(key, sizeof(key), "io%d", i);
+    preferences.getBytes(key, &ioPins[i], sizeof(IOPin));
+  }
+  analogConfigCount = preferences.getInt("anCount", 0);
+  if (analogConfigCount < 0 || analogConfigCount > ANALOG_MAX_CHANNELS) analogConfigCount = 0;
+  if (analogConfigCount > 0) {
+    preferences.getBytes("analog", analogConfigs, sizeof(AnalogConfig) * analogConfigCount);
+  }
+  modbusRegisterCount = preferences.getInt("mbCount", 0);
+  if (modbusRegisterCount < 0 || modbusRegisterCount > MODBUS_MAX_REGISTERS) modbusRegisterCount = 0;
+  if (modbusRegisterCount > 0) {
+    preferences.getBytes("mbRegs", modbusRegisters, sizeof(ModbusRegister) * modbusRegisterCount);
   }
   Serial.printf("Loaded %d I/O pin configurations.\n", ioPinCount);
 }
@@ -568,8 +711,17 @@ void loadIOs() {
 void saveIOs() {
   preferences.putInt("ioCount", ioPinCount);
   for (int i = 0; i < ioPinCount; i++) {
-    String key = "io" + String(i);
-    preferences.putBytes(key.c_str(), &ioPins[i], sizeof(IOPin));
+    char key[8];
+    snprintf(key, sizeof(key), "io%d", i);
+    preferences.putBytes(key, &ioPins[i], sizeof(IOPin));
+  }
+  preferences.putInt("anCount", analogConfigCount);
+  if (analogConfigCount > 0) {
+    preferences.putBytes("analog", analogConfigs, sizeof(AnalogConfig) * analogConfigCount);
+  }
+  preferences.putInt("mbCount", modbusRegisterCount);
+  if (modbusRegisterCount > 0) {
+    preferences.putBytes("mbRegs", modbusRegisters, sizeof(ModbusRegister) * modbusRegisterCount);
   }
   Serial.printf("Saved %d I/O pin configurations.\n", ioPinCount);
 }
@@ -578,6 +730,27 @@ void applyIOPinModes() {
 
     pinMode(STATUS_LED, OUTPUT); // Définit GPIO 2 comme une sortie (LED sur WT32-ETH01)
     for (int i = 0; i < ioPinCount; i++) {
+        if (!ioPinValid(ioPins[i].pin)) {
+            Serial.printf("⚠️ Pin %d (%s) ignored: no such GPIO or expander channel\n", ioPins[i].pin, ioPins[i].name);
+            continue;
+        }
+        if (ioPins[i].mode == 3) { // ANALOG (la tâche d'échantillonnage règle l'atténuation)
+            if (!analogPinValid(ioPins[i].pin)) {
+                Serial.printf("⚠️ Pin %d (%s) ignored: ANALOG requires an ADC1 pin (32..39)\n", ioPins[i].pin, ioPins[i].name);
+            } else {
+                Serial.printf("Pin %d (%s) configured as ANALOG\n", ioPins[i].pin, ioPins[i].name);
+            }
+            continue;
+        }
+        if (expanderIsVirtualPin(ioPins[i].pin)) {
+            // Canal d'extension : même modèle de mode, appliqué au registre de l'expander
+            // État par défaut préparé avant le changement de direction (écrit avec la configuration)
+            if (ioPins[i].mode == 2) expanderWrite(ioPins[i].pin, ioPins[i].defaultState);
+            expanderPinMode(ioPins[i].pin, ioPins[i].mode, ioPins[i].inputType);
+            Serial.printf("Pin %d (%s) configured on expander as %s\n", ioPins[i].pin, ioPins[i].name,
+                          ioPins[i].mode == 2 ? "OUTPUT" : "INPUT");
+            continue;
+        }
         if (ioPins[i].mode == 1) { // INPUT
             // Apply the selected input type
             switch (ioPins[i].inputType) {
@@ -604,36 +777,112 @@ void applyIOPinModes() {
             Serial.printf("Pin %d (%s) configured as OUTPUT\n", ioPins[i].pin, ioPins[i].name);
         }
     }
+    // Publication atomique de la nouvelle table (index par broche/nom, masques
+    // d'entrées, états de référence) : ioPins[] n'est qu'une copie de travail
+    ioTablePublish(ioPins, ioPinCount, analogConfigs, analogConfigCount);
+    analogRebuild();
     Serial.println("I/O pin modes applied.");
 }
 
 
 // ===== I/O HANDLING (FreeRTOS Task) =====
+static void onInputChanged(int index, bool state) {
+  const IoTable& table = ioTableActive();
+  logPrintf("Input '%s' (pin %d) changed to %s\n", table.pins[index].name, table.pin[index], state ? "HIGH" : "LOW");
+
+  char topic[128];
+  snprintf(topic, sizeof(topic), "%s/status/%s", config.deviceName, table.pins[index].name);
+  char payload[2];
+  snprintf(payload, sizeof(payload), "%d", state ? 1 : 0);
+
+  if (mqttEnabled && mqttConnected()) {
+    publishMQTT(topic, payload);
+  }
+  stateSyncPublishDelta(table, index, state, getCurrentTimeMicros());
+}
+
+bool submitIoCommand(int pin, int state, uint32_t exec_at_sec, uint32_t exec_at_us,
+                     const char* id, uint64_t receivedUs) {
+  IoCommand command;
+  command.pin = pin;
+  command.state = state;
+  command.exec_at_sec = exec_at_sec;
+  command.exec_at_us = exec_at_us;
+  command.received_us = receivedUs;
+  command.batch_follow = 0;
+  strlcpy(command.id, id ? id : "", sizeof(command.id));
+  if (commandQueue == NULL || xQueueSend(commandQueue, &command, 0) != pdTRUE) {
+    commandsDropped++;
+    logPrintf("⚠️ I/O command queue full - command for pin %d dropped\n", pin);
+    return false;
+  }
+  commandsSubmitted++;
+  return true;
+}
+
+int submitIoBatch(IoCommand* commands, int count) {
+  // Producteurs concurrents (MQTT, multicast) : la place vérifiée peut manquer au
+  // milieu du lot, la tâche temps réel cesse alors d'attendre la suite après 1 tick
+  if (commandQueue == NULL || count > IO_COMMAND_QUEUE_LENGTH || (int)uxQueueSpacesAvailable(commandQueue) < count) {
+    commandsDropped += count;
+    logPrintf("⚠️ I/O command queue full - batch of %d command(s) dropped\n", count);
+    return 0;
+  }
+  for (int i = 0; i < count; i++) {
+    commands[i].batch_follow = count - 1 - i > 255 ? 255 : count - 1 - i;
+    if (xQueueSend(commandQueue, &commands[i], 0) != pdTRUE) {
+      commandsDropped += count - i;
+      logPrintf("⚠️ I/O command queue full - %d command(s) of batch dropped\n", count - i);
+      return i;
+    }
+    commandsSubmitted++;
+  }
+  return count;
+}
+
+void ioCommandStatsToJson(JsonObject out) {
+  out["submitted"] = commandsSubmitted;
+  out["dropped"] = commandsDropped;
+  out["depth"] = commandQueue ? uxQueueMessagesWaiting(commandQueue) : 0;
+  out["capacity"] = IO_COMMAND_QUEUE_LENGTH;
+}
+
+static void runIoCommand(const IoCommand& command) {
+  if (command.exec_at_sec > 0) {
+    scheduleCommand(command.pin, command.state, command.exec_at_sec, command.exec_at_us,
+                    command.id, command.received_us);
+    return;
+  }
+  uint64_t executedUs = executeCommand(command.pin, command.state);
+  publishCommandAck(command.id, command.pin, command.state, "executed", command.received_us, 0, executedUs);
+}
+
+// Tâche temps réel : seule propriétaire des sorties et de scheduledCommands[]
 void handleIOs(void *pvParameters) {
-  Serial.println("✅ I/O handling task started.");
+  logPrintf("✅ I/O real-time task started on core %d.\n", xPortGetCoreID());
+  ioTableSetRealtimeTask(xTaskGetCurrentTaskHandle());
+  allocAuditRegisterTask();
 
   for (;;) { // Infinite loop for the task
-    for (int i = 0; i < ioPinCount; i++) {
-      if (ioPins[i].mode == 1) { // INPUT
-        bool currentState = digitalRead(ioPins[i].pin);
-
-        // Détection immédiate du changement d'état (sans debounce)
-        if (currentState != ioPins[i].state) {
-          ioPins[i].state = currentState;
-          Serial.printf("Input '%s' (pin %d) changed to %s\n", ioPins[i].name, ioPins[i].pin, currentState ? "HIGH" : "LOW");
-          
-          char topic[128];
-          snprintf(topic, sizeof(topic), "%s/status/%s", config.deviceName, ioPins[i].name);
-          char payload[2];
-          snprintf(payload, sizeof(payload), "%d", currentState ? 1 : 0);
-
-          if (mqttEnabled && mqttClient.connected()) {
-            publishMQTT(topic, payload);
-          }
-        }
-      }
+    // Écart entre deux tours : arrêt de la tâche (écriture flash d'une OTA, NVS)
+    otaGuardTick();
+    // Nouvelle configuration publiée par /api/ios : bascule entre deux ticks
+    ioTableApplyPending();
+    // Attente d'une commande, au plus 1 tick : une commande réveille la tâche
+    // immédiatement, sans attendre la fin de la période de balayage
+    IoCommand command;
+    if (xQueueReceive(commandQueue, &command, pdMS_TO_TICKS(1)) == pdTRUE) {
+      do {
+        runIoCommand(command);
+        // Lot /api/io/batch : la suite est en cours de dépôt, appliquée dans ce même tour
+      } while (xQueueReceive(commandQueue, &command, command.batch_follow > 0 ? pdMS_TO_TICKS(1) : 0) == pdTRUE);
     }
-    vTaskDelay(pdMS_TO_TICKS(1)); // Check inputs every 1ms (réactivité maximale)
+    processScheduledCommands();
+    // Une lecture de registre pour tous les GPIO : le coût ne dépend que des changements
+    ioScanInputs(onInputChanged);
+    // Sorties d'extension préparées depuis le dernier tick : une transaction par expander
+    expanderFlush();
+    allocAuditIteration();
   }
 }
 
@@ -0,0 +1,416 @@
+#include "modbus_master.h"
+#include "serial_manager.h"
+#include "mqtt.h"
+#include "alloc_audit.h"
+#include "log_task.h"
+#include <driver/uart.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <math.h>
+#include <time.h>
+
+extern Config config;
+extern bool mqttEnabled;
+
+ModbusRegister modbusRegisters[MODBUS_MAX_REGISTERS];
+int modbusRegisterCount = 0;
+
+// Copie de la tâche, remplacée par modbusRebuild() sous mapMutex
+static ModbusRegister regs[MODBUS_MAX_REGISTERS];
+static int regCount = 0;
+static uint8_t order[MODBUS_MAX_REGISTERS];
+static ModbusGroup groups[MODBUS_MAX_GROUPS];
+static int groupCount = 0;
+static uint32_t generation = 0;   // Table remplacée pendant une lecture : résultat écarté
+
+struct ModbusValue {
+  uint32_t raw;
+  float value;
+  uint32_t publishedRaw;
+  float lastPublished;
+  uint32_t updatedMs;             // 0 = jamais lue
+  bool valid;                     // Dernière lecture de son groupe réussie (ou récente)
+  bool pending;                   // À publier
+};
+static ModbusValue cache[MODBUS_MAX_REGISTERS];
+
+struct GroupState {
+  int64_t nextPollUs;
+  uint32_t polls;
+  uint32_t errors;
+  uint32_t rttUs;
+  uint8_t consecutiveErrors;
+  uint8_t lastResult;             // ModbusResult
+  uint8_t lastException;
+};
+static GroupState groupStates[MODBUS_MAX_GROUPS];
+
+static struct ModbusStats {
+  uint32_t requests = 0;
+  uint32_t responses = 0;
+  uint32_t timeouts = 0;
+  uint32_t crcErrors = 0;
+  uint32_t badFrames = 0;
+  uint32_t exceptions = 0;
+  uint32_t published = 0;
+} stats;
+
+static SemaphoreHandle_t mapMutex = NULL;
+static TaskHandle_t modbusTaskHandle = NULL;
+static uint8_t txFrame[8];
+static uint8_t rxFrame[MODBUS_MAX_FRAME];
+static long lineBaud = 9600;
+static uint32_t frameGapUs = 1750;
+static int64_t busIdleSinceUs = 0;
+
+static const char* typeNames[MODBUS_TYPE_COUNT] = { "u16", "s16", "u32", "s32", "f32", "bool" };
+static const char* resultNames[] = { "ok", "timeout", "crc_error", "bad_frame", "exception" };
+
+// ===== LIGNE =====
+
+// Une lecture : silence de 3,5 caractères, requête, puis réponse lue en deux temps
+// (en-tête de 3 octets, qui donne la longueur, puis le reste) directement dans rxFrame
+static ModbusResult transact(const ModbusGroup& g, uint8_t* exception, uint32_t* rttUs) {
+  int64_t idle = esp_timer_get_time() - busIdleSinceUs;
+  if (idle < frameGapUs) delayMicroseconds(frameGapUs - idle);
+
+  size_t n = modbusBuildRead(txFrame, g.slave, g.function, g.start, g.count);
+  uart_flush_input(SERIAL_BRIDGE_UART);   // Reste d'une réponse arrivée après son timeout
+  uart_write_bytes(SERIAL_BRIDGE_UART, txFrame, n);
+  uart_wait_tx_done(SERIAL_BRIDGE_UART, pdMS_TO_TICKS(100));
+  int64_t sentUs = esp_timer_get_time();
+  stats.requests++;
+
+  ModbusResult result = MODBUS_TIMEOUT;
+  int got = uart_read_bytes(SERIAL_BRIDGE_UART, rxFrame, 3, pdMS_TO_TICKS(config.modbusTimeoutMs));
+  if (got == 3) {
+    size_t total = (rxFrame[1] & 0x80) ? 5 : 5 + rxFrame[2];
+    if (total > sizeof(rxFrame)) {
+      result = MODBUS_BAD_FRAME;
+    } else {
+      // Le reste arrive à la vitesse de la ligne (11 bits par caractère), plus une marge
+      uint32_t restMs = (uint32_t)((total - 3) * 11 * 1000 / lineBaud) + 2 * frameGapUs / 1000 + 2;
+      got += uart_read_bytes(SERIAL_BRIDGE_UART, rxFrame + 3, total - 3, pdMS_TO_TICKS(restMs));
+      if (got == (int)total) {
+        result = modbusCheckResponse(rxFrame, total, g.slave, g.function, g.count, exception);
+      }
+    }
+  }
+  int64_t now = esp_timer_get_time();
+  *rttUs = (uint32_t)(now - sentUs);
+  busIdleSinceUs = now;
+
+  switch (result) {
+    case MODBUS_OK:        stats.responses++; break;
+    case MODBUS_TIMEOUT:   stats.timeouts++; break;
+    case MODBUS_CRC_ERROR: stats.crcErrors++; break;
+    case MODBUS_EXCEPTION: stats.exceptions++; stats.responses++; break;
+    default:               stats.badFrames++; break;
+  }
+  return result;
+}
+
+// ===== CACHE ET PUBLICATION (sous mapMutex) =====
+
+static bool publishValue(int i) {
+  const ModbusRegister& r = regs[i];
+  ModbusValue& v = cache[i];
+  char topic[128];
+  snprintf(topic, sizeof(topic), "%s/modbus/%s", config.deviceName, r.name);
+  char number[24];
+  if (v.updatedMs == 0 || !isfinite(v.value)) strcpy(number, "null");
+  else snprintf(number, sizeof(number), "%.7g", v.value);
+  char payload[160];
+  snprintf(payload, sizeof(payload), "{\"value\":%s,\"raw\":%lu,\"unit\":\"%s\",\"valid\":%s,\"timestamp\":%ld}",
+           number, (unsigned long)v.raw, r.unit, v.valid ? "true" : "false", (long)time(nullptr));
+  if (!publishMQTT(topic, payload, true)) return false;
+  v.pending = false;
+  v.lastPublished = v.value;
+  v.publishedRaw = v.raw;
+  stats.published++;
+  return true;
+}
+
+// Quelques publications par tour : la file "state" n'est jamais remplie d'un coup
+static void publishPending() {
+  if (!mqttEnabled || !mqttConnected()) return;   // Dernières valeurs publiées à la reconnexion
+  int budget = MQTT_REPUBLISH_BATCH;
+  for (int i = 0; i < regCount && budget > 0; i++) {
+    if (!cache[i].pending) continue;
+    if (!publishValue(i)) return;   // File pleine : au tour suivant
+    budget--;
+  }
+}
+
+static void applyResult(int index, ModbusResult result, uint8_t exception, uint32_t rttUs) {
+  const ModbusGroup& g = groups[index];
+  GroupState& st = groupStates[index];
+  int64_t now = esp_timer_get_time();
+  st.polls++;
+  st.lastResult = result;
+  st.lastException = exception;
+  // Cadence tenue, sans rafale de rattrapage après un retard
+  st.nextPollUs += (int64_t)g.intervalMs * 1000;
+  if (st.nextPollUs < now) st.nextPollUs = now + (int64_t)g.intervalMs * 1000;
+
+  if (result != MODBUS_OK) {
+    st.errors++;
+    if (st.consecutiveErrors < 255) st.consecutiveErrors++;
+    if (st.consecutiveErrors == MODBUS_OFFLINE_AFTER) {
+      logPrintf("⚠️ Modbus slave %u FC%u @%u: %s, values marked invalid\n",
+                g.slave, g.function, g.start, resultNames[result]);
+      for (int k = 0; k < g.members; k++) {
+        ModbusValue& v = cache[order[g.first + k]];
+        if (v.valid) {
+          v.valid = false;
+          v.pending = true;
+        }
+      }
+    }
+    return;
+  }
+
+  st.consecutiveErrors = 0;
+  st.rttUs = rttUs;
+  uint32_t nowMs = millis();
+  if (nowMs == 0) nowMs = 1;
+  for (int k = 0; k < g.members; k++) {
+    int i = order[g.first + k];
+    const ModbusRegister& r = regs[i];
+    ModbusValue& v = cache[i];
+    modbusDecode(r, g, rxFrame + 3, &v.raw, &v.value);
+    v.updatedMs = nowMs;
+    // Valeur redevenue valide, ou écart à la dernière valeur publiée
+    bool changed = r.deadband > 0 ? fabsf(v.value - v.lastPublished) >= r.deadband : v.raw != v.publishedRaw;
+    if (!v.valid || changed) v.pending = true;
+    v.valid = true;
+  }
+}
+
+// ===== TÂCHE =====
+
+static void modbusTask(void* pvParameters) {
+  Serial.println("✅ Modbus master task started.");
+  allocAuditRegisterTask();
+  // La tâche série cesse de lire Serial2 : la ligne est à nous seuls
+  serialManager.lendPort(1000);
+  for (;;) {
+    int index = -1;
+    int64_t due = INT64_MAX;
+    ModbusGroup group;
+    xSemaphoreTake(mapMutex, portMAX_DELAY);
+    publishPending();
+    for (int g = 0; g < groupCount; g++) {
+      if (groupStates[g].nextPollUs < due) {
+        due = groupStates[g].nextPollUs;
+        index = g;
+      }
+    }
+    if (index >= 0) group = groups[index];
+    uint32_t polledGeneration = generation;
+    xSemaphoreGive(mapMutex);
+
+    int64_t now = esp_timer_get_time();
+    if (index < 0 || due > now) {
+      // Rien d'échu : attente bornée pour voir une nouvelle table ou une demande de publication
+      int64_t waitMs = index < 0 ? 50 : (due - now + 999) / 1000;
+      vTaskDelay(pdMS_TO_TICKS(waitMs < 50 ? waitMs : 50));
+      allocAuditIteration();
+      continue;
+    }
+
+    uint8_t exception = 0;
+    uint32_t rttUs = 0;
+    ModbusResult result = transact(group, &exception, &rttUs);
+
+    xSemaphoreTake(mapMutex, portMAX_DELAY);
+    if (polledGeneration == generation) applyResult(index, result, exception, rttUs);
+    xSemaphoreGive(mapMutex);
+    allocAuditIteration();
+  }
+}
+
+void modbusRebuild() {
+  if (!mapMutex) mapMutex = xSemaphoreCreateMutex();
+  xSemaphoreTake(mapMutex, portMAX_DELAY);
+  regCount = modbusRegisterCount < MODBUS_MAX_REGISTERS ? modbusRegisterCount : MODBUS_MAX_REGISTERS;
+  memcpy(regs, modbusRegisters, sizeof(ModbusRegister) * regCount);
+  groupCount = modbusPlanGroups(regs, regCount, MODBUS_MERGE_GAP, groups, MODBUS_MAX_GROUPS, order);
+  memset(cache, 0, sizeof(cache));
+  memset(groupStates, 0, sizeof(groupStates));
+  int64_t now = esp_timer_get_time();
+  int polled = 0;
+  for (int g = 0; g < groupCount; g++) {
+    groupStates[g].nextPollUs = now;
+    polled += groups[g].members;
+  }
+  generation++;
+  xSemaphoreGive(mapMutex);
+  Serial.printf("%d Modbus register(s) in %d read(s).\n", regCount, groupCount);
+  if (polled < regCount) {
+    Serial.printf("⚠️ Modbus: more than %d reads, %d register(s) not polled\n", MODBUS_MAX_GROUPS, regCount - polled);
+  }
+}
+
+void setupModbus() {
+  modbusRebuild();
+  if (!config.useModbus || modbusTaskHandle) return;
+  if (!config.useSerialBridge) {
+    Serial.println("⚠️ Modbus master needs the serial bridge (Serial2) - not started");
+    return;
+  }
+
+  // 11 bits par caractère RTU ; silence entre trames de 3,5 caractères, 1,75 ms au-delà de 19200 bauds
+  lineBaud = config.serialBaudRate > 0 ? config.serialBaudRate : 9600;
+  frameGapUs = lineBaud > 19200 ? 1750 : (uint32_t)(3.5 * 11 * 1000000 / lineBaud);
+  uart_set_parity(SERIAL_BRIDGE_UART, config.modbusParity == 1 ? UART_PARITY_ODD
+                                      : config.modbusParity == 2 ? UART_PARITY_EVEN : UART_PARITY_DISABLE);
+  if (config.modbusDePin >= 0) {
+    // DE du transceiver sur le RTS de l'UART, relâché par le matériel après le dernier bit
+    uart_set_pin(SERIAL_BRIDGE_UART, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, config.modbusDePin, UART_PIN_NO_CHANGE);
+    uart_set_mode(SERIAL_BRIDGE_UART, UART_MODE_RS485_HALF_DUPLEX);
+  }
+  busIdleSinceUs = esp_timer_get_time();
+
+  xTaskCreatePinnedToCore(modbusTask, "ModbusTask", MODBUS_TASK_STACK_SIZE, NULL, MODBUS_TASK_PRIORITY,
+                          &modbusTaskHandle, SERVICE_TASK_CORE);
+  Serial.printf("✓ Modbus RTU master at %ld baud, parity %d, timeout %d ms\n",
+                lineBaud, config.modbusParity, config.modbusTimeoutMs);
+}
+
+// ===== CONFIGURATION ET CACHE (web, MQTT) =====
+
+void modbusRegisterDefaults(ModbusRegister& r) {
+  memset(&r, 0, sizeof(r));
+  r.slave = 1;
+  r.function = MODBUS_READ_HOLDING_REGISTERS;
+  r.type = MODBUS_TYPE_U16;
+  r.scale = 1.0f;
+  r.intervalMs = 1000;
+}
+
+bool modbusRegisterFromJson(ModbusRegister& r, JsonObjectConst in) {
+  modbusRegisterDefaults(r);
+  // Le nom est un niveau de topic et une chaîne JSON publiée telle quelle
+  const char* name = in["name"];
+  if (!name || !*name || strlen(name) >= sizeof(r.name) || strpbrk(name, "/+#\"\\")) return false;
+  strlcpy(r.name, name, sizeof(r.name));
+
+  int slave = in["slave"] | 0;
+  int function = in["function"] | (int)MODBUS_READ_HOLDING_REGISTERS;
+  long address = in["address"] | -1L;
+  if (slave < 1 || slave > 247 || function < 1 || function > 4 || address < 0 || address > 65535) return false;
+  r.slave = slave;
+  r.function = function;
+  r.address = address;
+
+  const char* type = in["type"] | "u16";
+  int t = 0;
+  while (t < MODBUS_TYPE_COUNT && strcmp(type, typeNames[t]) != 0) t++;
+  if (t == MODBUS_TYPE_COUNT) return false;
+  r.type = function <= MODBUS_READ_DISCRETE_INPUTS ? MODBUS_TYPE_BOOL : t;
+  if (address + modbusRegisterWidth(r) > 65536) return false;
+
+  r.swapWords = in["swapWords"] | false;
+  r.scale = in["scale"] | 1.0f;
+  r.offset = in["offset"] | 0.0f;
+  r.deadband = in["deadband"] | 0.0f;
+  uint32_t interval = in["intervalMs"] | 1000u;
+  r.intervalMs = interval < MODBUS_MIN_INTERVAL_MS ? MODBUS_MIN_INTERVAL_MS : interval;
+  const char* unit = in["unit"] | "";
+  if (strpbrk(unit, "\"\\")) return false;
+  strlcpy(r.unit, unit, sizeof(r.unit));
+  return true;
+}
+
+void modbusMapToJson(JsonArray out) {
+  for (int i = 0; i < modbusRegisterCount; i++) {
+    const ModbusRegister& r = modbusRegisters[i];
+    JsonObject entry = out.add<JsonObject>();
+    entry["name"] = r.name;
+    entry["slave"] = r.slave;
+    entry["function"] = r.function;
+    entry["address"] = r.address;
+    entry["type"] = typeNames[r.type < MODBUS_TYPE_COUNT ? r.type : 0];
+    if (r.swapWords) entry["swapWords"] = true;
+    entry["scale"] = r.scale;
+    entry["offset"] = r.offset;
+    entry["deadband"] = r.deadband;
+    entry["intervalMs"] = r.intervalMs;
+    entry["unit"] = r.unit;
+  }
+}
+
+void modbusRequestPublish(const char* name, size_t length) {
+  if (!mapMutex) return;
+  xSemaphoreTake(mapMutex, portMAX_DELAY);
+  for (int i = 0; i < regCount; i++) {
+    if (length == 0 || (strlen(regs[i].name) == length && memcmp(regs[i].name, name, length) == 0)) {
+      cache[i].pending = true;
+    }
+  }
+  xSemaphoreGive(mapMutex);
+}
+
+static void valueToJson(JsonObject out, int i, uint32_t nowMs) {
+  const ModbusValue& v = cache[i];
+  out["name"] = regs[i].name;
+  if (v.updatedMs == 0) {
+    out["value"] = nullptr;
+  } else {
+    out["value"] = v.value;
+    out["raw"] = v.raw;
+    out["ageMs"] = nowMs - v.updatedMs;
+  }
+  out["valid"] = v.valid;
+  if (regs[i].unit[0]) out["unit"] = regs[i].unit;
+}
+
+bool modbusValuesToJson(JsonObject out, const char* name) {
+  if (!mapMutex) return name == NULL;
+  uint32_t nowMs = millis();
+  bool found = name == NULL;
+  xSemaphoreTake(mapMutex, portMAX_DELAY);
+  if (name) {
+    for (int i = 0; i < regCount; i++) {
+      if (strcmp(regs[i].name, name) == 0) {
+        valueToJson(out, i, nowMs);
+        found = true;
+        break;
+      }
+    }
+  } else {
+    out["enabled"] = config.useModbus && modbusTaskHandle != NULL;
+    JsonObject counters = out["stats"].to<JsonObject>();
+    counters["requests"] = stats.requests;
+    counters["responses"] = stats.responses;
+    counters["timeouts"] = stats.timeouts;
+    counters["crcErrors"] = stats.crcErrors;
+    counters["badFrames"] = stats.badFrames;
+    counters["exceptions"] = stats.exceptions;
+    counters["published"] = stats.published;
+
+    JsonArray reads = out["reads"].to<JsonArray>();
+    for (int g = 0; g < groupCount; g++) {
+      const ModbusGroup& group = groups[g];
+      const GroupState& st = groupStates[g];
+      JsonObject entry = reads.add<JsonObject>();
+      entry["slave"] = group.slave;
+      entry["function"] = group.function;
+      entry["start"] = group.start;
+      entry["count"] = group.count;
+      entry["intervalMs"] = group.intervalMs;
+      entry["polls"] = st.polls;
+      entry["errors"] = st.errors;
+      entry["online"] = st.polls > 0 && st.consecutiveErrors < MODBUS_OFFLINE_AFTER;
+      entry["last"] = resultNames[st.lastResult];
+      if (st.lastResult == MODBUS_EXCEPTION) entry["exception"] = st.lastException;
+      entry["rttUs"] = st.rttUs;
+    }
+    JsonArray values = out["values"].to<JsonArray>();
+    for (int i = 0; i < regCount; i++) valueToJson(values.add<JsonObject>(), i, nowMs);
+  }
+  xSemaphoreGive(mapMutex);
+  return found;
+}
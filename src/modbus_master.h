@@ -0,0 +1,35 @@
+#ifndef MODBUS_MASTER_H
+#define MODBUS_MASTER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+#include "modbus_rtu.h"
+
+// ===== MAÎTRE MODBUS RTU =====
+// Une tâche scrute les esclaves de la ligne RS-485 de Serial2 d'après la table de
+// registres : les entrées voisines sont lues ensemble (modbusPlanGroups), chaque
+// lecture à l'intervalle le plus court de ses membres. Les valeurs vont dans un
+// cache ; seules celles qui ont changé (au-delà de deadband) sont publiées, retenues,
+// sur <device>/modbus/<name>. /api/modbus et <device>/modbus/get répondent depuis
+// le cache, sans trafic sur la ligne.
+//
+// La tâche a l'UART pour elle seule : pont série (serial/send, RPC) et serveur TCP
+// sont suspendus quand useModbus est actif.
+
+// Copie de travail (chargement, /api/modbus/map) : la tâche lit sa propre copie
+extern ModbusRegister modbusRegisters[];
+extern int modbusRegisterCount;
+
+void setupModbus();                          // Après serialManager.begin()
+void modbusRebuild();                        // Groupes recalculés depuis modbusRegisters[]
+void modbusRegisterDefaults(ModbusRegister& r);
+bool modbusRegisterFromJson(ModbusRegister& r, JsonObjectConst in);   // false si invalide
+void modbusMapToJson(JsonArray out);
+
+// <device>/modbus/get : republie une entrée (ou toutes si name est vide) depuis le cache
+void modbusRequestPublish(const char* name, size_t length);
+// Cache, groupes et compteurs ; name non NULL : une seule entrée (false si inconnue)
+bool modbusValuesToJson(JsonObject out, const char* name);
+
+#endif // MODBUS_MASTER_H
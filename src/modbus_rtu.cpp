@@ -0,0 +1,151 @@
+#include "modbus_rtu.h"
+#include <string.h>
+
+// CRC-16/MODBUS (polynôme 0xA001 réfléchi), une table de 256 mots en flash.
+// Calculé sur la trame reçue elle-même : CRC compris, le résultat vaut 0.
+static const uint16_t crcTable[256] = {
+  0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241, 0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+  0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40, 0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+  0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40, 0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+  0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641, 0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+  0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240, 0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+  0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41, 0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+  0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41, 0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+  0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640, 0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+  0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240, 0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+  0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41, 0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+  0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41, 0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+  0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640, 0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+  0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241, 0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+  0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40, 0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+  0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40, 0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+  0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641, 0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+};
+
+uint16_t modbusCrc16(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc = (crc >> 8) ^ crcTable[(crc ^ data[i]) & 0xFF];
+  }
+  return crc;
+}
+
+static bool isBitFunction(uint8_t function) {
+  return function == MODBUS_READ_COILS || function == MODBUS_READ_DISCRETE_INPUTS;
+}
+
+uint16_t modbusRegisterWidth(const ModbusRegister& r) {
+  if (isBitFunction(r.function)) return 1;
+  return r.type == MODBUS_TYPE_U32 || r.type == MODBUS_TYPE_S32 || r.type == MODBUS_TYPE_F32 ? 2 : 1;
+}
+
+size_t modbusBuildRead(uint8_t* frame, uint8_t slave, uint8_t function, uint16_t start, uint16_t count) {
+  frame[0] = slave;
+  frame[1] = function;
+  frame[2] = start >> 8;
+  frame[3] = start & 0xFF;
+  frame[4] = count >> 8;
+  frame[5] = count & 0xFF;
+  uint16_t crc = modbusCrc16(frame, 6);
+  frame[6] = crc & 0xFF;   // CRC : octet de poids faible en premier
+  frame[7] = crc >> 8;
+  return 8;
+}
+
+size_t modbusResponseLength(uint8_t function, uint16_t count) {
+  size_t data = isBitFunction(function) ? (count + 7) / 8 : 2 * (size_t)count;
+  return 3 + data + 2;
+}
+
+ModbusResult modbusCheckResponse(const uint8_t* frame, size_t length, uint8_t slave, uint8_t function,
+                                 uint16_t count, uint8_t* exception) {
+  if (length < 5) return MODBUS_BAD_FRAME;
+  if (modbusCrc16(frame, length) != 0) return MODBUS_CRC_ERROR;
+  if (frame[0] != slave) return MODBUS_BAD_FRAME;
+  if (frame[1] == (function | 0x80) && length == 5) {
+    *exception = frame[2];
+    return MODBUS_EXCEPTION;
+  }
+  if (frame[1] != function || length != modbusResponseLength(function, count) || frame[2] != length - 5) {
+    return MODBUS_BAD_FRAME;
+  }
+  return MODBUS_OK;
+}
+
+// Ordre de tri : esclave, fonction, adresse
+static bool sortsBefore(const ModbusRegister& a, const ModbusRegister& b) {
+  if (a.slave != b.slave) return a.slave < b.slave;
+  if (a.function != b.function) return a.function < b.function;
+  return a.address < b.address;
+}
+
+int modbusPlanGroups(const ModbusRegister* regs, int count, uint16_t maxGap,
+                     ModbusGroup* groups, int maxGroups, uint8_t* order) {
+  // Tri par insertion : quelques dizaines d'entrées, fait au chargement de la table
+  for (int i = 0; i < count; i++) {
+    int j = i;
+    while (j > 0 && sortsBefore(regs[i], regs[order[j - 1]])) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  int groupCount = 0;
+  ModbusGroup* g = NULL;
+  for (int k = 0; k < count; k++) {
+    const ModbusRegister& r = regs[order[k]];
+    bool bits = isBitFunction(r.function);
+    uint32_t limit = bits ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS;
+    uint32_t gap = bits ? (uint32_t)maxGap * 16 : maxGap;
+    uint32_t end = (uint32_t)r.address + modbusRegisterWidth(r);
+
+    if (g && g->slave == r.slave && g->function == r.function &&
+        r.address <= (uint32_t)g->start + g->count + gap && end - g->start <= limit) {
+      if (end - g->start > g->count) g->count = end - g->start;
+      if (r.intervalMs < g->intervalMs) g->intervalMs = r.intervalMs;
+      g->members++;
+      continue;
+    }
+    if (groupCount >= maxGroups) break;
+    g = &groups[groupCount++];
+    g->slave = r.slave;
+    g->function = r.function;
+    g->start = r.address;
+    g->count = end - r.address;
+    g->intervalMs = r.intervalMs;
+    g->first = k;
+    g->members = 1;
+  }
+  return groupCount;
+}
+
+void modbusDecode(const ModbusRegister& r, const ModbusGroup& g, const uint8_t* data,
+                  uint32_t* raw, float* value) {
+  uint16_t offset = r.address - g.start;
+  if (isBitFunction(g.function)) {
+    *raw = (data[offset / 8] >> (offset % 8)) & 1;
+    *value = *raw;
+    return;
+  }
+  const uint8_t* p = data + 2 * offset;
+  uint16_t w0 = (p[0] << 8) | p[1];
+  uint32_t v32 = 0;
+  if (modbusRegisterWidth(r) == 2) {
+    uint16_t w1 = (p[2] << 8) | p[3];
+    v32 = r.swapWords ? ((uint32_t)w1 << 16) | w0 : ((uint32_t)w0 << 16) | w1;
+  }
+  float v;
+  switch (r.type) {
+    case MODBUS_TYPE_S16: *raw = w0; v = (int16_t)w0; break;
+    case MODBUS_TYPE_U32: *raw = v32; v = v32; break;
+    case MODBUS_TYPE_S32: *raw = v32; v = (int32_t)v32; break;
+    case MODBUS_TYPE_F32: *raw = v32; memcpy(&v, &v32, sizeof(v)); break;
+    case MODBUS_TYPE_BOOL:
+      *raw = w0 != 0;
+      *value = *raw;
+      return;
+    default: *raw = w0; v = w0; break;
+  }
+  *value = v * r.scale + r.offset;
+}
@@ -0,0 +1,88 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ===== MODBUS RTU : TRAMES ET PLAN DE SCRUTATION =====
+// Sans dépendance matérielle (comme clock_model.h) : modbus_master.cpp s'en sert
+// sur la carte, et le tout se compile sur PC pour vérifier trames et regroupements.
+
+#define MODBUS_MAX_READ_REGISTERS 125   // Limites du protocole pour une lecture (FC 3/4, FC 1/2)
+#define MODBUS_MAX_READ_BITS      2000
+#define MODBUS_MAX_FRAME          256
+
+enum ModbusFunction : uint8_t {
+  MODBUS_READ_COILS = 1,
+  MODBUS_READ_DISCRETE_INPUTS = 2,
+  MODBUS_READ_HOLDING_REGISTERS = 3,
+  MODBUS_READ_INPUT_REGISTERS = 4
+};
+
+enum ModbusValueType : uint8_t {
+  MODBUS_TYPE_U16 = 0,
+  MODBUS_TYPE_S16,
+  MODBUS_TYPE_U32,         // 2 registres
+  MODBUS_TYPE_S32,
+  MODBUS_TYPE_F32,         // IEEE 754
+  MODBUS_TYPE_BOOL,        // Bit (FC 1/2) ou registre non nul (FC 3/4)
+  MODBUS_TYPE_COUNT
+};
+
+enum ModbusResult : uint8_t {
+  MODBUS_OK = 0,
+  MODBUS_TIMEOUT,          // Pas de réponse (ou incomplète) dans le délai
+  MODBUS_CRC_ERROR,
+  MODBUS_BAD_FRAME,        // Esclave, fonction ou longueur inattendus
+  MODBUS_EXCEPTION         // Réponse d'exception de l'esclave (code à part)
+};
+
+// Entrée de la table de registres, persistée telle quelle en NVS
+struct ModbusRegister {
+  char name[24];           // Topic <device>/modbus/<name>
+  uint8_t slave;           // 1..247
+  uint8_t function;        // ModbusFunction
+  uint16_t address;        // Adresse protocolaire (0 = premier registre)
+  uint8_t type;            // ModbusValueType
+  uint8_t swapWords;       // 32 bits : mot de poids faible en premier
+  uint16_t reserved;
+  float scale;             // Valeur publiée = brute * scale + offset
+  float offset;
+  float deadband;          // Variation minimale pour publier (0 = toute variation)
+  uint32_t intervalMs;     // Période de scrutation
+  char unit[8];
+};
+
+// Lecture regroupant des registres voisins d'un même esclave et d'une même fonction
+struct ModbusGroup {
+  uint8_t slave;
+  uint8_t function;
+  uint16_t start;
+  uint16_t count;          // Registres (FC 3/4) ou bits (FC 1/2)
+  uint32_t intervalMs;     // Plus petit intervalle des membres
+  uint8_t first;           // Membres : order[first .. first + members)
+  uint8_t members;
+};
+
+uint16_t modbusCrc16(const uint8_t* data, size_t length);
+uint16_t modbusRegisterWidth(const ModbusRegister& r);   // Registres ou bits occupés
+
+// Requête de lecture FC 1..4 (8 octets, CRC compris)
+size_t modbusBuildRead(uint8_t* frame, uint8_t slave, uint8_t function, uint16_t start, uint16_t count);
+// Longueur d'une réponse normale, CRC compris
+size_t modbusResponseLength(uint8_t function, uint16_t count);
+// Contrôle d'une réponse reçue, CRC calculé sur place. *exception : code de l'esclave.
+ModbusResult modbusCheckResponse(const uint8_t* frame, size_t length, uint8_t slave, uint8_t function,
+                                 uint16_t count, uint8_t* exception);
+
+// Trie les entrées (esclave, fonction, adresse) dans order[] et fusionne les voisines
+// en lectures : au plus maxGap registres inutilisés entre deux entrées (16x plus de bits),
+// dans les limites du protocole. Retourne le nombre de groupes.
+int modbusPlanGroups(const ModbusRegister* regs, int count, uint16_t maxGap,
+                     ModbusGroup* groups, int maxGroups, uint8_t* order);
+
+// Valeur d'une entrée à partir des données d'une réponse (après l'octet de longueur)
+void modbusDecode(const ModbusRegister& r, const ModbusGroup& g, const uint8_t* data,
+                  uint32_t* raw, float* value);
+
+#endif // MODBUS_RTU_H
@@ -0,0 +1,368 @@
+#include "modbus_tcp.h"
+#include "io_table.h"
+#include "io_command.h"
+#include "time_sync.h"
+#include "alloc_audit.h"
+#include "log_task.h"
+#include <lwip/sockets.h>
+#include <esp_timer.h>
+
+extern Config config;
+
+#define MBAP_HEADER      7                 // Transaction, protocole, longueur, unité
+#define MODBUS_TCP_FRAME (MBAP_HEADER + 253)
+#define PIN_ADDRESSES    256               // Adresses = numéros de broche (pinIndex[])
+
+enum : uint8_t {
+  FC_READ_COILS = 1, FC_READ_DISCRETE_INPUTS = 2, FC_WRITE_SINGLE_COIL = 5, FC_WRITE_MULTIPLE_COILS = 15,
+};
+enum : uint8_t {
+  EX_ILLEGAL_FUNCTION = 1, EX_ILLEGAL_ADDRESS = 2, EX_ILLEGAL_VALUE = 3, EX_DEVICE_FAILURE = 4, EX_BUSY = 6,
+};
+
+struct ModbusTcpClient {
+  int socket;
+  uint8_t rx[MODBUS_TCP_FRAME];            // Trames reçues, éventuellement plusieurs (pipeline)
+  size_t rxLength;
+  int64_t lastRequestUs;
+  uint32_t requests;
+  char peer[16];
+};
+
+static TaskHandle_t serverTaskHandle = NULL;
+static int listenSocket = -1;
+static ModbusTcpClient clients[MODBUS_TCP_MAX_CLIENTS];
+static uint8_t tx[MODBUS_TCP_FRAME];
+static IoCommand batch[IO_BATCH_MAX_OPS];  // FC 15 : un lot, dans l'ordre des adresses
+
+static struct ModbusTcpStats {
+  uint32_t connections = 0;
+  uint32_t rejected = 0;                   // Plus de place
+  uint32_t idleClosed = 0;
+  uint32_t badFrames = 0;                  // En-tête MBAP invalide : connexion fermée
+  uint32_t requests = 0;
+  uint32_t reads = 0;
+  uint32_t writes = 0;
+  uint32_t exceptions = 0;
+  uint32_t busy = 0;                       // File de commandes pleine (exception 06)
+  uint32_t serviceMinUs = UINT32_MAX;      // Trame complète -> réponse remise au socket
+  uint32_t serviceMaxUs = 0;
+  uint64_t serviceTotalUs = 0;
+} stats;
+
+static inline uint16_t readU16(const uint8_t* p) {
+  return (p[0] << 8) | p[1];
+}
+
+// ===== FONCTIONS =====
+// pdu : code fonction puis données ; la réponse est écrite dans out (code fonction
+// compris). Retourne sa longueur, ou 0 avec *exception renseignée.
+
+static size_t readBits(const uint8_t* pdu, size_t length, uint8_t mode, uint8_t* out, uint8_t* exception) {
+  if (length != 5) { *exception = EX_ILLEGAL_VALUE; return 0; }
+  uint16_t start = readU16(pdu + 1);
+  uint16_t count = readU16(pdu + 3);
+  if (count < 1 || count > 2000) { *exception = EX_ILLEGAL_VALUE; return 0; }
+  if ((uint32_t)start + count > PIN_ADDRESSES) { *exception = EX_ILLEGAL_ADDRESS; return 0; }
+
+  uint8_t bytes = (count + 7) / 8;
+  out[0] = pdu[0];
+  out[1] = bytes;
+  memset(out + 2, 0, bytes);
+  IoSnapshot table;
+  for (uint16_t i = 0; i < count; i++) {
+    uint8_t index = table->pinIndex[start + i];
+    if (index != IO_INDEX_NONE && table->mode[index] == mode && ioState(*table, index)) {
+      out[2 + i / 8] |= 1 << (i % 8);
+    }
+  }
+  stats.reads++;
+  return 2 + bytes;
+}
+
+static size_t writeSingleCoil(const uint8_t* pdu, size_t length, uint8_t* out, uint8_t* exception) {
+  if (length != 5) { *exception = EX_ILLEGAL_VALUE; return 0; }
+  uint16_t address = readU16(pdu + 1);
+  uint16_t value = readU16(pdu + 3);
+  if (value != 0xFF00 && value != 0x0000) { *exception = EX_ILLEGAL_VALUE; return 0; }
+  if (address >= PIN_ADDRESSES) { *exception = EX_ILLEGAL_ADDRESS; return 0; }
+  {
+    IoSnapshot table;
+    uint8_t index = table->pinIndex[address];
+    if (index == IO_INDEX_NONE || table->mode[index] != 2) { *exception = EX_ILLEGAL_ADDRESS; return 0; }
+  }
+  if (!submitIoCommand(address, value ? 1 : 0, 0, 0, NULL, getCurrentTimeMicros())) {
+    stats.busy++;
+    *exception = EX_BUSY;
+    return 0;
+  }
+  stats.writes++;
+  memcpy(out, pdu, 5);   // Réponse = requête
+  return 5;
+}
+
+static size_t writeMultipleCoils(const uint8_t* pdu, size_t length, uint8_t* out, uint8_t* exception) {
+  if (length < 6) { *exception = EX_ILLEGAL_VALUE; return 0; }
+  uint16_t start = readU16(pdu + 1);
+  uint16_t count = readU16(pdu + 3);
+  uint8_t bytes = pdu[5];
+  if (count < 1 || count > 1968 || bytes != (count + 7) / 8 || length != 6u + bytes) {
+    *exception = EX_ILLEGAL_VALUE;
+    return 0;
+  }
+  if ((uint32_t)start + count > PIN_ADDRESSES) { *exception = EX_ILLEGAL_ADDRESS; return 0; }
+  // Un lot tient dans la file de commandes (comme /api/io/batch)
+  if (count > IO_BATCH_MAX_OPS) { *exception = EX_ILLEGAL_VALUE; return 0; }
+
+  uint64_t receivedUs = getCurrentTimeMicros();
+  {
+    // Tout ou rien : une adresse qui n'est pas une sortie refuse la requête entière
+    IoSnapshot table;
+    for (uint16_t i = 0; i < count; i++) {
+      uint8_t index = table->pinIndex[start + i];
+      if (index == IO_INDEX_NONE || table->mode[index] != 2) { *exception = EX_ILLEGAL_ADDRESS; return 0; }
+      IoCommand& command = batch[i];
+      command.pin = start + i;
+      command.state = (pdu[6 + i / 8] >> (i % 8)) & 1;
+      command.exec_at_sec = 0;
+      command.exec_at_us = 0;
+      command.received_us = receivedUs;
+      command.id[0] = '\0';
+    }
+  }
+  int submitted = submitIoBatch(batch, count);
+  if (submitted != count) {
+    stats.busy++;
+    // Rien de parti : le maître peut réessayer ; une partie déjà partie : échec franc
+    *exception = submitted == 0 ? EX_BUSY : EX_DEVICE_FAILURE;
+    return 0;
+  }
+  stats.writes++;
+  memcpy(out, pdu, 5);   // Fonction, adresse de départ, quantité
+  return 5;
+}
+
+// Une trame complète : réponse (MBAP recopié, longueur recalculée) dans tx[]
+static size_t handleRequest(const uint8_t* frame, size_t pduLength) {
+  const uint8_t* pdu = frame + MBAP_HEADER;
+  uint8_t* out = tx + MBAP_HEADER;
+  uint8_t exception = EX_ILLEGAL_FUNCTION;
+  size_t length = 0;
+  switch (pdu[0]) {
+    case FC_READ_COILS:           length = readBits(pdu, pduLength, 2, out, &exception); break;
+    case FC_READ_DISCRETE_INPUTS: length = readBits(pdu, pduLength, 1, out, &exception); break;
+    case FC_WRITE_SINGLE_COIL:    length = writeSingleCoil(pdu, pduLength, out, &exception); break;
+    case FC_WRITE_MULTIPLE_COILS: length = writeMultipleCoils(pdu, pduLength, out, &exception); break;
+  }
+  if (length == 0) {
+    out[0] = pdu[0] | 0x80;
+    out[1] = exception;
+    length = 2;
+    stats.exceptions++;
+  }
+  memcpy(tx, frame, 4);                  // Transaction et protocole
+  tx[4] = (length + 1) >> 8;
+  tx[5] = (length + 1) & 0xFF;
+  tx[6] = frame[6];                      // Unité
+  return MBAP_HEADER + length;
+}
+
+// ===== CONNEXIONS =====
+
+static void closeClient(ModbusTcpClient& client, const char* reason) {
+  {
+    AllocAuditExempt exempt;
+    closesocket(client.socket);
+  }
+  client.socket = -1;
+  logPrintf("🔌 Modbus TCP client %s disconnected (%s, %lu requests)\n", client.peer, reason,
+            (unsigned long)client.requests);
+}
+
+static void acceptClient() {
+  struct sockaddr_in peer;
+  socklen_t peerLength = sizeof(peer);
+  int s;
+  {
+    AllocAuditExempt exempt;
+    s = accept(listenSocket, (struct sockaddr*)&peer, &peerLength);
+  }
+  if (s < 0) return;
+
+  ModbusTcpClient* client = NULL;
+  for (int i = 0; i < MODBUS_TCP_MAX_CLIENTS && !client; i++) {
+    if (clients[i].socket < 0) client = &clients[i];
+  }
+  if (!client) {
+    AllocAuditExempt exempt;
+    closesocket(s);
+    stats.rejected++;
+    return;
+  }
+
+  int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+  fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+  client->socket = s;
+  client->rxLength = 0;
+  client->requests = 0;
+  client->lastRequestUs = esp_timer_get_time();
+  inet_ntop(AF_INET, &peer.sin_addr, client->peer, sizeof(client->peer));
+  stats.connections++;
+  logPrintf("🔌 Modbus TCP client %s connected\n", client->peer);
+}
+
+// Lit ce qui est arrivé et répond à chaque trame complète, dans l'ordre
+static void serviceClient(ModbusTcpClient& client) {
+  int received;
+  {
+    AllocAuditExempt exempt;
+    received = recv(client.socket, client.rx + client.rxLength, sizeof(client.rx) - client.rxLength, MSG_DONTWAIT);
+  }
+  if (received == 0) {
+    closeClient(client, "closed");
+    return;
+  }
+  if (received < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) closeClient(client, "error");
+    return;
+  }
+  client.rxLength += received;
+
+  size_t offset = 0;
+  while (client.rxLength - offset >= MBAP_HEADER) {
+    const uint8_t* frame = client.rx + offset;
+    uint16_t protocol = readU16(frame + 2);
+    uint16_t length = readU16(frame + 4);   // Unité + PDU
+    if (protocol != 0 || length < 2 || length > 254) {
+      // Plus de synchronisation possible sur le flux
+      stats.badFrames++;
+      closeClient(client, "bad frame");
+      return;
+    }
+    size_t frameLength = 6 + length;
+    if (client.rxLength - offset < frameLength) break;
+
+    int64_t start = esp_timer_get_time();
+    size_t responseLength = handleRequest(frame, length - 1);
+    int sent;
+    {
+      AllocAuditExempt exempt;
+      sent = send(client.socket, tx, responseLength, MSG_DONTWAIT);
+    }
+    if (sent != (int)responseLength) {
+      // Réponse de quelques octets refusée : le maître ne lit plus ses réponses
+      closeClient(client, "send");
+      return;
+    }
+    int64_t now = esp_timer_get_time();
+    uint32_t serviceUs = (uint32_t)(now - start);
+    if (serviceUs < stats.serviceMinUs) stats.serviceMinUs = serviceUs;
+    if (serviceUs > stats.serviceMaxUs) stats.serviceMaxUs = serviceUs;
+    stats.serviceTotalUs += serviceUs;
+    stats.requests++;
+    client.requests++;
+    client.lastRequestUs = now;
+    offset += frameLength;
+  }
+  if (offset > 0) {
+    memmove(client.rx, client.rx + offset, client.rxLength - offset);
+    client.rxLength -= offset;
+  }
+}
+
+static void modbusTcpTask(void* pvParameters) {
+  Serial.println("✅ Modbus TCP server task started.");
+  allocAuditRegisterTask();
+  for (;;) {
+    // Réveillée par une connexion ou une requête ; au plus toutes les secondes
+    // pour fermer les connexions inactives
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(listenSocket, &readable);
+    int highest = listenSocket;
+    for (int i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) {
+      if (clients[i].socket < 0) continue;
+      FD_SET(clients[i].socket, &readable);
+      highest = max(highest, clients[i].socket);
+    }
+    struct timeval tv = { 1, 0 };
+    int ready = select(highest + 1, &readable, NULL, NULL, &tv);
+
+    if (ready > 0) {
+      for (int i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) {
+        if (clients[i].socket >= 0 && FD_ISSET(clients[i].socket, &readable)) serviceClient(clients[i]);
+      }
+      if (FD_ISSET(listenSocket, &readable)) acceptClient();
+    }
+
+    // Maître disparu sans FIN, ou qui garde sa connexion sans s'en servir
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) {
+      if (clients[i].socket >= 0 && now - clients[i].lastRequestUs > (int64_t)MODBUS_TCP_IDLE_TIMEOUT_MS * 1000) {
+        stats.idleClosed++;
+        closeClient(clients[i], "idle");
+      }
+    }
+    allocAuditIteration();
+  }
+}
+
+void setupModbusTcp() {
+  if (!config.useModbusTcp || serverTaskHandle) return;
+  for (int i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) clients[i].socket = -1;
+
+  listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+  if (listenSocket < 0) {
+    Serial.println("✗ Modbus TCP server: socket failed");
+    return;
+  }
+  int one = 1;
+  setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(config.modbusTcpPort);
+  if (bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(listenSocket, MODBUS_TCP_MAX_CLIENTS) != 0) {
+    Serial.printf("✗ Modbus TCP server: port %d unavailable\n", config.modbusTcpPort);
+    closesocket(listenSocket);
+    listenSocket = -1;
+    return;
+  }
+  fcntl(listenSocket, F_SETFL, fcntl(listenSocket, F_GETFL, 0) | O_NONBLOCK);
+
+  xTaskCreatePinnedToCore(modbusTcpTask, "ModbusTcpTask", MODBUS_TCP_STACK_SIZE, NULL,
+                          MODBUS_TCP_TASK_PRIORITY, &serverTaskHandle, SERVICE_TASK_CORE);
+  Serial.printf("✓ Modbus TCP server on port %d (%d clients)\n", config.modbusTcpPort, MODBUS_TCP_MAX_CLIENTS);
+}
+
+void modbusTcpStatsToJson(JsonObject out) {
+  out["enabled"] = config.useModbusTcp && serverTaskHandle != NULL;
+  out["port"] = config.modbusTcpPort;
+  out["maxClients"] = MODBUS_TCP_MAX_CLIENTS;
+  JsonArray connected = out["clients"].to<JsonArray>();
+  int64_t now = esp_timer_get_time();
+  for (int i = 0; i < MODBUS_TCP_MAX_CLIENTS; i++) {
+    if (!serverTaskHandle || clients[i].socket < 0) continue;
+    JsonObject client = connected.add<JsonObject>();
+    client["address"] = clients[i].peer;
+    client["requests"] = clients[i].requests;
+    client["idleMs"] = (uint32_t)((now - clients[i].lastRequestUs) / 1000);
+  }
+  out["connections"] = stats.connections;
+  out["rejected"] = stats.rejected;
+  out["idleClosed"] = stats.idleClosed;
+  out["badFrames"] = stats.badFrames;
+  out["requests"] = stats.requests;
+  out["reads"] = stats.reads;
+  out["writes"] = stats.writes;
+  out["exceptions"] = stats.exceptions;
+  out["busy"] = stats.busy;
+  JsonObject service = out["serviceUs"].to<JsonObject>();
+  service["min"] = stats.requests ? stats.serviceMinUs : 0;
+  service["avg"] = stats.requests ? (uint32_t)(stats.serviceTotalUs / stats.requests) : 0;
+  service["max"] = stats.serviceMaxUs;
+}
@@ -0,0 +1,27 @@
+#ifndef MODBUS_TCP_H
+#define MODBUS_TCP_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== SERVEUR MODBUS TCP =====
+// Les automates et la supervision interrogent les I/O sans broker (port modbusTcpPort,
+// 502 par défaut), jusqu'à MODBUS_TCP_MAX_CLIENTS maîtres à la fois. L'adresse d'un
+// coil ou d'une entrée TOR est le numéro de broche (GPIO 0..39, extensions 64+) :
+//   FC 1  lecture des coils            sorties (mode 2)
+//   FC 2  lecture des entrées TOR      entrées (mode 1)
+//   FC 5  écriture d'un coil
+//   FC 15 écriture de plusieurs coils  (au plus IO_BATCH_MAX_OPS sorties)
+//
+// Les lectures viennent d'un instantané de la table d'I/O (io_table.h), sans attendre
+// la tâche temps réel ; une adresse sans I/O du bon mode se lit 0. Les écritures
+// passent par la file de commandes comme MQTT et /api/io/set (FC 15 en un seul lot,
+// appliqué dans un même tour) : la réponse part dès la mise en file. Écrire une
+// adresse qui n'est pas une sortie donne l'exception 02, file pleine l'exception 06.
+// L'identifiant d'unité n'est pas vérifié : il est renvoyé tel quel.
+
+void setupModbusTcp();                       // Tâche serveur (après l'initialisation du réseau)
+void modbusTcpStatsToJson(JsonObject out);
+
+#endif // MODBUS_TCP_H
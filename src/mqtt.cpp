@@ -1,23 +1,94 @@
 #include <Arduino.h>
-#include <PubSubClient.h>
 #include "mqtt.h"
+#include "mqtt_scheduler.h"
 #include "serial_manager.h"
+#include "modbus_master.h"
+#include "time_sync.h"
+#include "io_table.h"
+#include "io_command.h"
+#include "log_task.h"
+#include "json_arena.h"
+#include "alloc_audit.h"
+#include "state_sync.h"
 #include <ArduinoJson.h>
 #include <time.h>
 #include <sys/time.h>
 
 #include <WiFi.h>
 
-// define the network client and the MQTT client here (single place)
-WiFiClient wifiClient;
-PubSubClient mqttClient(wifiClient);
+// Client MQTT asynchrone (esp-mqtt) : connexion, lecture et envoi dans sa propre tâche
+static esp_mqtt_client_handle_t mqttClient = NULL;
 // MQTT active flag (default disabled so web server can be debugged first)
 bool mqttEnabled = false;
 
-// Variables pour synchronisation temporelle précise
-static uint32_t lastSyncSeconds = 0;
-static uint32_t lastSyncMicros = 0;  // micros() au moment de la sync
-static uint32_t timeOffsetUs = 0;    // Offset en microsecondes
+// Machine d'état de la liaison (écrite par la tâche MQTT et par loop())
+static volatile MqttLinkState linkState = MQTT_LINK_IDLE;
+static volatile unsigned long nextAttemptAt = 0;
+
+// Le client est configuré avec un délai de reconnexion "parqué" : après une
+// déconnexion, la tâche MQTT attend que mqttLoop() appelle esp_mqtt_client_reconnect()
+// au moment choisi, au lieu de se reconnecter seule.
+static const int MQTT_RECONNECT_PARKED_MS = 24 * 3600 * 1000;
+
+// Tâche esp-mqtt (relevée à son premier événement) : seule autorisée à écrire sur le socket
+static TaskHandle_t mqttTaskHandle = NULL;
+// Republication des états après (re)connexion, par lots dans la file "state".
+// Curseur et files appartiennent à la tâche réseau (mqttLoop()) : la tâche MQTT ne
+// fait que poser des événements de liaison, lus et remis à zéro en un échange atomique.
+#define LINK_EVENT_DISCARD   0x01   // Déconnexion : vider les files, arrêter la republication
+#define LINK_EVENT_REPUBLISH 0x02   // Connexion : republier tous les états
+static uint8_t linkEvents = 0;
+static int republishIndex = -1;
+static uint32_t republishGeneration = 0;   // Table d'I/O en cours de republication
+
+static char mqttClientId[32];
+static char mqttLwtTopic[96];
+
+// Backoff exponentiel : MQTT_BACKOFF_MIN_MS * 2^n plafonné à MQTT_BACKOFF_MAX_MS,
+// avec une gigue de ±50 % pour que toute une flotte ne se reconnecte pas en même temps.
+static uint8_t consecutiveFailures = 0;
+
+// Bornes supérieures des classes de l'histogramme des durées de coupure
+static const unsigned long MQTT_DOWNTIME_BOUNDS_MS[MQTT_DOWNTIME_BUCKETS - 1] = {
+    1000, 5000, 30000, 120000, 600000
+};
+static const char* const MQTT_DOWNTIME_LABELS[MQTT_DOWNTIME_BUCKETS] = {
+    "lt_1s", "lt_5s", "lt_30s", "lt_2min", "lt_10min", "ge_10min"
+};
+
+// Statistiques de connexion (écrites par la tâche MQTT, lues par le web et loop())
+static struct MqttLinkStats {
+    uint32_t connects = 0;
+    uint32_t disconnects = 0;
+    uint32_t failedAttempts = 0;
+    uint32_t sessionResumes = 0;
+    unsigned long lastConnectedAt = 0;
+    unsigned long downSince = 0;        // 0 = liaison établie (ou jamais tentée)
+    unsigned long totalDowntimeMs = 0;
+    unsigned long longestDowntimeMs = 0;
+    uint32_t downtimeHistogram[MQTT_DOWNTIME_BUCKETS] = {};
+    float instability = 0;              // Déconnexions récentes, décroissance exponentielle
+    unsigned long instabilityUpdatedAt = 0;
+} mqttStats;
+
+static unsigned long lastStatsPublish = 0;
+
+// Groupes de diffusion auxquels appartient l'appareil (config.groups)
+static char groupNames[MAX_GROUPS][16];
+static int groupCount = 0;
+// Premier abonnement depuis le boot : toujours envoyé, même si le broker a gardé
+// la session (la liste des groupes ou le pont série ont pu changer entre-temps)
+static bool subscribedSinceBoot = false;
+
+static void publishMqttStats();
+static volatile bool statsPublishRequested = false;   // Posé par la tâche MQTT, servi par mqttLoop()
+
+// Tampon de réassemblage des messages entrants fragmentés (taille = config.mqttBufferSize)
+static char* rxBuffer = NULL;
+static size_t rxBufferSize = 0;
+static char rxTopic[128];
+static size_t rxTotalLength = 0;
+static bool rxDropping = false;
 
 // Statistiques de synchronisation (simplifiées - juste pour affichage)
 struct SyncStats {
@@ -26,78 +97,214 @@ struct SyncStats {
     uint32_t last_sync_timestamp = 0;
 } syncStats;
 
-// Obtenir le temps actuel avec précision microseconde
-uint64_t getCurrentTimeMicros() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
-}
-
 // MQTT callback and helpers moved out of main.cpp
 
-// Helper to get current time as string
-String getFormattedTime() {
-  char timeStr[20];
+// Helper to get current time as string (dans le tampon de l'appelant)
+static const char* formatLogTime(char* buffer, size_t size) {
   time_t now = time(nullptr);
-  strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-  return String(timeStr);
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &timeinfo);
+  return buffer;
 }
 
-void executeCommand(int pin, int state) {
-  digitalWrite(pin, state);
-  for (int i = 0; i < ioPinCount; i++) {
-    if (ioPins[i].pin == pin) {
-      ioPins[i].state = state;
-      break;
-    }
+uint64_t executeCommand(int pin, int state) {
+  // Tâche temps réel : la table active ne change pas sous ses pieds
+  const IoTable& table = ioTableActive();
+  int index = ioIndexByPin(table, pin);
+  if (index < 0) {
+    // Broche non configurée : écriture directe, pas de publication
+    if (pin < IO_NATIVE_PIN_COUNT) digitalWrite(pin, state);
+    return getCurrentTimeMicros();
   }
+  bool changed = ioWrite(index, state);
+  // Horodatage pris juste après l'écriture du registre GPIO (sur un expander,
+  // la transaction I2C/SPI part au prochain expanderFlush())
+  uint64_t timeUs = getCurrentTimeMicros();
 
   // Publish status
   char topic[128];
-  int pinIndex = -1;
-  for(int i=0; i<ioPinCount; i++) {
-    if(ioPins[i].pin == pin) {
-      pinIndex = i;
-      break;
-    }
+  snprintf(topic, sizeof(topic), "%s/status/%s", config.deviceName, table.pins[index].name);
+
+  uint32_t seconds = timeUs / 1000000ULL;
+  uint32_t us = timeUs % 1000000ULL;   // Microsecondes
+
+  // Tâche temps réel : formaté directement, sans document JSON
+  char payload[64];
+  snprintf(payload, sizeof(payload), "{\"state\":%d,\"timestamp\":%u,\"us\":%u}", state, seconds, us);
+
+  if (mqttEnabled && mqttConnected()) {
+    publishMQTT(topic, payload, false, 1);
   }
-  if(pinIndex != -1) {
-    snprintf(topic, sizeof(topic), "%s/status/%s", config.deviceName, ioPins[pinIndex].name);
-    
-    // Obtenir le temps avec précision microseconde
-    uint64_t timeUs = getCurrentTimeMicros();
-    uint32_t seconds = timeUs / 1000000ULL;
-    uint32_t us = timeUs % 1000000ULL;
-    
-    JsonDocument doc;
-    doc["state"] = state;
-    doc["timestamp"] = seconds;
-    doc["us"] = us;  // Microsecondes
-    
-    char payload[128];
-    serializeJson(doc, payload);
+  if (changed) stateSyncPublishDelta(table, index, state, timeUs);
+  return timeUs;
+}
+
+void publishCommandAck(const char* id, int pin, int state, const char* result,
+                       uint64_t receivedUs, uint64_t scheduledUs, uint64_t executedUs) {
+    if (id == NULL || id[0] == '\0' || !mqttEnabled || !mqttConnected()) return;
+
+    const IoTable& table = ioTableActive();
+    int index = ioIndexByPin(table, pin);
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/ack", config.deviceName);
+
+    // Retard : par rapport à exec_at pour une commande programmée, à la réception sinon
+    uint64_t referenceUs = scheduledUs > 0 ? scheduledUs : receivedUs;
+    long long latenessUs = executedUs > 0 ? (long long)(executedUs - referenceUs) : 0;
+    char payload[320];
+    snprintf(payload, sizeof(payload),
+             "{\"id\":\"%s\",\"pin\":\"%s\",\"state\":%d,\"result\":\"%s\",\"received_us\":%llu,"
+             "\"scheduled_us\":%llu,\"executed_us\":%llu,\"lateness_us\":%lld,\"time_quality\":\"%s\"}",
+             id, index >= 0 ? table.pins[index].name : "", state, result,
+             (unsigned long long)receivedUs, (unsigned long long)scheduledUs,
+             (unsigned long long)executedUs, latenessUs, timeQualityName(timeQuality()));
+    publishMQTT(topic, payload, false, 1, MQTT_PRIORITY_REALTIME);
+}
 
-    if (mqttEnabled && mqttClient.connected()) {
-      publishMQTT(topic, payload);
+// Découpe config.groups ("ligne1,ligne2") dans groupNames[]
+static void parseGroups() {
+    groupCount = 0;
+    const char* p = config.groups;
+    while (*p && groupCount < MAX_GROUPS) {
+        while (*p == ',' || *p == ' ') p++;
+        size_t len = strcspn(p, ", ");
+        if (len > 0 && len < sizeof(groupNames[0])) {
+            memcpy(groupNames[groupCount], p, len);
+            groupNames[groupCount][len] = '\0';
+            groupCount++;
+        }
+        p += len;
+    }
+}
+
+// Signale une commande programmée refusée ou acceptée avec une horloge dégradée
+static void publishScheduleEvent(int pin, uint32_t exec_at_sec, uint32_t exec_at_us, const char* result) {
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/schedule", config.deviceName);
+    char payload[192];
+    snprintf(payload, sizeof(payload),
+             "{\"pin\":%d,\"exec_at\":%u,\"exec_at_us\":%u,\"result\":\"%s\",\"time_quality\":\"%s\",\"uncertainty_us\":%u}",
+             pin, exec_at_sec, exec_at_us, result, timeQualityName(timeQuality()),
+             timeQuality() == TIME_QUALITY_NONE ? 0 : timeUncertaintyUs());
+    publishMQTT(topic, payload, false, 1, MQTT_PRIORITY_REALTIME);
+}
+
+bool scheduleCommand(int pin, int state, uint32_t exec_at_sec, uint32_t exec_at_us,
+                     const char* id, uint64_t receivedUs) {
+    uint64_t scheduledUs = (uint64_t)exec_at_sec * 1000000ULL + exec_at_us;
+    // exec_at est absolu : sans horloge fiable, l'exécuter n'aurait pas de sens
+    if (!timeScheduleAllowed()) {
+        logPrintf("⚠️ Scheduled command for pin %d rejected: clock quality insufficient\n", pin);
+        publishScheduleEvent(pin, exec_at_sec, exec_at_us, "rejected");
+        publishCommandAck(id, pin, state, "rejected", receivedUs, scheduledUs, 0);
+        return false;
+    }
+    if (timeQuality() == TIME_QUALITY_DEGRADED) {
+        logPrintf("⚠️ Scheduled command for pin %d accepted with degraded clock (±%u us)\n", pin, timeUncertaintyUs());
+        publishScheduleEvent(pin, exec_at_sec, exec_at_us, "degraded");
+    }
+
+    for (int j = 0; j < MAX_SCHEDULED_COMMANDS; j++) {
+        if (!scheduledCommands[j].active) {
+            scheduledCommands[j].pin = pin;
+            scheduledCommands[j].state = state;
+            scheduledCommands[j].exec_at_sec = exec_at_sec;
+            scheduledCommands[j].exec_at_us = exec_at_us;
+            scheduledCommands[j].received_us = receivedUs;
+            strlcpy(scheduledCommands[j].id, id ? id : "", sizeof(scheduledCommands[j].id));
+            scheduledCommands[j].active = true;
+            logPrintf("⏰ Command for pin %d scheduled at %u.%06u\n", pin, exec_at_sec, exec_at_us);
+            return true;
+        }
+    }
+    logPrintf("⚠️ Scheduled command queue is full!\n");
+    publishCommandAck(id, pin, state, "queue_full", receivedUs, scheduledUs, 0);
+    return false;
+}
+
+bool isGroupMember(const char* group, size_t length) {
+    for (int g = 0; g < groupCount; g++) {
+        if (strlen(groupNames[g]) == length && strncmp(groupNames[g], group, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Retourne la longueur du préfixe de contrôle reconnu dans le topic, ou -1 :
+//   <deviceName>/control/   all/control/   group/<g>/control/ (g parmi nos groupes)
+static int controlTopicPrefixLength(const char* topic, bool* broadcast) {
+    size_t nameLen = strlen(config.deviceName);
+    if (strncmp(topic, config.deviceName, nameLen) == 0 && strncmp(topic + nameLen, "/control/", 9) == 0) {
+        *broadcast = false;
+        return nameLen + 9;
+    }
+    *broadcast = true;
+    if (strncmp(topic, "all/control/", 12) == 0) {
+        return 12;
+    }
+    if (strncmp(topic, "group/", 6) == 0) {
+        const char* group = topic + 6;
+        const char* end = strstr(group, "/control/");
+        // Une session persistante peut encore porter l'abonnement d'un ancien groupe
+        if (end != NULL && isGroupMember(group, end - group)) {
+            return (end - topic) + 9;
+        }
+    }
+    return -1;
+}
+
+// <device>/serial/rpc : {"id":"r1","message":"POS?","terminator":"\n","match":"POS *",
+//                        "length":0,"timeout_ms":500,"pipeline":false,"eol":"\r\n"}
+static void handleSerialRpc(const byte* payload, unsigned int length) {
+    JsonDocument doc(&mqttTaskArena);
+    SerialRpcRequest request;
+    memset(&request, 0, sizeof(request));
+    if (deserializeJson(doc, payload, length) != DeserializationError::Ok) {
+        serialManager.rpcReject("", "invalid");
+        return;
+    }
+    strlcpy(request.id, doc["id"] | "", sizeof(request.id));
+    JsonString message = doc["message"];
+    if (message.isNull() || message.size() >= sizeof(request.message)) {
+        serialManager.rpcReject(request.id, "invalid");
+        return;
+    }
+    // Le message peut contenir des octets nuls (\u0000) : copié avec sa longueur
+    memcpy(request.message, message.c_str(), message.size());
+    request.messageLength = message.size();
+    strlcpy(request.eol, doc["eol"] | "\r\n", sizeof(request.eol));
+    const char* terminator = doc["terminator"] | "\n";
+    request.terminator = terminator[0] ? terminator[0] : '\n';
+    strlcpy(request.match, doc["match"] | "", sizeof(request.match));
+    uint32_t expected = doc["length"] | 0;
+    request.length = expected < SERIAL_LINE_LENGTH ? expected : SERIAL_LINE_LENGTH - 1;
+    uint32_t timeoutMs = doc["timeout_ms"] | SERIAL_RPC_DEFAULT_TIMEOUT_MS;
+    request.timeoutMs = timeoutMs < SERIAL_RPC_MAX_TIMEOUT_MS ? timeoutMs : SERIAL_RPC_MAX_TIMEOUT_MS;
+    request.pipeline = doc["pipeline"] | false;
+    if (!serialManager.rpcSubmit(request)) {
+        serialManager.rpcReject(request.id, "queue_full");
     }
-  }
 }
 
 void mqtt_callback(char* topic, byte* payload, unsigned int length) {
-    String topicStr = String(topic);
-    String baseTopic = String(config.deviceName);
+    // Heure de réception pour les accusés, avant tout traitement (log, parsing)
+    uint64_t receivedUs = getCurrentTimeMicros();
+    size_t nameLen = strlen(config.deviceName);
+    // Suffixe après "<deviceName>" si le topic est propre à cet appareil, NULL sinon
+    const char* ownSuffix = strncmp(topic, config.deviceName, nameLen) == 0 ? topic + nameLen : NULL;
 
-    // Convert payload to string for logging and parsing
-    char message[length + 1];
-    memcpy(message, payload, length);
-    message[length] = '\0';
+    // onMqttData() termine le tampon de réassemblage par '\0' : pas de copie sur la pile
+    const char* message = (const char*)payload;
 
-    Serial.printf("[%s] MQTT message arrived on topic [%s]: %s\n", getFormattedTime().c_str(), topic, message);
+    char when[20];
+    logPrintf("[%s] MQTT message arrived on topic [%s]: %s\n", formatLogTime(when, sizeof(when)), topic, message);
 
     // Handle time synchronization first, as it's a critical service
     // Le topic de temps est commun à tous les appareils
-    if (topicStr.equals("esp32/time/sync")) {
-        JsonDocument doc;
+    if (strcmp(topic, "esp32/time/sync") == 0) {
+        JsonDocument doc(&mqttTaskArena);
         DeserializationError error = deserializeJson(doc, payload, length);
         
         if (!error && doc["seconds"].is<uint32_t>()) {
@@ -107,11 +314,10 @@ void mqtt_callback(char* topic, byte* payload, unsigned int length) {
             // Lire la compensation pour NOTRE device (si disponible)
             if (doc["compensations"].is<JsonObject>()) {
                 JsonObject compensations = doc["compensations"];
-                String deviceName = String(config.deviceName);
                 
                 // Utiliser la méthode moderne is<T>() au lieu de containsKey (deprecated)
-                if (compensations[deviceName].is<uint32_t>()) {
-                    syncStats.estimated_latency_us = compensations[deviceName];
+                if (compensations[config.deviceName].is<uint32_t>()) {
+                    syncStats.estimated_latency_us = compensations[config.deviceName];
                 }
             }
             
@@ -123,214 +329,548 @@ void mqtt_callback(char* topic, byte* payload, unsigned int length) {
                 master_time_us += syncStats.estimated_latency_us;
             }
             
-            // Synchroniser l'horloge
+            // Synchroniser l'horloge (la source MQTT est classée face à SNTP)
+            timeSyncOnMqttSample(master_time_us, syncStats.estimated_latency_us > 0);
             struct timeval tv;
             tv.tv_sec = master_time_us / 1000000ULL;
             tv.tv_usec = master_time_us % 1000000ULL;
-            settimeofday(&tv, NULL);
             
             // Mettre à jour les statistiques
             syncStats.sync_count++;
             syncStats.last_sync_timestamp = master_sec;
-            lastSyncSeconds = master_sec;
-            lastSyncMicros = micros();
             
             // Affichage simplifié
             if (syncStats.sync_count <= 2) {
-                Serial.printf("⏰ Time sync #%u: %u.%06u (initializing)\n", 
-                             syncStats.sync_count, tv.tv_sec, tv.tv_usec);
+                logPrintf("⏰ Time sync #%u: %u.%06u (initializing)\n",
+                          syncStats.sync_count, (unsigned)tv.tv_sec, (unsigned)tv.tv_usec);
+            } else if (syncStats.estimated_latency_us > 0) {
+                logPrintf("⏰ Time sync #%u: %u.%06u | Comp: +%.2f ms\n",
+                          syncStats.sync_count, (unsigned)tv.tv_sec, (unsigned)tv.tv_usec,
+                          syncStats.estimated_latency_us / 1000.0f);
             } else {
-                Serial.printf("⏰ Time sync #%u: %u.%06u", 
-                             syncStats.sync_count, tv.tv_sec, tv.tv_usec);
-                
-                if (syncStats.estimated_latency_us > 0) {
-                    Serial.printf(" | Comp: +%.2f ms", 
-                                 syncStats.estimated_latency_us / 1000.0f);
-                }
-                Serial.println();
+                logPrintf("⏰ Time sync #%u: %u.%06u\n",
+                          syncStats.sync_count, (unsigned)tv.tv_sec, (unsigned)tv.tv_usec);
             }
             
         } else {
             // Ancienne méthode (compatibilité)
             unsigned long unix_time = atol(message);
             if (unix_time > 1000000000) {
-                struct timeval tv;
-                tv.tv_sec = unix_time;
-                tv.tv_usec = 0;
-                settimeofday(&tv, NULL);
-                Serial.printf("Time synchronized: %lu (legacy mode)\n", unix_time);
+                // Résolution d'une seconde : échantillon de faible qualité
+                timeSyncOnMqttSample((uint64_t)unix_time * 1000000ULL, false);
+                logPrintf("Time synchronized: %lu (legacy mode)\n", unix_time);
             }
         }
         return;
     }
     
     // Topic pour mesurer la latence réseau (ping/pong) - géré par le PC
-    if (topicStr.equals(String(config.deviceName) + "/ping")) {
+    if (ownSuffix && strcmp(ownSuffix, "/ping") == 0) {
         // Répondre immédiatement avec pong
         char pongTopic[128];
         snprintf(pongTopic, sizeof(pongTopic), "%s/pong", config.deviceName);
         
         // Renvoyer le payload reçu pour que le PC puisse mesurer le RTT
-        JsonDocument pongDoc;
-        pongDoc["ping_payload"] = String(message);
+        JsonDocument pongDoc(&mqttTaskArena);
+        pongDoc["ping_payload"] = (const char*)message;
         
         char pongPayload[128];
         serializeJson(pongDoc, pongPayload);
-        publishMQTT(pongTopic, pongPayload);
+        // Temps réel : depuis la tâche MQTT, écrit directement sur le socket
+        publishMQTT(pongTopic, pongPayload, false, 0, MQTT_PRIORITY_REALTIME);
+        return;
+    }
+
+    // Demande d'instantané d'état (consommateur arrivé en retard ou saut de version)
+    if (ownSuffix && strcmp(ownSuffix, "/state/get") == 0) {
+        stateSyncRequest();
         return;
     }
 
     // Handle Serial Bridge commands
-    if (topicStr.equals(baseTopic + "/serial/send")) {
+    if (ownSuffix && strcmp(ownSuffix, "/serial/send") == 0) {
         if (config.useSerialBridge) {
-            char message[length + 1];
-            memcpy(message, payload, length);
-            message[length] = '\0';
-            
-            Serial.printf("MQTT to Serial command received: %s\n", message);
-            serialManager.send(String(message));
+            logPrintf("MQTT to Serial command received: %s\n", message);
+            serialManager.send(message, length);
         } else {
             // This case should not happen if not subscribed, but as a safeguard:
-            Serial.println("-> WARNING: Received serial message but bridge is disabled.");
+            logPrintf("-> WARNING: Received serial message but bridge is disabled.\n");
         }
         return;
     }
 
-    // Check if it's a control topic for a pin
-    String controlTopicPrefix = baseTopic + "/control/";
-    if (!topicStr.startsWith(controlTopicPrefix) || !topicStr.endsWith("/set")) {
-        return; // Not a command for us
+    // RPC série : requête corrélée, réponse reconnue par la tâche série
+    if (ownSuffix && strcmp(ownSuffix, "/serial/rpc") == 0) {
+        if (config.useSerialBridge) handleSerialRpc(payload, length);
+        return;
     }
 
-    // Extract pin name
-    String pinName = topicStr.substring(controlTopicPrefix.length(), topicStr.length() - 4);
+    // Modbus : republication depuis le cache (payload = nom de l'entrée, vide = toutes)
+    if (ownSuffix && strcmp(ownSuffix, "/modbus/get") == 0) {
+        if (config.useModbus) modbusRequestPublish(message, length);
+        return;
+    }
 
-    // Find the IO pin by name
-    for (int i = 0; i < ioPinCount; i++) {
-        if (String(ioPins[i].name) == pinName) {
-            if (ioPins[i].mode == 2) { // OUTPUT
-                JsonDocument doc;
-                DeserializationError error = deserializeJson(doc, payload, length);
+    // Check if it's a control topic for a pin (device, group or broadcast)
+    bool broadcast = false;
+    int prefixLength = controlTopicPrefixLength(topic, &broadcast);
+    size_t topicLength = strlen(topic);
+    if (prefixLength < 0 || topicLength < (size_t)prefixLength + 4 ||
+        strcmp(topic + topicLength - 4, "/set") != 0) {
+        return; // Not a command for us
+    }
 
-                if (error) {
-                    Serial.print(F("deserializeJson() failed: "));
-                    Serial.println(error.c_str());
-                    // Fallback for simple "0" or "1" commands
-                    int state = atoi(message);
-                    executeCommand(ioPins[i].pin, state);
-                    return;
-                }
+    // Extract pin name (sans copie : "<prefix><pin_name>/set")
+    const char* pinName = topic + prefixLength;
+    size_t pinNameLength = topicLength - prefixLength - 4;
+
+    // Find the IO pin by name (table de hachage, O(1), instantané de la configuration)
+    IoSnapshot table;
+    int i = ioIndexByName(*table, pinName, pinNameLength);
+    if (i < 0) {
+        // Une commande de groupe/broadcast peut viser une broche que cet appareil n'a pas
+        if (!broadcast) {
+            logPrintf("Received command for unknown pin '%.*s'\n", (int)pinNameLength, pinName);
+        }
+        return;
+    }
 
-                int state = doc["state"];
-                uint32_t exec_at_sec = doc["exec_at"] | 0;
-                uint32_t exec_at_us = doc["exec_at_us"] | 0;
-
-                if (exec_at_sec > 0) {
-                    // Schedule command avec précision microseconde
-                    bool scheduled = false;
-                    for (int j = 0; j < MAX_SCHEDULED_COMMANDS; j++) {
-                        if (!scheduledCommands[j].active) {
-                            scheduledCommands[j].pin = ioPins[i].pin;
-                            scheduledCommands[j].state = state;
-                            scheduledCommands[j].exec_at_sec = exec_at_sec;
-                            scheduledCommands[j].exec_at_us = exec_at_us;
-                            scheduledCommands[j].active = true;
-                            scheduled = true;
-                            Serial.printf("⏰ Command for pin %d scheduled at %u.%06u\n", ioPins[i].pin, exec_at_sec, exec_at_us);
-                            break;
-                        }
-                    }
-                    if (!scheduled) {
-                        Serial.println("⚠️ Scheduled command queue is full!");
-                    }
-                } else {
-                    // Execute immediately
-                    executeCommand(ioPins[i].pin, state);
-                }
+    if (table->mode[i] != 2) { // OUTPUT
+        logPrintf("Received command for non-output pin '%.*s'\n", (int)pinNameLength, pinName);
+        return;
+    }
 
-            } else {
-                Serial.printf("Received command for non-output pin '%s'\n", pinName.c_str());
-            }
-            return; // Command handled for this pin
-        }
+    JsonDocument doc(&mqttTaskArena);
+    DeserializationError error = deserializeJson(doc, payload, length);
+
+    if (error) {
+        logPrintf("deserializeJson() failed: %s\n", error.c_str());
+        // Fallback for simple "0" or "1" commands
+        int state = atoi(message);
+        submitIoCommand(table->pin[i], state);
+        return;
     }
 
-    Serial.printf("Received command for unknown pin '%s'\n", pinName.c_str());
-}
+    int state = doc["state"];
+    uint32_t exec_at_sec = doc["exec_at"] | 0;
+    uint32_t exec_at_us = doc["exec_at_us"] | 0;
+    // Identifiant de corrélation optionnel : accusé d'exécution sur <device>/ack
+    char id[COMMAND_ID_LENGTH];
+    strlcpy(id, doc["id"] | "", sizeof(id));
 
-void setupMQTT() {
-  mqttClient.setServer(config.mqttServer, config.mqttPort);
-  mqttClient.setCallback(mqtt_callback);
-  Serial.println("MQTT setup.");
+    // Exécution (immédiate ou programmée à exec_at) et accusé par la tâche temps réel
+    submitIoCommand(table->pin[i], state, exec_at_sec, exec_at_us, id, receivedUs);
 }
 
-void reconnectMQTT() {
-  Serial.print("Attempting MQTT connection...");
-  String clientId = "ESP32-IO-Controller-";
-  clientId += String(random(0xffff), HEX);
-  if (mqttClient.connect(clientId.c_str(), config.mqttUser, config.mqttPassword)) {
-    Serial.println("connected");
-    blinkStatusLED(2, 100);  // Signal de connexion MQTT réussie
-    Serial.println();
-    Serial.println("========================================");
-    Serial.println("✓ Client MQTT connecté au broker");
-    
-    // Publish availability
-    char availabilityTopic[128];
-    snprintf(availabilityTopic, sizeof(availabilityTopic), "%s/availability", config.deviceName);
-    publishMQTT(availabilityTopic, "online", true);
-
-    // Subscribe to control topics
-    String controlTopic = String(config.deviceName) + "/control/#";
-    mqttClient.subscribe(controlTopic.c_str());
-    Serial.printf("✓ Abonné à: %s\n", controlTopic.c_str());
+static void subscribeTopics() {
+    // Subscribe to control topics (QoS 1 : les commandes ne doivent pas se perdre)
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/control/#", config.deviceName);
+    esp_mqtt_client_subscribe(mqttClient, topic, 1);
+    logPrintf("✓ Abonné à: %s\n", topic);
+
+    // Subscribe to broadcast and group control topics (commandes de flotte)
+    esp_mqtt_client_subscribe(mqttClient, "all/control/+/set", 1);
+    logPrintf("✓ Abonné à: all/control/+/set\n");
+    for (int g = 0; g < groupCount; g++) {
+        snprintf(topic, sizeof(topic), "group/%s/control/+/set", groupNames[g]);
+        esp_mqtt_client_subscribe(mqttClient, topic, 1);
+        logPrintf("✓ Abonné à: %s\n", topic);
+    }
 
     // Subscribe to time sync topic (commun à tous les ESP32)
-    mqttClient.subscribe("esp32/time/sync");
-    Serial.printf("✓ Abonné à: esp32/time/sync\n");
-    
+    esp_mqtt_client_subscribe(mqttClient, "esp32/time/sync", 0);
+    logPrintf("✓ Abonné à: esp32/time/sync\n");
+
     // Subscribe to ping topic for latency measurement (géré par le PC)
-    String pingTopic = String(config.deviceName) + "/ping";
-    mqttClient.subscribe(pingTopic.c_str());
-    Serial.printf("✓ Abonné à: %s\n", pingTopic.c_str());
+    snprintf(topic, sizeof(topic), "%s/ping", config.deviceName);
+    esp_mqtt_client_subscribe(mqttClient, topic, 0);
+    logPrintf("✓ Abonné à: %s\n", topic);
+
+    // Demandes d'instantané d'état
+    snprintf(topic, sizeof(topic), "%s/state/get", config.deviceName);
+    esp_mqtt_client_subscribe(mqttClient, topic, 0);
+    logPrintf("✓ Abonné à: %s\n", topic);
 
     // Subscribe to serial bridge topic
     if (config.useSerialBridge) {
-        String serialTopic = String(config.deviceName) + "/serial/send";
-        mqttClient.subscribe(serialTopic.c_str());
-        Serial.printf("✓ Abonné à: %s\n", serialTopic.c_str());
+        snprintf(topic, sizeof(topic), "%s/serial/send", config.deviceName);
+        esp_mqtt_client_subscribe(mqttClient, topic, 1);
+        logPrintf("✓ Abonné à: %s\n", topic);
+        snprintf(topic, sizeof(topic), "%s/serial/rpc", config.deviceName);
+        esp_mqtt_client_subscribe(mqttClient, topic, 1);
+        logPrintf("✓ Abonné à: %s\n", topic);
+    }
+
+    // Modbus : demandes de republication des valeurs du cache
+    if (config.useModbus) {
+        snprintf(topic, sizeof(topic), "%s/modbus/get", config.deviceName);
+        esp_mqtt_client_subscribe(mqttClient, topic, 0);
+        logPrintf("✓ Abonné à: %s\n", topic);
+    }
+}
+
+// Republie l'état des broches (messages retenus) par lots de MQTT_REPUBLISH_BATCH :
+// la file "state" n'est jamais remplie par la republication, les changements d'état
+// en direct gardent leur place. Le préfixe du topic est formaté une fois par lot.
+static void republishState() {
+    if (republishIndex < 0) return;
+    char topic[128];
+    int prefixLen = snprintf(topic, sizeof(topic), "%s/status/", config.deviceName);
+    if (prefixLen < 0 || prefixLen >= (int)sizeof(topic)) return;
+
+    IoSnapshot table;
+    // Configuration remplacée entre deux lots : les index ont changé, on reprend au début
+    if (republishIndex > 0 && table->generation != republishGeneration) republishIndex = 0;
+    republishGeneration = table->generation;
+
+    char payload[48];
+    long now = (long)time(nullptr);
+    while (republishIndex < table->count && mqttSchedulerDepth(MQTT_PRIORITY_STATE) < MQTT_REPUBLISH_BATCH) {
+        int i = republishIndex++;
+        // Les canaux analogiques publient leur valeur retenue sur <device>/analog/<name>
+        if (table->mode[i] == 3) continue;
+        strlcpy(topic + prefixLen, table->pins[i].name, sizeof(topic) - prefixLen);
+        int len = snprintf(payload, sizeof(payload), "{\"state\":\"%s\",\"timestamp\":%ld}",
+                           ioState(*table, i) ? "ON" : "OFF", now);
+        if (!mqttSchedulerSubmit(MQTT_PRIORITY_STATE, topic, payload, len, 1, true)) {
+            republishIndex--;   // File pleine : reprise au prochain tour
+            return;
+        }
+    }
+    if (republishIndex >= table->count) {
+        logPrintf("✓ %d états republiés\n", table->count);
+        republishIndex = -1;
+    }
+}
+
+static void recordDowntime(unsigned long downtimeMs) {
+    mqttStats.totalDowntimeMs += downtimeMs;
+    if (downtimeMs > mqttStats.longestDowntimeMs) mqttStats.longestDowntimeMs = downtimeMs;
+    int bucket = 0;
+    while (bucket < MQTT_DOWNTIME_BUCKETS - 1 && downtimeMs >= MQTT_DOWNTIME_BOUNDS_MS[bucket]) {
+        bucket++;
+    }
+    mqttStats.downtimeHistogram[bucket]++;
+}
+
+// Appelé dans la tâche MQTT à chaque session établie
+static void onMqttConnected(bool sessionPresent) {
+    unsigned long now = millis();
+    mqttStats.connects++;
+    mqttStats.lastConnectedAt = now;
+    if (mqttStats.downSince != 0) {
+        recordDowntime(now - mqttStats.downSince);
+        mqttStats.downSince = 0;
+    }
+
+    logPrintf("✓ Client MQTT connecté au broker (session %s)\n", sessionPresent ? "reprise" : "nouvelle");
+
+    // Publish availability (le LWT publie "offline" si la connexion est perdue)
+    publishMQTT(mqttLwtTopic, "online", true, 1);
+
+    // Session persistante (cleanSession=false) : le broker a conservé nos abonnements
+    if (sessionPresent) mqttStats.sessionResumes++;
+    if (sessionPresent && subscribedSinceBoot) {
+        logPrintf("✓ Abonnements conservés par le broker\n");
+    } else {
+        subscribeTopics();
+        subscribedSinceBoot = true;
     }
-    
-    Serial.println("========================================");
-    Serial.println();
 
-    // Publish current state of all pins as retained messages
-    for (int i = 0; i < ioPinCount; i++) {
-        JsonDocument doc;
-        doc["state"] = ioPins[i].state ? "ON" : "OFF";
-        doc["timestamp"] = time(nullptr);
+    // Republication et métriques passent par les files (vidées par mqttLoop())
+    __atomic_fetch_or(&linkEvents, LINK_EVENT_REPUBLISH, __ATOMIC_RELEASE);
+    statsPublishRequested = true;
+    stateSyncRequest();
+}
+
+// Réassemble les messages plus grands que le tampon du client avant d'appeler mqtt_callback()
+static void onMqttData(esp_mqtt_event_handle_t event) {
+    if (event->current_data_offset == 0) {
+        size_t topicLen = min((size_t)event->topic_len, sizeof(rxTopic) - 1);
+        memcpy(rxTopic, event->topic, topicLen);
+        rxTopic[topicLen] = '\0';
+        rxTotalLength = event->total_data_len;
+        rxDropping = rxTotalLength >= rxBufferSize;
+        if (rxDropping) {
+            logPrintf("⚠️ MQTT message on [%s] too large (%u bytes, buffer %u) - dropped\n",
+                      rxTopic, (unsigned)rxTotalLength, (unsigned)rxBufferSize);
+        }
+    }
+    if (rxDropping) return;
+
+    memcpy(rxBuffer + event->current_data_offset, event->data, event->data_len);
+    if ((size_t)(event->current_data_offset + event->data_len) < rxTotalLength) {
+        return; // Fragment suivant attendu
+    }
+    rxBuffer[rxTotalLength] = '\0';
+    mqtt_callback(rxTopic, (byte*)rxBuffer, rxTotalLength);
+}
 
-        char jsonBuffer[128];
-        serializeJson(doc, jsonBuffer);
+static void decayInstability(unsigned long now) {
+    float elapsedMin = (now - mqttStats.instabilityUpdatedAt) / 60000.0f;
+    mqttStats.instability *= expf(-elapsedMin / MQTT_INSTABILITY_DECAY_MIN);
+    mqttStats.instabilityUpdatedAt = now;
+}
 
-        char statusTopic[128];
-        snprintf(statusTopic, sizeof(statusTopic), "%s/status/%s", config.deviceName, ioPins[i].name);
-        publishMQTT(statusTopic, jsonBuffer, true);
+static unsigned long nextBackoffDelay() {
+    unsigned long delayMs = MQTT_BACKOFF_MIN_MS;
+    for (uint8_t i = 0; i < consecutiveFailures && delayMs < MQTT_BACKOFF_MAX_MS; i++) {
+        delayMs *= 2;
     }
+    if (delayMs > MQTT_BACKOFF_MAX_MS) delayMs = MQTT_BACKOFF_MAX_MS;
+    if (consecutiveFailures < 255) consecutiveFailures++;
+    return delayMs / 2 + random(delayMs);
+}
 
-  } else {
-    Serial.print("failed, rc=");
-    Serial.print(mqttClient.state());
-    Serial.println(" try again in 5 seconds");
+static void mqttEventHandler(void* handlerArgs, esp_event_base_t base, int32_t eventId, void* eventData) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)eventData;
+    mqttTaskHandle = xTaskGetCurrentTaskHandle();
+    switch ((esp_mqtt_event_id_t)eventId) {
+        case MQTT_EVENT_BEFORE_CONNECT:
+            logPrintf("Attempting MQTT connection...\n");
+            break;
+        case MQTT_EVENT_CONNECTED:
+            linkState = MQTT_LINK_CONNECTED;
+            onMqttConnected(event->session_present);
+            break;
+        case MQTT_EVENT_DISCONNECTED: {
+            if (linkState == MQTT_LINK_IDLE) break; // Arrêt volontaire
+            unsigned long now = millis();
+            if (linkState == MQTT_LINK_CONNECTED) {
+                logPrintf("⚠️ MQTT connection lost\n");
+                mqttStats.disconnects++;
+                mqttStats.downSince = now;
+                decayInstability(now);
+                mqttStats.instability += 1.0f;
+            } else {
+                logPrintf("MQTT connection failed\n");
+                mqttStats.failedAttempts++;
+                if (mqttStats.downSince == 0) mqttStats.downSince = now;
+            }
+            // Ce qui attend encore n'a plus de sens : l'état est republié à la reconnexion.
+            // Une connexion pas encore traitée par mqttLoop() est annulée avec.
+            __atomic_and_fetch(&linkEvents, (uint8_t)~LINK_EVENT_REPUBLISH, __ATOMIC_RELAXED);
+            __atomic_fetch_or(&linkEvents, LINK_EVENT_DISCARD, __ATOMIC_RELEASE);
+            unsigned long delayMs = nextBackoffDelay();
+            nextAttemptAt = now + delayMs;
+            linkState = MQTT_LINK_WAIT_RETRY;
+            logPrintf("MQTT: next attempt in %lu ms (failure #%u)\n", delayMs, consecutiveFailures);
+            break;
+        }
+        case MQTT_EVENT_DATA:
+            onMqttData(event);
+            break;
+        case MQTT_EVENT_ERROR:
+            if (event->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
+                logPrintf("MQTT connection refused, rc=%d\n", event->error_handle->connect_return_code);
+            } else if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
+                logPrintf("MQTT transport error, errno=%d\n", event->error_handle->esp_transport_sock_errno);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void setupMQTT() {
+  // Identifiant stable (dérivé du MAC) : indispensable pour reprendre la session persistante
+  snprintf(mqttClientId, sizeof(mqttClientId), "ESP32-IO-%012llX", (unsigned long long)ESP.getEfuseMac());
+  snprintf(mqttLwtTopic, sizeof(mqttLwtTopic), "%s/availability", config.deviceName);
+  parseGroups();
+
+  rxBufferSize = config.mqttBufferSize > 0 ? config.mqttBufferSize : MQTT_DEFAULT_BUFFER_SIZE;
+  rxBuffer = (char*)malloc(rxBufferSize);
+
+  esp_mqtt_client_config_t mqttCfg = {};
+  mqttCfg.host = config.mqttServer;
+  mqttCfg.port = config.mqttPort;
+  mqttCfg.transport = MQTT_TRANSPORT_OVER_TCP;
+  mqttCfg.client_id = mqttClientId;
+  mqttCfg.username = strlen(config.mqttUser) > 0 ? config.mqttUser : NULL;
+  mqttCfg.password = strlen(config.mqttPassword) > 0 ? config.mqttPassword : NULL;
+  mqttCfg.buffer_size = rxBufferSize;
+  mqttCfg.out_buffer_size = rxBufferSize;
+  mqttCfg.task_prio = MQTT_TASK_PRIORITY;
+  mqttCfg.task_stack = MQTT_TASK_STACK_SIZE;
+  mqttCfg.reconnect_timeout_ms = MQTT_RECONNECT_PARKED_MS;
+  mqttCfg.network_timeout_ms = MQTT_NETWORK_TIMEOUT_MS;
+  // Session persistante : le broker garde nos abonnements (et les QoS 1 en attente)
+  mqttCfg.disable_clean_session = 1;
+  // Last Will : le broker publie "offline" (retenu) si la liaison est perdue
+  mqttCfg.lwt_topic = mqttLwtTopic;
+  mqttCfg.lwt_msg = "offline";
+  mqttCfg.lwt_qos = 1;
+  mqttCfg.lwt_retain = 1;
+
+  mqttClient = esp_mqtt_client_init(&mqttCfg);
+  if (mqttClient == NULL || rxBuffer == NULL) {
+    Serial.println("✗ MQTT client initialization failed");
+    mqttClient = NULL;
+    return;
   }
+  if (!mqttSchedulerInit(mqttClient)) {
+    Serial.println("✗ MQTT publish queues allocation failed");
+  }
+  esp_mqtt_client_register_event(mqttClient, MQTT_EVENT_ANY, mqttEventHandler, NULL);
+  Serial.printf("MQTT setup (buffer %u bytes).\n", (unsigned)rxBufferSize);
 }
 
-void publishMQTT(const char* topic, const char* payload, boolean retained) {
-    if (mqttClient.connected()) {
-        if (mqttClient.publish(topic, payload, retained)) {
-            Serial.printf("[%s] MQTT message published to [%s]: %s\n", getFormattedTime().c_str(), topic, payload);
-        } else {
-            Serial.printf("[%s] MQTT publish failed to [%s]\n", getFormattedTime().c_str(), topic);
+void mqttLoop(bool networkOk) {
+  if (mqttClient == NULL) return;
+
+  // Déconnexion puis reconnexion entre deux tours : files vidées, puis republication
+  uint8_t events = __atomic_exchange_n(&linkEvents, 0, __ATOMIC_ACQUIRE);
+  if (events & LINK_EVENT_DISCARD) {
+    mqttSchedulerDiscard();
+    republishIndex = -1;
+  }
+  if (events & LINK_EVENT_REPUBLISH) republishIndex = 0;
+
+  switch (linkState) {
+    case MQTT_LINK_IDLE:
+      if (mqttEnabled && networkOk) {
+        // Démarrage, arrêt et reconnexion du client allouent (tâche, socket) : hors régime établi
+        AllocAuditExempt exempt;
+        linkState = MQTT_LINK_CONNECTING;
+        if (esp_mqtt_client_start(mqttClient) != ESP_OK) {
+          Serial.println("✗ MQTT client start failed");
+          linkState = MQTT_LINK_IDLE;
+        }
+      }
+      break;
+
+    case MQTT_LINK_WAIT_RETRY:
+      if (!mqttEnabled) {
+        AllocAuditExempt exempt;
+        linkState = MQTT_LINK_IDLE;
+        esp_mqtt_client_stop(mqttClient);
+      } else if (networkOk && (long)(millis() - nextAttemptAt) >= 0) {
+        AllocAuditExempt exempt;
+        linkState = MQTT_LINK_CONNECTING;
+        if (esp_mqtt_client_reconnect(mqttClient) != ESP_OK) {
+          // La tâche n'est pas encore prête à se reconnecter : réessayer plus tard
+          nextAttemptAt = millis() + MQTT_BACKOFF_MIN_MS;
+          linkState = MQTT_LINK_WAIT_RETRY;
+        }
+      }
+      break;
+
+    case MQTT_LINK_CONNECTING:
+    case MQTT_LINK_CONNECTED:
+      if (!mqttEnabled) {
+        AllocAuditExempt exempt;
+        if (linkState == MQTT_LINK_CONNECTED) {
+          // Arrêt volontaire : le broker n'enverra pas le LWT après un DISCONNECT propre
+          esp_mqtt_client_publish(mqttClient, mqttLwtTopic, "offline", 0, 0, 1);
+        }
+        linkState = MQTT_LINK_IDLE;
+        esp_mqtt_client_stop(mqttClient);
+        mqttSchedulerDiscard();
+        Serial.println("MQTT stopped.");
+      } else if (linkState == MQTT_LINK_CONNECTED) {
+        unsigned long now = millis();
+        // Le backoff n'est remis à zéro qu'après une connexion stable (évite le "flapping")
+        if (consecutiveFailures > 0 && now - mqttStats.lastConnectedAt > MQTT_STABLE_CONNECTION_MS) {
+          consecutiveFailures = 0;
+        }
+        if (statsPublishRequested || now - lastStatsPublish > MQTT_STATS_INTERVAL_MS) {
+          publishMqttStats();
         }
+        republishState();
+        mqttSchedulerDrain();
+      }
+      break;
+  }
+}
+
+void reconnectMQTT() {
+  consecutiveFailures = 0;
+  nextAttemptAt = millis();
+}
+
+void disconnectMQTT() {
+  // L'arrêt effectif du client est fait par mqttLoop() (jamais depuis la tâche MQTT)
+  mqttEnabled = false;
+}
+
+bool mqttConnected() {
+  return linkState == MQTT_LINK_CONNECTED;
+}
+
+MqttLinkState mqttLinkState() {
+  return linkState;
+}
+
+const char* mqttLinkStateName(MqttLinkState state) {
+  switch (state) {
+    case MQTT_LINK_IDLE: return "idle";
+    case MQTT_LINK_CONNECTING: return "connecting";
+    case MQTT_LINK_CONNECTED: return "connected";
+    case MQTT_LINK_WAIT_RETRY: return "wait_retry";
+  }
+  return "unknown";
+}
+
+bool publishMQTT(const char* topic, const char* payload, boolean retained, int qos, MqttPriority priority) {
+    if (!mqttConnected()) return false;
+
+    size_t length = strlen(payload);
+    bool ok;
+    if (priority == MQTT_PRIORITY_REALTIME && xTaskGetCurrentTaskHandle() == mqttTaskHandle) {
+        ok = mqttSchedulerSendNow(priority, topic, payload, length, qos, retained);
+    } else {
+        // Les autres tâches n'écrivent jamais sur le socket : file de la classe, vidée par loop()
+        ok = mqttSchedulerSubmit(priority, topic, payload, length, qos, retained);
+    }
+    char when[20];
+    if (ok) {
+        logPrintf("[%s] MQTT message published to [%s]: %s\n", formatLogTime(when, sizeof(when)), topic, payload);
+        return true;
     }
+    logPrintf("[%s] MQTT publish failed to [%s] (%s queue)\n", formatLogTime(when, sizeof(when)), topic, mqttPriorityName(priority));
+    return false;
+}
+
+// Score de santé 0-100 : 0 si déconnecté, sinon 100 moins 20 points par
+// déconnexion récente (le compteur décroît avec une constante de MQTT_INSTABILITY_DECAY_MIN).
+int mqttHealthScore() {
+    if (!mqttConnected()) return 0;
+    decayInstability(millis());
+    int score = 100 - (int)(mqttStats.instability * 20.0f + 0.5f);
+    return score < 0 ? 0 : score;
+}
+
+void mqttStatsToJson(JsonObject out) {
+    unsigned long now = millis();
+    out["state"] = mqttLinkStateName(linkState);
+    out["health"] = mqttHealthScore();
+    out["connects"] = mqttStats.connects;
+    out["disconnects"] = mqttStats.disconnects;
+    out["failedAttempts"] = mqttStats.failedAttempts;
+    out["sessionResumes"] = mqttStats.sessionResumes;
+    out["consecutiveFailures"] = consecutiveFailures;
+    out["uptimeMs"] = mqttConnected() ? now - mqttStats.lastConnectedAt : 0;
+    out["downtimeMs"] = mqttStats.downSince != 0 ? now - mqttStats.downSince : 0;
+    out["totalDowntimeMs"] = mqttStats.totalDowntimeMs;
+    out["longestDowntimeMs"] = mqttStats.longestDowntimeMs;
+    JsonObject histogram = out["downtimeHistogram"].to<JsonObject>();
+    for (int i = 0; i < MQTT_DOWNTIME_BUCKETS; i++) {
+        histogram[MQTT_DOWNTIME_LABELS[i]] = mqttStats.downtimeHistogram[i];
+    }
+    mqttSchedulerStatsToJson(out["queues"].to<JsonObject>());
+}
+
+static void publishMqttStats() {
+    lastStatsPublish = millis();
+    statsPublishRequested = false;
+
+    JsonDocument doc(&netTaskArena);
+    mqttStatsToJson(doc.to<JsonObject>());
+    char payload[1024];
+    size_t len = serializeJson(doc, payload, sizeof(payload));
+
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/metrics/mqtt", config.deviceName);
+    mqttSchedulerSubmit(MQTT_PRIORITY_BULK, topic, payload, len, 0, true);
 }
@@ -2,12 +2,12 @@
 #define MQTT_H
 
 #include <WiFi.h>
-#include <PubSubClient.h>
+#include <mqtt_client.h>
+#include <ArduinoJson.h>
 #include "config.h"
+#include "mqtt_scheduler.h"
 
 // externs provided by other translation units
-extern WiFiClient wifiClient;
-extern PubSubClient mqttClient;
 extern Config config;
 extern IOPin ioPins[];
 extern int ioPinCount;
@@ -15,17 +15,41 @@ extern ScheduledCommand scheduledCommands[];
 // Control whether MQTT subsystem should be active (can be toggled at runtime)
 extern bool mqttEnabled;
 
+// État de la liaison MQTT. Le transport (esp-mqtt) tourne dans sa propre tâche :
+// les transitions CONNECTING -> CONNECTED/WAIT_RETRY viennent de ses événements,
+// les transitions IDLE -> CONNECTING et WAIT_RETRY -> CONNECTING de mqttLoop().
+enum MqttLinkState : uint8_t {
+  MQTT_LINK_IDLE = 0,     // Client arrêté (MQTT désactivé ou réseau absent)
+  MQTT_LINK_CONNECTING,   // Tentative en cours dans la tâche MQTT
+  MQTT_LINK_CONNECTED,    // Session établie, abonnements envoyés
+  MQTT_LINK_WAIT_RETRY    // Déconnecté, attente de la prochaine tentative
+};
+
 // Fonction pour faire clignoter la LED (définie dans main.cpp)
 void blinkStatusLED(int times, int delayMs);
 
-// Fonction pour obtenir le temps avec précision microseconde
-uint64_t getCurrentTimeMicros();
-
 // MQTT API
 void setupMQTT();
-void reconnectMQTT();
-void publishMQTT(const char* sub_topic, const char* payload, boolean retained = false);
-void mqtt_callback(char* topic, byte* payload, unsigned int length);
-void executeCommand(int pin, int state);
+void mqttLoop(bool networkOk);   // Fait avancer la machine d'état, ne bloque jamais
+void reconnectMQTT();            // Demande une tentative immédiate (non bloquant)
+void disconnectMQTT();
+bool mqttConnected();
+MqttLinkState mqttLinkState();
+const char* mqttLinkStateName(MqttLinkState state);
+// Publication non bloquante : le message est placé dans la file de sa classe de
+// priorité (voir mqtt_scheduler.h) puis transféré dans l'outbox du client par loop().
+bool publishMQTT(const char* topic, const char* payload, boolean retained = false, int qos = 0,
+                 MqttPriority priority = MQTT_PRIORITY_STATE);
+int mqttHealthScore();
+void mqttStatsToJson(JsonObject out);   // Compteurs de reconnexion et histogramme des coupures
+void mqtt_callback(char* topic, byte* payload, unsigned int length);   // payload terminé par '\0'
+// Retourne l'heure (µs, horloge corrigée) à laquelle la sortie a été commutée
+uint64_t executeCommand(int pin, int state);
+bool scheduleCommand(int pin, int state, uint32_t exec_at_sec, uint32_t exec_at_us,
+                     const char* id = NULL, uint64_t receivedUs = 0);
+// Accusé d'exécution sur <device>/ack (commandes portant un "id" uniquement)
+void publishCommandAck(const char* id, int pin, int state, const char* result,
+                       uint64_t receivedUs, uint64_t scheduledUs, uint64_t executedUs);
+bool isGroupMember(const char* group, size_t length);
 
 #endif // MQTT_H
@@ -0,0 +1,206 @@
+#include "mqtt_scheduler.h"
+#include "alloc_audit.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
+
+// Élément d'une file (type NOSPLIT : toujours contigu) : en-tête, topic\0, payload
+struct QueuedMessage {
+  uint16_t topicLength;
+  uint16_t payloadLength;
+  uint8_t qos;
+  uint8_t retained;
+};
+
+struct TokenBucket {
+  float tokens;
+  float rate;          // Jetons par seconde
+  float burst;         // Capacité du seau
+  uint32_t refilledAt; // micros()
+};
+
+struct PriorityQueue {
+  RingbufHandle_t ring;
+  TokenBucket bucket;
+  uint32_t depth;
+  uint32_t highWater;
+  uint32_t submitted;
+  uint32_t sent;
+  uint32_t direct;     // Envoyés sans passer par la file (mqttSchedulerSendNow)
+  uint32_t dropped;    // File pleine ou message trop grand
+  uint32_t discarded;  // Abandonnés à la déconnexion
+  uint32_t failed;     // Refusés par esp-mqtt (mémoire)
+};
+
+static const struct {
+  size_t bytes;
+  float rate;
+  float burst;
+} QUEUE_SETTINGS[MQTT_PRIORITY_COUNT] = {
+  { MQTT_QUEUE_REALTIME_BYTES, MQTT_RATE_REALTIME, MQTT_BURST_REALTIME },
+  { MQTT_QUEUE_STATE_BYTES,    MQTT_RATE_STATE,    MQTT_BURST_STATE },
+  { MQTT_QUEUE_BULK_BYTES,     MQTT_RATE_BULK,     MQTT_BURST_BULK },
+};
+
+static esp_mqtt_client_handle_t mqttClient = NULL;
+static PriorityQueue queues[MQTT_PRIORITY_COUNT];
+// Compteurs modifiés par tous les producteurs (tâche I/O, loop, web, tâche MQTT)
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool mqttSchedulerInit(esp_mqtt_client_handle_t client) {
+  mqttClient = client;
+  uint32_t now = micros();
+  for (int p = 0; p < MQTT_PRIORITY_COUNT; p++) {
+    PriorityQueue& q = queues[p];
+    if (q.ring == NULL) {
+      q.ring = xRingbufferCreate(QUEUE_SETTINGS[p].bytes, RINGBUF_TYPE_NOSPLIT);
+      if (q.ring == NULL) return false;
+    }
+    q.bucket.rate = QUEUE_SETTINGS[p].rate;
+    q.bucket.burst = QUEUE_SETTINGS[p].burst;
+    q.bucket.tokens = QUEUE_SETTINGS[p].burst;
+    q.bucket.refilledAt = now;
+  }
+  return true;
+}
+
+const char* mqttPriorityName(MqttPriority priority) {
+  switch (priority) {
+    case MQTT_PRIORITY_REALTIME: return "realtime";
+    case MQTT_PRIORITY_STATE: return "state";
+    case MQTT_PRIORITY_BULK: return "bulk";
+    default: return "unknown";
+  }
+}
+
+uint32_t mqttSchedulerDepth(MqttPriority priority) {
+  return queues[priority].depth;
+}
+
+static void countDrop(PriorityQueue& q) {
+  portENTER_CRITICAL(&statsMux);
+  q.submitted++;
+  q.dropped++;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+bool mqttSchedulerSubmit(MqttPriority priority, const char* topic, const char* payload,
+                         size_t length, int qos, bool retained) {
+  PriorityQueue& q = queues[priority];
+  if (q.ring == NULL) return false;
+
+  size_t topicLength = strlen(topic);
+  size_t itemSize = sizeof(QueuedMessage) + topicLength + 1 + length;
+  void* slot = NULL;
+  if (length > UINT16_MAX || topicLength > UINT16_MAX ||
+      xRingbufferSendAcquire(q.ring, &slot, itemSize, 0) != pdTRUE) {
+    countDrop(q);
+    return false;
+  }
+
+  QueuedMessage* header = (QueuedMessage*)slot;
+  header->topicLength = topicLength;
+  header->payloadLength = length;
+  header->qos = qos;
+  header->retained = retained ? 1 : 0;
+  char* data = (char*)(header + 1);
+  memcpy(data, topic, topicLength + 1);
+  memcpy(data + topicLength + 1, payload, length);
+
+  portENTER_CRITICAL(&statsMux);
+  q.submitted++;
+  q.depth++;
+  if (q.depth > q.highWater) q.highWater = q.depth;
+  portEXIT_CRITICAL(&statsMux);
+  xRingbufferSendComplete(q.ring, slot);
+  return true;
+}
+
+bool mqttSchedulerSendNow(MqttPriority priority, const char* topic, const char* payload,
+                          size_t length, int qos, bool retained) {
+  PriorityQueue& q = queues[priority];
+  // Écriture directe sur le socket : n'attend ni l'outbox ni le prochain tour de loop()
+  bool ok = esp_mqtt_client_publish(mqttClient, topic, payload, length, qos, retained) >= 0;
+  portENTER_CRITICAL(&statsMux);
+  q.submitted++;
+  if (ok) q.direct++;
+  else q.failed++;
+  portEXIT_CRITICAL(&statsMux);
+  return ok;
+}
+
+static bool takeToken(TokenBucket& bucket, uint32_t now) {
+  float elapsed = (now - bucket.refilledAt) / 1000000.0f;
+  bucket.refilledAt = now;
+  bucket.tokens += elapsed * bucket.rate;
+  if (bucket.tokens > bucket.burst) bucket.tokens = bucket.burst;
+  if (bucket.tokens < 1.0f) return false;
+  bucket.tokens -= 1.0f;
+  return true;
+}
+
+void mqttSchedulerDrain() {
+  if (mqttClient == NULL) return;
+  uint32_t now = micros();
+  // Priorité stricte : une classe n'est servie que si les précédentes sont vides
+  // ou bloquées par leur propre limite de débit
+  for (int p = 0; p < MQTT_PRIORITY_COUNT; p++) {
+    PriorityQueue& q = queues[p];
+    while (q.depth > 0) {
+      if (esp_mqtt_client_get_outbox_size(mqttClient) >= MQTT_OUTBOX_HIGH_WATER) return;
+      if (!takeToken(q.bucket, now)) break;
+
+      size_t itemSize = 0;
+      QueuedMessage* header = (QueuedMessage*)xRingbufferReceive(q.ring, &itemSize, 0);
+      if (header == NULL) break;
+      const char* topic = (const char*)(header + 1);
+      const char* payload = topic + header->topicLength + 1;
+      int msgId;
+      {
+        AllocAuditExempt exempt;   // L'outbox esp-mqtt alloue chaque message qu'elle garde
+        msgId = esp_mqtt_client_enqueue(mqttClient, topic, payload, header->payloadLength,
+                                        header->qos, header->retained, true);
+      }
+      vRingbufferReturnItem(q.ring, header);
+
+      portENTER_CRITICAL(&statsMux);
+      q.depth--;
+      if (msgId >= 0) q.sent++;
+      else q.failed++;
+      portEXIT_CRITICAL(&statsMux);
+    }
+  }
+}
+
+void mqttSchedulerDiscard() {
+  for (int p = 0; p < MQTT_PRIORITY_COUNT; p++) {
+    PriorityQueue& q = queues[p];
+    while (q.depth > 0) {
+      size_t itemSize = 0;
+      void* item = xRingbufferReceive(q.ring, &itemSize, 0);
+      if (item == NULL) break;
+      vRingbufferReturnItem(q.ring, item);
+      portENTER_CRITICAL(&statsMux);
+      q.depth--;
+      q.discarded++;
+      portEXIT_CRITICAL(&statsMux);
+    }
+  }
+}
+
+void mqttSchedulerStatsToJson(JsonObject out) {
+  if (mqttClient != NULL) out["outboxBytes"] = esp_mqtt_client_get_outbox_size(mqttClient);
+  for (int p = 0; p < MQTT_PRIORITY_COUNT; p++) {
+    const PriorityQueue& q = queues[p];
+    JsonObject entry = out[mqttPriorityName((MqttPriority)p)].to<JsonObject>();
+    entry["depth"] = q.depth;
+    entry["highWater"] = q.highWater;
+    entry["submitted"] = q.submitted;
+    entry["sent"] = q.sent;
+    entry["direct"] = q.direct;
+    entry["dropped"] = q.dropped;
+    entry["discarded"] = q.discarded;
+    entry["failed"] = q.failed;
+    entry["tokens"] = q.bucket.tokens;
+    entry["rate"] = q.bucket.rate;
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef MQTT_SCHEDULER_H
+#define MQTT_SCHEDULER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <mqtt_client.h>
+#include "config.h"
+
+// ===== ORDONNANCEUR DE PUBLICATION MQTT =====
+// Les publications ne vont plus directement dans l'outbox esp-mqtt (FIFO unique) :
+// chacune est rangée dans la file de sa classe, puis mqttSchedulerDrain() (loop())
+// les transfère par priorité stricte, dans la limite du seau à jetons de la classe
+// et tant que l'outbox reste sous MQTT_OUTBOX_HIGH_WATER. Une rafale du pont série
+// ne peut donc plus retarder un pong : il passe devant tout ce qui attend encore.
+
+enum MqttPriority : uint8_t {
+  MQTT_PRIORITY_REALTIME = 0,   // pong, acquittements
+  MQTT_PRIORITY_STATE,          // états, disponibilité, valeurs analogiques
+  MQTT_PRIORITY_BULK,           // pont série, métriques
+  MQTT_PRIORITY_COUNT
+};
+
+bool mqttSchedulerInit(esp_mqtt_client_handle_t client);
+// Copie le message dans la file de sa classe ; false si la file est pleine (compté en drop)
+bool mqttSchedulerSubmit(MqttPriority priority, const char* topic, const char* payload,
+                         size_t length, int qos, bool retained);
+// Tâche MQTT uniquement : publication immédiate sur le socket (pong depuis mqtt_callback)
+bool mqttSchedulerSendNow(MqttPriority priority, const char* topic, const char* payload,
+                          size_t length, int qos, bool retained);
+void mqttSchedulerDrain();            // loop() : files -> outbox esp-mqtt
+void mqttSchedulerDiscard();          // loop(), après une déconnexion : messages en attente abandonnés
+uint32_t mqttSchedulerDepth(MqttPriority priority);
+const char* mqttPriorityName(MqttPriority priority);
+void mqttSchedulerStatsToJson(JsonObject out);
+
+#endif // MQTT_SCHEDULER_H
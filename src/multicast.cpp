@@ -0,0 +1,173 @@
+#include "multicast.h"
+#include "config.h"
+#include "mqtt.h"
+#include "io_table.h"
+#include "io_command.h"
+#include "time_sync.h"
+#include <AsyncUDP.h>
+#include <mbedtls/md.h>
+#include <time.h>
+
+extern Config config;
+
+static AsyncUDP multicastUdp;
+
+// Fenêtre anti-rejeu par émetteur (même principe qu'IPsec) : bit i = seq (highest - i) déjà reçu
+struct SenderWindow {
+  uint32_t senderId;
+  uint32_t highestSeq;
+  uint64_t seen;
+  bool used;
+};
+static SenderWindow senders[MULTICAST_MAX_SENDERS];
+static uint8_t nextSenderSlot = 0;
+
+static struct MulticastStats {
+  uint32_t received = 0;
+  uint32_t executed = 0;
+  uint32_t scheduled = 0;
+  uint32_t duplicates = 0;
+  uint32_t badSignature = 0;
+  uint32_t malformed = 0;
+  uint32_t stale = 0;
+  uint32_t noClock = 0;
+  uint32_t notForUs = 0;
+} stats;
+
+static bool verifySignature(const MulticastFrame* frame) {
+  uint8_t digest[32];
+  const mbedtls_md_info_t* md = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+  if (mbedtls_md_hmac(md, (const unsigned char*)config.multicastKey, strlen(config.multicastKey),
+                      (const unsigned char*)frame, offsetof(MulticastFrame, mac), digest) != 0) {
+    return false;
+  }
+  // Comparaison en temps constant
+  uint8_t diff = 0;
+  for (int i = 0; i < MULTICAST_MAC_LEN; i++) diff |= digest[i] ^ frame->mac[i];
+  return diff == 0;
+}
+
+// Retourne true si (senderId, seq) n'a jamais été vu, et le marque comme vu
+static bool acceptSequence(uint32_t senderId, uint32_t seq) {
+  SenderWindow* w = NULL;
+  for (int i = 0; i < MULTICAST_MAX_SENDERS; i++) {
+    if (senders[i].used && senders[i].senderId == senderId) {
+      w = &senders[i];
+      break;
+    }
+  }
+  if (w == NULL) {
+    // Nouvel émetteur : remplace le plus ancien emplacement (tourniquet)
+    w = &senders[nextSenderSlot];
+    nextSenderSlot = (nextSenderSlot + 1) % MULTICAST_MAX_SENDERS;
+    w->used = true;
+    w->senderId = senderId;
+    w->highestSeq = seq;
+    w->seen = 1;
+    return true;
+  }
+
+  if (seq > w->highestSeq) {
+    uint32_t shift = seq - w->highestSeq;
+    w->seen = shift >= 64 ? 0 : (w->seen << shift);
+    w->seen |= 1;
+    w->highestSeq = seq;
+    return true;
+  }
+  uint32_t offset = w->highestSeq - seq;
+  if (offset >= 64) return false;  // Trop ancien pour la fenêtre
+  uint64_t bit = 1ULL << offset;
+  if (w->seen & bit) return false;
+  w->seen |= bit;
+  return true;
+}
+
+static void handlePacket(AsyncUDPPacket& packet) {
+  stats.received++;
+  if (packet.length() != sizeof(MulticastFrame)) {
+    stats.malformed++;
+    return;
+  }
+  MulticastFrame frame;
+  memcpy(&frame, packet.data(), sizeof(frame));
+  if (frame.magic != MULTICAST_MAGIC || frame.version != MULTICAST_VERSION) {
+    stats.malformed++;
+    return;
+  }
+  if (!verifySignature(&frame)) {
+    stats.badSignature++;
+    return;
+  }
+
+  // Anti-rejeu : la fenêtre de séquence est perdue au reboot ou à l'éviction d'un
+  // émetteur, seul l'âge de la trame arrête alors un rejeu. Sans heure, pas de contrôle
+  // d'âge possible : trame refusée.
+  if (timeQuality() == TIME_QUALITY_NONE) {
+    stats.noClock++;
+    return;
+  }
+  time_t now = time(nullptr);
+  if (labs((long)(now - (time_t)frame.sent_at)) > MULTICAST_MAX_AGE_S) {
+    stats.stale++;
+    return;
+  }
+  if (!acceptSequence(frame.senderId, frame.seq)) {
+    stats.duplicates++;
+    return;
+  }
+
+  frame.group[sizeof(frame.group) - 1] = '\0';
+  frame.pin[sizeof(frame.pin) - 1] = '\0';
+  if (frame.group[0] != '\0' && !isGroupMember(frame.group, strlen(frame.group))) {
+    stats.notForUs++;
+    return;
+  }
+
+  IoSnapshot table;
+  int i = ioIndexByName(*table, frame.pin, strlen(frame.pin));
+  if (i < 0 || table->mode[i] != 2) {
+    stats.notForUs++;
+    return;
+  }
+  // Exécutée par la tâche temps réel, qui publie l'état résultant sur MQTT
+  if (submitIoCommand(table->pin[i], frame.state, frame.exec_at, frame.exec_at_us)) {
+    if (frame.exec_at > 0) stats.scheduled++;
+    else stats.executed++;
+  }
+}
+
+void setupMulticast() {
+  if (!config.useMulticast) return;
+
+  if (strlen(config.multicastKey) == 0) {
+    Serial.println("⚠️ Multicast enabled without key - channel not started");
+    return;
+  }
+
+  IPAddress group;
+  if (!group.fromString(config.multicastGroup)) {
+    Serial.printf("⚠️ Invalid multicast group '%s'\n", config.multicastGroup);
+    return;
+  }
+
+  // Écoute sur toutes les interfaces (Ethernet ou WiFi selon le lien actif)
+  if (multicastUdp.listenMulticast(group, config.multicastPort)) {
+    multicastUdp.onPacket(handlePacket);
+    Serial.printf("✓ Multicast command channel on %s:%d\n", config.multicastGroup, config.multicastPort);
+  } else {
+    Serial.println("✗ Multicast listen failed");
+  }
+}
+
+void multicastStatsToJson(JsonObject out) {
+  out["enabled"] = config.useMulticast;
+  out["received"] = stats.received;
+  out["executed"] = stats.executed;
+  out["scheduled"] = stats.scheduled;
+  out["duplicates"] = stats.duplicates;
+  out["badSignature"] = stats.badSignature;
+  out["malformed"] = stats.malformed;
+  out["stale"] = stats.stale;
+  out["noClock"] = stats.noClock;
+  out["notForUs"] = stats.notForUs;
+}
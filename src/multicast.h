@@ -0,0 +1,40 @@
+#ifndef MULTICAST_H
+#define MULTICAST_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ===== CANAL DE COMMANDE UDP MULTICAST =====
+// Chemin rapide sans broker : une trame signée (HMAC-SHA256 tronqué) envoyée sur
+// le groupe multicast est reçue directement par tous les appareils du LAN.
+// Le compte-rendu d'exécution continue de passer par MQTT (<device>/status/<pin>).
+// Les trames sont refusées tant que l'horloge n'a jamais été synchronisée : la
+// fenêtre de séquence ne survit pas au reboot, seul l'âge de la trame arrête un rejeu.
+
+#define MULTICAST_MAGIC        0x434D4F49  // "IOMC" en little-endian
+#define MULTICAST_VERSION      1
+#define MULTICAST_MAC_LEN      16          // HMAC-SHA256 tronqué à 128 bits
+#define MULTICAST_MAX_SENDERS  8           // Émetteurs suivis pour l'anti-doublon
+#define MULTICAST_MAX_AGE_S    5           // Âge max d'une trame (complète la fenêtre de séquence)
+
+// Trame de commande (little-endian, 92 octets). La signature couvre tous les
+// champs qui la précèdent.
+struct __attribute__((packed)) MulticastFrame {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t state;          // 0 = LOW, 1 = HIGH
+  uint16_t reserved;
+  uint32_t senderId;      // Identifiant aléatoire de l'émetteur
+  uint32_t seq;           // Numéro de séquence, croissant par émetteur
+  uint32_t sent_at;       // Heure d'émission (s) - rejet des trames trop anciennes
+  uint32_t exec_at;       // 0 = exécution immédiate
+  uint32_t exec_at_us;
+  char group[16];         // "" = tous les appareils, sinon nom de groupe
+  char pin[32];           // Nom de la broche (comme dans les topics MQTT)
+  uint8_t mac[MULTICAST_MAC_LEN];
+};
+
+void setupMulticast();
+void multicastStatsToJson(JsonObject out);
+
+#endif // MULTICAST_H
@@ -0,0 +1,170 @@
+#include "ota_guard.h"
+#include "log_task.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define OTA_REPORT_MAGIC 0x4F544152   // "RATO" : rapport valide en RTC
+
+// Dernière mise à jour : en mémoire RTC, survit au redémarrage qui la termine
+struct OtaReport {
+  uint32_t magic;
+  uint32_t worstStallUs;
+  uint32_t lateCommands;
+  uint32_t maxLateUs;
+  uint32_t sectors;
+  uint32_t deferrals;
+  uint32_t durationMs;
+  uint32_t success;
+};
+RTC_NOINIT_ATTR static OtaReport lastReport;
+
+static volatile bool active = false;
+static uint32_t updates = 0;
+static unsigned long startedAt = 0;
+
+// Écrits par la tâche temps réel
+static volatile uint32_t nextDeadline = 0;       // esp_timer, 32 bits bas
+static volatile bool deadlinePending = false;
+static uint32_t lastTick = 0;
+static uint32_t worstStallUs = 0;                // Pendant l'OTA en cours (ou la dernière)
+static uint32_t baselineStallUs = 0;             // Hors OTA, pour comparaison
+static uint32_t lateCommands = 0;
+static uint32_t maxLateUs = 0;
+
+// Tâche AsyncTCP (écritures flash)
+static uint32_t sectors = 0;
+static uint32_t deferrals = 0;
+static uint32_t deferredMs = 0;
+static uint32_t gateTimeouts = 0;
+
+void otaGuardTick() {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  uint32_t gap = now - lastTick;
+  if (lastTick != 0) {
+    if (active) {
+      if (gap > worstStallUs) worstStallUs = gap;
+    } else if (gap > baselineStallUs) {
+      baselineStallUs = gap;
+    }
+  }
+  lastTick = now;
+}
+
+void otaGuardSetNextDeadline(int64_t inUs) {
+  if (inUs > OTA_DEADLINE_HORIZON_US) {
+    deadlinePending = false;
+    return;
+  }
+  nextDeadline = (uint32_t)esp_timer_get_time() + (uint32_t)inUs;
+  deadlinePending = true;
+}
+
+void otaGuardScheduledExecuted(int64_t lateUs) {
+  if (!active || lateUs <= OTA_LATE_THRESHOLD_US) return;
+  lateCommands++;
+  if (lateUs > maxLateUs) maxLateUs = lateUs > UINT32_MAX ? UINT32_MAX : (uint32_t)lateUs;
+}
+
+bool otaGuardActive() {
+  return active;
+}
+
+bool otaGuardRealtimeAlive() {
+  return lastTick != 0 && (uint32_t)esp_timer_get_time() - lastTick < 100000;
+}
+
+// Attend qu'aucune commande programmée ne tombe pendant la prochaine opération flash
+void otaGuardFlashWindow() {
+  unsigned long start = millis();
+  bool waited = false;
+  while (deadlinePending) {
+    // Négatif : échéance atteinte, exécutée au prochain tour de la tâche temps réel
+    int32_t remaining = (int32_t)(nextDeadline - (uint32_t)esp_timer_get_time());
+    if (remaining > OTA_FLASH_GUARD_US) break;
+    if (millis() - start >= OTA_GATE_MAX_WAIT_MS) {
+      gateTimeouts++;
+      break;
+    }
+    waited = true;
+    vTaskDelay(1);
+  }
+  if (waited) {
+    deferrals++;
+    deferredMs += millis() - start;
+  }
+}
+
+void otaGuardSectorWritten() {
+  sectors++;
+  vTaskDelay(pdMS_TO_TICKS(OTA_SECTOR_PAUSE_MS));
+}
+
+bool otaGuardBegin() {
+  if (active) return false;
+  sectors = 0;
+  deferrals = 0;
+  deferredMs = 0;
+  gateTimeouts = 0;
+  worstStallUs = 0;
+  lateCommands = 0;
+  maxLateUs = 0;
+  startedAt = millis();
+  updates++;
+  active = true;
+  logPrintf("📦 OTA started - flash writes gated around scheduled commands\n");
+  return true;
+}
+
+void otaGuardEnd(bool success) {
+  if (!active) return;
+  active = false;
+  lastReport.worstStallUs = worstStallUs;
+  lastReport.lateCommands = lateCommands;
+  lastReport.maxLateUs = maxLateUs;
+  lastReport.sectors = sectors;
+  lastReport.deferrals = deferrals;
+  lastReport.durationMs = millis() - startedAt;
+  lastReport.success = success;
+  lastReport.magic = OTA_REPORT_MAGIC;
+  logPrintf("%s OTA %s: %u sectors in %u ms, worst I/O stall %u us (baseline %u us), "
+            "%u late scheduled command(s) (max %u us), %u deferral(s)\n",
+            success ? "✅" : "❌", success ? "done" : "failed", sectors, lastReport.durationMs,
+            worstStallUs, baselineStallUs, lateCommands, maxLateUs, deferrals);
+}
+
+void setupOtaGuard() {
+  if (lastReport.magic == OTA_REPORT_MAGIC) {
+    Serial.printf("📦 Last OTA: %s, worst I/O stall %u us, %u late scheduled command(s)\n",
+                  lastReport.success ? "success" : "failed", lastReport.worstStallUs, lastReport.lateCommands);
+  }
+}
+
+static void reportToJson(JsonObject out, uint32_t stall, uint32_t late, uint32_t maxLate,
+                         uint32_t sectorCount, uint32_t deferralCount) {
+  out["worstStallUs"] = stall;
+  out["lateCommands"] = late;
+  out["maxLateUs"] = maxLate;
+  out["sectors"] = sectorCount;
+  out["deferrals"] = deferralCount;
+}
+
+void otaGuardStatsToJson(JsonObject out) {
+  out["active"] = (bool)active;
+  out["updates"] = updates;
+  out["baselineStallUs"] = baselineStallUs;
+  if (updates > 0) {
+    JsonObject current = out["current"].to<JsonObject>();
+    reportToJson(current, worstStallUs, lateCommands, maxLateUs, sectors, deferrals);
+    current["deferredMs"] = deferredMs;
+    current["gateTimeouts"] = gateTimeouts;
+  }
+  // Mise à jour qui a précédé ce démarrage
+  if (lastReport.magic == OTA_REPORT_MAGIC) {
+    JsonObject last = out["last"].to<JsonObject>();
+    reportToJson(last, lastReport.worstStallUs, lastReport.lateCommands, lastReport.maxLateUs,
+                 lastReport.sectors, lastReport.deferrals);
+    last["durationMs"] = lastReport.durationMs;
+    last["success"] = lastReport.success != 0;
+  }
+}
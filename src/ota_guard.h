@@ -0,0 +1,36 @@
+#ifndef OTA_GUARD_H
+#define OTA_GUARD_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== OTA SANS ARRÊT DU TEMPS RÉEL =====
+// Un effacement ou une écriture flash coupe le cache : l'autre core est parqué et
+// seules les interruptions en IRAM tournent, la tâche temps réel est donc suspendue
+// le temps de l'opération (jusqu'à quelques dizaines de ms par secteur effacé).
+// Avant chaque opération flash d'une mise à jour (/api/ota ou page ElegantOTA, voir
+// ota_update.h), la tâche AsyncTCP attend qu'aucune commande programmée ne tombe
+// dans les OTA_FLASH_GUARD_US à venir, et laisse OTA_SECTOR_PAUSE_MS à la tâche
+// temps réel après chaque secteur de 4 Ko. La tâche temps réel n'est pas en IRAM
+// (exécution, accusés, publication et journal sont en flash) : seule cette
+// fenêtre protège les échéances.
+
+void setupOtaGuard();   // Rapport de la mise à jour précédente (mémoire RTC)
+
+// Tâche AsyncTCP : écritures flash d'une mise à jour
+bool otaGuardBegin();             // false si une mise à jour est déjà en cours
+void otaGuardFlashWindow();       // Avant une opération flash : attend une fenêtre sans échéance
+void otaGuardSectorWritten();     // Après un secteur : pause laissée à la tâche temps réel
+void otaGuardEnd(bool success);
+
+// Tâche temps réel
+void otaGuardTick();                              // Début de chaque tour : arrêts mesurés
+void otaGuardSetNextDeadline(int64_t inUs);       // Prochaine commande programmée (INT64_MAX : aucune)
+void otaGuardScheduledExecuted(int64_t lateUs);   // Retard d'une commande programmée exécutée
+
+bool otaGuardActive();
+bool otaGuardRealtimeAlive();     // La tâche temps réel a tourné dans les 100 dernières ms
+void otaGuardStatsToJson(JsonObject out);
+
+#endif // OTA_GUARD_H
@@ -0,0 +1,557 @@
+#include "ota_update.h"
+#include "ota_guard.h"
+#include "mqtt.h"
+#include "log_task.h"
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include <mbedtls/sha256.h>
+#include <esp32/rom/miniz.h>
+
+#define IODP_MAGIC        0x50444F49   // "IODP" en little-endian
+#define IODP_VERSION      1
+#define IODP_HEADER_SIZE  80
+#define IODP_END          0
+#define IODP_COPY         1
+#define IODP_INSERT       2
+
+#define ESP_IMAGE_MAGIC   0xE9
+#define GZIP_ID1          0x1F
+#define GZIP_FHCRC        0x02
+#define GZIP_FEXTRA       0x04
+#define GZIP_FNAME        0x08
+#define GZIP_FCOMMENT     0x10
+
+enum OtaFormat : uint8_t { OTA_FORMAT_UNKNOWN = 0, OTA_FORMAT_IMAGE, OTA_FORMAT_DELTA, OTA_FORMAT_FILESYSTEM };
+
+enum GzipState : uint8_t {
+  GZ_FIXED = 0,     // ID1 ID2 CM FLG MTIME XFL OS
+  GZ_XLEN,
+  GZ_SKIP,          // FEXTRA, FHCRC
+  GZ_STRING,        // FNAME, FCOMMENT (terminés par 0)
+  GZ_INFLATE,
+  GZ_DONE           // CRC32 et taille ignorés : l'image est vérifiée en SHA-256
+};
+
+enum DeltaState : uint8_t { DELTA_HEADER = 0, DELTA_OP, DELTA_ARGS, DELTA_INSERT, DELTA_END };
+
+// Une mise à jour à la fois, allouée pour sa durée (~50 Ko dont 32 Ko de dictionnaire)
+struct OtaSession {
+  tinfl_decompressor inflator;
+  uint8_t dict[TINFL_LZ_DICT_SIZE];
+  size_t dictOffset;
+  uint8_t sector[SPI_FLASH_SEC_SIZE];
+  size_t sectorFill;
+  uint8_t copy[OTA_COPY_CHUNK];
+  mbedtls_sha256_context sha;
+  esp_ota_handle_t handle;
+  const esp_partition_t* running;
+  const esp_partition_t* target;
+  uint32_t targetOffset;              // Système de fichiers : prochain secteur à écrire
+  unsigned long startedAt;
+
+  bool gzip;
+  GzipState gzState;
+  uint8_t gzFlags;
+  uint16_t gzCount;
+  uint16_t gzRemaining;
+
+  OtaFormat format;
+  DeltaState deltaState;
+  uint8_t header[IODP_HEADER_SIZE];   // En-tête puis arguments des opérations
+  size_t headerFill;
+  uint8_t op;
+  uint32_t insertRemaining;
+  uint32_t sourceSize;
+  uint32_t targetSize;
+
+  uint8_t expected[32];
+  bool hasExpected;
+  uint32_t imageBytes;                // Reconstruits (hachés)
+};
+
+// Dernier envoi, lu par la réponse HTTP et GET /api/ota
+static struct {
+  int code;                 // 0 : aucun envoi
+  const char* message;
+  OtaFormat format;
+  bool gzip;
+  uint32_t received;
+  uint32_t written;
+  uint32_t copied;          // Patch : octets repris du firmware en cours
+  uint32_t inserted;
+  uint32_t durationMs;
+  char sha256[65];
+} result;
+
+static OtaSession* session = NULL;
+static volatile unsigned long rebootAt = 0;
+
+// Contrôle de santé après une mise à jour
+static bool pendingVerify = false;
+static unsigned long healthySince = 0;
+static const char* lastVerdict = "";
+
+// Arduino valide une image « à vérifier » dès le démarrage sauf si cette fonction
+// répond true : la validation est faite par otaUpdateLoop()
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+static const char* formatName(OtaFormat format) {
+  switch (format) {
+    case OTA_FORMAT_IMAGE: return "image";
+    case OTA_FORMAT_DELTA: return "delta";
+    case OTA_FORMAT_FILESYSTEM: return "filesystem";
+    default: return "unknown";
+  }
+}
+
+static inline uint32_t readLe32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void toHex(const uint8_t* bytes, size_t len, char* out) {
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < len; i++) {
+    out[2 * i] = digits[bytes[i] >> 4];
+    out[2 * i + 1] = digits[bytes[i] & 0x0F];
+  }
+  out[2 * len] = '\0';
+}
+
+static bool parseHex(const char* hex, uint8_t* out, size_t len) {
+  if (strlen(hex) != 2 * len) return false;
+  for (size_t i = 0; i < 2 * len; i++) {
+    char c = hex[i];
+    int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    if (v < 0) return false;
+    if (i & 1) out[i / 2] |= v;
+    else out[i / 2] = v << 4;
+  }
+  return true;
+}
+
+static void closeSession(bool success) {
+  if (!session) return;
+  result.durationMs = millis() - session->startedAt;
+  mbedtls_sha256_free(&session->sha);
+  free(session);
+  session = NULL;
+  otaGuardEnd(success);
+}
+
+static bool fail(int code, const char* message) {
+  if (session) {
+    if (session->handle) esp_ota_abort(session->handle);
+    closeSession(false);
+  }
+  result.code = code;
+  result.message = message;
+  logPrintf("❌ OTA rejected: %s\n", message);
+  return false;
+}
+
+static bool flushSector() {
+  OtaSession* s = session;
+  otaGuardFlashWindow();
+  esp_err_t err;
+  if (s->format == OTA_FORMAT_FILESYSTEM) {
+    // Effacement et écriture du secteur dans la même fenêtre
+    err = esp_partition_erase_range(s->target, s->targetOffset, sizeof(s->sector));
+    if (err == ESP_OK) err = esp_partition_write(s->target, s->targetOffset, s->sector, s->sectorFill);
+    s->targetOffset += sizeof(s->sector);
+  } else {
+    err = esp_ota_write(s->handle, s->sector, s->sectorFill);
+  }
+  if (err != ESP_OK) return fail(400, esp_err_to_name(err));
+  result.written += s->sectorFill;
+  s->sectorFill = 0;
+  otaGuardSectorWritten();
+  return true;
+}
+
+// Dernier étage : octets de l'image finale
+static bool emitImage(const uint8_t* data, size_t len) {
+  OtaSession* s = session;
+  if (s->imageBytes + len > s->target->size) return fail(400, "Image trop grande pour la partition OTA");
+  mbedtls_sha256_update(&s->sha, data, len);
+  s->imageBytes += len;
+  while (len > 0) {
+    size_t n = min(len, sizeof(s->sector) - s->sectorFill);
+    memcpy(s->sector + s->sectorFill, data, n);
+    s->sectorFill += n;
+    data += n;
+    len -= n;
+    if (s->sectorFill == sizeof(s->sector) && !flushSector()) return false;
+  }
+  return true;
+}
+
+// Lecture du firmware en cours : le cache est aussi coupé, même fenêtre que les écritures
+static bool readRunning(uint32_t offset, size_t len) {
+  otaGuardFlashWindow();
+  return esp_partition_read(session->running, offset, session->copy, len) == ESP_OK;
+}
+
+static bool deltaStart() {
+  OtaSession* s = session;
+  const uint8_t* h = s->header;
+  if (readLe32(h) != IODP_MAGIC || readLe32(h + 4) != IODP_VERSION) return fail(400, "En-tête de patch invalide");
+  s->sourceSize = readLe32(h + 8);
+  s->targetSize = readLe32(h + 44);
+  if (s->sourceSize > s->running->size) return fail(409, "Patch prévu pour un autre firmware");
+  if (s->targetSize > s->target->size) return fail(400, "Image trop grande pour la partition OTA");
+
+  // Le patch ne s'applique qu'au firmware dont il a été calculé
+  mbedtls_sha256_context source;
+  mbedtls_sha256_init(&source);
+  mbedtls_sha256_starts(&source, 0);
+  bool readOk = true;
+  for (uint32_t offset = 0; offset < s->sourceSize && readOk; offset += OTA_COPY_CHUNK) {
+    size_t n = min((size_t)(s->sourceSize - offset), sizeof(s->copy));
+    readOk = readRunning(offset, n);
+    if (readOk) mbedtls_sha256_update(&source, s->copy, n);
+  }
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&source, digest);
+  mbedtls_sha256_free(&source);
+  if (!readOk) return fail(500, "Lecture du firmware en cours impossible");
+  if (memcmp(digest, h + 12, 32) != 0) return fail(409, "Patch prévu pour un autre firmware");
+
+  if (!s->hasExpected) {
+    memcpy(s->expected, h + 48, 32);
+    s->hasExpected = true;
+  }
+  return true;
+}
+
+static bool deltaCopy(uint32_t offset, uint32_t len) {
+  OtaSession* s = session;
+  if (offset > s->sourceSize || len > s->sourceSize - offset) return fail(400, "COPY hors du firmware source");
+  while (len > 0) {
+    size_t n = min((size_t)len, sizeof(s->copy));
+    if (!readRunning(offset, n)) return fail(500, "Lecture du firmware en cours impossible");
+    if (!emitImage(s->copy, n)) return false;
+    result.copied += n;
+    offset += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool deltaFeed(const uint8_t* data, size_t len) {
+  OtaSession* s = session;
+  size_t i = 0;
+  while (i < len) {
+    switch (s->deltaState) {
+      case DELTA_HEADER:
+      case DELTA_ARGS: {
+        size_t need = s->deltaState == DELTA_HEADER ? IODP_HEADER_SIZE : s->op == IODP_COPY ? 8 : 4;
+        size_t n = min(len - i, need - s->headerFill);
+        memcpy(s->header + s->headerFill, data + i, n);
+        s->headerFill += n;
+        i += n;
+        if (s->headerFill < need) break;
+        if (s->deltaState == DELTA_HEADER) {
+          if (!deltaStart()) return false;
+          s->deltaState = DELTA_OP;
+        } else if (s->op == IODP_COPY) {
+          if (!deltaCopy(readLe32(s->header), readLe32(s->header + 4))) return false;
+          s->deltaState = DELTA_OP;
+        } else {
+          s->insertRemaining = readLe32(s->header);
+          s->deltaState = s->insertRemaining ? DELTA_INSERT : DELTA_OP;
+        }
+        break;
+      }
+      case DELTA_OP:
+        s->op = data[i++];
+        s->headerFill = 0;
+        if (s->op == IODP_END) s->deltaState = DELTA_END;
+        else if (s->op == IODP_COPY || s->op == IODP_INSERT) s->deltaState = DELTA_ARGS;
+        else return fail(400, "Opération de patch inconnue");
+        break;
+      case DELTA_INSERT: {
+        size_t n = min(len - i, (size_t)s->insertRemaining);
+        if (!emitImage(data + i, n)) return false;
+        result.inserted += n;
+        s->insertRemaining -= n;
+        i += n;
+        if (s->insertRemaining == 0) s->deltaState = DELTA_OP;
+        break;
+      }
+      case DELTA_END:
+        return fail(400, "Données après la fin du patch");
+    }
+  }
+  return true;
+}
+
+// Octets décompressés : image ou patch, reconnu au premier octet
+static bool emitDecoded(const uint8_t* data, size_t len) {
+  OtaSession* s = session;
+  if (s->format == OTA_FORMAT_UNKNOWN) {
+    if (data[0] == ESP_IMAGE_MAGIC) s->format = OTA_FORMAT_IMAGE;
+    else if (data[0] == (IODP_MAGIC & 0xFF)) s->format = OTA_FORMAT_DELTA;
+    else return fail(400, "Format inconnu (image, gzip ou patch IODP attendu)");
+    result.format = s->format;
+  }
+  return s->format == OTA_FORMAT_IMAGE ? emitImage(data, len) : deltaFeed(data, len);
+}
+
+static void nextGzipField() {
+  OtaSession* s = session;
+  s->gzCount = 0;
+  s->gzRemaining = 0;
+  if (s->gzFlags & GZIP_FEXTRA) {
+    s->gzFlags &= ~GZIP_FEXTRA;
+    s->gzState = GZ_XLEN;
+  } else if (s->gzFlags & (GZIP_FNAME | GZIP_FCOMMENT)) {
+    s->gzFlags &= (s->gzFlags & GZIP_FNAME) ? ~GZIP_FNAME : ~GZIP_FCOMMENT;
+    s->gzState = GZ_STRING;
+  } else if (s->gzFlags & GZIP_FHCRC) {
+    s->gzFlags &= ~GZIP_FHCRC;
+    s->gzRemaining = 2;
+    s->gzState = GZ_SKIP;
+  } else {
+    tinfl_init(&s->inflator);
+    s->gzState = GZ_INFLATE;
+  }
+}
+
+// En-tête gzip (RFC 1952), octet par octet : il peut être coupé entre deux morceaux
+static size_t gzipHeaderFeed(const uint8_t* data, size_t len) {
+  OtaSession* s = session;
+  size_t i = 0;
+  while (i < len && s->gzState < GZ_INFLATE) {
+    uint8_t b = data[i++];
+    switch (s->gzState) {
+      case GZ_FIXED:
+        if ((s->gzCount == 1 && b != 0x8B) || (s->gzCount == 2 && b != 8)) {
+          fail(400, "En-tête gzip invalide (deflate attendu)");
+          return len;
+        }
+        if (s->gzCount == 3) s->gzFlags = b;
+        if (++s->gzCount == 10) nextGzipField();
+        break;
+      case GZ_XLEN:
+        s->gzRemaining |= (uint16_t)b << (8 * s->gzCount);
+        if (++s->gzCount == 2) {
+          s->gzState = GZ_SKIP;
+          if (s->gzRemaining == 0) nextGzipField();
+        }
+        break;
+      case GZ_SKIP:
+        if (--s->gzRemaining == 0) nextGzipField();
+        break;
+      case GZ_STRING:
+        if (b == 0) nextGzipField();
+        break;
+      default:
+        break;
+    }
+  }
+  return i;
+}
+
+static bool inflateFeed(const uint8_t* data, size_t len) {
+  OtaSession* s = session;
+  size_t used = 0;
+  for (;;) {
+    size_t inSize = len - used;
+    size_t outSize = TINFL_LZ_DICT_SIZE - s->dictOffset;
+    tinfl_status status = tinfl_decompress(&s->inflator, data + used, &inSize, s->dict, s->dict + s->dictOffset,
+                                           &outSize, TINFL_FLAG_HAS_MORE_INPUT);
+    used += inSize;
+    if (outSize > 0 && !emitDecoded(s->dict + s->dictOffset, outSize)) return false;
+    s->dictOffset = (s->dictOffset + outSize) & (TINFL_LZ_DICT_SIZE - 1);
+    if (status == TINFL_STATUS_DONE) {
+      s->gzState = GZ_DONE;
+      return true;
+    }
+    if (status < TINFL_STATUS_DONE) return fail(400, "Flux gzip invalide");
+    if (status == TINFL_STATUS_NEEDS_MORE_INPUT && used >= len) return true;
+  }
+}
+
+static bool begin(const char* expectedSha256, bool filesystem) {
+  closeSession(false);   // Envoi précédent interrompu sans déconnexion
+  memset(&result, 0, sizeof(result));
+  result.message = "";
+
+  uint8_t expected[32];
+  bool hasExpected = expectedSha256 && *expectedSha256;
+  if (hasExpected && !parseHex(expectedSha256, expected, sizeof(expected))) {
+    return fail(400, "sha256 : 64 caractères hexadécimaux attendus");
+  }
+  if (!otaGuardBegin()) return fail(503, "Mise à jour déjà en cours");
+
+  session = (OtaSession*)malloc(sizeof(OtaSession));
+  if (!session) {
+    otaGuardEnd(false);
+    return fail(503, "Mémoire insuffisante pour la mise à jour");
+  }
+  memset(session, 0, sizeof(OtaSession));
+  session->startedAt = millis();
+  session->hasExpected = hasExpected;
+  if (hasExpected) memcpy(session->expected, expected, sizeof(expected));
+  mbedtls_sha256_init(&session->sha);
+  mbedtls_sha256_starts(&session->sha, 0);
+
+  if (filesystem) {
+    session->format = OTA_FORMAT_FILESYSTEM;
+    result.format = OTA_FORMAT_FILESYSTEM;
+    session->target = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+    if (!session->target) return fail(500, "Pas de partition SPIFFS");
+    logPrintf("📦 Filesystem upload to partition %s\n", session->target->label);
+    return true;
+  }
+  session->running = esp_ota_get_running_partition();
+  session->target = esp_ota_get_next_update_partition(NULL);
+  if (!session->running || !session->target) return fail(500, "Pas de partition OTA inactive");
+  // Effacement secteur par secteur au fil des écritures (pas d'effacement global
+  // de la partition, qui arrêterait la tâche temps réel pendant des secondes)
+  esp_err_t err = esp_ota_begin(session->target, OTA_WITH_SEQUENTIAL_WRITES, &session->handle);
+  if (err != ESP_OK) {
+    session->handle = 0;
+    return fail(500, esp_err_to_name(err));
+  }
+  logPrintf("📦 OTA upload to partition %s\n", session->target->label);
+  return true;
+}
+
+static void complete() {
+  OtaSession* s = session;
+  if (s->gzip && s->gzState != GZ_DONE) { fail(400, "Flux gzip tronqué"); return; }
+  if (s->format == OTA_FORMAT_DELTA && s->deltaState != DELTA_END) { fail(400, "Patch tronqué"); return; }
+  if (s->format == OTA_FORMAT_UNKNOWN || s->imageBytes == 0) { fail(400, "Fichier vide"); return; }
+  if (s->sectorFill > 0 && !flushSector()) return;
+
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&s->sha, digest);
+  toHex(digest, sizeof(digest), result.sha256);
+  if (s->format == OTA_FORMAT_DELTA && s->imageBytes != s->targetSize) {
+    fail(400, "Taille de l'image reconstruite incorrecte");
+    return;
+  }
+  if (s->hasExpected && memcmp(digest, s->expected, sizeof(digest)) != 0) {
+    fail(400, "Empreinte SHA-256 différente de celle attendue");
+    return;
+  }
+
+  if (s->format == OTA_FORMAT_FILESYSTEM) {
+    result.code = 200;
+    result.message = "Système de fichiers écrit, redémarrage";
+    logPrintf("✅ Filesystem image written (%u bytes) - rebooting\n", result.written);
+    closeSession(true);
+    rebootAt = millis() + OTA_REBOOT_DELAY_MS;
+    return;
+  }
+
+  // Vérifie aussi l'en-tête et la somme de contrôle du format d'image ESP32
+  esp_err_t err = esp_ota_end(s->handle);
+  s->handle = 0;
+  if (err == ESP_OK) err = esp_ota_set_boot_partition(s->target);
+  if (err != ESP_OK) { fail(400, esp_err_to_name(err)); return; }
+
+  result.code = 200;
+  result.message = "Image vérifiée, redémarrage";
+  logPrintf("✅ OTA %s%s verified (%u bytes received, %u written, sha256 %.16s...) - rebooting\n",
+            s->gzip ? "gzip " : "", formatName(s->format), result.received, result.written, result.sha256);
+  closeSession(true);
+  rebootAt = millis() + OTA_REBOOT_DELAY_MS;
+}
+
+void otaUpdateReceive(const char* expectedSha256, size_t index, const uint8_t* data, size_t len, bool final,
+                      bool filesystem) {
+  if (index == 0 && !begin(expectedSha256, filesystem)) return;
+  if (!session) return;   // Envoi déjà rejeté : le reste est ignoré
+  result.received += len;
+
+  size_t i = 0;
+  if (len > 0 && index == 0 && session->format != OTA_FORMAT_FILESYSTEM) {
+    session->gzip = data[0] == GZIP_ID1;
+    result.gzip = session->gzip;
+  }
+  if (session->format == OTA_FORMAT_FILESYSTEM) {
+    if (len > 0) emitImage(data, len);   // Image SPIFFS écrite telle quelle
+  } else if (session->gzip) {
+    if (session->gzState < GZ_INFLATE) i = gzipHeaderFeed(data, len);
+    if (session && session->gzState == GZ_INFLATE && i < len) inflateFeed(data + i, len - i);
+  } else if (len > 0) {
+    emitDecoded(data, len);
+  }
+  if (final && session) complete();
+}
+
+void otaUpdateAbort() {
+  if (session) fail(400, "Envoi interrompu");
+}
+
+int otaUpdateResultToJson(JsonObject out) {
+  int code = result.code ? result.code : 400;
+  out["success"] = code == 200;
+  out["message"] = result.code ? result.message : "Aucun fichier reçu";
+  out["format"] = formatName(result.format);
+  out["gzip"] = result.gzip;
+  out["received"] = result.received;
+  out["written"] = result.written;
+  if (result.format == OTA_FORMAT_DELTA) {
+    out["copied"] = result.copied;
+    out["inserted"] = result.inserted;
+  }
+  if (result.sha256[0]) out["sha256"] = result.sha256;
+  out["durationMs"] = result.durationMs;
+  return code;
+}
+
+void setupOtaUpdate() {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state;
+  if (running && esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+    pendingVerify = true;
+    Serial.printf("📦 New firmware on %s - health check pending (%u s)\n", running->label,
+                  OTA_HEALTH_TIMEOUT_MS / 1000);
+  }
+}
+
+void otaUpdateLoop(bool networkOk) {
+  unsigned long now = millis();
+  if (rebootAt != 0 && (long)(now - rebootAt) >= 0) {
+    ESP.restart();
+  }
+  if (!pendingVerify) return;
+
+  bool healthy = networkOk && (!mqttEnabled || mqttConnected()) && otaGuardRealtimeAlive();
+  if (!healthy) {
+    healthySince = 0;
+  } else if (healthySince == 0) {
+    healthySince = now;
+  }
+
+  if (healthySince != 0 && now - healthySince >= OTA_HEALTH_STABLE_MS) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    pendingVerify = false;
+    lastVerdict = "valid";
+    logPrintf("✅ New firmware confirmed after health check\n");
+  } else if (now >= OTA_HEALTH_TIMEOUT_MS) {
+    lastVerdict = "rollback";
+    logPrintf("❌ Health check failed (network %d, MQTT %d, I/O task %d) - rolling back\n",
+              networkOk, mqttConnected(), otaGuardRealtimeAlive());
+    vTaskDelay(pdMS_TO_TICKS(100));   // Laisse la tâche de log écrire la ligne
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+  }
+}
+
+void otaUpdateStatusToJson(JsonObject out) {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_partition_t* next = esp_ota_get_next_update_partition(NULL);
+  out["running"] = running ? running->label : "";
+  out["next"] = next ? next->label : "";
+  out["pendingVerify"] = pendingVerify;
+  if (pendingVerify) out["healthyMs"] = healthySince ? millis() - healthySince : 0;
+  else if (lastVerdict[0]) out["verdict"] = lastVerdict;
+  out["inProgress"] = session != NULL;
+  if (result.code) otaUpdateResultToJson(out["last"].to<JsonObject>());
+}
@@ -0,0 +1,48 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== MISE À JOUR COMPRESSÉE ET DIFFÉRENTIELLE =====
+// POST /api/ota reçoit, reconnu à son premier octet :
+//   - une image brute (0xE9),
+//   - une image gzip, décompressée au fil de l'eau (tinfl, en ROM),
+//   - un patch IODP (ota_delta.py) contre le firmware en cours, gzip ou non.
+// L'image reconstruite est hachée en SHA-256 au passage et écrite secteur par
+// secteur dans la partition OTA inactive (écritures placées par ota_guard.h). Elle
+// n'est activée que si son empreinte est celle attendue (?sha256=, ou celle du patch).
+// Au redémarrage, le nouveau firmware reste « à vérifier » : si réseau, MQTT (s'il
+// est configuré) et tâche temps réel ne sont pas stables pendant OTA_HEALTH_STABLE_MS
+// avant OTA_HEALTH_TIMEOUT_MS, ou s'il redémarre avant, le bootloader revient à
+// l'ancien firmware.
+//
+// La page ElegantOTA (/update) envoie aussi ici : /ota/start et /ota/upload sont
+// déclarées avant ElegantOTA.begin() et passent par ce même chemin, écritures placées
+// comprises (l'empreinte MD5 de la page est ignorée, l'image ESP32 porte sa propre
+// somme de contrôle). En mode système de fichiers, l'image est écrite telle quelle
+// dans la partition SPIFFS.
+//
+// Patch IODP (little-endian) :
+//   en-tête (80 octets) : "IODP", u32 version (1), u32 taille source, u8[32] SHA-256
+//                         source, u32 taille cible, u8[32] SHA-256 cible
+//   opérations : u8 code puis arguments
+//     1 COPY   u32 offset, u32 longueur  octets du firmware en cours
+//     2 INSERT u32 longueur, octets      octets littéraux
+//     0 END
+
+void setupOtaUpdate();   // État de la partition courante (contrôle de santé à faire ?)
+
+// Tâche AsyncTCP : un morceau du fichier reçu (index = position dans le fichier).
+// expectedSha256 (64 caractères hexadécimaux ou NULL) et filesystem ne sont lus qu'au
+// premier morceau.
+void otaUpdateReceive(const char* expectedSha256, size_t index, const uint8_t* data, size_t len, bool final,
+                      bool filesystem = false);
+void otaUpdateAbort();                      // Client déconnecté pendant l'envoi
+int otaUpdateResultToJson(JsonObject out);  // Après le dernier morceau : code HTTP
+
+void otaUpdateLoop(bool networkOk);         // Tâche réseau : contrôle de santé, redémarrage
+void otaUpdateStatusToJson(JsonObject out);
+
+#endif // OTA_UPDATE_H
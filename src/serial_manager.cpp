@@ -1,7 +1,9 @@
 #include "serial_manager.h"
 #include "config.h"
 #include "mqtt.h"
+#include "log_task.h"
 #include <time.h>
+#include <esp_timer.h>
 #include <ArduinoJson.h>
 
 extern Config config;
@@ -11,13 +13,32 @@ SerialManager serialManager;
 
 SerialManager::SerialManager() {
     _serial = &Serial2; // Use Serial2 for external communication
+    _logHead = 0;
+    _logCount = 0;
+    _logMutex = NULL;
+    _txRing = NULL;
+    _rxLength = 0;
+    _txDropped = 0;
+    _lent = false;
+    _lendAcked = false;
+    _rpcQueue = NULL;
+    _rpcCount = 0;
+    memset(&_rpcStats, 0, sizeof(_rpcStats));
 }
 
 void SerialManager::begin() {
+    if (!_logMutex) _logMutex = xSemaphoreCreateMutex();
     if (config.useSerialBridge) {
+        if (!_txRing) _txRing = xRingbufferCreate(SERIAL_TX_QUEUE_BYTES, RINGBUF_TYPE_NOSPLIT);
+        if (!_rpcQueue) _rpcQueue = xQueueCreate(SERIAL_RPC_QUEUE_LENGTH, sizeof(SerialRpcRequest));
         const int rxPin = 5;
         const int txPin = 17;
         long baud = config.serialBaudRate > 0 ? config.serialBaudRate : 9600;
+        if (config.useSerialServer) {
+            // Serveur TCP : les tampons du pilote absorbent les à-coups du réseau à 921600 bauds
+            _serial->setRxBufferSize(SERIAL_SERVER_UART_RX_BYTES);
+            _serial->setTxBufferSize(SERIAL_SERVER_UART_TX_BYTES);
+        }
 
         _serial->begin(baud, SERIAL_8N1, rxPin, txPin);
         Serial.printf("Serial Bridge started on RX:%d, TX:%d at %ld baud\n", rxPin, txPin, baud);
@@ -27,81 +48,374 @@ void SerialManager::begin() {
 void SerialManager::loop() {
     if (!config.useSerialBridge) return;
 
-    if (_serial->available()) {
-        String msg = _serial->readStringUntil('\n');
-        msg.trim();
+    // Messages déposés par send() depuis les autres tâches
+    size_t length = 0;
+    char* pending;
+    if (_lent) {
+        // Session TCP en cours : rien n'est lu ni émis, les requêtes RPC expirent
+        _rxLength = 0;
+        _lendAcked = true;
+        while (_txRing && (pending = (char*)xRingbufferReceive(_txRing, &length, 0)) != NULL) {
+            vRingbufferReturnItem(_txRing, pending);
+            _txDropped++;
+        }
+        _rpcLoop();
+        return;
+    }
+    _lendAcked = false;
+    while (_txRing && (pending = (char*)xRingbufferReceive(_txRing, &length, 0)) != NULL) {
+        _transmit(pending, length - 1);   // Éléments stockés avec leur '\0'
+        vRingbufferReturnItem(_txRing, pending);
+    }
+
+    // Requêtes RPC : prise en charge, émission, timeouts
+    _rpcLoop();
 
-        if (msg.length() > 0) {
-            addLog("RX", msg);
-            Serial.println("Serial Bridge RX: " + msg);
-            publish(msg);
+    // Lecture caractère par caractère : readStringUntil() bloquait jusqu'au timeout
+    // de Serial2 (1 s) sur une ligne incomplète
+    while (_serial->available()) {
+        char c = _serial->read();
+        int head = _rpcHead();
+        const SerialRpcRequest* request = head >= 0 ? &_rpc[head].request : NULL;
+        // Réponse de longueur fixe : octets bruts, sans découpage en lignes
+        if (request && request->length > 0) {
+            _rxLine[_rxLength++] = c;
+            if (_rxLength >= request->length) {
+                addLog("RX", _rxLine, _rxLength);
+                _rpcComplete(head, "ok", _rxLine, _rxLength);
+                _rxLength = 0;
+            }
+            continue;
         }
+        if (c != (request ? request->terminator : '\n')) {
+            if (_rxLength < sizeof(_rxLine) - 1) _rxLine[_rxLength++] = c;
+            continue;
+        }
+        _receiveLine();
     }
 }
 
-void SerialManager::send(String message) {
+void SerialManager::_receiveLine() {
+    // Espaces (et \r) retirés aux deux extrémités, sur place
+    while (_rxLength > 0 && isspace((unsigned char)_rxLine[_rxLength - 1])) _rxLength--;
+    _rxLine[_rxLength] = '\0';
+    const char* line = _rxLine;
+    while (isspace((unsigned char)*line)) line++;
+    size_t length = _rxLine + _rxLength - line;
+    if (*line != '\0') {
+        addLog("RX", line, length);
+        // Réponse à une requête RPC, sinon ligne publiée sur <device>/serial/receive
+        if (!_rpcOnLine(line, length)) {
+            logPrintf("Serial Bridge RX: %s\n", line);
+            publish(line);
+        }
+    }
+    _rxLength = 0;
+}
+
+bool SerialManager::lendPort(uint32_t timeoutMs) {
+    _lent = true;
+    if (!config.useSerialBridge) return true;   // Tâche série inactive
+    for (uint32_t waited = 0; !_lendAcked; waited++) {
+        if (waited >= timeoutMs) {
+            _lent = false;
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return true;
+}
+
+void SerialManager::_transmit(const char* message, size_t length) {
+    _serial->write((const uint8_t*)message, length);
+    _serial->println();
+    addLog("TX", message, length);
+    logPrintf("Serial Bridge TX: %s\n", message);
+}
+
+void SerialManager::send(const char* message, size_t length) {
     if (!config.useSerialBridge) return;
 
-    _serial->println(message);
-    addLog("TX", message);
-    Serial.println("Serial Bridge TX: " + message);
+    if (_txRing == NULL) {
+        _transmit(message, length);
+        return;
+    }
+    // Élément stocké avec son '\0' : copié en deux fois dans l'emplacement réservé
+    void* slot = NULL;
+    if (xRingbufferSendAcquire(_txRing, &slot, length + 1, 0) == pdTRUE) {
+        memcpy(slot, message, length);
+        ((char*)slot)[length] = '\0';
+        xRingbufferSendComplete(_txRing, slot);
+    } else {
+        _txDropped++;
+        logPrintf("⚠️ Serial Bridge TX queue full - message dropped\n");
+    }
+}
+
+// Copie `in` en chaîne JSON échappée (sans les guillemets), tronquée à `size`
+static void jsonEscape(char* out, size_t size, const char* in) {
+    size_t n = 0;
+    for (; *in && n + 7 < size; in++) {
+        unsigned char c = *in;
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = c;
+        } else if (c < 0x20) {
+            n += snprintf(out + n, size - n, "\\u%04x", c);
+        } else {
+            out[n++] = c;
+        }
+    }
+    out[n] = '\0';
 }
 
-void SerialManager::publish(String message) {
+void SerialManager::publish(const char* message) {
     if (!config.useSerialBridge) return;
 
     // Publish received message to MQTT
-    if (mqttEnabled && mqttClient.connected()) {
+    if (mqttEnabled && mqttConnected()) {
         char topic[128];
         snprintf(topic, sizeof(topic), "%s/serial/receive", config.deviceName);
 
-        JsonDocument doc;
-        doc["message"] = message;
-        
         time_t now;
         time(&now);
         struct tm timeinfo;
         localtime_r(&now, &timeinfo);
         char timeStr[25];
         strftime(timeStr, sizeof(timeStr), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
-        doc["timestamp"] = timeStr;
 
-        char payload[256];
-        serializeJson(doc, payload);
+        // Sérialisé à la main : ni document JSON ni String sur ce chemin
+        char escaped[SERIAL_LINE_LENGTH];
+        jsonEscape(escaped, sizeof(escaped), message);
+        char payload[SERIAL_LINE_LENGTH + 64];
+        snprintf(payload, sizeof(payload), "{\"message\":\"%s\",\"timestamp\":\"%s\"}", escaped, timeStr);
         
-        Serial.printf("Publishing serial RX to topic [%s]: %s\n", topic, payload);
-        publishMQTT(topic, payload);
+        logPrintf("Publishing serial RX to topic [%s]: %s\n", topic, payload);
+        publishMQTT(topic, payload, false, 0, MQTT_PRIORITY_BULK);
     } else {
-        Serial.println("MQTT not connected or disabled - serial message not published");
+        logPrintf("MQTT not connected or disabled - serial message not published\n");
+    }
+}
+
+// ===== RPC =====
+
+// Motif de réponse : '*' (suite quelconque) et '?' (un caractère), sans allocation
+static bool globMatch(const char* pattern, const char* text, size_t length) {
+    const char* star = NULL;
+    size_t i = 0, resume = 0;
+    while (i < length) {
+        if (*pattern == '*') {
+            star = ++pattern;
+            resume = i;
+        } else if (*pattern != '\0' && (*pattern == '?' || *pattern == text[i])) {
+            pattern++;
+            i++;
+        } else if (star) {
+            pattern = star;
+            i = ++resume;
+        } else {
+            return false;
+        }
     }
+    while (*pattern == '*') pattern++;
+    return *pattern == '\0';
+}
+
+bool SerialManager::rpcSubmit(const SerialRpcRequest& request) {
+    return _rpcQueue != NULL && xQueueSend(_rpcQueue, &request, 0) == pdTRUE;
+}
+
+void SerialManager::rpcReject(const char* id, const char* result) {
+    _rpcStats.dropped++;
+    if (!mqttEnabled || !mqttConnected()) return;
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/serial/rpc/reply", config.deviceName);
+    char escaped[COMMAND_ID_LENGTH * 2];
+    jsonEscape(escaped, sizeof(escaped), id);
+    char payload[128];
+    snprintf(payload, sizeof(payload), "{\"id\":\"%s\",\"result\":\"%s\"}", escaped, result);
+    publishMQTT(topic, payload, false, 1, MQTT_PRIORITY_REALTIME);
 }
 
-void SerialManager::addLog(String direction, String message) {
-    SerialLog log;
-    
+int SerialManager::_rpcHead() const {
+    for (int i = 0; i < _rpcCount; i++) {
+        if (_rpc[i].sentUs != 0) return i;
+    }
+    return -1;
+}
+
+void SerialManager::_rpcLoop() {
+    if (_rpcQueue == NULL) return;
+    int64_t now = esp_timer_get_time();
+    while (_rpcCount < SERIAL_RPC_MAX_PENDING) {
+        RpcSlot& slot = _rpc[_rpcCount];
+        if (xQueueReceive(_rpcQueue, &slot.request, 0) != pdTRUE) break;
+        slot.queuedUs = now;
+        slot.sentUs = 0;
+        _rpcCount++;
+    }
+
+    // Timeout compté depuis l'émission, ou depuis l'arrivée si jamais émise
+    int head = _rpcHead();
+    for (int i = 0; i < _rpcCount;) {
+        RpcSlot& slot = _rpc[i];
+        int64_t since = slot.sentUs ? slot.sentUs : slot.queuedUs;
+        if (now - since < (int64_t)slot.request.timeoutMs * 1000) {
+            i++;
+            continue;
+        }
+        // La plus ancienne requête émise emporte ce qui a été reçu jusque-là
+        if (i == head && _rxLength > 0) {
+            _rxLine[_rxLength] = '\0';
+            _rpcComplete(i, "timeout", _rxLine, _rxLength);
+            _rxLength = 0;
+        } else {
+            _rpcComplete(i, slot.sentUs ? "timeout" : "expired", NULL, 0);
+        }
+        head = _rpcHead();
+    }
+    _rpcTransmitReady();
+}
+
+// Émission dans l'ordre d'arrivée : une requête attend les réponses de toutes les
+// précédentes, sauf si elle et les requêtes en cours devant elle sont "pipeline"
+void SerialManager::_rpcTransmitReady() {
+    if (_lent) return;
+    bool outstanding = false;
+    bool exclusive = false;
+    for (int i = 0; i < _rpcCount; i++) {
+        RpcSlot& slot = _rpc[i];
+        if (slot.sentUs == 0) {
+            if (exclusive || (outstanding && !slot.request.pipeline)) return;
+            slot.sentUs = esp_timer_get_time();
+            _serial->write((const uint8_t*)slot.request.message, slot.request.messageLength);
+            _serial->write((const uint8_t*)slot.request.eol, strlen(slot.request.eol));
+            addLog("TX", slot.request.message, slot.request.messageLength);
+            _rpcStats.requests++;
+        }
+        outstanding = true;
+        if (!slot.request.pipeline) exclusive = true;
+    }
+}
+
+bool SerialManager::_rpcOnLine(const char* line, size_t length) {
+    bool waiting = false;
+    for (int i = 0; i < _rpcCount; i++) {
+        const SerialRpcRequest& request = _rpc[i].request;
+        if (_rpc[i].sentUs == 0 || request.length > 0) continue;
+        waiting = true;
+        if (request.match[0] == '\0' || globMatch(request.match, line, length)) {
+            _rpcComplete(i, "ok", line, length);
+            return true;
+        }
+    }
+    if (waiting) _rpcStats.unsolicited++;
+    return false;
+}
+
+void SerialManager::_rpcComplete(int index, const char* result, const char* reply, size_t length) {
+    RpcSlot& slot = _rpc[index];
+    uint32_t rttUs = slot.sentUs ? (uint32_t)(esp_timer_get_time() - slot.sentUs) : 0;
+    if (strcmp(result, "ok") == 0) {
+        _rpcStats.replies++;
+        _rpcStats.rttLastUs = rttUs;
+        _rpcStats.rttSumUs += rttUs;
+        if (_rpcStats.replies == 1 || rttUs < _rpcStats.rttMinUs) _rpcStats.rttMinUs = rttUs;
+        if (rttUs > _rpcStats.rttMaxUs) _rpcStats.rttMaxUs = rttUs;
+        static const uint32_t bounds[] = { 1000, 5000, 10000, 50000, 100000 };
+        int bucket = 0;
+        while (bucket < 5 && rttUs >= bounds[bucket]) bucket++;
+        _rpcStats.rttHistogram[bucket]++;
+    } else {
+        _rpcStats.timeouts++;
+        logPrintf("⚠️ Serial RPC %s: %s\n", slot.request.id, result);
+    }
+
+    if (mqttEnabled && mqttConnected()) {
+        char topic[128];
+        snprintf(topic, sizeof(topic), "%s/serial/rpc/reply", config.deviceName);
+        char id[COMMAND_ID_LENGTH * 2];
+        jsonEscape(id, sizeof(id), slot.request.id);
+        // Sérialisé à la main dans un tampon de la tâche série
+        size_t size = sizeof(_rpcPayload);
+        int n = snprintf(_rpcPayload, size, "{\"id\":\"%s\",\"result\":\"%s\",\"rtt_us\":%u",
+                         id, result, rttUs);
+        if (reply && length > 0) {
+            if (slot.request.length > 0) {
+                // Réponse binaire : hexadécimal
+                n += snprintf(_rpcPayload + n, size - n, ",\"reply_hex\":\"");
+                for (size_t i = 0; i < length && n + 4 < (int)size; i++) {
+                    n += snprintf(_rpcPayload + n, size - n, "%02x", (uint8_t)reply[i]);
+                }
+            } else {
+                // Ligne terminée par '\0' (_receiveLine, timeout)
+                n += snprintf(_rpcPayload + n, size - n, ",\"reply\":\"");
+                jsonEscape(_rpcPayload + n, size - n - 3, reply);
+                n += strlen(_rpcPayload + n);
+            }
+            n += snprintf(_rpcPayload + n, size - n, "\"");
+        }
+        snprintf(_rpcPayload + n, size - n, "}");
+        publishMQTT(topic, _rpcPayload, false, 1, MQTT_PRIORITY_REALTIME);
+    }
+
+    // Retrait en conservant l'ordre d'arrivée
+    memmove(&_rpc[index], &_rpc[index + 1], (_rpcCount - index - 1) * sizeof(RpcSlot));
+    _rpcCount--;
+}
+
+void SerialManager::rpcStatsToJson(JsonObject out) {
+    out["requests"] = _rpcStats.requests;
+    out["replies"] = _rpcStats.replies;
+    out["timeouts"] = _rpcStats.timeouts;
+    out["dropped"] = _rpcStats.dropped;
+    out["unsolicited"] = _rpcStats.unsolicited;
+    out["pending"] = _rpcCount;
+    JsonObject rtt = out["rttUs"].to<JsonObject>();
+    rtt["min"] = _rpcStats.replies ? _rpcStats.rttMinUs : 0;
+    rtt["avg"] = _rpcStats.replies ? (uint32_t)(_rpcStats.rttSumUs / _rpcStats.replies) : 0;
+    rtt["max"] = _rpcStats.rttMaxUs;
+    rtt["last"] = _rpcStats.rttLastUs;
+    static const char* labels[] = { "<1ms", "<5ms", "<10ms", "<50ms", "<100ms", ">=100ms" };
+    JsonObject histogram = out["rttHistogram"].to<JsonObject>();
+    for (int i = 0; i < 6; i++) histogram[labels[i]] = _rpcStats.rttHistogram[i];
+}
+
+void SerialManager::addLog(const char* direction, const char* message, size_t length) {
     time_t now;
     time(&now);
     struct tm timeinfo;
     localtime_r(&now, &timeinfo);
-    char timeStr[20];
-    strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
-    
-    log.timestamp = String(timeStr);
-    log.direction = direction;
-    log.message = message;
-    
-    _logs.push_back(log);
-    
-    // Keep only last 50 logs
-    if (_logs.size() > 50) {
-        _logs.erase(_logs.begin());
-    }
+
+    if (_logMutex) xSemaphoreTake(_logMutex, portMAX_DELAY);
+    // Anneau de SERIAL_LOG_ENTRIES : la plus ancienne entrée est écrasée
+    SerialLog& log = _logs[_logHead];
+    strftime(log.timestamp, sizeof(log.timestamp), "%H:%M:%S", &timeinfo);
+    strlcpy(log.direction, direction, sizeof(log.direction));
+    if (length >= sizeof(log.message)) length = sizeof(log.message) - 1;
+    memcpy(log.message, message, length);
+    log.message[length] = '\0';
+    _logHead = (_logHead + 1) % SERIAL_LOG_ENTRIES;
+    if (_logCount < SERIAL_LOG_ENTRIES) _logCount++;
+    if (_logMutex) xSemaphoreGive(_logMutex);
 }
 
-std::vector<SerialLog> SerialManager::getLogs() {
-    return _logs;
+void SerialManager::logsToJson(JsonArray out) {
+    if (_logMutex) xSemaphoreTake(_logMutex, portMAX_DELAY);
+    int first = (_logHead - _logCount + SERIAL_LOG_ENTRIES) % SERIAL_LOG_ENTRIES;
+    for (int i = 0; i < _logCount; i++) {
+        const SerialLog& log = _logs[(first + i) % SERIAL_LOG_ENTRIES];
+        JsonObject entry = out.add<JsonObject>();
+        entry["timestamp"] = log.timestamp;
+        entry["direction"] = log.direction;
+        entry["message"] = log.message;
+    }
+    if (_logMutex) xSemaphoreGive(_logMutex);
 }
 
 void SerialManager::clearLogs() {
-    _logs.clear();
+    if (_logMutex) xSemaphoreTake(_logMutex, portMAX_DELAY);
+    _logHead = 0;
+    _logCount = 0;
+    if (_logMutex) xSemaphoreGive(_logMutex);
 }
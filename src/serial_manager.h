@@ -2,28 +2,107 @@
 #define SERIAL_MANAGER_H
 
 #include <Arduino.h>
-#include <vector>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include "config.h"
 
 struct SerialLog {
-    String timestamp;
-    String direction; // "TX" or "RX"
-    String message;
+    char timestamp[9];   // HH:MM:SS
+    char direction[10];  // "TX", "RX" ou "RX (Sim)"
+    char message[SERIAL_LOG_MESSAGE_LENGTH];
+};
+
+// ===== RPC SÉRIE =====
+// <device>/serial/rpc : requête corrélée par "id". La réponse est reconnue sur la
+// carte (ligne jusqu'au terminateur, filtrée par un motif, ou longueur fixe) et
+// publiée sur <device>/serial/rpc/reply avec le temps d'aller-retour, ou un timeout.
+// Les requêtes "pipeline" sont émises sans attendre la réponse des précédentes ;
+// une ligne reçue va à la plus ancienne requête émise dont le motif l'accepte.
+struct SerialRpcRequest {
+    char id[COMMAND_ID_LENGTH];
+    char message[SERIAL_RPC_MESSAGE_LENGTH];
+    uint16_t messageLength;
+    char eol[3];                 // Ajouté au message émis ("\r\n" par défaut)
+    char terminator;             // Fin de la réponse en mode ligne ('\n' par défaut)
+    char match[SERIAL_RPC_MATCH_LENGTH];   // Motif de la réponse (* et ?), vide = toute ligne
+    uint16_t length;             // > 0 : réponse binaire de longueur fixe (publiée en hexadécimal)
+    uint32_t timeoutMs;
+    bool pipeline;
+};
+
+struct SerialRpcStats {
+    uint32_t requests;
+    uint32_t replies;
+    uint32_t timeouts;
+    uint32_t dropped;            // File pleine ou requête invalide
+    uint32_t unsolicited;        // Lignes reçues pendant une requête, sans requête correspondante
+    uint32_t rttMinUs;
+    uint32_t rttMaxUs;
+    uint32_t rttLastUs;
+    uint64_t rttSumUs;
+    uint32_t rttHistogram[6];    // < 1, 5, 10, 50, 100 ms, au-delà
 };
 
 class SerialManager {
 public:
     SerialManager();
     void begin();
-    void loop();
-    void send(String message);
-    void publish(String message);
-    std::vector<SerialLog> getLogs();
+    void loop();                 // Tâche série : émission des messages en file, lecture non bloquante
+    // Mise en file (appelable depuis MQTT ou le web, ne bloque pas, n'alloue pas)
+    void send(const char* message, size_t length);
+    void send(const char* message) { send(message, strlen(message)); }
+    void publish(const char* message);
+    void logsToJson(JsonArray out);
     void clearLogs();
-    void addLog(String direction, String message);
+    void addLog(const char* direction, const char* message, size_t length);
+    // RPC : mise en file depuis la tâche MQTT (false si la file est pleine)
+    bool rpcSubmit(const SerialRpcRequest& request);
+    void rpcReject(const char* id, const char* result);
+    bool rpcBusy() const { return _rpcCount > 0; }
+    void rpcStatsToJson(JsonObject out);
+    // Serveur TCP (serial_server.h) ou maître Modbus : l'UART leur est prêtée
+    bool lendPort(uint32_t timeoutMs);   // true quand la tâche série a cessé de la lire
+    bool portLent() const { return _lent; }
+    void reclaimPort() {
+        _lendAcked = false;
+        _lent = false;
+    }
 
 private:
     HardwareSerial* _serial;
-    std::vector<SerialLog> _logs;
+    // Historique circulaire : lu par le web, écrit par les tâches série et MQTT
+    SerialLog _logs[SERIAL_LOG_ENTRIES];
+    int _logHead;                  // Prochaine entrée écrite
+    int _logCount;
+    SemaphoreHandle_t _logMutex;
+    RingbufHandle_t _txRing;
+    char _rxLine[SERIAL_LINE_LENGTH];
+    size_t _rxLength;
+    uint32_t _txDropped;
+    volatile bool _lent;           // Demandé par le serveur TCP ou le maître Modbus
+    volatile bool _lendAcked;      // Constaté par la tâche série
+    void _transmit(const char* message, size_t length);
+    void _receiveLine();
+
+    // RPC (tâche série) : requêtes en cours par ordre d'arrivée
+    struct RpcSlot {
+        SerialRpcRequest request;
+        int64_t queuedUs;
+        int64_t sentUs;          // 0 : pas encore émise
+    };
+    QueueHandle_t _rpcQueue;
+    RpcSlot _rpc[SERIAL_RPC_MAX_PENDING];
+    int _rpcCount;
+    SerialRpcStats _rpcStats;
+    char _rpcPayload[SERIAL_LINE_LENGTH * 2 + 160];
+    void _rpcLoop();
+    void _rpcTransmitReady();
+    bool _rpcOnLine(const char* line, size_t length);
+    void _rpcComplete(int slot, const char* result, const char* reply, size_t length);
+    int _rpcHead() const;        // Plus ancienne requête émise, -1 si aucune
 };
 
 extern SerialManager serialManager;
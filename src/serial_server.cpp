@@ -0,0 +1,585 @@
+#include "serial_server.h"
+#include "serial_manager.h"
+#include "alloc_audit.h"
+#include "log_task.h"
+#include <lwip/sockets.h>
+#include <driver/uart.h>
+#include <esp_timer.h>
+
+extern Config config;
+
+// Telnet (RFC 854)
+enum : uint8_t {
+  TN_SE = 240, TN_SB = 250, TN_WILL = 251, TN_WONT = 252, TN_DO = 253, TN_DONT = 254, TN_IAC = 255,
+  TN_BINARY = 0, TN_SGA = 3, TN_COM_PORT = 44,
+};
+// COM-PORT-OPTION (RFC 2217) : commandes du client, réponses du serveur = code + 100
+enum : uint8_t {
+  CPO_SIGNATURE = 0, CPO_SET_BAUDRATE = 1, CPO_SET_DATASIZE = 2, CPO_SET_PARITY = 3,
+  CPO_SET_STOPSIZE = 4, CPO_SET_CONTROL = 5, CPO_FLOWCONTROL_SUSPEND = 8, CPO_FLOWCONTROL_RESUME = 9,
+  CPO_SET_LINESTATE_MASK = 10, CPO_SET_MODEMSTATE_MASK = 11, CPO_PURGE_DATA = 12,
+  CPO_SERVER_OFFSET = 100,
+};
+
+static TaskHandle_t serverTaskHandle = NULL;
+static int listenSocket = -1;
+static int clientSocket = -1;
+static volatile bool active = false;
+
+// UART -> TCP : octets lus et pas encore acceptés par le socket. En RFC 2217, lus dans
+// la seconde moitié puis recopiés sur place dans la première avec 0xFF doublé.
+static uint8_t toNet[SERIAL_SERVER_CHUNK * 2];
+static size_t toNetLength = 0;
+static size_t toNetOffset = 0;
+static bool suspended = false;             // FLOWCONTROL-SUSPEND du client
+// TCP -> UART
+static uint8_t fromNet[SERIAL_SERVER_CHUNK];
+static uint8_t toUart[SERIAL_SERVER_CHUNK];
+
+// Ligne de la session, valeurs RFC 2217 (parité 1 = aucune, 2 = impaire, 3 = paire ;
+// stop 1 = 1 bit, 2 = 2 bits, 3 = 1,5 bit)
+static struct LineSettings {
+  uint32_t baud;
+  uint8_t dataBits;
+  uint8_t parity;
+  uint8_t stopBits;
+} line;
+static bool lineChanged = false;
+
+// Analyse telnet des octets du client
+enum TelnetState : uint8_t { TS_DATA, TS_IAC, TS_OPTION, TS_SB, TS_SB_IAC };
+static TelnetState tnState = TS_DATA;
+static uint8_t tnVerb = 0;
+static uint8_t sb[48];
+static size_t sbLength = 0;
+static bool sbOverflow = false;
+static uint8_t localOptions = 0;           // Options actives de notre côté (bits de optionBit())
+static uint8_t remoteOptions = 0;          // ... et du côté du client
+
+static struct SerialServerStats {
+  uint32_t connections = 0;
+  uint32_t rejected = 0;
+  uint32_t lineChanges = 0;
+  uint64_t toNetBytes = 0;
+  uint64_t toUartBytes = 0;
+  uint32_t toNetRate = 0;                  // Octets/s sur la dernière seconde
+  uint32_t toUartRate = 0;
+  uint32_t toNetPeak = 0;
+  uint32_t toUartPeak = 0;
+  uint32_t uartRxHighWater = 0;            // Maximum en attente dans le tampon RX du pilote
+  int64_t connectedAt = 0;
+  char peer[16] = "";
+} stats;
+static int64_t windowStartUs = 0;
+static uint32_t windowToNet = 0;
+static uint32_t windowToUart = 0;
+
+// ===== LIGNE SÉRIE =====
+
+static void applyLine() {
+  uart_set_baudrate(SERIAL_BRIDGE_UART, line.baud);
+  uart_set_word_length(SERIAL_BRIDGE_UART, (uart_word_length_t)(UART_DATA_5_BITS + (line.dataBits - 5)));
+  uart_set_parity(SERIAL_BRIDGE_UART, line.parity == 2 ? UART_PARITY_ODD
+                                      : line.parity == 3 ? UART_PARITY_EVEN : UART_PARITY_DISABLE);
+  uart_set_stop_bits(SERIAL_BRIDGE_UART, line.stopBits == 2 ? UART_STOP_BITS_2
+                                         : line.stopBits == 3 ? UART_STOP_BITS_1_5 : UART_STOP_BITS_1);
+}
+
+// Configuration enregistrée (celle de SerialManager::begin())
+static void defaultLine() {
+  line.baud = config.serialBaudRate > 0 ? config.serialBaudRate : 9600;
+  line.dataBits = 8;
+  line.parity = 1;
+  line.stopBits = 1;
+}
+
+// ===== ÉMISSION VERS LE CLIENT =====
+
+// Envoie ce qui reste de toNet sans bloquer : 1 tout est parti, 0 socket plein, -1 erreur
+static int sendPending() {
+  while (toNetOffset < toNetLength) {
+    int sent;
+    {
+      // pbufs lwIP alloués par la pile pour chaque segment : comptés à part
+      AllocAuditExempt exempt;
+      sent = send(clientSocket, toNet + toNetOffset, toNetLength - toNetOffset, MSG_DONTWAIT);
+    }
+    if (sent > 0) {
+      toNetOffset += sent;
+      continue;
+    }
+    return sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+  }
+  toNetOffset = 0;
+  toNetLength = 0;
+  return 1;
+}
+
+static bool waitWritable(uint32_t timeoutMs) {
+  fd_set writable;
+  FD_ZERO(&writable);
+  FD_SET(clientSocket, &writable);
+  struct timeval tv = { 0, (long)timeoutMs * 1000 };
+  return select(clientSocket + 1, NULL, &writable, NULL, &tv) > 0;
+}
+
+// Réponses telnet / RFC 2217 : après les données en attente, pour ne pas couper un
+// 0xFF doublé. Attente bornée : le client est censé lire ce qu'il a demandé.
+static void sendControl(const uint8_t* data, size_t length) {
+  for (int result; (result = sendPending()) != 1;) {
+    if (result < 0 || !waitWritable(100)) return;   // Erreur : constatée par recv()
+  }
+  size_t offset = 0;
+  while (offset < length) {
+    int sent;
+    {
+      AllocAuditExempt exempt;
+      sent = send(clientSocket, data + offset, length - offset, MSG_DONTWAIT);
+    }
+    if (sent > 0) {
+      offset += sent;
+    } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(100)) {
+      continue;
+    } else {
+      return;
+    }
+  }
+}
+
+// ===== TELNET / RFC 2217 =====
+
+static uint8_t optionBit(uint8_t option) {
+  switch (option) {
+    case TN_BINARY:   return 1;
+    case TN_SGA:      return 2;
+    case TN_COM_PORT: return 4;
+    default:          return 0;
+  }
+}
+
+// Pas de réponse à une demande qui correspond déjà à l'état courant (RFC 854) :
+// c'est ce qui évite les boucles de négociation
+static void negotiate(uint8_t verb, uint8_t option) {
+  uint8_t bit = optionBit(option);
+  uint8_t reply = 0;
+  switch (verb) {
+    case TN_DO:
+      if (!bit) reply = TN_WONT;
+      else if (!(localOptions & bit)) { localOptions |= bit; reply = TN_WILL; }
+      break;
+    case TN_DONT:
+      if (localOptions & bit) { localOptions &= ~bit; reply = TN_WONT; }
+      break;
+    case TN_WILL:
+      if (!bit) reply = TN_DONT;
+      else if (!(remoteOptions & bit)) { remoteOptions |= bit; reply = TN_DO; }
+      break;
+    case TN_WONT:
+      if (remoteOptions & bit) { remoteOptions &= ~bit; reply = TN_DONT; }
+      break;
+  }
+  if (reply) {
+    uint8_t out[3] = { TN_IAC, reply, option };
+    sendControl(out, sizeof(out));
+  }
+}
+
+static void comPortReply(uint8_t command, const uint8_t* value, size_t length) {
+  uint8_t out[6 + 2 * 40];
+  size_t n = 0;
+  out[n++] = TN_IAC;
+  out[n++] = TN_SB;
+  out[n++] = TN_COM_PORT;
+  out[n++] = command + CPO_SERVER_OFFSET;
+  for (size_t i = 0; i < length && n + 4 <= sizeof(out); i++) {
+    out[n++] = value[i];
+    if (value[i] == TN_IAC) out[n++] = TN_IAC;
+  }
+  out[n++] = TN_IAC;
+  out[n++] = TN_SE;
+  sendControl(out, n);
+}
+
+static void comPortReplyByte(uint8_t command, uint8_t value) {
+  comPortReply(command, &value, 1);
+}
+
+// Une commande COM-PORT-OPTION : valeur 0 = question, sinon demande. La réponse
+// porte toujours la valeur en vigueur (une demande non prise en charge la laisse inchangée).
+static void comPortCommand(const uint8_t* data, size_t length) {
+  uint8_t command = data[0];
+  uint8_t value = length > 1 ? data[1] : 0;
+  switch (command) {
+    case CPO_SIGNATURE: {
+      char signature[40];
+      int n = snprintf(signature, sizeof(signature), "ESP32 IO Controller %s", config.deviceName);
+      comPortReply(command, (const uint8_t*)signature, min(n, (int)sizeof(signature) - 1));
+      break;
+    }
+    case CPO_SET_BAUDRATE: {
+      if (length >= 5) {
+        uint32_t baud = ((uint32_t)data[1] << 24) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 8) | data[4];
+        if (baud >= 300 && baud <= 5000000 && baud != line.baud) {
+          line.baud = baud;
+          lineChanged = true;
+          stats.lineChanges++;
+          applyLine();
+        }
+      }
+      uint8_t out[4] = { (uint8_t)(line.baud >> 24), (uint8_t)(line.baud >> 16),
+                         (uint8_t)(line.baud >> 8), (uint8_t)line.baud };
+      comPortReply(command, out, sizeof(out));
+      break;
+    }
+    case CPO_SET_DATASIZE:
+    case CPO_SET_PARITY:
+    case CPO_SET_STOPSIZE: {
+      // Parités MARK (4) et SPACE (5) : pas sur l'UART de l'ESP32
+      uint8_t* field = command == CPO_SET_DATASIZE ? &line.dataBits
+                     : command == CPO_SET_PARITY ? &line.parity : &line.stopBits;
+      bool valid = command == CPO_SET_DATASIZE ? (value >= 5 && value <= 8) : (value >= 1 && value <= 3);
+      if (valid && value != *field) {
+        *field = value;
+        lineChanged = true;
+        stats.lineChanges++;
+        applyLine();
+      }
+      comPortReplyByte(command, *field);
+      break;
+    }
+    case CPO_SET_CONTROL:
+      // Ni contrôle de flux matériel ni lignes modem câblés : le client lit l'état réel
+      if (value <= 3) comPortReplyByte(command, 1);            // Flux sortant : aucun
+      else if (value <= 6) comPortReplyByte(command, 6);       // BREAK : inactif
+      else if (value == 7) comPortReplyByte(command, 8);       // DTR : actif
+      else if (value == 10) comPortReplyByte(command, 11);     // RTS : actif
+      else if (value >= 13) comPortReplyByte(command, 14);     // Flux entrant : aucun
+      else comPortReplyByte(command, value);
+      break;
+    case CPO_FLOWCONTROL_SUSPEND:
+      suspended = true;      // La réception reste dans le tampon du pilote UART
+      break;
+    case CPO_FLOWCONTROL_RESUME:
+      suspended = false;
+      break;
+    case CPO_SET_LINESTATE_MASK:
+    case CPO_SET_MODEMSTATE_MASK:
+      comPortReplyByte(command, value);   // Aucune notification n'est émise
+      break;
+    case CPO_PURGE_DATA:
+      // 1 = réception, 2 = émission (déjà confiée au pilote : non purgeable), 3 = les deux
+      if (value == 1 || value == 3) {
+        uart_flush_input(SERIAL_BRIDGE_UART);
+        toNetOffset = 0;
+        toNetLength = 0;
+      }
+      comPortReplyByte(command, value);
+      break;
+    default:
+      break;
+  }
+}
+
+static void sbAppend(uint8_t c) {
+  if (sbLength < sizeof(sb)) sb[sbLength++] = c;
+  else sbOverflow = true;
+}
+
+// Octets du client -> données pour l'UART (IAC IAC = 0xFF), commandes traitées au passage
+static size_t telnetReceive(const uint8_t* in, size_t length, uint8_t* out) {
+  size_t n = 0;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t c = in[i];
+    switch (tnState) {
+      case TS_DATA:
+        if (c == TN_IAC) tnState = TS_IAC;
+        else out[n++] = c;
+        break;
+      case TS_IAC:
+        if (c == TN_IAC) {
+          out[n++] = c;
+          tnState = TS_DATA;
+        } else if (c >= TN_WILL) {
+          tnVerb = c;
+          tnState = TS_OPTION;
+        } else if (c == TN_SB) {
+          sbLength = 0;
+          sbOverflow = false;
+          tnState = TS_SB;
+        } else {
+          tnState = TS_DATA;   // NOP, AYT, BRK... ignorés
+        }
+        break;
+      case TS_OPTION:
+        negotiate(tnVerb, c);
+        tnState = TS_DATA;
+        break;
+      case TS_SB:
+        if (c == TN_IAC) tnState = TS_SB_IAC;
+        else sbAppend(c);
+        break;
+      case TS_SB_IAC:
+        if (c == TN_IAC) {
+          sbAppend(c);
+          tnState = TS_SB;
+        } else {
+          if (c == TN_SE && !sbOverflow && sbLength >= 2 && sb[0] == TN_COM_PORT) {
+            comPortCommand(sb + 1, sbLength - 1);
+          }
+          tnState = TS_DATA;
+        }
+        break;
+    }
+  }
+  return n;
+}
+
+// Recopie sur place de toNet[CHUNK..CHUNK+length) vers toNet[0..), 0xFF doublé.
+// L'écriture ne rattrape jamais la lecture : au pire 2 * length <= 2 * CHUNK.
+static size_t telnetEscape(size_t length) {
+  const uint8_t* in = toNet + SERIAL_SERVER_CHUNK;
+  size_t n = 0;
+  for (size_t i = 0; i < length; i++) {
+    toNet[n++] = in[i];
+    if (in[i] == TN_IAC) toNet[n++] = TN_IAC;
+  }
+  return n;
+}
+
+// ===== SESSION =====
+
+static void closeClient(const char* reason) {
+  {
+    AllocAuditExempt exempt;
+    closesocket(clientSocket);
+  }
+  clientSocket = -1;
+  toNetOffset = 0;
+  toNetLength = 0;
+  if (lineChanged) {
+    defaultLine();
+    applyLine();
+    lineChanged = false;
+  }
+  active = false;
+  serialManager.reclaimPort();
+  logPrintf("🔌 Serial TCP client %s disconnected (%s)\n", stats.peer, reason);
+}
+
+static void acceptClient() {
+  struct sockaddr_in peer;
+  socklen_t peerLength = sizeof(peer);
+  int s;
+  {
+    AllocAuditExempt exempt;
+    s = accept(listenSocket, (struct sockaddr*)&peer, &peerLength);
+  }
+  if (s < 0) return;
+
+  if (clientSocket >= 0 || !serialManager.lendPort(50)) {
+    AllocAuditExempt exempt;
+    closesocket(s);
+    stats.rejected++;
+    return;
+  }
+
+  clientSocket = s;
+  int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  // Client disparu sans FIN (câble, coupure) : port libéré en ~25 s
+  setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+#ifdef TCP_KEEPIDLE
+  int idle = 10, interval = 5, count = 3;
+  setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+  setsockopt(s, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+  setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#endif
+  fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+
+  inet_ntop(AF_INET, &peer.sin_addr, stats.peer, sizeof(stats.peer));
+  stats.connections++;
+  stats.connectedAt = esp_timer_get_time();
+  defaultLine();
+  lineChanged = false;
+  suspended = false;
+  toNetOffset = 0;
+  toNetLength = 0;
+  // Le client ne reçoit que ce qui arrive après sa connexion
+  uart_flush_input(SERIAL_BRIDGE_UART);
+  active = true;
+  logPrintf("🔌 Serial TCP client %s connected\n", stats.peer);
+
+  if (config.serialServerRfc2217) {
+    tnState = TS_DATA;
+    localOptions = optionBit(TN_BINARY) | optionBit(TN_SGA) | optionBit(TN_COM_PORT);
+    remoteOptions = optionBit(TN_BINARY) | optionBit(TN_SGA);
+    const uint8_t offer[] = {
+      TN_IAC, TN_WILL, TN_BINARY, TN_IAC, TN_DO, TN_BINARY,
+      TN_IAC, TN_WILL, TN_SGA, TN_IAC, TN_DO, TN_SGA,
+      TN_IAC, TN_WILL, TN_COM_PORT,
+    };
+    sendControl(offer, sizeof(offer));
+  }
+}
+
+// TCP -> UART. uart_write_bytes() attend la place dans le tampon TX du pilote : tant
+// qu'il est plein, le socket n'est plus lu et la fenêtre TCP freine le client.
+static void pumpNetToUart() {
+  int received;
+  {
+    AllocAuditExempt exempt;
+    received = recv(clientSocket, fromNet, sizeof(fromNet), MSG_DONTWAIT);
+  }
+  if (received == 0) {
+    closeClient("closed");
+    return;
+  }
+  if (received < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) closeClient("error");
+    return;
+  }
+  const uint8_t* data = fromNet;
+  size_t length = received;
+  if (config.serialServerRfc2217) {
+    length = telnetReceive(fromNet, received, toUart);
+    data = toUart;
+  }
+  if (length > 0) {
+    uart_write_bytes(SERIAL_BRIDGE_UART, data, length);
+    stats.toUartBytes += length;
+    windowToUart += length;
+  }
+}
+
+// UART -> TCP. Socket plein : rien n'est lu, la réception attend dans le tampon du pilote.
+static void pumpUartToNet() {
+  int pending = sendPending();
+  if (pending < 0) {
+    closeClient("error");
+    return;
+  }
+  if (pending == 0 || suspended) return;
+  size_t buffered = 0;
+  uart_get_buffered_data_len(SERIAL_BRIDGE_UART, &buffered);
+  if (buffered > stats.uartRxHighWater) stats.uartRxHighWater = buffered;
+  if (buffered == 0) return;
+
+  bool telnet = config.serialServerRfc2217;
+  uint8_t* raw = telnet ? toNet + SERIAL_SERVER_CHUNK : toNet;
+  int n = uart_read_bytes(SERIAL_BRIDGE_UART, raw, min(buffered, (size_t)SERIAL_SERVER_CHUNK), 0);
+  if (n <= 0) return;
+  stats.toNetBytes += n;
+  windowToNet += n;
+  toNetLength = telnet ? telnetEscape(n) : n;
+  toNetOffset = 0;
+  sendPending();
+}
+
+static void updateRates(int64_t now) {
+  int64_t elapsed = now - windowStartUs;
+  if (elapsed < 1000000) return;
+  stats.toNetRate = (uint32_t)((uint64_t)windowToNet * 1000000 / elapsed);
+  stats.toUartRate = (uint32_t)((uint64_t)windowToUart * 1000000 / elapsed);
+  if (stats.toNetRate > stats.toNetPeak) stats.toNetPeak = stats.toNetRate;
+  if (stats.toUartRate > stats.toUartPeak) stats.toUartPeak = stats.toUartRate;
+  windowToNet = 0;
+  windowToUart = 0;
+  windowStartUs = now;
+}
+
+static void serialServerTask(void* pvParameters) {
+  Serial.println("✅ Serial TCP server task started.");
+  allocAuditRegisterTask();
+  for (;;) {
+    // Sans client : bloquée sur le socket d'écoute. Avec client : réveillée par
+    // l'arrivée de données TCP, sinon au tick suivant pour relever l'UART.
+    int watched = clientSocket >= 0 ? clientSocket : listenSocket;
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(watched, &readable);
+    FD_SET(listenSocket, &readable);
+    struct timeval tv = { 0, clientSocket >= 0 ? 1000 : 100000 };
+    int ready = select(max(watched, listenSocket) + 1, &readable, NULL, NULL, &tv);
+
+    if (ready > 0 && FD_ISSET(listenSocket, &readable)) acceptClient();
+    if (clientSocket >= 0) {
+      pumpNetToUart();
+      if (clientSocket >= 0) pumpUartToNet();
+    }
+    updateRates(esp_timer_get_time());
+    allocAuditIteration();
+  }
+}
+
+void setupSerialServer() {
+  if (!config.useSerialServer || serverTaskHandle) return;
+  if (!config.useSerialBridge) {
+    Serial.println("⚠️ Serial TCP server needs the serial bridge - not started");
+    return;
+  }
+  if (config.useModbus) {
+    Serial.println("⚠️ Serial TCP server: Serial2 is used by the Modbus master - not started");
+    return;
+  }
+
+  listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+  if (listenSocket < 0) {
+    Serial.println("✗ Serial TCP server: socket failed");
+    return;
+  }
+  int one = 1;
+  setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(config.serialServerPort);
+  if (bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, 1) != 0) {
+    Serial.printf("✗ Serial TCP server: port %d unavailable\n", config.serialServerPort);
+    closesocket(listenSocket);
+    listenSocket = -1;
+    return;
+  }
+  fcntl(listenSocket, F_SETFL, fcntl(listenSocket, F_GETFL, 0) | O_NONBLOCK);
+
+  windowStartUs = esp_timer_get_time();
+  xTaskCreatePinnedToCore(serialServerTask, "SerialSrvTask", SERIAL_SERVER_STACK_SIZE, NULL,
+                          SERIAL_SERVER_TASK_PRIORITY, &serverTaskHandle, SERVICE_TASK_CORE);
+  Serial.printf("✓ Serial TCP server on port %d (%s)\n", config.serialServerPort,
+                config.serialServerRfc2217 ? "RFC 2217" : "raw");
+}
+
+bool serialServerActive() {
+  return active;
+}
+
+void serialServerStatsToJson(JsonObject out) {
+  out["enabled"] = config.useSerialServer && serverTaskHandle != NULL;
+  out["port"] = config.serialServerPort;
+  out["mode"] = config.serialServerRfc2217 ? "rfc2217" : "raw";
+  out["connected"] = (bool)active;
+  if (active) {
+    out["client"] = stats.peer;
+    out["connectedSec"] = (uint32_t)((esp_timer_get_time() - stats.connectedAt) / 1000000);
+    JsonObject settings = out["line"].to<JsonObject>();
+    static const char* parities[] = { "?", "none", "odd", "even" };
+    static const char* stops[] = { "?", "1", "2", "1.5" };
+    settings["baud"] = line.baud;
+    settings["dataBits"] = line.dataBits;
+    settings["parity"] = parities[line.parity & 3];
+    settings["stopBits"] = stops[line.stopBits & 3];
+  }
+  out["connections"] = stats.connections;
+  out["rejected"] = stats.rejected;
+  out["lineChanges"] = stats.lineChanges;
+  JsonObject toNetStats = out["uartToTcp"].to<JsonObject>();
+  toNetStats["bytes"] = stats.toNetBytes;
+  toNetStats["bytesPerSec"] = stats.toNetRate;
+  toNetStats["peakBytesPerSec"] = stats.toNetPeak;
+  JsonObject toUartStats = out["tcpToUart"].to<JsonObject>();
+  toUartStats["bytes"] = stats.toUartBytes;
+  toUartStats["bytesPerSec"] = stats.toUartRate;
+  toUartStats["peakBytesPerSec"] = stats.toUartPeak;
+  out["uartRxBuffer"] = SERIAL_SERVER_UART_RX_BYTES;
+  out["uartRxHighWater"] = stats.uartRxHighWater;
+}
@@ -0,0 +1,29 @@
+#ifndef SERIAL_SERVER_H
+#define SERIAL_SERVER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== SERVEUR TCP DU PONT SÉRIE =====
+// Un client TCP (port serialServerPort) reçoit les octets de Serial2 tels quels et
+// ce qu'il envoie part sur Serial2 : ni découpage en lignes, ni JSON, ni broker.
+// Les octets passent directement entre les tampons du pilote UART
+// (SERIAL_SERVER_UART_RX_BYTES / TX_BYTES) et le socket, par passes de
+// SERIAL_SERVER_CHUNK : si le réseau ralentit, la réception s'accumule dans le
+// tampon du pilote plutôt que d'être recopiée ailleurs.
+//
+// Un seul client à la fois (les suivants sont refusés). Pendant la session, le
+// client a l'UART pour lui seul : serial/send est ignoré, les requêtes RPC expirent.
+//
+// Mode RFC 2217 (serialServerRfc2217) : négociation telnet (BINARY, SGA,
+// COM-PORT-OPTION), 0xFF doublé dans les données, et réglage de la ligne par le
+// client (baud, bits de données, parité, bits de stop, purge). Ces réglages ne
+// valent que pour la session : la configuration enregistrée est rétablie à la
+// déconnexion. Exemple : pyserial `rfc2217://<ip>:2217`.
+
+void setupSerialServer();                    // Tâche serveur (après l'initialisation du réseau)
+bool serialServerActive();                   // Client connecté
+void serialServerStatsToJson(JsonObject out);
+
+#endif // SERIAL_SERVER_H
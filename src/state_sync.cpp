@@ -0,0 +1,95 @@
+#include "state_sync.h"
+#include "config.h"
+#include "mqtt.h"
+#include "time_sync.h"
+#include "log_task.h"
+
+static uint32_t bootId = 0;                 // Distingue les versions d'un démarrage à l'autre
+static volatile bool snapshotRequested = false;
+static unsigned long lastSnapshotAt = 0;
+static uint32_t lastSnapshotGeneration = 0;
+static uint32_t lastSnapshotVersion = 0;
+static uint32_t snapshotsPublished = 0;
+static uint32_t snapshotRequests = 0;       // Tâche MQTT
+static uint32_t deltasPublished = 0;        // Tâche temps réel
+static uint32_t deltasDropped = 0;
+// Tâche réseau uniquement
+static char snapshotPayload[STATE_SNAPSHOT_BYTES];
+
+void setupStateSync() {
+  bootId = esp_random();
+}
+
+void stateSyncRequest() {
+  snapshotRequests++;
+  snapshotRequested = true;
+}
+
+void stateSyncLoop() {
+  if (!mqttConnected()) return;
+  unsigned long now = millis();
+  // Plusieurs consommateurs qui demandent en même temps : une seule publication
+  if (lastSnapshotAt != 0 && now - lastSnapshotAt < STATE_SNAPSHOT_MIN_INTERVAL_MS) return;
+
+  IoSnapshot table;
+  bool due = snapshotRequested || table->generation != lastSnapshotGeneration ||
+             now - lastSnapshotAt >= STATE_SNAPSHOT_INTERVAL_MS;
+  if (!due) return;
+  lastSnapshotAt = now;
+
+  // Version lue avant les états : l'instantané contient au moins tous les changements
+  // jusqu'à elle, un delta de version supérieure déjà inclus est simplement réappliqué
+  uint32_t version = ioStateVersion();
+  const size_t size = sizeof(snapshotPayload);
+  int len = snprintf(snapshotPayload, size, "{\"v\":%u,\"boot\":\"%08x\",\"gen\":%u,\"ts\":%llu,\"state\":{",
+                     version, bootId, table->generation, (unsigned long long)getCurrentTimeMicros());
+  int pins = 0;
+  for (int i = 0; i < table->count && len < (int)size; i++) {
+    if (table->mode[i] != 1 && table->mode[i] != 2) continue;   // Numériques seulement
+    len += snprintf(snapshotPayload + len, size - len, "%s\"%s\":%d", pins++ ? "," : "",
+                    table->pins[i].name, ioState(*table, i) ? 1 : 0);
+  }
+  if (len < (int)size) len += snprintf(snapshotPayload + len, size - len, "}}");
+  if (len >= (int)size) {
+    logPrintf("⚠️ State snapshot larger than %u bytes - not published\n", (unsigned)size);
+    snapshotRequested = false;
+    lastSnapshotGeneration = table->generation;
+    return;
+  }
+
+  char topic[128];
+  snprintf(topic, sizeof(topic), "%s/state", config.deviceName);
+  if (!mqttSchedulerSubmit(MQTT_PRIORITY_STATE, topic, snapshotPayload, len, 1, true)) {
+    return;   // File pleine : nouvel essai après STATE_SNAPSHOT_MIN_INTERVAL_MS
+  }
+  snapshotRequested = false;
+  lastSnapshotGeneration = table->generation;
+  lastSnapshotVersion = version;
+  snapshotsPublished++;
+  logPrintf("📸 State snapshot v%u published (%d I/O, %d bytes)\n", version, pins, len);
+}
+
+void stateSyncPublishDelta(const IoTable& table, int index, bool state, uint64_t timeUs) {
+  if (!mqttEnabled || !mqttConnected()) return;   // Le saut de version sera vu à la reconnexion
+
+  char topic[128];
+  snprintf(topic, sizeof(topic), "%s/state/delta", config.deviceName);
+  char payload[160];
+  int len = snprintf(payload, sizeof(payload), "{\"v\":%u,\"gen\":%u,\"pin\":\"%s\",\"state\":%d,\"ts\":%llu}",
+                     ioStateVersion(), table.generation, table.pins[index].name, state ? 1 : 0,
+                     (unsigned long long)timeUs);
+  if (mqttSchedulerSubmit(MQTT_PRIORITY_STATE, topic, payload, len, 1, false)) deltasPublished++;
+  else deltasDropped++;
+}
+
+void stateSyncStatsToJson(JsonObject out) {
+  char boot[9];
+  snprintf(boot, sizeof(boot), "%08x", bootId);
+  out["version"] = ioStateVersion();
+  out["boot"] = boot;
+  out["snapshots"] = snapshotsPublished;
+  out["snapshotRequests"] = snapshotRequests;
+  out["lastSnapshotVersion"] = lastSnapshotVersion;
+  out["deltas"] = deltasPublished;
+  out["deltasDropped"] = deltasDropped;
+}
@@ -0,0 +1,23 @@
+#ifndef STATE_SYNC_H
+#define STATE_SYNC_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "io_table.h"
+
+// ===== INSTANTANÉ ET DELTAS D'ÉTAT =====
+// <device>/state (retenu) : état de toutes les I/O numériques en un message, étiqueté
+// par la version d'état (ioStateVersion). Publié à la connexion, après un changement
+// de configuration, toutes les STATE_SNAPSHOT_INTERVAL_MS et sur <device>/state/get.
+// <device>/state/delta : un message par changement, dans l'ordre des versions.
+// Un consommateur applique les deltas de version > instantané ; un saut de version
+// (delta perdu, file pleine, coupure) se rattrape en redemandant l'instantané.
+
+void setupStateSync();
+void stateSyncRequest();    // Tâche MQTT : <device>/state/get, nouvelle session
+void stateSyncLoop();       // Tâche réseau : publication de l'instantané
+// Tâche temps réel : delta d'une I/O dont l'état vient de changer
+void stateSyncPublishDelta(const IoTable& table, int index, bool state, uint64_t timeUs);
+void stateSyncStatsToJson(JsonObject out);
+
+#endif // STATE_SYNC_H
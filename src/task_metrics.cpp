@@ -0,0 +1,149 @@
+#include "task_metrics.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+struct TaskMetric {
+  TaskHandle_t handle;
+  char name[configMAX_TASK_NAME_LEN];
+  uint32_t runTime;         // Compteur cumulé au dernier échantillon
+  float cpuPercent;         // Sur la dernière fenêtre, en % d'un core
+  uint32_t stackFree;       // Octets (plus bas niveau atteint)
+  uint8_t priority;
+  int8_t core;              // -1 = pas d'affinité
+  bool seen;
+};
+
+static TaskMetric metrics[TASK_METRICS_MAX];
+static int metricCount = 0;
+static float coreIdlePercent[portNUM_PROCESSORS];
+static uint32_t lastTotalRunTime = 0;
+static unsigned long lastSampleAt = 0;
+static bool supported = true;
+static SemaphoreHandle_t metricsMutex = NULL;
+
+static TaskMetric* findMetric(TaskHandle_t handle) {
+  for (int i = 0; i < metricCount; i++) {
+    if (metrics[i].handle == handle) return &metrics[i];
+  }
+  return NULL;
+}
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+static void sampleTasks() {
+  static TaskStatus_t status[TASK_METRICS_MAX];
+  uint32_t totalRunTime = 0;
+  UBaseType_t count = uxTaskGetSystemState(status, TASK_METRICS_MAX, &totalRunTime);
+  if (count == 0) return;   // Plus de tâches que TASK_METRICS_MAX
+  uint32_t window = totalRunTime - lastTotalRunTime;
+  lastTotalRunTime = totalRunTime;
+
+  TaskHandle_t idle[portNUM_PROCESSORS];
+  for (int c = 0; c < portNUM_PROCESSORS; c++) idle[c] = xTaskGetIdleTaskHandleForCPU(c);
+
+  xSemaphoreTake(metricsMutex, portMAX_DELAY);
+  for (int i = 0; i < metricCount; i++) metrics[i].seen = false;
+  for (UBaseType_t t = 0; t < count; t++) {
+    TaskMetric* m = findMetric(status[t].xHandle);
+    bool isNew = m == NULL;
+    if (isNew) {
+      if (metricCount >= TASK_METRICS_MAX) continue;
+      m = &metrics[metricCount++];
+      m->handle = status[t].xHandle;
+      m->runTime = status[t].ulRunTimeCounter;
+    }
+    uint32_t delta = status[t].ulRunTimeCounter - m->runTime;
+    m->runTime = status[t].ulRunTimeCounter;
+    m->cpuPercent = (!isNew && window > 0) ? delta * 100.0f / window : 0.0f;
+    strlcpy(m->name, status[t].pcTaskName, sizeof(m->name));
+    m->stackFree = status[t].usStackHighWaterMark;   // ESP-IDF : en octets
+    m->priority = status[t].uxCurrentPriority;
+#if configTASKLIST_INCLUDE_COREID
+    m->core = status[t].xCoreID < portNUM_PROCESSORS ? status[t].xCoreID : -1;
+#else
+    m->core = -1;
+#endif
+    m->seen = true;
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+      if (status[t].xHandle == idle[c]) {
+        m->core = c;
+        coreIdlePercent[c] = m->cpuPercent;
+      }
+    }
+  }
+  // Tâches supprimées depuis le dernier échantillon
+  int kept = 0;
+  for (int i = 0; i < metricCount; i++) {
+    if (metrics[i].seen) metrics[kept++] = metrics[i];
+  }
+  metricCount = kept;
+  xSemaphoreGive(metricsMutex);
+}
+#else
+// Sans compteurs de temps d'exécution : pas de charge CPU, mais la pile, la
+// priorité et le core des tâches connues restent lisibles à partir de leur nom
+static const char* const KNOWN_TASKS[] = {
+  "IOTask", "NetTask", "SerialTask", "LogTask", "AnalogTask", "ModbusTask",
+  "ModbusTcpTask", "SerialSrvTask", "async_tcp", "mqtt_task", "loopTask"
+};
+
+static void sampleTasks() {
+  supported = false;
+  xSemaphoreTake(metricsMutex, portMAX_DELAY);
+  metricCount = 0;
+  for (const char* name : KNOWN_TASKS) {
+    TaskHandle_t handle = xTaskGetHandle(name);
+    if (!handle || metricCount >= TASK_METRICS_MAX) continue;
+    TaskMetric* m = &metrics[metricCount++];
+    memset(m, 0, sizeof(*m));
+    m->handle = handle;
+    strlcpy(m->name, name, sizeof(m->name));
+    m->stackFree = uxTaskGetStackHighWaterMark(handle);
+    m->priority = uxTaskPriorityGet(handle);
+    BaseType_t affinity = xTaskGetAffinity(handle);
+    m->core = affinity >= 0 && affinity < portNUM_PROCESSORS ? affinity : -1;   // tskNO_AFFINITY
+    m->seen = true;
+  }
+  xSemaphoreGive(metricsMutex);
+}
+#endif
+
+void taskMetricsLoop() {
+  unsigned long now = millis();
+  if (lastSampleAt != 0 && now - lastSampleAt < TASK_METRICS_PERIOD_MS) return;
+  lastSampleAt = now;
+  if (!metricsMutex) metricsMutex = xSemaphoreCreateMutex();
+  sampleTasks();
+}
+
+void taskMetricsToJson(JsonObject out) {
+  out["periodMs"] = TASK_METRICS_PERIOD_MS;
+  out["runtimeStats"] = supported;
+  out["freeHeap"] = ESP.getFreeHeap();
+  out["minFreeHeap"] = ESP.getMinFreeHeap();
+  if (!metricsMutex) return;
+
+  xSemaphoreTake(metricsMutex, portMAX_DELAY);
+  if (supported) {
+    JsonArray cores = out["cores"].to<JsonArray>();
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+      JsonObject core = cores.add<JsonObject>();
+      core["core"] = c;
+      core["idle"] = coreIdlePercent[c];
+      core["load"] = 100.0f - coreIdlePercent[c];
+    }
+  }
+  JsonArray tasks = out["tasks"].to<JsonArray>();
+  for (int i = 0; i < metricCount; i++) {
+    JsonObject task = tasks.add<JsonObject>();
+    task["name"] = metrics[i].name;
+    task["core"] = metrics[i].core;
+    task["priority"] = metrics[i].priority;
+    if (supported) {
+      task["cpu"] = metrics[i].cpuPercent;
+      task["runTime"] = metrics[i].runTime;
+    }
+    task["stackFree"] = metrics[i].stackFree;
+  }
+  xSemaphoreGive(metricsMutex);
+}
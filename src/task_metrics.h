@@ -0,0 +1,16 @@
+#ifndef TASK_METRICS_H
+#define TASK_METRICS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// ===== CHARGE CPU PAR TÂCHE =====
+// Toutes les TASK_METRICS_PERIOD_MS, relève les compteurs de temps d'exécution
+// FreeRTOS (mêmes données que vTaskGetRunTimeStats) et calcule la part de CPU
+// de chaque tâche et le taux d'inactivité de chaque core sur la fenêtre écoulée.
+
+void taskMetricsLoop();                   // Tâche réseau : échantillonnage périodique
+void taskMetricsToJson(JsonObject out);   // GET /api/metrics
+
+#endif // TASK_METRICS_H
@@ -0,0 +1,152 @@
+#include "time_sync.h"
+#include "config.h"
+#include "mqtt.h"
+#include "json_arena.h"
+#include "log_task.h"
+#include <esp_timer.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+#include <time.h>
+
+extern Config config;
+
+// Modèle d'horloge (clock_model.h) : l'écoulé est mesuré avec esp_timer
+// (monotone, non affecté par settimeofday)
+static ClockModel model = {};
+static const ClockModelParams modelParams = TIME_CLOCK_MODEL_PARAMS;
+
+static portMUX_TYPE modelMux = portMUX_INITIALIZER_UNLOCKED;
+
+static unsigned long lastQualityPublish = 0;
+static TimeQuality lastPublishedQuality = TIME_QUALITY_NONE;
+static TimeSource lastPublishedSource = TIME_SOURCE_NONE;
+
+static void onSample(TimeSource source, uint64_t sampleUs, uint32_t uncertaintyUs) {
+  int64_t localUs = esp_timer_get_time();
+  portENTER_CRITICAL(&modelMux);
+  bool adopted = clockModelSample(model, modelParams, source, localUs, sampleUs, uncertaintyUs);
+  portEXIT_CRITICAL(&modelMux);
+
+  if (adopted) {
+    // Garde l'horloge système (time(), localtime) alignée sur la source retenue
+    struct timeval tv;
+    tv.tv_sec = sampleUs / 1000000ULL;
+    tv.tv_usec = sampleUs % 1000000ULL;
+    settimeofday(&tv, NULL);
+  }
+}
+
+// Remplace l'implémentation faible de l'ESP-IDF : SNTP ne règle plus l'horloge
+// directement, l'échantillon passe par le classement des sources.
+extern "C" void sntp_sync_time(struct timeval* tv) {
+  uint64_t sampleUs = (uint64_t)tv->tv_sec * 1000000ULL + tv->tv_usec;
+  onSample(TIME_SOURCE_SNTP, sampleUs, TIME_SNTP_UNCERTAINTY_US);
+  sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+  logPrintf("⏰ SNTP sample: %ld.%06ld (source active: %s)\n",
+            (long)tv->tv_sec, (long)tv->tv_usec, timeSourceName(model.source));
+}
+
+void timeSyncOnMqttSample(uint64_t masterTimeUs, bool compensated) {
+  onSample(TIME_SOURCE_MQTT, masterTimeUs,
+           compensated ? TIME_MQTT_UNCERTAINTY_US : TIME_MQTT_UNCOMPENSATED_UNCERTAINTY_US);
+}
+
+void setupTimeSync() {
+  if (strlen(config.ntpServer) == 0) {
+    Serial.println("SNTP disabled (no server) - time from MQTT only");
+    return;
+  }
+  // lwIP SNTP : fonctionne sur l'interface active (Ethernet ou WiFi)
+  configTime(config.gmtOffset_sec, config.daylightOffset_sec, config.ntpServer);
+  Serial.printf("✓ SNTP started (%s)\n", config.ntpServer);
+}
+
+uint64_t getCurrentTimeMicros() {
+  if (model.valid) {
+    int64_t localUs = esp_timer_get_time();
+    portENTER_CRITICAL(&modelMux);
+    uint64_t now = clockModelPredict(model, localUs);
+    portEXIT_CRITICAL(&modelMux);
+    return now;
+  }
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+}
+
+uint32_t timeUncertaintyUs() {
+  int64_t localUs = esp_timer_get_time();
+  portENTER_CRITICAL(&modelMux);
+  uint32_t u = clockModelUncertainty(model, modelParams, localUs);
+  portEXIT_CRITICAL(&modelMux);
+  return u;
+}
+
+TimeQuality timeQuality() {
+  if (!model.valid) return TIME_QUALITY_NONE;
+  return timeUncertaintyUs() <= TIME_GOOD_UNCERTAINTY_US ? TIME_QUALITY_GOOD : TIME_QUALITY_DEGRADED;
+}
+
+bool timeScheduleAllowed() {
+  return timeQuality() != TIME_QUALITY_NONE && timeUncertaintyUs() <= TIME_REJECT_UNCERTAINTY_US;
+}
+
+const char* timeQualityName(TimeQuality quality) {
+  switch (quality) {
+    case TIME_QUALITY_NONE: return "none";
+    case TIME_QUALITY_DEGRADED: return "degraded";
+    case TIME_QUALITY_GOOD: return "good";
+  }
+  return "unknown";
+}
+
+const char* timeSourceName(TimeSource source) {
+  switch (source) {
+    case TIME_SOURCE_NONE: return "none";
+    case TIME_SOURCE_SNTP: return "sntp";
+    case TIME_SOURCE_MQTT: return "mqtt";
+  }
+  return "unknown";
+}
+
+void timeStatusToJson(JsonObject out) {
+  int64_t localUs = esp_timer_get_time();
+  TimeQuality quality = timeQuality();
+  out["quality"] = timeQualityName(quality);
+  out["source"] = timeSourceName(model.source);
+  out["uncertainty_us"] = quality == TIME_QUALITY_NONE ? 0 : timeUncertaintyUs();
+  out["since_sync_s"] = model.valid ? (uint32_t)((localUs - model.localRefUs) / 1000000LL) : 0;
+  out["drift_ppm"] = model.driftPpm;
+  out["drift_known"] = model.driftKnown;
+  JsonObject src = out["sources"].to<JsonObject>();
+  for (int s = TIME_SOURCE_SNTP; s <= TIME_SOURCE_MQTT; s++) {
+    JsonObject o = src[timeSourceName((TimeSource)s)].to<JsonObject>();
+    const ClockSourceState& st = model.sources[s];
+    o["samples"] = st.samples;
+    o["age_s"] = st.samples ? (uint32_t)((localUs - st.lastLocalUs) / 1000000LL) : 0;
+    o["last_offset_us"] = st.lastOffsetUs;
+    o["outliers"] = st.outliers;
+  }
+}
+
+void timeSyncLoop() {
+  if (!mqttConnected()) return;
+
+  TimeQuality quality = timeQuality();
+  unsigned long now = millis();
+  bool changed = quality != lastPublishedQuality || model.source != lastPublishedSource;
+  if (!changed && now - lastQualityPublish < TIME_QUALITY_INTERVAL_MS) return;
+
+  lastQualityPublish = now;
+  lastPublishedQuality = quality;
+  lastPublishedSource = model.source;
+
+  JsonDocument doc(&netTaskArena);
+  timeStatusToJson(doc.to<JsonObject>());
+  char payload[384];
+  serializeJson(doc, payload, sizeof(payload));
+
+  char topic[128];
+  snprintf(topic, sizeof(topic), "%s/time/quality", config.deviceName);
+  publishMQTT(topic, payload, true);
+}
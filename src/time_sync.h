@@ -0,0 +1,37 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "clock_model.h"
+
+// ===== SOURCE DE TEMPS MULTI-SOURCES =====
+// Les échantillons SNTP et MQTT (esp32/time/sync) sont classés par incertitude.
+// La meilleure source discipline un modèle d'horloge (référence + dérive estimée,
+// clock_model.h) qui continue en holdover quand plus aucune source ne répond.
+
+enum TimeQuality : uint8_t {
+  TIME_QUALITY_NONE = 0,   // Jamais synchronisé : exec_at n'a pas de sens
+  TIME_QUALITY_DEGRADED,   // Holdover, incertitude > TIME_GOOD_UNCERTAINTY_US
+  TIME_QUALITY_GOOD
+};
+
+void setupTimeSync();                // Démarre SNTP si config.ntpServer est renseigné
+void timeSyncLoop();                 // Publication périodique de <device>/time/quality
+
+// Échantillon reçu via esp32/time/sync (déjà compensé de la latence réseau)
+void timeSyncOnMqttSample(uint64_t masterTimeUs, bool compensated);
+
+// Temps courant (UTC, µs) selon le modèle discipliné ; repli sur gettimeofday()
+uint64_t getCurrentTimeMicros();
+
+TimeQuality timeQuality();
+uint32_t timeUncertaintyUs();
+// exec_at accepté : horloge synchronisée et incertitude <= TIME_REJECT_UNCERTAINTY_US.
+// Règle commune à scheduleCommand() et à /api/io/batch.
+bool timeScheduleAllowed();
+const char* timeQualityName(TimeQuality quality);
+const char* timeSourceName(TimeSource source);
+void timeStatusToJson(JsonObject out);
+
+#endif // TIME_SYNC_H
@@ -0,0 +1,28 @@
+#ifndef TIME_SYNC_CONFIG_H
+#define TIME_SYNC_CONFIG_H
+
+// ===== TIME SYNC =====
+// Sans dépendance Arduino : inclus par config.h et par le simulateur PC
+// (tools/sync_sim.cpp), qui reprend ainsi les réglages du firmware.
+#define TIME_MQTT_UNCERTAINTY_US               1000    // esp32/time/sync avec compensation de latence
+#define TIME_MQTT_UNCOMPENSATED_UNCERTAINTY_US 20000   // esp32/time/sync sans compensation
+#define TIME_SNTP_UNCERTAINTY_US               10000
+#define TIME_DRIFT_UNKNOWN_PPM                 50.0    // Hypothèse tant que la dérive n'est pas mesurée
+#define TIME_DRIFT_RESIDUAL_PPM                5.0     // Erreur résiduelle après correction de dérive
+#define TIME_DRIFT_MAX_PPM                     500.0   // Mesure de dérive au-delà : rejetée (saut d'horloge)
+#define TIME_DRIFT_MIN_INTERVAL_S              300     // Base de temps minimale d'une mesure de dérive
+#define TIME_DRIFT_EMA_ALPHA                   0.25f
+#define TIME_GOOD_UNCERTAINTY_US               5000    // Au-delà : qualité "degraded" (holdover)
+#define TIME_REJECT_UNCERTAINTY_US             100000  // Au-delà : commandes exec_at refusées
+#define TIME_QUALITY_INTERVAL_MS               30000   // Publication de <device>/time/quality
+#define TIME_OUTLIER_MARGIN_US                 2000    // Écart toléré au-delà des incertitudes
+#define TIME_OUTLIER_MAX_CONSECUTIVE           3       // Aberrants d'affilée : saut réel, adopté
+
+// Initialiseur de ClockModelParams (clock_model.h)
+#define TIME_CLOCK_MODEL_PARAMS { \
+  TIME_DRIFT_UNKNOWN_PPM, TIME_DRIFT_RESIDUAL_PPM, TIME_DRIFT_MAX_PPM, \
+  TIME_DRIFT_MIN_INTERVAL_S, TIME_DRIFT_EMA_ALPHA, \
+  TIME_OUTLIER_MARGIN_US, TIME_OUTLIER_MAX_CONSECUTIVE \
+}
+
+#endif // TIME_SYNC_CONFIG_H
@@ -2,11 +2,30 @@
 #include "config.h"
 #include "mqtt.h"
 #include "serial_manager.h"
+#include "multicast.h"
+#include "serial_server.h"
+#include "modbus_master.h"
+#include "modbus_tcp.h"
+#include "access_log.h"
+#include "time_sync.h"
+#include "io_table.h"
+#include "io_command.h"
+#include "task_metrics.h"
+#include "log_task.h"
+#include "expander.h"
+#include "analog.h"
+#include "capture.h"
+#include "json_arena.h"
+#include "alloc_audit.h"
+#include "state_sync.h"
+#include "ota_guard.h"
+#include "ota_update.h"
 #include <ElegantOTA.h>
 #include <ArduinoJson.h>
 #include <SPIFFS.h>
 #include <ESPAsyncWebServer.h>
 #include <ETH.h>
+#include <esp_timer.h>
 
 extern AsyncWebServer server;
 extern Config config;
@@ -15,34 +34,188 @@ extern int ioPinCount;
 extern bool mqttEnabled;
 extern bool ethConnected;
 
-extern void saveConfig();
+extern void saveConfig(const Config& c);
 extern void saveIOs();
 extern void applyIOPinModes();
 
+// Toutes les routes s'exécutent dans la tâche AsyncTCP, l'une après l'autre :
+// documents dans webArena, réponse sérialisée dans un tampon fixe
+static char responseBuffer[WEB_RESPONSE_BYTES];
+
+// ===== JOURNAL D'ACCÈS (access_log.h) =====
+// Les routes sont déclarées par route() plutôt que server.on() : chaque gestionnaire
+// (requête, corps, upload) est chronométré, et celui qui répond via reply() ou
+// sendJson() fait journaliser la requête avec son statut et la taille du corps.
+// Une seule route s'exécute à la fois : le contexte en cours est statique.
+static struct AccessContext {
+  int route;
+  AsyncWebServerRequest* request;
+  int64_t startUs;
+  uint16_t status;   // 0 : ce gestionnaire n'a pas répondu (morceau de corps, upload)
+  uint32_t bytes;
+} current;
+
+class AccessScope {
+public:
+  AccessScope(int route, AsyncWebServerRequest* request) {
+    current.route = route;
+    current.request = request;
+    current.status = 0;
+    current.bytes = 0;
+    current.startUs = esp_timer_get_time();
+  }
+  ~AccessScope() {
+    if (current.status == 0) return;
+    uint32_t durationUs = (uint32_t)(esp_timer_get_time() - current.startUs);
+    AsyncClient* client = current.request->client();
+    accessRecord(current.route, client ? (uint32_t)client->remoteIP() : 0, current.status, current.bytes, durationUs);
+    current.status = 0;
+  }
+private:
+  AccessScope(const AccessScope&);
+  AccessScope& operator=(const AccessScope&);
+};
+
+static inline void accessNoteReply(int code, size_t bytes) {
+  current.status = code;
+  current.bytes = bytes;
+}
+
+static void reply(AsyncWebServerRequest *request, int code, const char* json) {
+  accessNoteReply(code, strlen(json));
+  request->send(code, "application/json", json);
+}
+
+static void replyText(AsyncWebServerRequest *request, int code, const char* text) {
+  accessNoteReply(code, strlen(text));
+  request->send(code, "text/plain", text);
+}
+
+static void sendJson(AsyncWebServerRequest *request, int code, const JsonDocument& doc) {
+  if (measureJson(doc) < sizeof(responseBuffer)) {
+    size_t length = serializeJson(doc, responseBuffer, sizeof(responseBuffer));
+    accessNoteReply(code, length);
+    request->send(code, "application/json", responseBuffer);
+    return;
+  }
+  String response;   // Plus grand que le tampon (configuration I/O très chargée) : rare
+  serializeJson(doc, response);
+  accessNoteReply(code, response.length());
+  request->send(code, "application/json", response);
+}
+
+static const char* formatIp(char* buffer, size_t size, IPAddress ip) {
+  snprintf(buffer, size, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  return buffer;
+}
+
+// Corps de requête : AsyncTCP le livre par morceaux (index/total) et entrelace les
+// clients. Un corps reçu en un seul morceau est lu sur place ; sinon il est assemblé
+// dans un tampon fixe, réservé à une requête à la fois (libéré au dernier morceau,
+// ou repris après WEB_BODY_TIMEOUT_MS si le client a disparu en cours d'envoi).
+// Une requête qui perd le tampon reçoit 408 à son morceau suivant, une seule fois.
+static char bodyBuffer[WEB_BODY_BYTES];
+static AsyncWebServerRequest* bodyOwner = NULL;
+static AsyncWebServerRequest* bodyEvicted = NULL;   // Dernier propriétaire dépossédé, pas encore averti
+static unsigned long bodyTouchedAt = 0;
+
+// Corps complet au dernier morceau, NULL avant (ou si la requête a reçu 400/408/413/503)
+static const char* assembleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len,
+                                size_t index, size_t total, size_t* bodyLen) {
+  if (index == 0 && request == bodyEvicted) bodyEvicted = NULL;   // Adresse réutilisée
+  if (index == 0 && len == total) {
+    *bodyLen = len;
+    return (const char*)data;
+  }
+  if (total > sizeof(bodyBuffer)) {
+    if (index == 0) reply(request, 413, "{\"success\":false, \"message\":\"Corps de requête trop grand\"}");
+    return NULL;
+  }
+  if (index == 0) {
+    if (bodyOwner != NULL && millis() - bodyTouchedAt < WEB_BODY_TIMEOUT_MS) {
+      reply(request, 503, "{\"success\":false, \"message\":\"Requête en cours de réception, réessayer\"}");
+      return NULL;
+    }
+    if (bodyOwner != NULL) bodyEvicted = bodyOwner;
+    bodyOwner = request;
+  } else if (bodyOwner != request) {
+    // Dépossédée après WEB_BODY_TIMEOUT_MS ; les refus 503 ont déjà répondu à index 0
+    if (request == bodyEvicted) {
+      bodyEvicted = NULL;
+      reply(request, 408, "{\"success\":false, \"message\":\"Corps de requête interrompu trop longtemps\"}");
+    }
+    return NULL;
+  } else if (index + len > total) {
+    bodyOwner = NULL;   // Morceaux suivants ignorés (plus propriétaire)
+    reply(request, 400, "{\"success\":false, \"message\":\"Corps de requête incohérent\"}");
+    return NULL;
+  }
+  bodyTouchedAt = millis();
+  memcpy(bodyBuffer + index, data, len);
+  if (index + len < total) return NULL;
+  bodyOwner = NULL;   // Le tampon reste lisible jusqu'au retour de la route
+  *bodyLen = total;
+  return bodyBuffer;
+}
+
+// server.on() chronométré et journalisé (même signature)
+static AsyncCallbackWebHandler& route(const char* path, WebRequestMethodComposite method,
+                                      ArRequestHandlerFunction onRequest,
+                                      ArUploadHandlerFunction onUpload = NULL,
+                                      ArBodyHandlerFunction onBody = NULL) {
+  int id = accessRegisterRoute(method, path);
+  ArRequestHandlerFunction timedRequest = [id, onRequest](AsyncWebServerRequest *request) {
+    AccessScope scope(id, request);
+    onRequest(request);
+  };
+  ArUploadHandlerFunction timedUpload;
+  if (onUpload) {
+    timedUpload = [id, onUpload](AsyncWebServerRequest *request, const String& filename, size_t index,
+                                 uint8_t *data, size_t len, bool final) {
+      AccessScope scope(id, request);
+      onUpload(request, filename, index, data, len, final);
+    };
+  }
+  ArBodyHandlerFunction timedBody;
+  if (onBody) {
+    timedBody = [id, onBody](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      AccessScope scope(id, request);
+      onBody(request, data, len, index, total);
+    };
+  }
+  return server.on(path, method, timedRequest, timedUpload, timedBody);
+}
+
+static bool elegantFilesystem = false;   // Mode choisi par /ota/start (page ElegantOTA)
+
 void setupWebServer() {
   // Servir le fichier index.html depuis SPIFFS
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
+  route("/", HTTP_GET, [](AsyncWebServerRequest *request){
+    accessNoteReply(200, 0);   // Fichier lu au fil de l'envoi : taille non comptée
     request->send(SPIFFS, "/index.html", "text/html");
   });
   
   // API pour le statut système complet
-  server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request){
-    JsonDocument doc;
+  route("/api/status", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
     doc["deviceName"] = config.deviceName;
     doc["useEthernet"] = config.useEthernet;
     
+    char ip[16];
     if (config.useEthernet) {
       doc["network"] = ethConnected;
-      doc["ip"] = ethConnected ? ETH.localIP().toString() : "Not connected";
+      doc["ip"] = ethConnected ? formatIp(ip, sizeof(ip), ETH.localIP()) : "Not connected";
       doc["networkType"] = "Ethernet";
     } else {
       doc["network"] = WiFi.status() == WL_CONNECTED;
-      doc["ip"] = WiFi.localIP().toString();
+      doc["ip"] = formatIp(ip, sizeof(ip), WiFi.localIP());
       doc["networkType"] = "WiFi";
       doc["rssi"] = WiFi.RSSI();
     }
     
-    doc["mqtt"] = mqttClient.connected();
+    doc["mqtt"] = mqttConnected();
+    doc["mqttState"] = mqttLinkStateName(mqttLinkState());
+    multicastStatsToJson(doc["multicast"].to<JsonObject>());
     
     time_t now;
     time(&now);
@@ -51,96 +224,351 @@ void setupWebServer() {
     char timeStr[20];
     strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &timeinfo);
     doc["time"] = timeStr;
+    timeStatusToJson(doc["timeSync"].to<JsonObject>());
+    stateSyncStatsToJson(doc["stateSync"].to<JsonObject>());
     
     JsonArray ios = doc["ios"].to<JsonArray>();
-    for (int i = 0; i < ioPinCount; i++) {
-      JsonObject io = ios.add<JsonObject>();
-      io["name"] = ioPins[i].name;
-      io["pin"] = ioPins[i].pin;
-      io["mode"] = ioPins[i].mode;
-      io["state"] = digitalRead(ioPins[i].pin);
+    {
+      IoSnapshot table;   // Noms, modes et états d'une même configuration
+      for (int i = 0; i < table->count; i++) {
+        const IOPin& pin = table->pins[i];
+        JsonObject io = ios.add<JsonObject>();
+        io["name"] = pin.name;
+        io["pin"] = pin.pin;
+        io["mode"] = pin.mode;
+        if (pin.mode == 3) { // ANALOG
+          float value, mv;
+          if (analogValue(pin.pin, &value, &mv)) {
+            io["value"] = value;
+            io["mv"] = mv;
+          }
+          const AnalogConfig* cfg = ioAnalogConfig(*table, pin.pin);
+          io["unit"] = cfg ? cfg->unit : "mV";
+        } else {
+          io["state"] = ioState(*table, i);
+        }
+      }
     }
     
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    sendJson(request, 200, doc);
   });
   
   // API pour contrôler une sortie
-  server.on("/api/io/set", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+  route("/api/io/set", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
     [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
-      JsonDocument doc;
-      if (deserializeJson(doc, (const char*)data) != DeserializationError::Ok) {
-        request->send(400, "application/json", "{\"success\":false, \"message\":\"Invalid JSON\"}");
+      size_t bodyLen;
+      const char* body = assembleBody(request, data, len, index, total, &bodyLen);
+      if (body == NULL) return;
+      JsonDocument doc(&webArena);
+      if (deserializeJson(doc, body, bodyLen) != DeserializationError::Ok) {
+        reply(request, 400, "{\"success\":false, \"message\":\"Invalid JSON\"}");
         return;
       }
       
       const char* ioName = doc["name"];
       bool state = doc["state"];
 
-      for (int i = 0; i < ioPinCount; i++) {
-        if (strcmp(ioPins[i].name, ioName) == 0) {
-          if (ioPins[i].mode == 2) { // OUTPUT
-            executeCommand(ioPins[i].pin, state);
-            request->send(200, "application/json", "{\"success\":true, \"message\":\"IO mis à jour\"}");
-          } else {
-            request->send(400, "application/json", "{\"success\":false, \"message\":\"Cet IO n'est pas une sortie\"}");
+      IoSnapshot table;
+      int i = ioName ? ioIndexByName(*table, ioName, strlen(ioName)) : -1;
+      if (i >= 0) {
+        if (table->mode[i] == 2) { // OUTPUT
+          if (!submitIoCommand(table->pin[i], state)) {
+            reply(request, 503, "{\"success\":false, \"message\":\"File de commandes pleine\"}");
             return;
           }
-          return;
+          reply(request, 200, "{\"success\":true, \"message\":\"IO mis à jour\"}");
+        } else {
+          reply(request, 400, "{\"success\":false, \"message\":\"Cet IO n'est pas une sortie\"}");
+        }
+        return;
+      }
+      reply(request, 404, "{\"success\":false, \"message\":\"IO non trouvé\"}");
+    }
+  );
+
+  // API pour piloter plusieurs sorties en une requête
+  // {"exec_at":1700000000, "exec_at_us":0, "atomic":false,
+  //  "ops":[{"name":"RelaisK1","state":1}, {"pin":16,"state":0,"exec_at":..., "id":"k2-off"}]}
+  // Toutes les opérations sont résolues sur la même configuration puis déposées en
+  // un lot, appliqué dans un même tour de la tâche temps réel. exec_at (lot ou
+  // opération) programme l'exécution ; "id" donne l'accusé MQTT habituel.
+  route("/api/io/batch", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+    [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+      size_t bodyLen;
+      const char* body = assembleBody(request, data, len, index, total, &bodyLen);
+      if (body == NULL) return;
+      JsonDocument doc(&webArena);
+      if (deserializeJson(doc, body, bodyLen) != DeserializationError::Ok) {
+        reply(request, 400, "{\"success\":false, \"message\":\"Invalid JSON\"}");
+        return;
+      }
+      JsonArrayConst ops = doc["ops"];
+      if (ops.isNull() || ops.size() == 0) {
+        reply(request, 400, "{\"success\":false, \"message\":\"ops manquant\"}");
+        return;
+      }
+      if (ops.size() > IO_BATCH_MAX_OPS) {
+        reply(request, 413, "{\"success\":false, \"message\":\"Trop d'opérations dans le lot\"}");
+        return;
+      }
+
+      // Tâche AsyncTCP seule : tampons statiques plutôt que la pile
+      static IoCommand commands[IO_BATCH_MAX_OPS];
+      static int8_t slot[IO_BATCH_MAX_OPS];       // Opération -> commande, -1 : refusée
+      static const char* result[IO_BATCH_MAX_OPS];
+      uint32_t batchSec = doc["exec_at"] | 0;
+      uint32_t batchUs = doc["exec_at_us"] | 0;
+      bool atomic = doc["atomic"] | false;
+      uint64_t receivedUs = getCurrentTimeMicros();
+      bool scheduleAllowed = timeScheduleAllowed();   // Même règle que scheduleCommand()
+      int count = 0;
+      int refused = 0;
+
+      IoSnapshot table;
+      for (size_t n = 0; n < ops.size(); n++) {
+        JsonObjectConst op = ops[n];
+        const char* ioName = op["name"];
+        int i = ioName ? ioIndexByName(*table, ioName, strlen(ioName))
+                       : op["pin"].is<int>() ? ioIndexByPin(*table, op["pin"].as<int>()) : -1;
+        uint32_t execSec = op["exec_at"] | batchSec;
+        uint32_t execUs = op["exec_at"].is<uint32_t>() ? (op["exec_at_us"] | 0) : batchUs;
+        slot[n] = -1;
+        if (i < 0) {
+          result[n] = "not_found";
+        } else if (table->mode[i] != 2) { // OUTPUT
+          result[n] = "not_output";
+        } else if (!op["state"].is<bool>() && !op["state"].is<int>()) {
+          result[n] = "invalid";
+        } else if (execSec > 0 && !scheduleAllowed) {
+          result[n] = "rejected";   // exec_at absolu sans horloge fiable
+        } else {
+          IoCommand& command = commands[count];
+          command.pin = table->pin[i];
+          command.state = op["state"].as<bool>() ? 1 : 0;
+          command.exec_at_sec = execSec;
+          command.exec_at_us = execUs;
+          command.received_us = receivedUs;
+          strlcpy(command.id, op["id"] | "", sizeof(command.id));
+          result[n] = execSec > 0 ? "scheduled" : "queued";
+          slot[n] = count++;
+          continue;
+        }
+        refused++;
+      }
+
+      // atomic : une opération refusée et rien n'est appliqué
+      bool held = atomic && refused > 0;
+      int submitted = count > 0 && !held ? submitIoBatch(commands, count) : 0;
+
+      JsonDocument resp(&webArena);
+      JsonArray results = resp["results"].to<JsonArray>();
+      for (size_t n = 0; n < ops.size(); n++) {
+        JsonObject r = results.add<JsonObject>();
+        JsonObjectConst op = ops[n];
+        if (op["name"].is<const char*>()) r["name"] = op["name"];
+        else if (op["pin"].is<int>()) r["pin"] = op["pin"];
+        if (slot[n] >= 0) {
+          r["pin"] = commands[slot[n]].pin;
+          if (slot[n] >= submitted) result[n] = held ? "skipped" : "queue_full";
         }
+        r["result"] = result[n];
       }
-      request->send(404, "application/json", "{\"success\":false, \"message\":\"IO non trouvé\"}");
+      bool success = refused == 0 && submitted == count;
+      resp["success"] = success;
+      resp["applied"] = submitted;
+      resp["failed"] = (int)ops.size() - submitted;
+      // 207 : lot partiellement appliqué, 503 : file pleine, 422 : rien d'applicable ;
+      // le détail par opération est dans results
+      int code = success ? 200 : submitted > 0 ? 207 : count > 0 && !held ? 503 : 422;
+      sendJson(request, code, resp);
     }
   );
 
+  // ===== CAPTURE D'ENTRÉES =====
+  // Armement : {"pins":["Bouton", 4], "trigger":"Bouton", "edge":"falling", "preTrigger":20, "durationMs":2000}
+  route("/api/capture/arm", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+    [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+      size_t bodyLen;
+      const char* body = assembleBody(request, data, len, index, total, &bodyLen);
+      if (body == NULL) return;
+      JsonDocument doc(&webArena);
+      if (deserializeJson(doc, body, bodyLen) != DeserializationError::Ok) {
+        reply(request, 400, "{\"success\":false, \"message\":\"Invalid JSON\"}");
+        return;
+      }
+      // Broche désignée par son nom d'I/O ou son numéro de GPIO
+      auto resolvePin = [](JsonVariantConst v) -> int {
+        if (v.is<int>()) return v.as<int>();
+        const char* name = v.as<const char*>();
+        if (!name) return -1;
+        IoSnapshot table;
+        int i = ioIndexByName(*table, name, strlen(name));
+        return i < 0 ? -1 : table->pin[i];
+      };
+
+      CaptureSettings settings;
+      settings.pins = 0;
+      for (JsonVariantConst v : doc["pins"].as<JsonArrayConst>()) {
+        int pin = resolvePin(v);
+        if (pin >= 0 && pin < IO_NATIVE_PIN_COUNT) settings.pins |= 1ULL << pin;
+      }
+      settings.triggerPin = doc["trigger"].isNull() ? -1 : resolvePin(doc["trigger"]);
+      const char* edge = doc["edge"] | "any";
+      settings.edge = strcmp(edge, "rising") == 0 ? CAPTURE_EDGE_RISING
+                    : strcmp(edge, "falling") == 0 ? CAPTURE_EDGE_FALLING : CAPTURE_EDGE_ANY;
+      settings.preTriggerPercent = doc["preTrigger"] | 20;
+      settings.durationMs = doc["durationMs"] | 2000;
+
+      if (captureDownloading()) {
+        reply(request, 409, "{\"success\":false, \"message\":\"Téléchargement de capture en cours\"}");
+        return;
+      }
+      const char* error = NULL;
+      if (!captureArm(settings, &error)) {
+        JsonDocument resp(&webArena);
+        resp["success"] = false;
+        resp["message"] = error;
+        sendJson(request, 400, resp);
+        return;
+      }
+      reply(request, 200, "{\"success\":true, \"message\":\"Capture armée\"}");
+    }
+  );
+
+  route("/api/capture/trigger", HTTP_POST, [](AsyncWebServerRequest *request){
+    captureTrigger();
+    reply(request, 200, "{\"success\":true}");
+  });
+
+  route("/api/capture/stop", HTTP_POST, [](AsyncWebServerRequest *request){
+    captureStop();
+    reply(request, 200, "{\"success\":true}");
+  });
+
+  route("/api/capture/status", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    captureStatusToJson(doc.to<JsonObject>());
+    sendJson(request, 200, doc);
+  });
+
+  // Téléchargement : ?format=vcd (défaut, GTKWave/PulseView) ou ?format=bin
+  route("/api/capture", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (captureState() != CAPTURE_DONE) {
+      reply(request, 409, "{\"success\":false, \"message\":\"Aucune capture terminée\"}");
+      return;
+    }
+    if (!captureBeginDownload()) {
+      reply(request, 409, "{\"success\":false, \"message\":\"Téléchargement de capture déjà en cours\"}");
+      return;
+    }
+    // Libéré à la fermeture de la connexion, que l'export soit complet ou abandonné
+    request->onDisconnect(captureEndDownload);
+    bool binary = request->hasParam("format") && request->getParam("format")->value() == "bin";
+    AsyncWebServerResponse *response;
+    if (binary) {
+      response = request->beginResponse("application/octet-stream", captureBinarySize(),
+        [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+          return captureFillBinary(buffer, maxLen, index);
+        });
+      response->addHeader("Content-Disposition", "attachment; filename=capture.bin");
+    } else {
+      response = request->beginChunkedResponse("text/plain",
+        [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+          return captureFillVcd(buffer, maxLen, index);
+        });
+      response->addHeader("Content-Disposition", "attachment; filename=capture.vcd");
+    }
+    accessNoteReply(200, binary ? captureBinarySize() : 0);
+    request->send(response);
+  });
+
   // API pour récupérer la config des IOs
-  server.on("/api/ios", HTTP_GET, [](AsyncWebServerRequest *request){
-    JsonDocument doc;
+  route("/api/ios", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
     JsonArray ios = doc["ios"].to<JsonArray>();
-    for (int i = 0; i < ioPinCount; i++) {
-      JsonObject io = ios.add<JsonObject>();
-      io["name"] = ioPins[i].name;
-      io["pin"] = ioPins[i].pin;
-      io["mode"] = ioPins[i].mode;
-      io["inputType"] = ioPins[i].inputType;
-      io["defaultState"] = ioPins[i].defaultState;
+    {
+      IoSnapshot table;
+      for (int i = 0; i < table->count; i++) {
+        const IOPin& pin = table->pins[i];
+        JsonObject io = ios.add<JsonObject>();
+        io["name"] = pin.name;
+        io["pin"] = pin.pin;
+        io["mode"] = pin.mode;
+        io["inputType"] = pin.inputType;
+        io["defaultState"] = pin.defaultState;
+        if (pin.mode == 3) {
+          AnalogConfig defaults;
+          const AnalogConfig* cfg = ioAnalogConfig(*table, pin.pin);
+          if (!cfg) {
+            analogConfigDefaults(defaults, pin.pin);
+            cfg = &defaults;
+          }
+          analogConfigToJson(*cfg, io["analog"].to<JsonObject>());
+        }
+      }
+      doc["generation"] = table->generation;
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    doc["maxIos"] = MAX_IOS;
+    expanderStatsToJson(doc["expanders"].to<JsonObject>());
+    sendJson(request, 200, doc);
   });
 
   // API pour enregistrer la config des IOs
-  server.on("/api/ios", HTTP_POST, 
+  route("/api/ios", HTTP_POST, 
     [](AsyncWebServerRequest *request){},
     NULL,
     [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
-    JsonDocument doc;
-    if (deserializeJson(doc, (const char*)data) != DeserializationError::Ok) {
-        request->send(400, "application/json", "{\"success\":false, \"message\":\"Invalid JSON\"}");
+    size_t bodyLen;
+    const char* body = assembleBody(request, data, len, index, total, &bodyLen);
+    if (body == NULL) return;
+    JsonDocument doc(&webArena);
+    if (deserializeJson(doc, body, bodyLen) != DeserializationError::Ok) {
+        reply(request, 400, "{\"success\":false, \"message\":\"Invalid JSON\"}");
         return;
     }
+    // ioPins[]/analogConfigs[] sont la copie de travail : les autres tâches lisent
+    // la table publiée, qui ne bascule qu'une fois la nouvelle configuration complète
     JsonArray newIOs = doc["ios"];
+    // Calibrations vérifiées avant de toucher à la copie de travail (inHi = inLo : division par zéro)
+    for (JsonObject ioData : newIOs) {
+        if ((int)(ioData["mode"] | 0) != 3) continue;
+        AnalogConfig check;
+        analogConfigDefaults(check, ioData["pin"] | 0);
+        if (!analogConfigFromJson(check, ioData["analog"].as<JsonObjectConst>())) {
+            char message[128];
+            snprintf(message, sizeof(message),
+                     "{\"success\":false, \"message\":\"Calibration analogique invalide (inHi = inLo) : %s\"}",
+                     (const char*)(ioData["name"] | "?"));
+            reply(request, 400, message);
+            return;
+        }
+    }
     ioPinCount = 0;
+    analogConfigCount = 0;
     for (JsonObject ioData : newIOs) {
-        if (ioPinCount < MAX_IOS) {
+        if (ioPinCount < MAX_IOS && ioPinValid(ioData["pin"] | -1)) {
             strlcpy(ioPins[ioPinCount].name, ioData["name"], sizeof(ioPins[ioPinCount].name));
             ioPins[ioPinCount].pin = ioData["pin"];
             ioPins[ioPinCount].mode = ioData["mode"];
             ioPins[ioPinCount].inputType = ioData["inputType"] | 1; // Default to PULLUP if not specified
             ioPins[ioPinCount].defaultState = ioData["defaultState"];
+            if (ioPins[ioPinCount].mode == 3 && analogConfigCount < ANALOG_MAX_CHANNELS) {
+                // Paramètres analogiques : valeurs par défaut complétées par l'objet "analog"
+                AnalogConfig& cfg = analogConfigs[analogConfigCount++];
+                analogConfigDefaults(cfg, ioPins[ioPinCount].pin);
+                analogConfigFromJson(cfg, ioData["analog"].as<JsonObjectConst>());
+            }
             ioPinCount++;
         }
     }
     saveIOs();
     applyIOPinModes();
-    request->send(200, "application/json", "{\"success\":true, \"message\":\"Configuration I/O enregistrée.\"}");
+    reply(request, 200, "{\"success\":true, \"message\":\"Configuration I/O enregistrée.\"}");
   });
   
   // API pour récupérer la configuration système
-  server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request){
-    JsonDocument doc;
+  route("/api/config", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
     doc["deviceName"] = config.deviceName;
     doc["useEthernet"] = config.useEthernet;
     doc["ethernetType"] = config.ethernetType;
@@ -152,132 +580,344 @@ void setupWebServer() {
     doc["mqttPort"] = config.mqttPort;
     doc["mqttUser"] = config.mqttUser;
     doc["mqttTopic"] = config.mqttTopic;
+    doc["mqttBufferSize"] = config.mqttBufferSize;
+    doc["groups"] = config.groups;
+    doc["ntpServer"] = config.ntpServer;
+    doc["i2cSdaPin"] = config.i2cSdaPin;
+    doc["i2cSclPin"] = config.i2cSclPin;
+    doc["expanders"] = config.expanders;
+    doc["expanderIntPin"] = config.expanderIntPin;
+    doc["spiSckPin"] = config.spiSckPin;
+    doc["spiMisoPin"] = config.spiMisoPin;
+    doc["spiMosiPin"] = config.spiMosiPin;
+    doc["spiCsPin"] = config.spiCsPin;
+    doc["useMulticast"] = config.useMulticast;
+    doc["multicastGroup"] = config.multicastGroup;
+    doc["multicastPort"] = config.multicastPort;
+    doc["useModbusTcp"] = config.useModbusTcp;
+    doc["modbusTcpPort"] = config.modbusTcpPort;
 
     doc["useSerialBridge"] = config.useSerialBridge;
     doc["serialRxPin"] = config.serialRxPin;
     doc["serialTxPin"] = config.serialTxPin;
     doc["serialBaudRate"] = config.serialBaudRate;
+    doc["useSerialServer"] = config.useSerialServer;
+    doc["serialServerPort"] = config.serialServerPort;
+    doc["serialServerRfc2217"] = config.serialServerRfc2217;
+    doc["useModbus"] = config.useModbus;
+    doc["modbusDePin"] = config.modbusDePin;
+    doc["modbusParity"] = config.modbusParity;
+    doc["modbusTimeoutMs"] = config.modbusTimeoutMs;
     
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    sendJson(request, 200, doc);
   });
   
   // API pour enregistrer la configuration système
-  server.on("/api/config", HTTP_POST, 
+  route("/api/config", HTTP_POST, 
     [](AsyncWebServerRequest *request){},
     NULL,
     [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
-      JsonDocument doc;
-      if (deserializeJson(doc, (const char*)data) != DeserializationError::Ok) {
-        request->send(400, "application/json", "{\"success\":false, \"message\":\"Invalid JSON\"}");
+      size_t bodyLen;
+      const char* body = assembleBody(request, data, len, index, total, &bodyLen);
+      if (body == NULL) return;
+      JsonDocument doc(&webArena);
+      if (deserializeJson(doc, body, bodyLen) != DeserializationError::Ok) {
+        reply(request, 400, "{\"success\":false, \"message\":\"Invalid JSON\"}");
         return;
       }
     
-      if (doc["deviceName"]) strlcpy(config.deviceName, doc["deviceName"], sizeof(config.deviceName));
+      // La configuration courante reste intacte (lue par les autres tâches jusqu'au
+      // redémarrage) : les modifications portent sur une copie, puis enregistrée
+      Config staged = config;
+      if (doc["deviceName"]) strlcpy(staged.deviceName, doc["deviceName"], sizeof(staged.deviceName));
       
       // Network settings
-      if (doc["useEthernet"].is<bool>()) config.useEthernet = doc["useEthernet"];
-      if (doc["ethernetType"]) strlcpy(config.ethernetType, doc["ethernetType"], sizeof(config.ethernetType));
+      if (doc["useEthernet"].is<bool>()) staged.useEthernet = doc["useEthernet"];
+      if (doc["ethernetType"]) strlcpy(staged.ethernetType, doc["ethernetType"], sizeof(staged.ethernetType));
       
-      config.useStaticIP = doc["useStaticIP"];
-      if (doc["staticIP"]) strlcpy(config.staticIP, doc["staticIP"], sizeof(config.staticIP));
-      if (doc["staticGateway"]) strlcpy(config.staticGateway, doc["staticGateway"], sizeof(config.staticGateway));
-      if (doc["staticSubnet"]) strlcpy(config.staticSubnet, doc["staticSubnet"], sizeof(config.staticSubnet));
-
-      if (doc["mqttServer"]) strlcpy(config.mqttServer, doc["mqttServer"], sizeof(config.mqttServer));
-      if (doc["mqttPort"]) config.mqttPort = doc["mqttPort"];
-      if (doc["mqttUser"]) strlcpy(config.mqttUser, doc["mqttUser"], sizeof(config.mqttUser));
+      staged.useStaticIP = doc["useStaticIP"];
+      if (doc["staticIP"]) strlcpy(staged.staticIP, doc["staticIP"], sizeof(staged.staticIP));
+      if (doc["staticGateway"]) strlcpy(staged.staticGateway, doc["staticGateway"], sizeof(staged.staticGateway));
+      if (doc["staticSubnet"]) strlcpy(staged.staticSubnet, doc["staticSubnet"], sizeof(staged.staticSubnet));
+
+      if (doc["mqttServer"]) strlcpy(staged.mqttServer, doc["mqttServer"], sizeof(staged.mqttServer));
+      if (doc["mqttPort"]) staged.mqttPort = doc["mqttPort"];
+      if (doc["mqttUser"]) strlcpy(staged.mqttUser, doc["mqttUser"], sizeof(staged.mqttUser));
       if (doc["mqttPassword"] && !doc["mqttPassword"].isNull() && strlen(doc["mqttPassword"]) > 0) {
-        strlcpy(config.mqttPassword, doc["mqttPassword"], sizeof(config.mqttPassword));
+        strlcpy(staged.mqttPassword, doc["mqttPassword"], sizeof(staged.mqttPassword));
       }
-      if (doc["mqttTopic"]) strlcpy(config.mqttTopic, doc["mqttTopic"], sizeof(config.mqttTopic));
+      if (doc["mqttTopic"]) strlcpy(staged.mqttTopic, doc["mqttTopic"], sizeof(staged.mqttTopic));
+      if (doc["mqttBufferSize"]) staged.mqttBufferSize = constrain((int)doc["mqttBufferSize"], 256, 16384);
+      if (doc["groups"].is<const char*>()) strlcpy(staged.groups, doc["groups"], sizeof(staged.groups));
+
+      if (doc["i2cSdaPin"].is<int>()) staged.i2cSdaPin = doc["i2cSdaPin"];
+      if (doc["i2cSclPin"].is<int>()) staged.i2cSclPin = doc["i2cSclPin"];
+      if (doc["expanders"].is<const char*>()) strlcpy(staged.expanders, doc["expanders"], sizeof(staged.expanders));
+      if (doc["expanderIntPin"].is<int>()) staged.expanderIntPin = doc["expanderIntPin"];
+      if (doc["spiSckPin"].is<int>()) staged.spiSckPin = doc["spiSckPin"];
+      if (doc["spiMisoPin"].is<int>()) staged.spiMisoPin = doc["spiMisoPin"];
+      if (doc["spiMosiPin"].is<int>()) staged.spiMosiPin = doc["spiMosiPin"];
+      if (doc["spiCsPin"].is<int>()) staged.spiCsPin = doc["spiCsPin"];
+      if (doc["ntpServer"].is<const char*>()) strlcpy(staged.ntpServer, doc["ntpServer"], sizeof(staged.ntpServer));
+      if (doc["useMulticast"].is<bool>()) staged.useMulticast = doc["useMulticast"];
+      if (doc["multicastGroup"]) strlcpy(staged.multicastGroup, doc["multicastGroup"], sizeof(staged.multicastGroup));
+      if (doc["multicastPort"]) staged.multicastPort = doc["multicastPort"];
+      if (doc["multicastKey"] && strlen(doc["multicastKey"]) > 0) {
+        strlcpy(staged.multicastKey, doc["multicastKey"], sizeof(staged.multicastKey));
+      }
+      if (doc["useModbusTcp"].is<bool>()) staged.useModbusTcp = doc["useModbusTcp"];
+      if (doc["modbusTcpPort"].is<int>()) staged.modbusTcpPort = constrain((int)doc["modbusTcpPort"], 1, 65535);
       
-      if (doc["useSerialBridge"].is<bool>()) config.useSerialBridge = doc["useSerialBridge"];
-      if (doc["serialRxPin"]) config.serialRxPin = doc["serialRxPin"];
-      if (doc["serialTxPin"]) config.serialTxPin = doc["serialTxPin"];
-      if (doc["serialBaudRate"]) config.serialBaudRate = doc["serialBaudRate"];
+      if (doc["useSerialBridge"].is<bool>()) staged.useSerialBridge = doc["useSerialBridge"];
+      if (doc["serialRxPin"]) staged.serialRxPin = doc["serialRxPin"];
+      if (doc["serialTxPin"]) staged.serialTxPin = doc["serialTxPin"];
+      if (doc["serialBaudRate"]) staged.serialBaudRate = doc["serialBaudRate"];
+      if (doc["useSerialServer"].is<bool>()) staged.useSerialServer = doc["useSerialServer"];
+      if (doc["serialServerPort"].is<int>()) staged.serialServerPort = constrain((int)doc["serialServerPort"], 1, 65535);
+      if (doc["serialServerRfc2217"].is<bool>()) staged.serialServerRfc2217 = doc["serialServerRfc2217"];
+      if (doc["useModbus"].is<bool>()) staged.useModbus = doc["useModbus"];
+      if (doc["modbusDePin"].is<int>()) staged.modbusDePin = constrain((int)doc["modbusDePin"], -1, 39);
+      if (doc["modbusParity"].is<int>()) staged.modbusParity = constrain((int)doc["modbusParity"], 0, 2);
+      if (doc["modbusTimeoutMs"].is<int>()) staged.modbusTimeoutMs = constrain((int)doc["modbusTimeoutMs"], 20, 2000);
 
-      saveConfig();
+      saveConfig(staged);
       
-      request->send(200, "application/json", "{\"success\":true, \"message\":\"Configuration enregistrée, redémarrage...\"}");
+      reply(request, 200, "{\"success\":true, \"message\":\"Configuration enregistrée, redémarrage...\"}");
       delay(1000);
       ESP.restart();
     }
   );
 
   // API pour contrôler la connexion MQTT
-  server.on("/api/mqtt/connect", HTTP_POST, [](AsyncWebServerRequest *request){
+  route("/api/mqtt/connect", HTTP_POST, [](AsyncWebServerRequest *request){
     mqttEnabled = true;
     reconnectMQTT();
-    request->send(200, "application/json", "{\"success\":true, \"message\":\"Tentative de connexion MQTT lancée.\"}");
+    reply(request, 200, "{\"success\":true, \"message\":\"Tentative de connexion MQTT lancée.\"}");
+  });
+
+  route("/api/mqtt/disconnect", HTTP_POST, [](AsyncWebServerRequest *request){
+    disconnectMQTT();
+    reply(request, 200, "{\"success\":true, \"message\":\"MQTT déconnecté.\"}");
+  });
+
+  // Charge CPU par tâche et par core, files entre tâches
+  route("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    taskMetricsToJson(doc.to<JsonObject>());
+    JsonObject queues = doc["queues"].to<JsonObject>();
+    ioCommandStatsToJson(queues["commands"].to<JsonObject>());
+    logStatsToJson(queues["log"].to<JsonObject>());
+    mqttSchedulerStatsToJson(queues["mqtt"].to<JsonObject>());
+    memoryStatsToJson(doc["memory"].to<JsonObject>());
+    otaGuardStatsToJson(doc["ota"].to<JsonObject>());
+    sendJson(request, 200, doc);
   });
 
-  server.on("/api/mqtt/disconnect", HTTP_POST, [](AsyncWebServerRequest *request){
-    mqttEnabled = false;
-    mqttClient.disconnect();
-    request->send(200, "application/json", "{\"success\":true, \"message\":\"MQTT déconnecté.\"}");
+  // Statistiques de connexion MQTT (compteurs, histogramme des coupures, score de santé)
+  route("/api/mqtt/stats", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    mqttStatsToJson(doc.to<JsonObject>());
+    sendJson(request, 200, doc);
   });
 
   // API pour envoyer un message série
-  server.on("/api/serial/send", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+  route("/api/serial/send", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
     [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
-      JsonDocument doc;
-      if (deserializeJson(doc, (const char*)data) != DeserializationError::Ok) {
-        request->send(400, "application/json", "{\"success\":false, \"message\":\"Invalid JSON\"}");
+      size_t bodyLen;
+      const char* body = assembleBody(request, data, len, index, total, &bodyLen);
+      if (body == NULL) return;
+      JsonDocument doc(&webArena);
+      if (deserializeJson(doc, body, bodyLen) != DeserializationError::Ok) {
+        reply(request, 400, "{\"success\":false, \"message\":\"Invalid JSON\"}");
         return;
       }
       
-      if (doc["message"]) {
-        String msg = doc["message"].as<String>();
+      const char* msg = doc["message"];
+      if (msg && serialManager.portLent()) {
+        reply(request, 409, "{\"success\":false, \"message\":\"Serial port in use (TCP client or Modbus master)\"}");
+      } else if (msg) {
         serialManager.send(msg);
-        request->send(200, "application/json", "{\"success\":true, \"message\":\"Message sent\"}");
+        reply(request, 200, "{\"success\":true, \"message\":\"Message sent\"}");
       } else {
-        request->send(400, "application/json", "{\"success\":false, \"message\":\"Missing message\"}");
+        reply(request, 400, "{\"success\":false, \"message\":\"Missing message\"}");
       }
     }
   );
 
   // API pour simuler un message RX série et le publier sur MQTT
-  server.on("/api/serial/simulate-rx", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+  route("/api/serial/simulate-rx", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
     [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
-      JsonDocument doc;
-      if (deserializeJson(doc, (const char*)data) != DeserializationError::Ok) {
-        request->send(400, "application/json", "{\"success\":false, \"message\":\"Invalid JSON\"}");
+      size_t bodyLen;
+      const char* body = assembleBody(request, data, len, index, total, &bodyLen);
+      if (body == NULL) return;
+      JsonDocument doc(&webArena);
+      if (deserializeJson(doc, body, bodyLen) != DeserializationError::Ok) {
+        reply(request, 400, "{\"success\":false, \"message\":\"Invalid JSON\"}");
         return;
       }
       
-      if (doc["message"]) {
-        String msg = doc["message"].as<String>();
+      const char* msg = doc["message"];
+      if (msg) {
         serialManager.publish(msg); // Utilise la nouvelle fonction pour publier
-        serialManager.addLog("RX (Sim)", msg); // Ajoute au log local comme une simulation
-        request->send(200, "application/json", "{\"success\":true, \"message\":\"Simulated RX message published to MQTT\"}");
+        serialManager.addLog("RX (Sim)", msg, strlen(msg)); // Ajoute au log local comme une simulation
+        reply(request, 200, "{\"success\":true, \"message\":\"Simulated RX message published to MQTT\"}");
       } else {
-        request->send(400, "application/json", "{\"success\":false, \"message\":\"Missing message\"}");
+        reply(request, 400, "{\"success\":false, \"message\":\"Missing message\"}");
       }
     }
   );
 
+  // Statistiques du mode RPC série (<device>/serial/rpc)
+  route("/api/serial/rpc", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    serialManager.rpcStatsToJson(doc.to<JsonObject>());
+    sendJson(request, 200, doc);
+  });
+
+  // Serveur TCP du pont série : session en cours, réglages de ligne, débits
+  route("/api/serial/server", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    serialServerStatsToJson(doc.to<JsonObject>());
+    sendJson(request, 200, doc);
+  });
+
   // API pour récupérer les logs série
-  server.on("/api/serial/logs", HTTP_GET, [](AsyncWebServerRequest *request){
-    JsonDocument doc;
-    JsonArray logs = doc.to<JsonArray>();
-    
-    std::vector<SerialLog> serialLogs = serialManager.getLogs();
-    for (const auto& log : serialLogs) {
-      JsonObject l = logs.add<JsonObject>();
-      l["timestamp"] = log.timestamp;
-      l["direction"] = log.direction;
-      l["message"] = log.message;
+  route("/api/serial/logs", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    serialManager.logsToJson(doc.to<JsonArray>());
+
+    sendJson(request, 200, doc);
+  });
+
+  // ===== MODBUS RTU =====
+  // Valeurs en cache, lectures groupées et compteurs ; ?name=<entrée> pour une seule valeur
+  route("/api/modbus", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    const char* name = request->hasParam("name") ? request->getParam("name")->value().c_str() : NULL;
+    if (!modbusValuesToJson(doc.to<JsonObject>(), name)) {
+      reply(request, 404, "{\"success\":false, \"message\":\"Unknown Modbus register\"}");
+      return;
     }
-    
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    sendJson(request, 200, doc);
+  });
+
+  route("/api/modbus/map", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    modbusMapToJson(doc["registers"].to<JsonArray>());
+    doc["maxRegisters"] = MODBUS_MAX_REGISTERS;
+    sendJson(request, 200, doc);
+  });
+
+  // Remplace la table de registres : refusée en entier si une entrée est invalide
+  route("/api/modbus/map", HTTP_POST, [](AsyncWebServerRequest *request){}, NULL,
+    [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total){
+      size_t bodyLen;
+      const char* body = assembleBody(request, data, len, index, total, &bodyLen);
+      if (body == NULL) return;
+      JsonDocument doc(&webArena);
+      if (deserializeJson(doc, body, bodyLen) != DeserializationError::Ok) {
+        reply(request, 400, "{\"success\":false, \"message\":\"Invalid JSON\"}");
+        return;
+      }
+      JsonArrayConst entries = doc["registers"];
+      if (entries.isNull() || entries.size() > MODBUS_MAX_REGISTERS) {
+        reply(request, 400, "{\"success\":false, \"message\":\"registers: array of at most 64 entries expected\"}");
+        return;
+      }
+      // Premier passage : validation seule, la table en service reste intacte
+      int position = 0;
+      for (JsonObjectConst entry : entries) {
+        ModbusRegister r;
+        bool valid = modbusRegisterFromJson(r, entry);
+        for (int k = 0; valid && k < position; k++) {
+          valid = strcmp(entries[k]["name"] | "", r.name) != 0;   // Noms uniques (un topic chacun)
+        }
+        if (!valid) {
+          char message[96];
+          snprintf(message, sizeof(message), "{\"success\":false, \"message\":\"Invalid register entry %d\"}", position);
+          reply(request, 400, message);
+          return;
+        }
+        position++;
+      }
+      modbusRegisterCount = 0;
+      for (JsonObjectConst entry : entries) {
+        modbusRegisterFromJson(modbusRegisters[modbusRegisterCount++], entry);
+      }
+      saveIOs();
+      modbusRebuild();
+      reply(request, 200, "{\"success\":true, \"message\":\"Modbus register map saved.\"}");
+    }
+  );
+
+  // Serveur Modbus TCP : maîtres connectés, requêtes, exceptions, temps de service
+  route("/api/modbus/tcp", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    modbusTcpStatsToJson(doc.to<JsonObject>());
+    sendJson(request, 200, doc);
+  });
+
+  // Journal d'accès : latence et débit par route, clients les plus actifs
+  route("/api/access", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    accessStatsToJson(doc.to<JsonObject>());
+    sendJson(request, 200, doc);
+  });
+
+  // Dernières requêtes, la plus récente en premier (?limit=, 50 par défaut)
+  route("/api/access/log", HTTP_GET, [](AsyncWebServerRequest *request){
+    int limit = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : 50;
+    JsonDocument doc(&webArena);
+    accessLogToJson(doc["entries"].to<JsonArray>(), constrain(limit, 1, ACCESS_LOG_ENTRIES));
+    sendJson(request, 200, doc);
+  });
+
+  // ===== MISE À JOUR (image, gzip ou patch IODP, voir ota_update.h) =====
+  // curl -F firmware=@patch.iodp.gz "http://<ip>/api/ota?sha256=<empreinte de l'image finale>"
+  route("/api/ota", HTTP_POST, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    int code = otaUpdateResultToJson(doc.to<JsonObject>());
+    sendJson(request, code, doc);
+  }, [](AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final){
+    if (index == 0) request->onDisconnect(otaUpdateAbort);
+    const char* sha256 = index == 0 && request->hasParam("sha256") ? request->getParam("sha256")->value().c_str() : NULL;
+    otaUpdateReceive(sha256, index, data, len, final);
+  });
+
+  route("/api/ota", HTTP_GET, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    otaUpdateStatusToJson(doc.to<JsonObject>());
+    sendJson(request, 200, doc);
+  });
+
+  // Page ElegantOTA (/update) : son démarrage et son envoi sont servis ici, déclarés
+  // avant ElegantOTA.begin() qui ne répond donc plus qu'à la page. Même chemin que
+  // /api/ota : écritures flash placées avant chaque opération (ota_guard.h).
+  route("/ota/start", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (otaGuardActive()) {
+      replyText(request, 503, "Mise à jour déjà en cours");
+      return;
+    }
+    elegantFilesystem = request->hasParam("mode") && request->getParam("mode")->value() == "fs";
+    replyText(request, 200, "OK");
+  });
+
+  route("/ota/upload", HTTP_POST, [](AsyncWebServerRequest *request){
+    JsonDocument doc(&webArena);
+    int code = otaUpdateResultToJson(doc.to<JsonObject>());
+    replyText(request, code, code == 200 ? "OK" : doc["message"].as<const char*>());
+  }, [](AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final){
+    if (index == 0) request->onDisconnect(otaUpdateAbort);
+    otaUpdateReceive(NULL, index, data, len, final, elegantFilesystem);
   });
 
-  // ElegantOTA pour les mises à jour
   ElegantOTA.begin(&server);
+  // Requêtes sans route : journalisées sous "other"
+  server.onNotFound([](AsyncWebServerRequest *request){
+    AccessScope scope(0, request);
+    reply(request, 404, "{\"success\":false, \"message\":\"Not found\"}");
+  });
+  setupOtaGuard();
   
   server.begin();
   Serial.println("Web server started with new architecture.");
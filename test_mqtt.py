@@ -21,6 +21,9 @@ RELAY_NAMES = ["RelaisK1", "RelaisK2"]
 
 # Liste des devices pour les tests multi-ESP32
 ALL_DEVICES = ["laser", "lilygo"]  # Ajouter vos ESP32 ici
+# Groupe ciblé par le test de synchronisation par diffusion (configuré sur chaque ESP32),
+# None = diffusion à tous les appareils via all/control/...
+SYNC_GROUP = None
 
 # Dictionnaire pour suivre les commandes en attente de confirmation
 pending_commands = {}
@@ -275,8 +278,18 @@ def toggle_relay(client, relay_name, delay=2):
     time.sleep(delay)
     turn_off(client, relay_name)
 
-def synchronized_toggle_all_devices(client, relay_name="RelaisK1", delay_seconds=3):
-    """Active un relais sur TOUS les ESP32 de manière synchronisée"""
+def broadcast_control_topic(relay_name):
+    """Topic de contrôle de groupe (SYNC_GROUP) ou de diffusion à tous les appareils"""
+    if SYNC_GROUP:
+        return f"group/{SYNC_GROUP}/control/{relay_name}/set"
+    return f"all/control/{relay_name}/set"
+
+def synchronized_toggle_all_devices(client, relay_name="RelaisK1", delay_seconds=3, broadcast=False):
+    """Active un relais sur TOUS les ESP32 de manière synchronisée
+
+    broadcast=False : une commande par device (<device>/control/...)
+    broadcast=True  : une seule publication sur all/ ou group/<SYNC_GROUP>/
+    """
     print(f"\n🎬 TEST DE SYNCHRONISATION MULTI-ESP32")
     print(f"{'='*60}")
     print(f"Relais ciblé: {relay_name}")
@@ -309,21 +322,30 @@ def synchronized_toggle_all_devices(client, relay_name="RelaisK1", delay_seconds
     print(f"\n⏰ Heure d'exécution synchronisée: {exec_time_str}.{exec_us:06d}")
     print(f"\n📤 Envoi des commandes programmées...\n")
     
-    # Envoyer la commande à tous les devices
-    for device in ALL_DEVICES:
-        topic = f"{device}/control/{relay_name}/set"
-        payload_data = {
-            "state": 1,  # ON
-            "exec_at": exec_seconds,
-            "exec_at_us": exec_us
-        }
-        payload = json.dumps(payload_data)
-        
+    payload_data = {
+        "state": 1,  # ON
+        "exec_at": exec_seconds,
+        "exec_at_us": exec_us
+    }
+    payload = json.dumps(payload_data)
+    
+    if broadcast:
+        # Une seule publication : le broker la diffuse à tous les devices abonnés
+        topic = broadcast_control_topic(relay_name)
         result = client.publish(topic, payload, qos=1)
         if result.rc == mqtt.MQTT_ERR_SUCCESS:
-            print(f"  ✓ Commande envoyée à {device}")
+            print(f"  ✓ Commande diffusée sur {topic}")
         else:
-            print(f"  ✗ Échec d'envoi à {device}")
+            print(f"  ✗ Échec d'envoi sur {topic}")
+    else:
+        # Envoyer la commande à tous les devices
+        for device in ALL_DEVICES:
+            topic = f"{device}/control/{relay_name}/set"
+            result = client.publish(topic, payload, qos=1)
+            if result.rc == mqtt.MQTT_ERR_SUCCESS:
+                print(f"  ✓ Commande envoyée à {device}")
+            else:
+                print(f"  ✗ Échec d'envoi à {device}")
     
     print(f"\n⏳ Attente de l'exécution ({delay_seconds}s)...")
     print(f"🎥 FILMEZ MAINTENANT pour vérifier la synchronisation !\n")
@@ -333,12 +355,16 @@ def synchronized_toggle_all_devices(client, relay_name="RelaisK1", delay_seconds
     
     # Éteindre tous les relais
     print(f"\n📤 Extinction des relais...\n")
-    for device in ALL_DEVICES:
-        topic = f"{device}/control/{relay_name}/set"
-        payload_data = {"state": 0}  # OFF
-        payload = json.dumps(payload_data)
-        client.publish(topic, payload, qos=1)
-        print(f"  ✓ {device} éteint")
+    if broadcast:
+        client.publish(topic, json.dumps({"state": 0}), qos=1)  # OFF
+        print(f"  ✓ Extinction diffusée sur {topic}")
+    else:
+        for device in ALL_DEVICES:
+            topic = f"{device}/control/{relay_name}/set"
+            payload_data = {"state": 0}  # OFF
+            payload = json.dumps(payload_data)
+            client.publish(topic, payload, qos=1)
+            print(f"  ✓ {device} éteint")
     
     print(f"\n{'='*60}")
     print(f"✓ Test de synchronisation terminé")
@@ -381,6 +407,7 @@ def show_menu():
     print(f"{offset+6}. 🎬 TEST SYNC MULTI-ESP32 (laser + lilygo)")
     print(f"{offset+7}. 🔄 Changer de device")
     print(f"{offset+8}. Envoyer message série à l'ESP32")
+    print(f"{offset+9}. 🎬 TEST SYNC par diffusion ({'group/' + SYNC_GROUP if SYNC_GROUP else 'all'})")
     print("0. Quitter")
     print("="*50)
 
@@ -799,6 +826,10 @@ def main():
                     if msg:
                         send_serial_message_via_mqtt(client, msg)
                 
+                # Test de synchronisation par diffusion (all/ ou group/)
+                elif choice == num_relays*2 + 9:
+                    synchronized_toggle_all_devices(client, broadcast=True)
+                
                 else:
                     print("❌ Option invalide")
                 
@@ -0,0 +1,107 @@
+// Test PC des noyaux de filtrage analogique (src/analog_filter.h) : réponse à
+// un échelon de la moyenne glissante et du passe-bas, bornes des paramètres,
+// calibration deux points. Code de sortie non nul au premier écart.
+//
+//   g++ -O2 -std=c++17 -Isrc tools/analog_filter_test.cpp -o analog_filter_test
+//   ./analog_filter_test
+
+#include <math.h>
+#include <stdio.h>
+#include "analog_filter.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%s %s\n", ok ? "✓" : "✗", what);
+  if (!ok) failures++;
+}
+
+static bool near(float a, float b, float tolerance = 1e-4f) {
+  return fabsf(a - b) <= tolerance;
+}
+
+// Échelon 0 -> 1000 : la moyenne monte d'un pas par échantillon et atteint 1000 après `window`
+static void testMovingAverageStep() {
+  MovingAverage f;
+  movingAverageInit(f, 8);
+  for (int i = 0; i < 20; i++) movingAverageUpdate(f, 0.0f);
+  bool ramp = true;
+  for (int i = 1; i <= 8; i++) ramp = ramp && near(movingAverageUpdate(f, 1000.0f), 1000.0f * i / 8);
+  check(ramp, "moyenne glissante : rampe de window échantillons sur un échelon");
+  bool settled = true;
+  for (int i = 0; i < 1000; i++) settled = settled && near(movingAverageUpdate(f, 1000.0f), 1000.0f);
+  check(settled, "moyenne glissante : palier stable (re-somme exacte à chaque tour)");
+
+  movingAverageInit(f, 4);
+  check(near(movingAverageUpdate(f, 10.0f), 10.0f) && near(movingAverageUpdate(f, 20.0f), 15.0f),
+        "moyenne glissante : moyenne des échantillons reçus avant la fenêtre pleine");
+}
+
+// Passe-bas : y(n) = 1000 * (1 - (1 - alpha)^n) après l'échelon
+static void testIirStep() {
+  IirFilter f;
+  iirInit(f, 0.2f);
+  check(near(iirUpdate(f, 500.0f), 500.0f), "passe-bas : le premier échantillon initialise la sortie");
+  iirInit(f, 0.2f);
+  iirUpdate(f, 0.0f);
+  bool curve = true;
+  for (int n = 1; n <= 30; n++) curve = curve && near(iirUpdate(f, 1000.0f), 1000.0f * (1.0f - powf(0.8f, n)), 0.01f);
+  check(curve, "passe-bas : réponse exponentielle à un échelon");
+  for (int n = 0; n < 200; n++) iirUpdate(f, 1000.0f);
+  check(near(f.y, 1000.0f, 0.01f), "passe-bas : converge vers l'échelon");
+}
+
+static void testParameterClamps() {
+  MovingAverage m;
+  movingAverageInit(m, 0);
+  check(m.window == 1, "moyenne glissante : fenêtre 0 ramenée à 1");
+  movingAverageInit(m, 200);
+  check(m.window == ANALOG_MAX_WINDOW, "moyenne glissante : fenêtre bornée à ANALOG_MAX_WINDOW");
+  bool wide = true;
+  for (int i = 0; i < 3 * ANALOG_MAX_WINDOW; i++) wide = wide && isfinite(movingAverageUpdate(m, (float)i));
+  check(wide, "moyenne glissante : pas de débordement avec la fenêtre maximale");
+
+  IirFilter f;
+  iirInit(f, 0.0f);
+  check(f.alpha == 1.0f, "passe-bas : alpha 0 ramené à 1 (pas de filtrage)");
+  iirInit(f, 1.5f);
+  check(f.alpha == 1.0f, "passe-bas : alpha > 1 ramené à 1");
+  iirUpdate(f, 0.0f);
+  check(near(iirUpdate(f, 42.0f), 42.0f), "passe-bas : alpha 1 suit l'entrée");
+
+  const uint16_t readings[] = { 1000, 1002, 1004, 1006 };
+  check(near(oversampleAverage(readings, 4), 1003.0f) && oversampleAverage(readings, 0) == 0.0f,
+        "suréchantillonnage : moyenne des lectures, 0 sans lecture");
+}
+
+static void testCalibration() {
+  // 4-20 mA sur shunt 150 Ω : 600..3000 mV -> 4..20
+  LinearCalibration loop = { 600.0f, 3000.0f, 4.0f, 20.0f };
+  check(near(calibrate(loop, 600.0f), 4.0f) && near(calibrate(loop, 3000.0f), 20.0f) &&
+        near(calibrate(loop, 1800.0f), 12.0f), "calibration : points 4-20 mA");
+  check(near(calibrate(loop, 0.0f), 0.0f) && near(calibrate(loop, 3300.0f), 22.0f),
+        "calibration : extrapolée hors de inLo..inHi");
+  LinearCalibration inverted = { 0.0f, 2500.0f, 10.0f, 0.0f };
+  check(near(calibrate(inverted, 1250.0f), 5.0f), "calibration : pente négative");
+
+  LinearCalibration flat = { 1000.0f, 1000.0f, 0.0f, 10.0f };
+  check(!calibrationValid(flat), "calibration : inHi = inLo refusée");
+  check(calibrate(flat, 1234.0f) == 1234.0f, "calibration : inHi = inLo laisse passer la valeur (pas de division par zéro)");
+  LinearCalibration notFinite = { 0.0f, NAN, 0.0f, 10.0f };
+  check(!calibrationValid(notFinite), "calibration : valeur non finie refusée");
+  check(calibrationValid(loop) && calibrationValid(inverted), "calibration : 4-20 mA et pente négative acceptées");
+
+  check(deadbandExceeded(5.0f, NAN, 10.0f), "bande morte : première valeur toujours publiée");
+  check(!deadbandExceeded(109.0f, 100.0f, 10.0f) && deadbandExceeded(90.0f, 100.0f, 10.0f),
+        "bande morte : variation inférieure ignorée, égale publiée");
+}
+
+int main() {
+  testMovingAverageStep();
+  testIirStep();
+  testParameterClamps();
+  testCalibration();
+  if (failures) printf("\n❌ %d échec(s)\n", failures);
+  else printf("\n✅ Tous les tests passent\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+// Banc d'essai PC des pilotes d'extensions d'I/O (src/expander_driver.*).
+// Un bus simulé compte les transactions et les octets pour comparer les
+// stratégies d'accès sur un même scénario (entrées qui changent, rafales de
+// commandes sur les sorties).
+//
+//   g++ -O2 -std=c++17 -Isrc tools/expander_bench.cpp src/expander_driver.cpp -o expander_bench
+//   ./expander_bench [ticks] [expanders]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "expander_driver.h"
+
+// Bus simulé : un banc de registres par adresse, INT active tant qu'une entrée
+// a changé depuis la dernière lecture du port.
+class MockExpanderBus : public ExpanderBus {
+public:
+  uint32_t bytes = 0;
+  uint8_t regs[8][0x16];
+  uint16_t pins[8];        // Niveaux physiques des broches
+  uint16_t lastRead[8];
+
+  MockExpanderBus() {
+    memset(regs, 0, sizeof(regs));
+    memset(pins, 0, sizeof(pins));
+    memset(lastRead, 0, sizeof(lastRead));
+  }
+
+  bool writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, size_t length) override {
+    _transactions++;
+    bytes += 2 + length;
+    for (size_t i = 0; i < length && reg + i < sizeof(regs[0]); i++) regs[address & 7][reg + i] = data[i];
+    return true;
+  }
+  bool readRegisters(uint8_t address, uint8_t reg, uint8_t* data, size_t length) override {
+    _transactions++;
+    bytes += 3 + length;
+    int a = address & 7;
+    for (size_t i = 0; i < length; i++) {
+      uint8_t r = reg + i;
+      if (r == 0x12) data[i] = pins[a] & 0xFF;
+      else if (r == 0x13) data[i] = pins[a] >> 8;
+      else data[i] = r < sizeof(regs[0]) ? regs[a][r] : 0;
+    }
+    if (reg <= 0x13 && reg + length > 0x12) lastRead[a] = pins[a];
+    return true;
+  }
+  bool writeRaw(uint8_t, const uint8_t*, size_t length) override {
+    _transactions++;
+    bytes += 1 + length;
+    return true;
+  }
+  bool readRaw(uint8_t address, uint8_t* data, size_t length) override {
+    _transactions++;
+    bytes += 1 + length;
+    data[0] = pins[address & 7] & 0xFF;
+    lastRead[address & 7] = pins[address & 7];
+    return true;
+  }
+  bool probe(uint8_t) override {
+    _transactions++;
+    bytes += 1;
+    return true;
+  }
+
+  bool interruptLine(int count, uint16_t inputMask) const {
+    for (int a = 0; a < count; a++) {
+      if ((pins[a] ^ lastRead[a]) & inputMask) return true;
+    }
+    return false;
+  }
+};
+
+enum Strategy { PER_PIN, BATCHED_POLL, BATCHED_INTERRUPT };
+static const char* STRATEGY_NAMES[] = { "par broche (naïf)", "port complet, scrutation", "port complet, INT + coalescence" };
+
+// Moitié basse de chaque expander en entrées, moitié haute en sorties
+static const uint16_t INPUT_MASK = 0x00FF;
+
+struct Result {
+  uint32_t transactions;
+  uint32_t bytes;
+  uint32_t missed;     // Changements d'entrée non vus avant le tick suivant
+};
+
+static Result run(Strategy strategy, int ticks, int count, unsigned seed) {
+  MockExpanderBus bus;
+  ExpanderDevice devices[8];
+  for (int i = 0; i < count; i++) {
+    expanderDeviceReset(devices[i], EXPANDER_MCP23017, i, &bus);
+    devices[i].iodir = INPUT_MASK;
+    expanderDeviceInit(devices[i], strategy == BATCHED_INTERRUPT);
+  }
+  uint32_t baseTransactions = bus.transactions();
+  uint32_t baseBytes = bus.bytes;
+  uint16_t seen[8] = {0};
+  Result result = {0, 0, 0};
+  srand(seed);
+
+  for (int t = 0; t < ticks; t++) {
+    // Environ 2 % des ticks : une entrée change
+    if (rand() % 50 == 0) bus.pins[rand() % count] ^= 1u << (rand() % 8);
+
+    // Lecture des entrées
+    bool readAll = strategy == BATCHED_POLL ||
+                   (strategy == BATCHED_INTERRUPT && bus.interruptLine(count, INPUT_MASK));
+    for (int e = 0; e < count; e++) {
+      uint16_t port;
+      if (strategy == PER_PIN) {
+        // Une transaction par broche d'entrée (lecture du port, un seul bit utilisé)
+        for (int c = 0; c < 16; c++) {
+          if (!(INPUT_MASK & (1u << c))) continue;
+          expanderDeviceReadPort(devices[e], &port);
+          seen[e] = (seen[e] & ~(1u << c)) | (port & (1u << c));
+        }
+      } else if (readAll) {
+        expanderDeviceReadPort(devices[e], &port);
+        seen[e] = port & INPUT_MASK;
+      }
+      if ((seen[e] ^ bus.pins[e]) & INPUT_MASK) result.missed++;
+    }
+
+    // Environ 1 % des ticks : rafale de 8 commandes (commande synchronisée)
+    if (rand() % 100 == 0) {
+      for (int k = 0; k < 8; k++) {
+        int e = rand() % count;
+        int c = 8 + rand() % 8;
+        expanderDeviceStage(devices[e], c, rand() & 1);
+        if (strategy == PER_PIN) expanderDeviceFlush(devices[e]);
+      }
+    }
+    if (strategy != PER_PIN) {
+      for (int e = 0; e < count; e++) expanderDeviceFlush(devices[e]);
+    }
+  }
+  result.transactions = bus.transactions() - baseTransactions;
+  result.bytes = bus.bytes - baseBytes;
+  return result;
+}
+
+int main(int argc, char** argv) {
+  int ticks = argc > 1 ? atoi(argv[1]) : 10000;
+  int count = argc > 2 ? atoi(argv[2]) : 8;
+  if (count < 1 || count > 8) count = 8;
+
+  printf("%d ticks de 1 ms, %d x MCP23017 (%d entrées, %d sorties)\n\n",
+         ticks, count, count * 8, count * 8);
+  // Temps de bus à 400 kHz : ~9 bits (8 + ACK) par octet = 22.5 µs
+  printf("%-34s %14s %12s %12s %14s %10s\n", "stratégie", "transactions", "octets", "trans./tick", "µs bus/tick", "manqués");
+  for (int s = PER_PIN; s <= BATCHED_INTERRUPT; s++) {
+    Result r = run((Strategy)s, ticks, count, 42);
+    printf("%-34s %14u %12u %12.2f %14.1f %10u\n", STRATEGY_NAMES[s], r.transactions, r.bytes,
+           (double)r.transactions / ticks, r.bytes * 22.5 / ticks, r.missed);
+  }
+  return 0;
+}
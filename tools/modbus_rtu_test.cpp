@@ -0,0 +1,170 @@
+// Test PC des trames et du plan de scrutation Modbus RTU (src/modbus_rtu.*) :
+// CRC, requêtes, contrôle des réponses (exception, trame courte, CRC faux),
+// regroupement des registres et décodage. Code de sortie non nul au premier écart.
+//
+//   g++ -O2 -std=c++17 -Isrc tools/modbus_rtu_test.cpp src/modbus_rtu.cpp -o modbus_rtu_test
+//   ./modbus_rtu_test
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "modbus_rtu.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%s %s\n", ok ? "✓" : "✗", what);
+  if (!ok) failures++;
+}
+
+// Ajoute le CRC (octet de poids faible en premier) et retourne la longueur totale
+static size_t withCrc(uint8_t* frame, size_t length) {
+  uint16_t crc = modbusCrc16(frame, length);
+  frame[length] = crc & 0xFF;
+  frame[length + 1] = crc >> 8;
+  return length + 2;
+}
+
+static ModbusRegister reg(uint8_t slave, uint8_t function, uint16_t address, uint8_t type = MODBUS_TYPE_U16,
+                          uint32_t intervalMs = 1000) {
+  ModbusRegister r;
+  memset(&r, 0, sizeof(r));
+  r.slave = slave;
+  r.function = function;
+  r.address = address;
+  r.type = type;
+  r.scale = 1.0f;
+  r.intervalMs = intervalMs;
+  return r;
+}
+
+static void testFrames() {
+  const uint8_t request[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x0A };
+  check(modbusCrc16(request, sizeof(request)) == 0xCDC5, "CRC : 01 03 00 00 00 0A -> C5 CD");
+  uint8_t frame[8];
+  const uint8_t expected[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD };
+  check(modbusBuildRead(frame, 1, MODBUS_READ_HOLDING_REGISTERS, 0, 10) == 8 && !memcmp(frame, expected, 8),
+        "requête FC 3 : octets et CRC poids faible en premier");
+  check(modbusCrc16(expected, sizeof(expected)) == 0, "CRC : nul sur une trame complète");
+
+  check(modbusResponseLength(MODBUS_READ_HOLDING_REGISTERS, 10) == 25 &&
+        modbusResponseLength(MODBUS_READ_COILS, 10) == 7 && modbusResponseLength(MODBUS_READ_COILS, 8) == 6,
+        "longueur de réponse : 2 octets par registre, 8 bits par octet");
+}
+
+static void testResponses() {
+  uint8_t exception = 0;
+  uint8_t ok[16] = { 0x01, 0x03, 0x04, 0x00, 0x2A, 0x12, 0x34 };
+  size_t okLength = withCrc(ok, 7);
+  check(modbusCheckResponse(ok, okLength, 1, MODBUS_READ_HOLDING_REGISTERS, 2, &exception) == MODBUS_OK,
+        "réponse FC 3 valide");
+
+  uint8_t ex[8] = { 0x01, 0x83, 0x02 };
+  size_t exLength = withCrc(ex, 3);
+  exception = 0;
+  check(modbusCheckResponse(ex, exLength, 1, MODBUS_READ_HOLDING_REGISTERS, 2, &exception) == MODBUS_EXCEPTION &&
+        exception == 2, "exception 02 (adresse illégale) remontée avec son code");
+  check(modbusCheckResponse(ex, exLength, 1, MODBUS_READ_INPUT_REGISTERS, 2, &exception) == MODBUS_BAD_FRAME,
+        "exception d'une autre fonction : trame inattendue");
+
+  check(modbusCheckResponse(ok, 4, 1, MODBUS_READ_HOLDING_REGISTERS, 2, &exception) == MODBUS_BAD_FRAME &&
+        modbusCheckResponse(ok, 0, 1, MODBUS_READ_HOLDING_REGISTERS, 2, &exception) == MODBUS_BAD_FRAME,
+        "trame courte (< 5 octets) refusée avant le CRC");
+
+  uint8_t truncated[16] = { 0x01, 0x03, 0x04, 0x00, 0x2A };
+  size_t truncatedLength = withCrc(truncated, 5);
+  check(modbusCheckResponse(truncated, truncatedLength, 1, MODBUS_READ_HOLDING_REGISTERS, 2, &exception) ==
+        MODBUS_BAD_FRAME, "réponse tronquée avec CRC valide : longueur refusée");
+
+  uint8_t badCount[16] = { 0x01, 0x03, 0x02, 0x00, 0x2A, 0x12, 0x34 };
+  size_t badCountLength = withCrc(badCount, 7);
+  check(modbusCheckResponse(badCount, badCountLength, 1, MODBUS_READ_HOLDING_REGISTERS, 2, &exception) ==
+        MODBUS_BAD_FRAME, "octet de longueur incohérent refusé");
+
+  uint8_t corrupted[16];
+  memcpy(corrupted, ok, okLength);
+  corrupted[4] ^= 0x01;
+  check(modbusCheckResponse(corrupted, okLength, 1, MODBUS_READ_HOLDING_REGISTERS, 2, &exception) ==
+        MODBUS_CRC_ERROR, "octet altéré : erreur de CRC");
+  check(modbusCheckResponse(ok, okLength, 2, MODBUS_READ_HOLDING_REGISTERS, 2, &exception) == MODBUS_BAD_FRAME,
+        "réponse d'un autre esclave refusée");
+}
+
+static void testPlan() {
+  ModbusGroup groups[8];
+  uint8_t order[8];
+
+  // Entrées dans le désordre : 10 (F32), 0, 1 sur l'esclave 1
+  ModbusRegister gaps[] = { reg(1, 3, 10, MODBUS_TYPE_F32), reg(1, 3, 0), reg(1, 3, 1) };
+  int n = modbusPlanGroups(gaps, 3, 4, groups, 8, order);
+  check(n == 2 && groups[0].start == 0 && groups[0].count == 2 && groups[0].members == 2 &&
+        groups[1].start == 10 && groups[1].count == 2 && groups[1].members == 1,
+        "plan : coupure sur un trou de 8 registres (maxGap 4)");
+  check(order[0] == 1 && order[1] == 2 && order[2] == 0, "plan : membres triés par adresse");
+  n = modbusPlanGroups(gaps, 3, 8, groups, 8, order);
+  check(n == 1 && groups[0].start == 0 && groups[0].count == 12 && groups[0].members == 3,
+        "plan : trou de 8 registres comblé avec maxGap 8");
+
+  ModbusRegister fits[] = { reg(1, 3, 0), reg(1, 3, 123, MODBUS_TYPE_U32) };
+  n = modbusPlanGroups(fits, 2, 200, groups, 8, order);
+  check(n == 1 && groups[0].count == MODBUS_MAX_READ_REGISTERS, "plan : 125 registres en une lecture");
+  ModbusRegister span[] = { reg(1, 3, 0), reg(1, 3, 124, MODBUS_TYPE_U32) };
+  n = modbusPlanGroups(span, 2, 200, groups, 8, order);
+  check(n == 2 && groups[0].count == 1 && groups[1].start == 124 && groups[1].count == 2,
+        "plan : coupure au-delà de 125 registres");
+  ModbusRegister bits[] = { reg(1, 1, 0), reg(1, 1, 1999), reg(1, 1, 2000) };
+  n = modbusPlanGroups(bits, 3, 200, groups, 8, order);
+  check(n == 2 && groups[0].count == MODBUS_MAX_READ_BITS && groups[1].start == 2000,
+        "plan : bits bornés à 2000 par lecture");
+
+  ModbusRegister mixed[] = { reg(2, 3, 0), reg(1, 4, 0, MODBUS_TYPE_U16, 500), reg(1, 3, 1),
+                             reg(1, 3, 0, MODBUS_TYPE_U16, 200) };
+  n = modbusPlanGroups(mixed, 4, 10, groups, 8, order);
+  check(n == 3 && groups[0].slave == 1 && groups[0].function == 3 && groups[0].members == 2 &&
+        groups[0].intervalMs == 200 && groups[1].function == 4 && groups[2].slave == 2,
+        "plan : esclaves et fonctions séparés, intervalle le plus court du groupe");
+  n = modbusPlanGroups(mixed, 4, 10, groups, 2, order);
+  check(n == 2, "plan : nombre de groupes borné par maxGroups");
+}
+
+static void testDecode() {
+  uint32_t raw;
+  float value;
+  ModbusGroup g = { 1, 3, 100, 6, 1000, 0, 3 };
+  const uint8_t data[] = { 0xFF, 0x38, 0x00, 0x01, 0x00, 0x02, 0x42, 0x28, 0x00, 0x00, 0x00, 0x00 };
+
+  ModbusRegister s16 = reg(1, 3, 100, MODBUS_TYPE_S16);
+  s16.scale = 0.1f;
+  modbusDecode(s16, g, data, &raw, &value);
+  check(raw == 0xFF38 && fabsf(value + 20.0f) < 1e-4f, "décodage S16 avec échelle (-200 x 0.1)");
+
+  ModbusRegister u32 = reg(1, 3, 101, MODBUS_TYPE_U32);
+  modbusDecode(u32, g, data, &raw, &value);
+  check(raw == 0x00010002, "décodage U32 poids fort en premier");
+  u32.swapWords = 1;
+  modbusDecode(u32, g, data, &raw, &value);
+  check(raw == 0x00020001, "décodage U32 mots inversés");
+
+  ModbusRegister f32 = reg(1, 3, 103, MODBUS_TYPE_F32);
+  modbusDecode(f32, g, data, &raw, &value);
+  check(value == 42.0f, "décodage F32 (0x42280000 = 42.0)");
+
+  ModbusGroup coils = { 1, 1, 0, 16, 1000, 0, 1 };
+  const uint8_t bitData[] = { 0x05, 0x80 };
+  ModbusRegister bit = reg(1, 1, 2, MODBUS_TYPE_BOOL);
+  modbusDecode(bit, coils, bitData, &raw, &value);
+  bool second = raw == 1;
+  bit.address = 15;
+  modbusDecode(bit, coils, bitData, &raw, &value);
+  check(second && raw == 1 && value == 1.0f, "décodage des bits, poids faible en premier");
+}
+
+int main() {
+  testFrames();
+  testResponses();
+  testPlan();
+  testDecode();
+  if (failures) printf("\n❌ %d échec(s)\n", failures);
+  else printf("\n✅ Tous les tests passent\n");
+  return failures ? 1 : 0;
+}
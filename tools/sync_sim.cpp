@@ -0,0 +1,468 @@
+// Simulateur PC de la commutation synchronisée (esp32/time/sync + exec_at).
+// N appareils simulés, chacun avec son oscillateur (dérive en ppm, marche
+// aléatoire) et le modèle d'horloge du firmware (src/clock_model.*). Le maître
+// (test_mqtt.py) diffuse l'heure et les compensations de latence mesurées par
+// ping ; le réseau tire une latence par message. Chaque commande exec_at est
+// exécutée au premier tour de la tâche temps réel où l'heure du modèle atteint
+// l'échéance (processScheduledCommands). Résultat : distribution de l'écart
+// entre appareils pour une même commande. Même graine, même résultat.
+//
+// Garde-fou de régression : avec compensation (mean, min), p99 et max de l'écart
+// doivent rester sous --max-p99 et --max-skew, sinon code de sortie 2. Sans
+// compensation (none), l'écart reflète la latence propre à chaque appareil et
+// l'incertitude annoncée (20 ms) laisse passer les messages retardés : référence
+// seulement, non bornée. Avant le rejet des échantillons aberrants du modèle
+// (clockModelSample), un seul message retardé faisait sauter l'horloge d'un
+// appareil ; avec compensation l'incertitude annoncée (1 ms) n'en rendait pas
+// compte et mean finissait derrière none (p99 28 ms, max 120 ms).
+//
+//   g++ -O2 -std=c++17 -Isrc tools/sync_sim.cpp src/clock_model.cpp -o sync_sim
+//   ./sync_sim --devices 8 --sync-interval 10 --compensation min
+//   ./sync_sim --sweep 1,5,10,30             # intervalle de synchronisation
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <random>
+#include <vector>
+#include "clock_model.h"
+#include "time_sync_config.h"
+
+// Valeurs de test_mqtt.py
+#define MASTER_EPOCH_US                   1700000000000000ULL
+#define PING_WINDOW                       20
+
+enum Compensation { COMP_NONE, COMP_MEAN, COMP_MIN };
+static const char* COMPENSATION_NAMES[] = { "none", "mean", "min" };
+
+struct Options {
+  int devices = 4;
+  double durationS = 3600;
+  double warmupS = 60;
+  double syncIntervalS = 10;
+  double pingIntervalS = 5;
+  double commandIntervalS = 2;
+  double leadMs = 500;
+  double ppm = 20;             // Dérive tirée dans [-ppm, +ppm]
+  double wanderPpm = 0.01;     // Marche aléatoire de la dérive, écart-type par seconde
+  double latencyUs = 1500;     // Latence réseau de base (un sens)
+  double spreadUs = 1000;      // Latence de base propre à chaque appareil, dans [0, spread]
+  double jitterUs = 500;       // Gigue exponentielle par message (moyenne)
+  double spikeProb = 0.02;     // Probabilité d'un pic de latence
+  double spikeUs = 15000;
+  double rxJitterUs = 200;     // Traitement côté appareil (tâche MQTT), exponentiel
+  double tickUs = 1000;        // Tour de la tâche temps réel
+  double execJitterUs = 20;
+  Compensation compensation = COMP_MEAN;
+  ClockModelParams params = TIME_CLOCK_MODEL_PARAMS;
+  unsigned long seed = 1;
+  const char* csv = NULL;
+  double maxP99Us = TIME_GOOD_UNCERTAINTY_US;   // Bornes de régression (avec compensation)
+  double maxSkewUs = 2 * TIME_GOOD_UNCERTAINTY_US;
+};
+
+struct Device {
+  ClockModel model;
+  // Oscillateur : local(t) = lastLocal + (t - lastT) * (1 + ppm / 1e6)
+  double ppm, lastT, lastLocal;
+  double phaseUs;              // Phase des tours de la tâche temps réel
+  double baseLatencyUs;
+  std::deque<double> rtts;
+  uint32_t compensationUs;
+  uint32_t version;            // Incrémenté à chaque changement du modèle ou de l'oscillateur
+  std::vector<int> pending;    // Commandes reçues, pas encore exécutées
+  std::vector<double> jitter;  // Par commande
+
+  double local(double t) const { return lastLocal + (t - lastT) * (1.0 + ppm / 1e6); }
+  double trueAt(double localUs) const { return lastT + (localUs - lastLocal) / (1.0 + ppm / 1e6); }
+};
+
+struct Command {
+  uint64_t execAtUs;           // Temps maître
+  std::vector<double> executedT;   // Temps vrai, NAN si non exécutée
+  int rejected;
+};
+
+enum EventType { SYNC_SEND, SYNC_RECV, PING_DONE, COMMAND_SEND, COMMAND_RECV, EXECUTE, WANDER };
+
+struct Event {
+  double t;
+  EventType type;
+  int device;
+  int command;
+  uint64_t value;              // SYNC_RECV : échantillon ; EXECUTE : version
+  bool operator<(const Event& o) const { return t > o.t; }   // File de priorité : le plus tôt d'abord
+};
+
+class Simulation {
+public:
+  explicit Simulation(const Options& o) : opt(o), rng(o.seed) {}
+
+  std::vector<double> skews;          // Écart max - min par commande (µs)
+  std::vector<double> errors;         // Exécution - échéance, tous appareils (µs)
+  std::vector<std::vector<double>> deviceErrors;
+  int rejected = 0, missed = 0, commandsMeasured = 0;
+
+  void run() {
+    devices.resize(opt.devices);
+    deviceErrors.assign(opt.devices, {});
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (Device& d : devices) {
+      clockModelReset(d.model);
+      d.ppm = (unit(rng) * 2 - 1) * opt.ppm;
+      d.lastT = 0;
+      d.lastLocal = 1e6 + unit(rng) * 10e6;     // esp_timer : quelques secondes après le boot
+      d.phaseUs = unit(rng) * opt.tickUs;
+      d.baseLatencyUs = opt.latencyUs + unit(rng) * opt.spreadUs;
+      d.compensationUs = 0;
+      d.version = 0;
+    }
+    double end = opt.durationS * 1e6;
+    push({unit(rng) * opt.syncIntervalS * 1e6, SYNC_SEND, -1, -1, 0});
+    for (int i = 0; i < opt.devices; i++) {
+      push({unit(rng) * opt.pingIntervalS * 1e6, PING_DONE, i, -1, 0});
+      push({1e6, WANDER, i, -1, 0});
+    }
+    push({opt.commandIntervalS * 1e6, COMMAND_SEND, -1, -1, 0});
+
+    while (!events.empty()) {
+      Event e = events.top();
+      events.pop();
+      if (e.t > end + 10e6) break;
+      switch (e.type) {
+        case SYNC_SEND: onSyncSend(e, end); break;
+        case SYNC_RECV: onSyncRecv(e); break;
+        case PING_DONE: onPing(e, end); break;
+        case COMMAND_SEND: onCommandSend(e, end); break;
+        case COMMAND_RECV: onCommandRecv(e); break;
+        case EXECUTE: onExecute(e); break;
+        case WANDER: onWander(e, end); break;
+      }
+    }
+    collect();
+  }
+
+  double meanDriftErrorPpm() const {
+    // Dérive estimée par le modèle contre dérive réelle (driftPpm > 0 : l'oscillateur retarde)
+    double sum = 0;
+    for (const Device& d : devices) sum += fabs(d.model.driftPpm + d.ppm / (1 + d.ppm / 1e6));
+    return sum / devices.size();
+  }
+
+  const std::vector<Device>& deviceList() const { return devices; }
+
+private:
+  Options opt;
+  std::mt19937_64 rng;
+  std::vector<Device> devices;
+  std::vector<Command> commands;
+  std::priority_queue<Event> events;
+
+  void push(const Event& e) { events.push(e); }
+
+  double exponential(double mean) {
+    if (mean <= 0) return 0;
+    return std::exponential_distribution<double>(1.0 / mean)(rng);
+  }
+
+  double oneWay(const Device& d) {
+    double latency = d.baseLatencyUs + exponential(opt.jitterUs);
+    if (std::uniform_real_distribution<double>(0.0, 1.0)(rng) < opt.spikeProb) latency += exponential(opt.spikeUs);
+    return latency;
+  }
+
+  static uint64_t masterTime(double t) { return MASTER_EPOCH_US + (uint64_t)llround(t); }
+
+  // Le maître envoie son heure et la compensation de chaque appareil (un seul message)
+  void onSyncSend(const Event& e, double end) {
+    for (int i = 0; i < opt.devices; i++) {
+      uint64_t sample = masterTime(e.t) + devices[i].compensationUs;
+      push({e.t + oneWay(devices[i]) + exponential(opt.rxJitterUs), SYNC_RECV, i, -1, sample});
+    }
+    if (e.t + opt.syncIntervalS * 1e6 < end) push({e.t + opt.syncIntervalS * 1e6, SYNC_SEND, -1, -1, 0});
+  }
+
+  void onSyncRecv(const Event& e) {
+    Device& d = devices[e.device];
+    // Même classement que timeSyncOnMqttSample()
+    uint32_t uncertainty = d.compensationUs > 0 ? TIME_MQTT_UNCERTAINTY_US : TIME_MQTT_UNCOMPENSATED_UNCERTAINTY_US;
+    clockModelSample(d.model, opt.params, TIME_SOURCE_MQTT, (int64_t)llround(d.local(e.t)), e.value, uncertainty);
+    changed(e.device, e.t);
+  }
+
+  // Ping aller-retour (pong envoyé directement par la tâche MQTT) : compensation = RTT / 2
+  void onPing(const Event& e, double end) {
+    Device& d = devices[e.device];
+    double rtt = oneWay(d) + exponential(opt.rxJitterUs) + oneWay(d);
+    d.rtts.push_back(rtt);
+    if (d.rtts.size() > PING_WINDOW) d.rtts.pop_front();
+    std::vector<double> sorted(d.rtts.begin(), d.rtts.end());
+    std::sort(sorted.begin(), sorted.end());
+    double estimate = 0;
+    if (opt.compensation == COMP_MEAN) {
+      // test_mqtt.py : moyenne des RTT inférieurs à 3 x la médiane
+      double median = sorted[sorted.size() / 2], sum = 0;
+      int n = 0;
+      for (double r : sorted) if (r < median * 3) { sum += r; n++; }
+      estimate = n ? sum / n / 2 : 0;
+    } else if (opt.compensation == COMP_MIN) {
+      estimate = sorted.front() / 2;   // Chemin le moins chargé : la gigue ne s'y ajoute pas
+    }
+    d.compensationUs = (uint32_t)llround(estimate);
+    if (e.t + opt.pingIntervalS * 1e6 < end) push({e.t + opt.pingIntervalS * 1e6, PING_DONE, e.device, -1, 0});
+  }
+
+  void onWander(const Event& e, double end) {
+    Device& d = devices[e.device];
+    d.lastLocal = d.local(e.t);
+    d.lastT = e.t;
+    d.ppm += std::normal_distribution<double>(0.0, opt.wanderPpm)(rng);
+    changed(e.device, e.t);
+    if (e.t + 1e6 < end) push({e.t + 1e6, WANDER, e.device, -1, 0});
+  }
+
+  void onCommandSend(const Event& e, double end) {
+    Command c;
+    c.execAtUs = masterTime(e.t + opt.leadMs * 1000);
+    c.executedT.assign(opt.devices, NAN);
+    c.rejected = 0;
+    commands.push_back(c);
+    int index = commands.size() - 1;
+    for (int i = 0; i < opt.devices; i++) {
+      push({e.t + oneWay(devices[i]) + exponential(opt.rxJitterUs), COMMAND_RECV, i, index, 0});
+    }
+    if (e.t + opt.commandIntervalS * 1e6 < end) push({e.t + opt.commandIntervalS * 1e6, COMMAND_SEND, -1, -1, 0});
+  }
+
+  void onCommandRecv(const Event& e) {
+    Device& d = devices[e.device];
+    // scheduleCommand() : exec_at refusé sans horloge fiable
+    uint32_t u = clockModelUncertainty(d.model, opt.params, (int64_t)llround(d.local(e.t)));
+    if (!d.model.valid || u > TIME_REJECT_UNCERTAINTY_US) {
+      commands[e.command].rejected++;
+      return;
+    }
+    if ((int)d.jitter.size() < (int)commands.size()) d.jitter.resize(commands.size() * 2, 0);
+    d.jitter[e.command] = exponential(opt.execJitterUs);
+    d.pending.push_back(e.command);
+    push({executionTime(d, e.command, e.t), EXECUTE, e.device, e.command, d.version});
+  }
+
+  void onExecute(const Event& e) {
+    Device& d = devices[e.device];
+    if (e.value != d.version) return;    // Recalculée depuis (modèle ou oscillateur changé)
+    auto it = std::find(d.pending.begin(), d.pending.end(), e.command);
+    if (it == d.pending.end()) return;
+    d.pending.erase(it);
+    commands[e.command].executedT[e.device] = e.t;
+  }
+
+  // Modèle ou oscillateur changé : les échéances en attente sont recalculées
+  void changed(int device, double now) {
+    Device& d = devices[device];
+    d.version++;
+    for (int c : d.pending) push({executionTime(d, c, now), EXECUTE, device, c, d.version});
+  }
+
+  // Premier tour de la tâche temps réel, à partir de now, où le modèle atteint l'échéance
+  double executionTime(const Device& d, int command, double now) {
+    uint64_t target = commands[command].execAtUs;
+    int64_t localUs = (int64_t)ceil(d.local(now));
+    if (clockModelPredict(d.model, localUs) < target) {
+      double rate = 1.0 + d.model.driftPpm / 1e6;
+      int64_t estimate = d.model.localRefUs + (int64_t)ceil((double)(int64_t)(target - d.model.masterRefUs) / rate);
+      if (estimate > localUs) localUs = estimate;
+      while (clockModelPredict(d.model, localUs) < target) localUs++;
+    }
+    double tick = d.phaseUs + ceil((localUs - d.phaseUs) / opt.tickUs) * opt.tickUs;
+    return d.trueAt(tick) + d.jitter[command];
+  }
+
+  void collect() {
+    for (size_t c = 0; c < commands.size(); c++) {
+      const Command& cmd = commands[c];
+      double deadline = (double)(cmd.execAtUs - MASTER_EPOCH_US);
+      if (deadline < opt.warmupS * 1e6) continue;
+      rejected += cmd.rejected;
+      double lo = INFINITY, hi = -INFINITY;
+      int executed = 0;
+      for (int i = 0; i < opt.devices; i++) {
+        double t = cmd.executedT[i];
+        if (isnan(t)) continue;
+        executed++;
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+        errors.push_back(t - deadline);
+        deviceErrors[i].push_back(t - deadline);
+      }
+      missed += opt.devices - executed - cmd.rejected;
+      if (executed >= 2) skews.push_back(hi - lo);
+      commandsMeasured++;
+    }
+  }
+};
+
+static double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  double k = (v.size() - 1) * p / 100.0;
+  size_t lo = (size_t)k, hi = std::min(lo + 1, v.size() - 1);
+  return v[lo] + (v[hi] - v[lo]) * (k - lo);
+}
+
+static double mean(const std::vector<double>& v) {
+  double s = 0;
+  for (double x : v) s += x;
+  return v.empty() ? 0 : s / v.size();
+}
+
+static bool withinBounds(const Options& opt, const Simulation& sim) {
+  if (opt.compensation == COMP_NONE) return true;
+  return percentile(sim.skews, 99) <= opt.maxP99Us && percentile(sim.skews, 100) <= opt.maxSkewUs;
+}
+
+static void printDetailed(const Options& opt, Simulation& sim) {
+  printf("%d appareils, %.0f s simulées (mesure après %.0f s), synchro toutes les %.1f s, compensation %s, graine %lu\n",
+         opt.devices, opt.durationS, opt.warmupS, opt.syncIntervalS, COMPENSATION_NAMES[opt.compensation], opt.seed);
+  printf("oscillateurs ±%.1f ppm (marche %.3f ppm/√s), latence %.0f µs + [0, %.0f] par appareil + gigue %.0f µs, pics %.1f %% de %.0f µs\n\n",
+         opt.ppm, opt.wanderPpm, opt.latencyUs, opt.spreadUs, opt.jitterUs, opt.spikeProb * 100, opt.spikeUs);
+
+  printf("Écart entre appareils (%zu commandes)\n", sim.skews.size());
+  printf("  p50 %8.0f µs   p90 %8.0f µs   p99 %8.0f µs   p99.9 %8.0f µs   max %8.0f µs\n",
+         percentile(sim.skews, 50), percentile(sim.skews, 90), percentile(sim.skews, 99),
+         percentile(sim.skews, 99.9), percentile(sim.skews, 100));
+  printf("Retard sur l'échéance (tous appareils)\n");
+  printf("  moy %8.0f µs   p1 %8.0f µs   p50 %8.0f µs   p99 %8.0f µs\n",
+         mean(sim.errors), percentile(sim.errors, 1), percentile(sim.errors, 50), percentile(sim.errors, 99));
+  if (sim.rejected || sim.missed) printf("  %d refusée(s) (horloge), %d non exécutée(s)\n", sim.rejected, sim.missed);
+
+  printf("\n%-8s %10s %12s %12s %12s %12s %14s\n", "appareil", "ppm réel", "ppm estimé", "latence µs", "moy µs", "p99 |µs|", "compensation");
+  const std::vector<Device>& devices = sim.deviceList();
+  for (size_t i = 0; i < devices.size(); i++) {
+    std::vector<double> absErr;
+    for (double x : sim.deviceErrors[i]) absErr.push_back(fabs(x));
+    printf("%-8zu %10.2f %12.2f %12.0f %12.0f %12.0f %14u\n", i, devices[i].ppm,
+           devices[i].model.driftKnown ? -devices[i].model.driftPpm : NAN, devices[i].baseLatencyUs,
+           mean(sim.deviceErrors[i]), percentile(absErr, 99), devices[i].compensationUs);
+  }
+}
+
+static void writeCsv(const char* path, Simulation& sim) {
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    fprintf(stderr, "impossible d'écrire %s\n", path);
+    return;
+  }
+  fprintf(f, "command,skew_us\n");
+  for (size_t i = 0; i < sim.skews.size(); i++) fprintf(f, "%zu,%.1f\n", i, sim.skews[i]);
+  fclose(f);
+}
+
+static void usage() {
+  printf("sync_sim [options]\n"
+         "  --devices N            appareils simulés (4)\n"
+         "  --duration S           durée simulée (3600)\n"
+         "  --warmup S             commandes ignorées avant (60)\n"
+         "  --sync-interval S      période de esp32/time/sync (10)\n"
+         "  --ping-interval S      période des pings de compensation (5)\n"
+         "  --compensation M       none | mean (test_mqtt.py) | min (mean)\n"
+         "  --command-interval S   période des commandes exec_at (2)\n"
+         "  --lead MS              exec_at = maintenant + MS (500)\n"
+         "  --ppm P                dérive des oscillateurs dans [-P, P] (20)\n"
+         "  --wander P             marche aléatoire de la dérive, ppm/√s (0.01)\n"
+         "  --latency US           latence réseau de base (1500)\n"
+         "  --spread US            latence propre à chaque appareil, dans [0, US] (1000)\n"
+         "  --jitter US            gigue exponentielle moyenne (500)\n"
+         "  --spike-prob P         probabilité d'un pic de latence (0.02)\n"
+         "  --spike US             pic moyen (15000)\n"
+         "  --rx-jitter US         traitement côté appareil (200)\n"
+         "  --tick US              tour de la tâche temps réel (1000)\n"
+         "  --drift-interval S     base de temps de la mesure de dérive (300)\n"
+         "  --drift-alpha A        lissage de la dérive (0.25)\n"
+         "  --seed N               graine (1)\n"
+         "  --sweep S1,S2,...      compare plusieurs intervalles de synchronisation\n"
+         "  --csv FICHIER          écart par commande\n"
+         "  --max-p99 US           borne du p99 de l'écart, avec compensation (5000)\n"
+         "  --max-skew US          borne de l'écart maximal, avec compensation (10000)\n"
+         "code de sortie 2 si une borne est dépassée\n");
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  const char* sweep = NULL;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!strcmp(a, "-h") || !strcmp(a, "--help")) { usage(); return 0; }
+    if (!v) { usage(); return 1; }
+    i++;
+    if (!strcmp(a, "--devices")) opt.devices = std::max(2, atoi(v));
+    else if (!strcmp(a, "--duration")) opt.durationS = atof(v);
+    else if (!strcmp(a, "--warmup")) opt.warmupS = atof(v);
+    else if (!strcmp(a, "--sync-interval")) opt.syncIntervalS = atof(v);
+    else if (!strcmp(a, "--ping-interval")) opt.pingIntervalS = atof(v);
+    else if (!strcmp(a, "--command-interval")) opt.commandIntervalS = atof(v);
+    else if (!strcmp(a, "--lead")) opt.leadMs = atof(v);
+    else if (!strcmp(a, "--ppm")) opt.ppm = atof(v);
+    else if (!strcmp(a, "--wander")) opt.wanderPpm = atof(v);
+    else if (!strcmp(a, "--latency")) opt.latencyUs = atof(v);
+    else if (!strcmp(a, "--spread")) opt.spreadUs = atof(v);
+    else if (!strcmp(a, "--jitter")) opt.jitterUs = atof(v);
+    else if (!strcmp(a, "--spike-prob")) opt.spikeProb = atof(v);
+    else if (!strcmp(a, "--spike")) opt.spikeUs = atof(v);
+    else if (!strcmp(a, "--rx-jitter")) opt.rxJitterUs = atof(v);
+    else if (!strcmp(a, "--tick")) opt.tickUs = atof(v);
+    else if (!strcmp(a, "--drift-interval")) opt.params.driftMinIntervalS = atoi(v);
+    else if (!strcmp(a, "--drift-alpha")) opt.params.driftEmaAlpha = atof(v);
+    else if (!strcmp(a, "--seed")) opt.seed = strtoul(v, NULL, 10);
+    else if (!strcmp(a, "--sweep")) sweep = v;
+    else if (!strcmp(a, "--csv")) opt.csv = v;
+    else if (!strcmp(a, "--max-p99")) opt.maxP99Us = atof(v);
+    else if (!strcmp(a, "--max-skew")) opt.maxSkewUs = atof(v);
+    else if (!strcmp(a, "--compensation")) {
+      if (!strcmp(v, "none")) opt.compensation = COMP_NONE;
+      else if (!strcmp(v, "mean")) opt.compensation = COMP_MEAN;
+      else if (!strcmp(v, "min")) opt.compensation = COMP_MIN;
+      else { usage(); return 1; }
+    } else { usage(); return 1; }
+  }
+  if (opt.syncIntervalS <= 0 || opt.pingIntervalS <= 0 || opt.commandIntervalS <= 0 || opt.tickUs <= 0) {
+    usage();
+    return 1;
+  }
+
+  if (!sweep) {
+    Simulation sim(opt);
+    sim.run();
+    printDetailed(opt, sim);
+    if (opt.csv) writeCsv(opt.csv, sim);
+    if (withinBounds(opt, sim)) return 0;
+    printf("\n❌ Écart hors bornes (p99 %.0f µs, max %.0f µs)\n", opt.maxP99Us, opt.maxSkewUs);
+    return 2;
+  }
+
+  // Balayage : même graine, seuls l'intervalle de synchronisation et la compensation changent
+  printf("%d appareils, %.0f s, graine %lu - écart entre appareils (µs)\n\n", opt.devices, opt.durationS, opt.seed);
+  printf("%-10s %-6s %10s %10s %10s %10s %12s  %s\n", "synchro s", "comp.", "p50", "p99", "p99.9", "max", "|ppm| résid.", "bornes");
+  bool ok = true;
+  for (const char* p = sweep; p && *p; p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL) {
+    for (int c = COMP_NONE; c <= COMP_MIN; c++) {
+      Options o = opt;
+      o.syncIntervalS = atof(p);
+      o.compensation = (Compensation)c;
+      if (o.syncIntervalS <= 0) continue;
+      Simulation sim(o);
+      sim.run();
+      bool within = withinBounds(o, sim);
+      ok = ok && within;
+      printf("%-10.1f %-6s %10.0f %10.0f %10.0f %10.0f %12.2f  %s\n", o.syncIntervalS, COMPENSATION_NAMES[c],
+             percentile(sim.skews, 50), percentile(sim.skews, 99), percentile(sim.skews, 99.9),
+             percentile(sim.skews, 100), sim.meanDriftErrorPpm(), c == COMP_NONE ? "-" : within ? "ok" : "❌");
+    }
+  }
+  return ok ? 0 : 2;
+}